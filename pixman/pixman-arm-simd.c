@@ -250,6 +250,8 @@ _pixman_implementation_create_arm_simd (pixman_implementation_t *fallback)
 {
     pixman_implementation_t *imp = _pixman_implementation_create (fallback, arm_simd_fast_paths);
 
+    imp->name = "arm-simd";
+
     imp->blt = arm_simd_blt;
     imp->fill = arm_simd_fill;
 
@@ -0,0 +1,2898 @@
+/*
+ * Copyright © 2026 The Pixman Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Based on the SSE2 implementation in pixman-sse2.c. All arithmetic is
+ * done exactly the same way as there, just on eight pixels at a time, so
+ * the results are bit-identical to the SSE2 and C paths.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <float.h>
+#include <math.h>
+#include <immintrin.h> /* for AVX2 intrinsics */
+#include "pixman-private.h"
+#include "pixman-combine32.h"
+#include "pixman-inlines.h"
+
+/* As in the SSE2 implementation, the float combiners are only used where
+ * the C code doesn't run on the x87 unit.
+ */
+#if defined (__x86_64__) || defined (__amd64__) || defined (_M_AMD64)
+#define AVX2_FLOAT_MATCHES_C
+#endif
+
+static __m256i mask_0080;
+static __m256i mask_00ff;
+static __m256i mask_0101;
+static __m256i mask_ff000000;
+
+/*
+ * Single pixel helpers, used for the unaligned heads and tails of
+ * scanlines. These are the same as the 1x128 functions in the SSE2
+ * implementation.
+ */
+static force_inline __m128i
+unpack_32_1x128 (uint32_t data)
+{
+    return _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (data), _mm_setzero_si128 ());
+}
+
+static force_inline __m128i
+expand_alpha_1x128 (__m128i data)
+{
+    return _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (data,
+						     _MM_SHUFFLE (3, 3, 3, 3)),
+				_MM_SHUFFLE (3, 3, 3, 3));
+}
+
+static force_inline __m128i
+expand_alpha_rev_1x128 (__m128i data)
+{
+    return _mm_shufflelo_epi16 (data, _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline __m128i
+expand_pixel_8_1x128 (uint8_t data)
+{
+    return _mm_shufflelo_epi16 (
+	unpack_32_1x128 ((uint32_t)data), _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline __m128i
+pix_multiply_1x128 (__m128i data,
+		    __m128i alpha)
+{
+    return _mm_mulhi_epu16 (_mm_adds_epu16 (_mm_mullo_epi16 (data, alpha),
+					    _mm256_castsi256_si128 (mask_0080)),
+			    _mm256_castsi256_si128 (mask_0101));
+}
+
+static force_inline __m128i
+negate_1x128 (__m128i data)
+{
+    return _mm_xor_si128 (data, _mm256_castsi256_si128 (mask_00ff));
+}
+
+static force_inline __m128i
+over_1x128 (__m128i src, __m128i alpha, __m128i dst)
+{
+    return _mm_adds_epu8 (src, pix_multiply_1x128 (dst, negate_1x128 (alpha)));
+}
+
+static force_inline __m128i
+in_over_1x128 (__m128i* src, __m128i* alpha, __m128i* mask, __m128i* dst)
+{
+    return over_1x128 (pix_multiply_1x128 (*src, *mask),
+		       pix_multiply_1x128 (*alpha, *mask),
+		       *dst);
+}
+
+static force_inline uint32_t
+pack_1x128_32 (__m128i data)
+{
+    return _mm_cvtsi128_si32 (_mm_packus_epi16 (data, _mm_setzero_si128 ()));
+}
+
+static force_inline uint32_t
+core_combine_over_u_pixel_avx2 (uint32_t src, uint32_t dst)
+{
+    uint8_t a;
+    __m128i xmms;
+
+    a = src >> 24;
+
+    if (a == 0xff)
+    {
+	return src;
+    }
+    else if (src)
+    {
+	xmms = unpack_32_1x128 (src);
+	return pack_1x128_32 (
+	    over_1x128 (xmms, expand_alpha_1x128 (xmms),
+			unpack_32_1x128 (dst)));
+    }
+
+    return dst;
+}
+
+static force_inline uint32_t
+combine1 (const uint32_t *ps, const uint32_t *pm)
+{
+    uint32_t s = *ps;
+
+    if (pm)
+    {
+	__m128i ms, mm;
+
+	mm = unpack_32_1x128 (*pm);
+	mm = expand_alpha_1x128 (mm);
+
+	ms = unpack_32_1x128 (s);
+	ms = pix_multiply_1x128 (ms, mm);
+
+	s = pack_1x128_32 (ms);
+    }
+
+    return s;
+}
+
+/*
+ * Eight pixel helpers. Unpacking works within each 128 bit lane, so
+ * the "lo" half holds pixels 0, 1, 4, 5 and the "hi" half holds pixels
+ * 2, 3, 6, 7; packing puts them back in their original order.
+ */
+static force_inline void
+unpack_256_2x256 (__m256i data, __m256i* data_lo, __m256i* data_hi)
+{
+    *data_lo = _mm256_unpacklo_epi8 (data, _mm256_setzero_si256 ());
+    *data_hi = _mm256_unpackhi_epi8 (data, _mm256_setzero_si256 ());
+}
+
+static force_inline __m256i
+pack_2x256_256 (__m256i lo, __m256i hi)
+{
+    return _mm256_packus_epi16 (lo, hi);
+}
+
+static force_inline int
+is_opaque_256 (__m256i x)
+{
+    __m256i ffs = _mm256_cmpeq_epi8 (x, x);
+
+    return (_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (x, ffs)) & 0x88888888)
+	== 0x88888888;
+}
+
+static force_inline int
+is_zero_256 (__m256i x)
+{
+    return _mm256_movemask_epi8 (
+	_mm256_cmpeq_epi8 (x, _mm256_setzero_si256 ())) == (int)0xffffffff;
+}
+
+static force_inline int
+is_transparent_256 (__m256i x)
+{
+    return (_mm256_movemask_epi8 (
+		_mm256_cmpeq_epi8 (x, _mm256_setzero_si256 ())) & 0x88888888)
+	== 0x88888888;
+}
+
+static force_inline void
+expand_alpha_2x256 (__m256i  data_lo,
+                    __m256i  data_hi,
+                    __m256i* alpha_lo,
+                    __m256i* alpha_hi)
+{
+    __m256i lo, hi;
+
+    lo = _mm256_shufflelo_epi16 (data_lo, _MM_SHUFFLE (3, 3, 3, 3));
+    hi = _mm256_shufflelo_epi16 (data_hi, _MM_SHUFFLE (3, 3, 3, 3));
+
+    *alpha_lo = _mm256_shufflehi_epi16 (lo, _MM_SHUFFLE (3, 3, 3, 3));
+    *alpha_hi = _mm256_shufflehi_epi16 (hi, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+static force_inline void
+expand_alpha_rev_2x256 (__m256i  data_lo,
+                        __m256i  data_hi,
+                        __m256i* alpha_lo,
+                        __m256i* alpha_hi)
+{
+    __m256i lo, hi;
+
+    lo = _mm256_shufflelo_epi16 (data_lo, _MM_SHUFFLE (0, 0, 0, 0));
+    hi = _mm256_shufflelo_epi16 (data_hi, _MM_SHUFFLE (0, 0, 0, 0));
+
+    *alpha_lo = _mm256_shufflehi_epi16 (lo, _MM_SHUFFLE (0, 0, 0, 0));
+    *alpha_hi = _mm256_shufflehi_epi16 (hi, _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline void
+pix_multiply_2x256 (__m256i* data_lo,
+                    __m256i* data_hi,
+                    __m256i* alpha_lo,
+                    __m256i* alpha_hi,
+                    __m256i* ret_lo,
+                    __m256i* ret_hi)
+{
+    __m256i lo, hi;
+
+    lo = _mm256_mullo_epi16 (*data_lo, *alpha_lo);
+    hi = _mm256_mullo_epi16 (*data_hi, *alpha_hi);
+    lo = _mm256_adds_epu16 (lo, mask_0080);
+    hi = _mm256_adds_epu16 (hi, mask_0080);
+    *ret_lo = _mm256_mulhi_epu16 (lo, mask_0101);
+    *ret_hi = _mm256_mulhi_epu16 (hi, mask_0101);
+}
+
+static force_inline void
+negate_2x256 (__m256i  data_lo,
+              __m256i  data_hi,
+              __m256i* neg_lo,
+              __m256i* neg_hi)
+{
+    *neg_lo = _mm256_xor_si256 (data_lo, mask_00ff);
+    *neg_hi = _mm256_xor_si256 (data_hi, mask_00ff);
+}
+
+static force_inline void
+over_2x256 (__m256i* src_lo,
+            __m256i* src_hi,
+            __m256i* alpha_lo,
+            __m256i* alpha_hi,
+            __m256i* dst_lo,
+            __m256i* dst_hi)
+{
+    __m256i t1, t2;
+
+    negate_2x256 (*alpha_lo, *alpha_hi, &t1, &t2);
+
+    pix_multiply_2x256 (dst_lo, dst_hi, &t1, &t2, dst_lo, dst_hi);
+
+    *dst_lo = _mm256_adds_epu8 (*src_lo, *dst_lo);
+    *dst_hi = _mm256_adds_epu8 (*src_hi, *dst_hi);
+}
+
+static force_inline void
+in_over_2x256 (__m256i* src_lo,
+               __m256i* src_hi,
+               __m256i* alpha_lo,
+               __m256i* alpha_hi,
+               __m256i* mask_lo,
+               __m256i* mask_hi,
+               __m256i* dst_lo,
+               __m256i* dst_hi)
+{
+    __m256i s_lo, s_hi;
+    __m256i a_lo, a_hi;
+
+    pix_multiply_2x256 (src_lo,   src_hi, mask_lo, mask_hi, &s_lo, &s_hi);
+    pix_multiply_2x256 (alpha_lo, alpha_hi, mask_lo, mask_hi, &a_lo, &a_hi);
+
+    over_2x256 (&s_lo, &s_hi, &a_lo, &a_hi, dst_lo, dst_hi);
+}
+
+/* load 8 pixels from a 32-byte boundary aligned address */
+static force_inline __m256i
+load_256_aligned (__m256i* src)
+{
+    return _mm256_load_si256 (src);
+}
+
+/* load 8 pixels from a unaligned address */
+static force_inline __m256i
+load_256_unaligned (const __m256i* src)
+{
+    return _mm256_loadu_si256 (src);
+}
+
+/* save 8 pixels on a 32-byte boundary aligned address */
+static force_inline void
+save_256_aligned (__m256i* dst,
+                  __m256i  data)
+{
+    _mm256_store_si256 (dst, data);
+}
+
+static force_inline __m256i
+combine8 (const __m256i *ps, const __m256i *pm)
+{
+    __m256i ymm_src_lo, ymm_src_hi;
+    __m256i ymm_msk_lo, ymm_msk_hi;
+    __m256i s;
+
+    if (pm)
+    {
+	ymm_msk_lo = load_256_unaligned (pm);
+
+	if (is_transparent_256 (ymm_msk_lo))
+	    return _mm256_setzero_si256 ();
+    }
+
+    s = load_256_unaligned (ps);
+
+    if (pm)
+    {
+	unpack_256_2x256 (s, &ymm_src_lo, &ymm_src_hi);
+	unpack_256_2x256 (ymm_msk_lo, &ymm_msk_lo, &ymm_msk_hi);
+
+	expand_alpha_2x256 (ymm_msk_lo, ymm_msk_hi, &ymm_msk_lo, &ymm_msk_hi);
+
+	pix_multiply_2x256 (&ymm_src_lo, &ymm_src_hi,
+			    &ymm_msk_lo, &ymm_msk_hi,
+			    &ymm_src_lo, &ymm_src_hi);
+
+	s = pack_2x256_256 (ymm_src_lo, ymm_src_hi);
+    }
+
+    return s;
+}
+
+static force_inline void
+core_combine_over_u_avx2_mask (uint32_t *	  pd,
+			       const uint32_t*    ps,
+			       const uint32_t*    pm,
+			       int                w)
+{
+    uint32_t s, d;
+
+    /* Align dst on a 32-byte boundary */
+    while (w && ((uintptr_t)pd & 31))
+    {
+	d = *pd;
+	s = combine1 (ps, pm);
+
+	if (s)
+	    *pd = core_combine_over_u_pixel_avx2 (s, d);
+	pd++;
+	ps++;
+	pm++;
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	__m256i mask = load_256_unaligned ((__m256i *)pm);
+
+	if (!is_zero_256 (mask))
+	{
+	    __m256i src;
+	    __m256i src_hi, src_lo;
+	    __m256i mask_hi, mask_lo;
+	    __m256i alpha_hi, alpha_lo;
+
+	    src = load_256_unaligned ((__m256i *)ps);
+
+	    if (is_opaque_256 (_mm256_and_si256 (src, mask)))
+	    {
+		save_256_aligned ((__m256i *)pd, src);
+	    }
+	    else
+	    {
+		__m256i dst = load_256_aligned ((__m256i *)pd);
+		__m256i dst_hi, dst_lo;
+
+		unpack_256_2x256 (mask, &mask_lo, &mask_hi);
+		unpack_256_2x256 (src, &src_lo, &src_hi);
+
+		expand_alpha_2x256 (mask_lo, mask_hi, &mask_lo, &mask_hi);
+		pix_multiply_2x256 (&src_lo, &src_hi,
+				    &mask_lo, &mask_hi,
+				    &src_lo, &src_hi);
+
+		unpack_256_2x256 (dst, &dst_lo, &dst_hi);
+
+		expand_alpha_2x256 (src_lo, src_hi,
+				    &alpha_lo, &alpha_hi);
+
+		over_2x256 (&src_lo, &src_hi, &alpha_lo, &alpha_hi,
+			    &dst_lo, &dst_hi);
+
+		save_256_aligned (
+		    (__m256i *)pd,
+		    pack_2x256_256 (dst_lo, dst_hi));
+	    }
+	}
+
+	pm += 8;
+	ps += 8;
+	pd += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	d = *pd;
+	s = combine1 (ps, pm);
+
+	if (s)
+	    *pd = core_combine_over_u_pixel_avx2 (s, d);
+	pd++;
+	ps++;
+	pm++;
+
+	w--;
+    }
+}
+
+static force_inline void
+core_combine_over_u_avx2_no_mask (uint32_t *	  pd,
+				  const uint32_t*    ps,
+				  int                w)
+{
+    uint32_t s, d;
+
+    /* Align dst on a 32-byte boundary */
+    while (w && ((uintptr_t)pd & 31))
+    {
+	d = *pd;
+	s = *ps;
+
+	if (s)
+	    *pd = core_combine_over_u_pixel_avx2 (s, d);
+	pd++;
+	ps++;
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	__m256i src;
+	__m256i src_hi, src_lo, dst_hi, dst_lo;
+	__m256i alpha_hi, alpha_lo;
+
+	src = load_256_unaligned ((__m256i *)ps);
+
+	if (!is_zero_256 (src))
+	{
+	    if (is_opaque_256 (src))
+	    {
+		save_256_aligned ((__m256i *)pd, src);
+	    }
+	    else
+	    {
+		__m256i dst = load_256_aligned ((__m256i *)pd);
+
+		unpack_256_2x256 (src, &src_lo, &src_hi);
+		unpack_256_2x256 (dst, &dst_lo, &dst_hi);
+
+		expand_alpha_2x256 (src_lo, src_hi,
+				    &alpha_lo, &alpha_hi);
+		over_2x256 (&src_lo, &src_hi, &alpha_lo, &alpha_hi,
+			    &dst_lo, &dst_hi);
+
+		save_256_aligned (
+		    (__m256i *)pd,
+		    pack_2x256_256 (dst_lo, dst_hi));
+	    }
+	}
+
+	ps += 8;
+	pd += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	d = *pd;
+	s = *ps;
+
+	if (s)
+	    *pd = core_combine_over_u_pixel_avx2 (s, d);
+	pd++;
+	ps++;
+
+	w--;
+    }
+}
+
+static force_inline void
+avx2_combine_over_u (pixman_implementation_t *imp,
+                     pixman_op_t              op,
+                     uint32_t *               pd,
+                     const uint32_t *         ps,
+                     const uint32_t *         pm,
+                     int                      w)
+{
+    if (pm)
+	core_combine_over_u_avx2_mask (pd, ps, pm, w);
+    else
+	core_combine_over_u_avx2_no_mask (pd, ps, w);
+}
+
+static force_inline void
+avx2_combine_add_u (pixman_implementation_t *imp,
+                    pixman_op_t              op,
+                    uint32_t *               dst,
+                    const uint32_t *         src,
+                    const uint32_t *         mask,
+                    int                      width)
+{
+    int w = width;
+    uint32_t s, d;
+    uint32_t* pd = dst;
+    const uint32_t* ps = src;
+    const uint32_t* pm = mask;
+
+    while (w && (uintptr_t)pd & 31)
+    {
+	s = combine1 (ps, pm);
+	d = *pd;
+
+	ps++;
+	if (pm)
+	    pm++;
+	*pd++ = _mm_cvtsi128_si32 (
+	    _mm_adds_epu8 (_mm_cvtsi32_si128 (s), _mm_cvtsi32_si128 (d)));
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	__m256i s;
+
+	s = combine8 ((__m256i*)ps, (__m256i*)pm);
+
+	save_256_aligned (
+	    (__m256i*)pd, _mm256_adds_epu8 (s, load_256_aligned ((__m256i*)pd)));
+
+	pd += 8;
+	ps += 8;
+	if (pm)
+	    pm += 8;
+	w -= 8;
+    }
+
+    while (w--)
+    {
+	s = combine1 (ps, pm);
+	d = *pd;
+
+	ps++;
+	*pd++ = _mm_cvtsi128_si32 (
+	    _mm_adds_epu8 (_mm_cvtsi32_si128 (s), _mm_cvtsi32_si128 (d)));
+	if (pm)
+	    pm++;
+    }
+}
+
+#ifdef AVX2_FLOAT_MATCHES_C
+/*
+ * Float combiners
+ *
+ * These are the float combiners of the SSE2 implementation, working on
+ * two pixels in each register instead of one. The alpha channels are in
+ * lanes 0 and 4, and each is broadcast to the lanes of its pixel.
+ */
+
+typedef __m256 (* combine_float_channel_t) (__m256 sa, __m256 s, __m256 da, __m256 d);
+
+static force_inline __m256
+expand_alpha_ps (__m256 x)
+{
+    return _mm256_permute_ps (x, _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline __m256
+cmplt_ps (__m256 a, __m256 b)
+{
+    return _mm256_cmp_ps (a, b, _CMP_LT_OS);
+}
+
+static force_inline __m256
+cmple_ps (__m256 a, __m256 b)
+{
+    return _mm256_cmp_ps (a, b, _CMP_LE_OS);
+}
+
+static force_inline __m256
+select_ps (__m256 mask, __m256 a, __m256 b)
+{
+    return _mm256_or_ps (_mm256_and_ps (mask, a), _mm256_andnot_ps (mask, b));
+}
+
+/* The lanes that hold the alpha channels */
+static force_inline __m256
+alpha_lane_ps (void)
+{
+    return _mm256_castsi256_ps (_mm256_set_epi32 (0, 0, 0, -1, 0, 0, 0, -1));
+}
+
+/* Combines two pixels, or if last is TRUE, only the first one */
+static force_inline void
+combine_float_2 (pixman_bool_t component, pixman_bool_t last,
+		 float *dest, const float *src, const float *mask,
+		 combine_float_channel_t combine)
+{
+    __m256i first = _mm256_set_epi32 (0, 0, 0, 0, -1, -1, -1, -1);
+    __m256 s, d, m, sa;
+
+    s = last ? _mm256_maskload_ps (src, first) : _mm256_loadu_ps (src);
+    d = last ? _mm256_maskload_ps (dest, first) : _mm256_loadu_ps (dest);
+
+    if (!mask)
+    {
+	sa = expand_alpha_ps (s);
+    }
+    else
+    {
+	m = last ? _mm256_maskload_ps (mask, first) : _mm256_loadu_ps (mask);
+
+	if (component)
+	{
+	    sa = _mm256_mul_ps (m, expand_alpha_ps (s));
+	    s = _mm256_mul_ps (s, m);
+	}
+	else
+	{
+	    s = _mm256_mul_ps (s, expand_alpha_ps (m));
+	    sa = expand_alpha_ps (s);
+	}
+    }
+
+    d = combine (sa, s, expand_alpha_ps (d), d);
+
+    if (last)
+	_mm256_maskstore_ps (dest, first, d);
+    else
+	_mm256_storeu_ps (dest, d);
+}
+
+static force_inline void
+combine_float_inner (pixman_bool_t component,
+		     float *dest, const float *src, const float *mask, int n_pixels,
+		     combine_float_channel_t combine)
+{
+    while (n_pixels >= 4)
+    {
+	combine_float_2 (component, FALSE, dest, src, mask, combine);
+	combine_float_2 (component, FALSE, dest + 8, src + 8,
+			 mask ? mask + 8 : NULL, combine);
+
+	dest += 16;
+	src += 16;
+	if (mask)
+	    mask += 16;
+	n_pixels -= 4;
+    }
+
+    if (n_pixels >= 2)
+    {
+	combine_float_2 (component, FALSE, dest, src, mask, combine);
+
+	dest += 8;
+	src += 8;
+	if (mask)
+	    mask += 8;
+	n_pixels -= 2;
+    }
+
+    if (n_pixels)
+	combine_float_2 (component, TRUE, dest, src, mask, combine);
+}
+
+#define MAKE_FLOAT_COMBINER(name, component, combine)			\
+    static void								\
+    avx2_combine_ ## name ## _float (pixman_implementation_t *imp,	\
+				     pixman_op_t              op,	\
+				     float                   *dest,	\
+				     const float             *src,	\
+				     const float             *mask,	\
+				     int                      n_pixels)	\
+    {									\
+	combine_float_inner (component, dest, src, mask, n_pixels,	\
+			     combine);					\
+    }
+
+#define MAKE_FLOAT_COMBINERS(name, combine)				\
+    MAKE_FLOAT_COMBINER (name ## _ca, TRUE, combine)			\
+    MAKE_FLOAT_COMBINER (name ## _u, FALSE, combine)
+
+/*
+ * Porter/Duff operators
+ */
+typedef enum
+{
+    ZERO,
+    ONE,
+    SRC_ALPHA,
+    DEST_ALPHA,
+    INV_SA,
+    INV_DA,
+    SA_OVER_DA,
+    DA_OVER_SA,
+    INV_SA_OVER_DA,
+    INV_DA_OVER_SA,
+    ONE_MINUS_SA_OVER_DA,
+    ONE_MINUS_DA_OVER_SA,
+    ONE_MINUS_INV_DA_OVER_SA,
+    ONE_MINUS_INV_SA_OVER_DA
+} combine_factor_t;
+
+/* FLOAT_IS_ZERO () for all lanes */
+static force_inline __m256
+is_zero_ps (__m256 f)
+{
+    return _mm256_and_ps (cmplt_ps (_mm256_set1_ps (-FLT_MIN), f),
+		       cmplt_ps (f, _mm256_set1_ps (FLT_MIN)));
+}
+
+static force_inline __m256
+clamp_ps (__m256 f)
+{
+    return _mm256_min_ps (_mm256_set1_ps (1.0f), _mm256_max_ps (_mm256_setzero_ps (), f));
+}
+
+/* Computes n / d, or if d is zero, which is passed in as a mask, z */
+static force_inline __m256
+div_or_ps (__m256 n, __m256 d, __m256 zero, __m256 z)
+{
+    return select_ps (zero, z, _mm256_div_ps (n, select_ps (zero, _mm256_set1_ps (1.0f), d)));
+}
+
+static force_inline __m256
+get_factor_ps (combine_factor_t factor, __m256 sa, __m256 da)
+{
+    __m256 one = _mm256_set1_ps (1.0f);
+    __m256 zero = _mm256_setzero_ps ();
+    __m256 sa_zero = is_zero_ps (sa);
+    __m256 da_zero = is_zero_ps (da);
+    __m256 f = _mm256_set1_ps (-1.0f);
+
+    switch (factor)
+    {
+    case ZERO:
+	f = zero;
+	break;
+
+    case ONE:
+	f = one;
+	break;
+
+    case SRC_ALPHA:
+	f = sa;
+	break;
+
+    case DEST_ALPHA:
+	f = da;
+	break;
+
+    case INV_SA:
+	f = _mm256_sub_ps (one, sa);
+	break;
+
+    case INV_DA:
+	f = _mm256_sub_ps (one, da);
+	break;
+
+    case SA_OVER_DA:
+	f = div_or_ps (sa, da, da_zero, one);
+	f = select_ps (da_zero, one, clamp_ps (f));
+	break;
+
+    case DA_OVER_SA:
+	f = div_or_ps (da, sa, sa_zero, one);
+	f = select_ps (sa_zero, one, clamp_ps (f));
+	break;
+
+    case INV_SA_OVER_DA:
+	f = div_or_ps (_mm256_sub_ps (one, sa), da, da_zero, one);
+	f = select_ps (da_zero, one, clamp_ps (f));
+	break;
+
+    case INV_DA_OVER_SA:
+	f = div_or_ps (_mm256_sub_ps (one, da), sa, sa_zero, one);
+	f = select_ps (sa_zero, one, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_SA_OVER_DA:
+	f = _mm256_sub_ps (one, div_or_ps (sa, da, da_zero, one));
+	f = select_ps (da_zero, zero, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_DA_OVER_SA:
+	f = _mm256_sub_ps (one, div_or_ps (da, sa, sa_zero, one));
+	f = select_ps (sa_zero, zero, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_INV_DA_OVER_SA:
+	f = _mm256_sub_ps (one, div_or_ps (_mm256_sub_ps (one, da), sa, sa_zero, one));
+	f = select_ps (sa_zero, zero, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_INV_SA_OVER_DA:
+	f = _mm256_sub_ps (one, div_or_ps (_mm256_sub_ps (one, sa), da, da_zero, one));
+	f = select_ps (da_zero, zero, clamp_ps (f));
+	break;
+    }
+
+    return f;
+}
+
+#define MAKE_PD_COMBINERS(name, a, b)					\
+    static force_inline __m256						\
+    pd_combine_ ## name (__m256 sa, __m256 s, __m256 da, __m256 d)	\
+    {									\
+	const __m256 fa = get_factor_ps (a, sa, da);			\
+	const __m256 fb = get_factor_ps (b, sa, da);			\
+									\
+	return _mm256_min_ps (_mm256_set1_ps (1.0f),				\
+			   _mm256_add_ps (_mm256_mul_ps (s, fa),		\
+				       _mm256_mul_ps (d, fb)));		\
+    }									\
+									\
+    MAKE_FLOAT_COMBINERS (name, pd_combine_ ## name)
+
+MAKE_PD_COMBINERS (clear,			ZERO,				ZERO)
+MAKE_PD_COMBINERS (src,				ONE,				ZERO)
+MAKE_PD_COMBINERS (dst,				ZERO,				ONE)
+MAKE_PD_COMBINERS (over,			ONE,				INV_SA)
+MAKE_PD_COMBINERS (over_reverse,		INV_DA,				ONE)
+MAKE_PD_COMBINERS (in,				DEST_ALPHA,			ZERO)
+MAKE_PD_COMBINERS (in_reverse,			ZERO,				SRC_ALPHA)
+MAKE_PD_COMBINERS (out,				INV_DA,				ZERO)
+MAKE_PD_COMBINERS (out_reverse,			ZERO,				INV_SA)
+MAKE_PD_COMBINERS (atop,			DEST_ALPHA,			INV_SA)
+MAKE_PD_COMBINERS (atop_reverse,		INV_DA,				SRC_ALPHA)
+MAKE_PD_COMBINERS (xor,				INV_DA,				INV_SA)
+MAKE_PD_COMBINERS (add,				ONE,				ONE)
+
+MAKE_PD_COMBINERS (saturate,			INV_DA_OVER_SA,			ONE)
+
+MAKE_PD_COMBINERS (disjoint_clear,		ZERO,				ZERO)
+MAKE_PD_COMBINERS (disjoint_src,		ONE,				ZERO)
+MAKE_PD_COMBINERS (disjoint_dst,		ZERO,				ONE)
+MAKE_PD_COMBINERS (disjoint_over,		ONE,				INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_over_reverse,	INV_DA_OVER_SA,			ONE)
+MAKE_PD_COMBINERS (disjoint_in,			ONE_MINUS_INV_DA_OVER_SA,	ZERO)
+MAKE_PD_COMBINERS (disjoint_in_reverse,		ZERO,				ONE_MINUS_INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_out,		INV_DA_OVER_SA,			ZERO)
+MAKE_PD_COMBINERS (disjoint_out_reverse,	ZERO,				INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_atop,		ONE_MINUS_INV_DA_OVER_SA,	INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_atop_reverse,	INV_DA_OVER_SA,			ONE_MINUS_INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_xor,		INV_DA_OVER_SA,			INV_SA_OVER_DA)
+
+MAKE_PD_COMBINERS (conjoint_clear,		ZERO,				ZERO)
+MAKE_PD_COMBINERS (conjoint_src,		ONE,				ZERO)
+MAKE_PD_COMBINERS (conjoint_dst,		ZERO,				ONE)
+MAKE_PD_COMBINERS (conjoint_over,		ONE,				ONE_MINUS_SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_over_reverse,	ONE_MINUS_DA_OVER_SA,		ONE)
+MAKE_PD_COMBINERS (conjoint_in,			DA_OVER_SA,			ZERO)
+MAKE_PD_COMBINERS (conjoint_in_reverse,		ZERO,				SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_out,		ONE_MINUS_DA_OVER_SA,		ZERO)
+MAKE_PD_COMBINERS (conjoint_out_reverse,	ZERO,				ONE_MINUS_SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_atop,		DA_OVER_SA,			ONE_MINUS_SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_atop_reverse,	ONE_MINUS_DA_OVER_SA,		SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_xor,		ONE_MINUS_DA_OVER_SA,		ONE_MINUS_SA_OVER_DA)
+
+/*
+ * PDF separable blend modes
+ */
+#define MAKE_SEPARABLE_PDF_COMBINERS(name)				\
+    static force_inline __m256						\
+    combine_ ## name (__m256 sa, __m256 s, __m256 da, __m256 d)	\
+    {									\
+	__m256 one = _mm256_set1_ps (1.0f);				\
+	__m256 a, c;							\
+									\
+	a = _mm256_sub_ps (_mm256_add_ps (da, sa), _mm256_mul_ps (da, sa));	\
+	c = _mm256_add_ps (_mm256_mul_ps (_mm256_sub_ps (one, sa), d),		\
+			_mm256_mul_ps (_mm256_sub_ps (one, da), s));		\
+	c = _mm256_add_ps (c, blend_ ## name ## _ps (sa, s, da, d));	\
+									\
+	return select_ps (alpha_lane_ps (), a, c);			\
+    }									\
+									\
+    MAKE_FLOAT_COMBINERS (name, combine_ ## name)
+
+static force_inline __m256
+blend_multiply_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    return _mm256_mul_ps (d, s);
+}
+
+static force_inline __m256
+blend_screen_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    return _mm256_sub_ps (_mm256_add_ps (_mm256_mul_ps (d, sa), _mm256_mul_ps (s, da)),
+		       _mm256_mul_ps (s, d));
+}
+
+/* sa * da - 2 * (da - d) * (sa - s) */
+static force_inline __m256
+blend_hard_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    return _mm256_sub_ps (_mm256_mul_ps (sa, da),
+		       _mm256_mul_ps (_mm256_mul_ps (_mm256_set1_ps (2.0f), _mm256_sub_ps (da, d)),
+				   _mm256_sub_ps (sa, s)));
+}
+
+static force_inline __m256
+blend_overlay_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    __m256 two = _mm256_set1_ps (2.0f);
+
+    return select_ps (cmplt_ps (_mm256_mul_ps (two, d), da),
+		      _mm256_mul_ps (_mm256_mul_ps (two, s), d),
+		      blend_hard_ps (sa, s, da, d));
+}
+
+static force_inline __m256
+blend_darken_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    s = _mm256_mul_ps (s, da);
+    d = _mm256_mul_ps (d, sa);
+
+    return select_ps (cmplt_ps (d, s), d, s);
+}
+
+static force_inline __m256
+blend_lighten_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    s = _mm256_mul_ps (s, da);
+    d = _mm256_mul_ps (d, sa);
+
+    return select_ps (cmplt_ps (d, s), s, d);
+}
+
+static force_inline __m256
+blend_color_dodge_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    __m256 sada = _mm256_mul_ps (sa, da);
+    __m256 r;
+
+    r = div_or_ps (_mm256_mul_ps (_mm256_mul_ps (sa, sa), d), _mm256_sub_ps (sa, s),
+		   is_zero_ps (_mm256_sub_ps (sa, s)), sada);
+    r = select_ps (cmple_ps (_mm256_sub_ps (sada, _mm256_mul_ps (s, da)), _mm256_mul_ps (d, sa)),
+		   sada, r);
+
+    return _mm256_andnot_ps (is_zero_ps (d), r);
+}
+
+static force_inline __m256
+blend_color_burn_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    __m256 zero = _mm256_setzero_ps ();
+    __m256 t = _mm256_mul_ps (sa, _mm256_sub_ps (da, d));
+    __m256 r;
+
+    r = _mm256_mul_ps (sa, _mm256_sub_ps (da, div_or_ps (t, s, is_zero_ps (s), zero)));
+    r = select_ps (_mm256_or_ps (cmple_ps (_mm256_mul_ps (s, da), t), is_zero_ps (s)),
+		   zero, r);
+
+    return select_ps (cmple_ps (da, d), _mm256_mul_ps (sa, da), r);
+}
+
+static force_inline __m256
+blend_hard_light_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    __m256 two = _mm256_set1_ps (2.0f);
+
+    return select_ps (cmplt_ps (_mm256_mul_ps (two, s), sa),
+		      _mm256_mul_ps (_mm256_mul_ps (two, s), d),
+		      blend_hard_ps (sa, s, da, d));
+}
+
+static force_inline __m256
+blend_soft_light_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    __m256 two = _mm256_set1_ps (2.0f);
+    __m256 zero = _mm256_setzero_ps ();
+    __m256 da_zero = is_zero_ps (da);
+    __m256 dsa = _mm256_mul_ps (d, sa);
+    __m256 s2 = _mm256_mul_ps (two, s);
+    __m256 r1, r2, r3, t;
+
+    /* d * sa - d * (da - d) * (sa - 2 * s) / da */
+    t = _mm256_mul_ps (_mm256_mul_ps (d, _mm256_sub_ps (da, d)), _mm256_sub_ps (sa, s2));
+    r1 = select_ps (da_zero, dsa, _mm256_sub_ps (dsa, div_or_ps (t, da, da_zero, zero)));
+
+    /* d * sa + (2 * s - sa) * d * ((16 * d / da - 12) * d / da + 3) */
+    t = div_or_ps (_mm256_mul_ps (_mm256_set1_ps (16.0f), d), da, da_zero, zero);
+    t = div_or_ps (_mm256_mul_ps (_mm256_sub_ps (t, _mm256_set1_ps (12.0f)), d), da, da_zero, zero);
+    t = _mm256_add_ps (t, _mm256_set1_ps (3.0f));
+    r2 = _mm256_add_ps (dsa, _mm256_mul_ps (_mm256_mul_ps (_mm256_sub_ps (s2, sa), d), t));
+
+    /* d * sa + (sqrtf (d * da) - d) * (2 * s - sa) */
+    r3 = _mm256_add_ps (dsa, _mm256_mul_ps (_mm256_sub_ps (_mm256_sqrt_ps (_mm256_mul_ps (d, da)), d),
+				      _mm256_sub_ps (s2, sa)));
+
+    r2 = select_ps (cmple_ps (_mm256_mul_ps (_mm256_set1_ps (4.0f), d), da), r2, r3);
+    r2 = _mm256_andnot_ps (da_zero, r2);
+
+    return select_ps (cmplt_ps (s2, sa), r1, r2);
+}
+
+static force_inline __m256
+blend_difference_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    __m256 dsa = _mm256_mul_ps (d, sa);
+    __m256 sda = _mm256_mul_ps (s, da);
+
+    return select_ps (cmplt_ps (sda, dsa),
+		      _mm256_sub_ps (dsa, sda), _mm256_sub_ps (sda, dsa));
+}
+
+static force_inline __m256
+blend_exclusion_ps (__m256 sa, __m256 s, __m256 da, __m256 d)
+{
+    return _mm256_sub_ps (_mm256_add_ps (_mm256_mul_ps (s, da), _mm256_mul_ps (d, sa)),
+		       _mm256_mul_ps (_mm256_mul_ps (_mm256_set1_ps (2.0f), d), s));
+}
+
+MAKE_SEPARABLE_PDF_COMBINERS (multiply)
+MAKE_SEPARABLE_PDF_COMBINERS (screen)
+MAKE_SEPARABLE_PDF_COMBINERS (overlay)
+MAKE_SEPARABLE_PDF_COMBINERS (darken)
+MAKE_SEPARABLE_PDF_COMBINERS (lighten)
+MAKE_SEPARABLE_PDF_COMBINERS (color_dodge)
+MAKE_SEPARABLE_PDF_COMBINERS (color_burn)
+MAKE_SEPARABLE_PDF_COMBINERS (hard_light)
+MAKE_SEPARABLE_PDF_COMBINERS (soft_light)
+MAKE_SEPARABLE_PDF_COMBINERS (difference)
+MAKE_SEPARABLE_PDF_COMBINERS (exclusion)
+
+#undef MAKE_SEPARABLE_PDF_COMBINERS
+#undef MAKE_PD_COMBINERS
+#undef MAKE_FLOAT_COMBINERS
+#undef MAKE_FLOAT_COMBINER
+
+#endif /* AVX2_FLOAT_MATCHES_C */
+
+static void
+avx2_composite_over_8888_8888 (pixman_implementation_t *imp,
+                               pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    int dst_stride, src_stride;
+    uint32_t    *dst_line, *dst;
+    uint32_t    *src_line, *src;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+
+    dst = dst_line;
+    src = src_line;
+
+    while (height--)
+    {
+	avx2_combine_over_u (imp, op, dst, src, NULL, width);
+
+	dst += dst_stride;
+	src += src_stride;
+    }
+}
+
+static void
+avx2_composite_over_n_8_8888 (pixman_implementation_t *imp,
+                              pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t src, srca;
+    uint32_t *dst_line, *dst;
+    uint8_t *mask_line, *mask;
+    int dst_stride, mask_stride;
+    int32_t w;
+    uint64_t m;
+    uint32_t d;
+
+    __m256i ymm_src, ymm_alpha, ymm_def;
+    __m256i ymm_dst, ymm_dst_lo, ymm_dst_hi;
+    __m256i ymm_mask, ymm_mask_lo, ymm_mask_hi;
+
+    __m128i xmm_src, xmm_alpha, xmm_mask, xmm_dest;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+
+    srca = src >> 24;
+    if (src == 0)
+	return;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	mask_image, mask_x, mask_y, uint8_t, mask_stride, mask_line, 1);
+
+    ymm_def = _mm256_set1_epi32 (src);
+    ymm_src = _mm256_unpacklo_epi8 (ymm_def, _mm256_setzero_si256 ());
+    expand_alpha_2x256 (ymm_src, ymm_src, &ymm_alpha, &ymm_alpha);
+    xmm_src = _mm256_castsi256_si128 (ymm_src);
+    xmm_alpha = _mm256_castsi256_si128 (ymm_alpha);
+
+    while (height--)
+    {
+	dst = dst_line;
+	dst_line += dst_stride;
+	mask = mask_line;
+	mask_line += mask_stride;
+	w = width;
+
+	while (w && (uintptr_t)dst & 31)
+	{
+	    uint8_t m = *mask++;
+
+	    if (m)
+	    {
+		d = *dst;
+		xmm_mask = expand_pixel_8_1x128 (m);
+		xmm_dest = unpack_32_1x128 (d);
+
+		*dst = pack_1x128_32 (in_over_1x128 (&xmm_src,
+						     &xmm_alpha,
+						     &xmm_mask,
+						     &xmm_dest));
+	    }
+
+	    w--;
+	    dst++;
+	}
+
+	while (w >= 8)
+	{
+	    memcpy (&m, mask, sizeof (m));
+
+	    if (srca == 0xff && m == ~(uint64_t)0)
+	    {
+		save_256_aligned ((__m256i*)dst, ymm_def);
+	    }
+	    else if (m)
+	    {
+		ymm_dst = load_256_aligned ((__m256i*) dst);
+		ymm_mask = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)mask));
+
+		/* Unpacking */
+		unpack_256_2x256 (ymm_dst, &ymm_dst_lo, &ymm_dst_hi);
+		unpack_256_2x256 (ymm_mask, &ymm_mask_lo, &ymm_mask_hi);
+
+		expand_alpha_rev_2x256 (ymm_mask_lo, ymm_mask_hi,
+					&ymm_mask_lo, &ymm_mask_hi);
+
+		in_over_2x256 (&ymm_src, &ymm_src,
+			       &ymm_alpha, &ymm_alpha,
+			       &ymm_mask_lo, &ymm_mask_hi,
+			       &ymm_dst_lo, &ymm_dst_hi);
+
+		save_256_aligned (
+		    (__m256i*)dst, pack_2x256_256 (ymm_dst_lo, ymm_dst_hi));
+	    }
+
+	    w -= 8;
+	    dst += 8;
+	    mask += 8;
+	}
+
+	while (w)
+	{
+	    uint8_t m = *mask++;
+
+	    if (m)
+	    {
+		d = *dst;
+		xmm_mask = expand_pixel_8_1x128 (m);
+		xmm_dest = unpack_32_1x128 (d);
+
+		*dst = pack_1x128_32 (in_over_1x128 (&xmm_src,
+						     &xmm_alpha,
+						     &xmm_mask,
+						     &xmm_dest));
+	    }
+
+	    w--;
+	    dst++;
+	}
+    }
+}
+
+/* Glyph spans are short, so they are composited eight pixels at a time
+ * without aligning the destination first, and the last pixels of a span
+ * are loaded and stored with a mask.
+ */
+static void
+avx2_glyph_spans (pixman_implementation_t   *imp,
+		  uint32_t                   src,
+		  const pixman_glyph_span_t *spans,
+		  int                        n_spans)
+{
+    uint32_t srca = src >> 24;
+    __m256i ymm_src, ymm_alpha, ymm_def, ymm_lanes;
+    __m256i ymm_dst, ymm_dst_lo, ymm_dst_hi;
+    __m256i ymm_mask, ymm_mask_lo, ymm_mask_hi;
+    int i;
+
+    ymm_def = _mm256_set1_epi32 (src);
+    ymm_src = _mm256_unpacklo_epi8 (ymm_def, _mm256_setzero_si256 ());
+    expand_alpha_2x256 (ymm_src, ymm_src, &ymm_alpha, &ymm_alpha);
+    ymm_lanes = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (i = 0; i < n_spans; ++i)
+    {
+	uint32_t *dst = spans[i].dest;
+	const uint8_t *mask = spans[i].mask;
+	int32_t w = spans[i].width;
+
+	while (w > 0)
+	{
+	    __m256i ymm_first = _mm256_setzero_si256 ();
+	    uint64_t m = 0;
+
+	    if (w >= 8)
+	    {
+		memcpy (&m, mask, sizeof (m));
+	    }
+	    else
+	    {
+		int k;
+
+		for (k = 0; k < w; ++k)
+		    m |= (uint64_t)mask[k] << (8 * k);
+
+		ymm_first = _mm256_cmpgt_epi32 (_mm256_set1_epi32 (w), ymm_lanes);
+	    }
+
+	    if (srca == 0xff && m == ~(uint64_t)0)
+	    {
+		_mm256_storeu_si256 ((__m256i *)dst, ymm_def);
+	    }
+	    else if (m)
+	    {
+		if (w >= 8)
+		    ymm_dst = load_256_unaligned ((__m256i *)dst);
+		else
+		    ymm_dst = _mm256_maskload_epi32 ((int *)dst, ymm_first);
+
+		ymm_mask = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)&m));
+
+		unpack_256_2x256 (ymm_dst, &ymm_dst_lo, &ymm_dst_hi);
+		unpack_256_2x256 (ymm_mask, &ymm_mask_lo, &ymm_mask_hi);
+
+		expand_alpha_rev_2x256 (ymm_mask_lo, ymm_mask_hi,
+					&ymm_mask_lo, &ymm_mask_hi);
+
+		in_over_2x256 (&ymm_src, &ymm_src,
+			       &ymm_alpha, &ymm_alpha,
+			       &ymm_mask_lo, &ymm_mask_hi,
+			       &ymm_dst_lo, &ymm_dst_hi);
+
+		ymm_dst = pack_2x256_256 (ymm_dst_lo, ymm_dst_hi);
+
+		if (w >= 8)
+		    _mm256_storeu_si256 ((__m256i *)dst, ymm_dst);
+		else
+		    _mm256_maskstore_epi32 ((int *)dst, ymm_first, ymm_dst);
+	    }
+
+	    w -= 8;
+	    dst += 8;
+	    mask += 8;
+	}
+    }
+}
+
+static void
+avx2_composite_add_8888_8888 (pixman_implementation_t *imp,
+                              pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t    *dst_line, *dst;
+    uint32_t    *src_line, *src;
+    int dst_stride, src_stride;
+
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+
+    while (height--)
+    {
+	dst = dst_line;
+	dst_line += dst_stride;
+	src = src_line;
+	src_line += src_stride;
+
+	avx2_combine_add_u (imp, op, dst, src, NULL, width);
+    }
+}
+
+static void
+avx2_composite_src_x888_8888 (pixman_implementation_t *imp,
+			      pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t    *dst_line, *dst;
+    uint32_t    *src_line, *src;
+    int32_t w;
+    int dst_stride, src_stride;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+
+    while (height--)
+    {
+	dst = dst_line;
+	dst_line += dst_stride;
+	src = src_line;
+	src_line += src_stride;
+	w = width;
+
+	while (w && (uintptr_t)dst & 31)
+	{
+	    *dst++ = *src++ | 0xff000000;
+	    w--;
+	}
+
+	while (w >= 32)
+	{
+	    __m256i ymm_src1, ymm_src2, ymm_src3, ymm_src4;
+
+	    ymm_src1 = load_256_unaligned ((__m256i*)src + 0);
+	    ymm_src2 = load_256_unaligned ((__m256i*)src + 1);
+	    ymm_src3 = load_256_unaligned ((__m256i*)src + 2);
+	    ymm_src4 = load_256_unaligned ((__m256i*)src + 3);
+
+	    save_256_aligned ((__m256i*)dst + 0, _mm256_or_si256 (ymm_src1, mask_ff000000));
+	    save_256_aligned ((__m256i*)dst + 1, _mm256_or_si256 (ymm_src2, mask_ff000000));
+	    save_256_aligned ((__m256i*)dst + 2, _mm256_or_si256 (ymm_src3, mask_ff000000));
+	    save_256_aligned ((__m256i*)dst + 3, _mm256_or_si256 (ymm_src4, mask_ff000000));
+
+	    dst += 32;
+	    src += 32;
+	    w -= 32;
+	}
+
+	while (w >= 8)
+	{
+	    save_256_aligned ((__m256i*)dst, _mm256_or_si256 (
+				  load_256_unaligned ((__m256i*)src), mask_ff000000));
+
+	    dst += 8;
+	    src += 8;
+	    w -= 8;
+	}
+
+	while (w)
+	{
+	    *dst++ = *src++ | 0xff000000;
+	    w--;
+	}
+    }
+}
+
+static pixman_bool_t
+avx2_blt (pixman_implementation_t *imp,
+          uint32_t *               src_bits,
+          uint32_t *               dst_bits,
+          int                      src_stride,
+          int                      dst_stride,
+          int                      src_bpp,
+          int                      dst_bpp,
+          int                      src_x,
+          int                      src_y,
+          int                      dest_x,
+          int                      dest_y,
+          int                      width,
+          int                      height)
+{
+    uint8_t *   src_bytes;
+    uint8_t *   dst_bytes;
+    int byte_width;
+
+    if (src_bpp != dst_bpp)
+	return FALSE;
+
+    if (src_bpp == 16)
+    {
+	src_stride = src_stride * (int) sizeof (uint32_t) / 2;
+	dst_stride = dst_stride * (int) sizeof (uint32_t) / 2;
+	src_bytes =(uint8_t *)(((uint16_t *)src_bits) + src_stride * (src_y) + (src_x));
+	dst_bytes = (uint8_t *)(((uint16_t *)dst_bits) + dst_stride * (dest_y) + (dest_x));
+	byte_width = 2 * width;
+	src_stride *= 2;
+	dst_stride *= 2;
+    }
+    else if (src_bpp == 32)
+    {
+	src_stride = src_stride * (int) sizeof (uint32_t) / 4;
+	dst_stride = dst_stride * (int) sizeof (uint32_t) / 4;
+	src_bytes = (uint8_t *)(((uint32_t *)src_bits) + src_stride * (src_y) + (src_x));
+	dst_bytes = (uint8_t *)(((uint32_t *)dst_bits) + dst_stride * (dest_y) + (dest_x));
+	byte_width = 4 * width;
+	src_stride *= 4;
+	dst_stride *= 4;
+    }
+    else
+    {
+	return FALSE;
+    }
+
+    while (height--)
+    {
+	int w;
+	uint8_t *s = src_bytes;
+	uint8_t *d = dst_bytes;
+	src_bytes += src_stride;
+	dst_bytes += dst_stride;
+	w = byte_width;
+
+	while (w >= 2 && ((uintptr_t)d & 3))
+	{
+	    *(uint16_t *)d = *(uint16_t *)s;
+	    w -= 2;
+	    s += 2;
+	    d += 2;
+	}
+
+	while (w >= 4 && ((uintptr_t)d & 31))
+	{
+	    *(uint32_t *)d = *(uint32_t *)s;
+
+	    w -= 4;
+	    s += 4;
+	    d += 4;
+	}
+
+	while (w >= 128)
+	{
+	    __m256i ymm0, ymm1, ymm2, ymm3;
+
+	    ymm0 = load_256_unaligned ((__m256i*)(s));
+	    ymm1 = load_256_unaligned ((__m256i*)(s + 32));
+	    ymm2 = load_256_unaligned ((__m256i*)(s + 64));
+	    ymm3 = load_256_unaligned ((__m256i*)(s + 96));
+
+	    save_256_aligned ((__m256i*)(d),      ymm0);
+	    save_256_aligned ((__m256i*)(d + 32), ymm1);
+	    save_256_aligned ((__m256i*)(d + 64), ymm2);
+	    save_256_aligned ((__m256i*)(d + 96), ymm3);
+
+	    s += 128;
+	    d += 128;
+	    w -= 128;
+	}
+
+	while (w >= 32)
+	{
+	    save_256_aligned ((__m256i*)d, load_256_unaligned ((__m256i*)s));
+
+	    w -= 32;
+	    d += 32;
+	    s += 32;
+	}
+
+	while (w >= 4)
+	{
+	    *(uint32_t *)d = *(uint32_t *)s;
+
+	    w -= 4;
+	    s += 4;
+	    d += 4;
+	}
+
+	if (w >= 2)
+	{
+	    *(uint16_t *)d = *(uint16_t *)s;
+	    w -= 2;
+	    s += 2;
+	    d += 2;
+	}
+    }
+
+    return TRUE;
+}
+
+static void
+avx2_composite_copy_area (pixman_implementation_t *imp,
+                          pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    avx2_blt (imp, src_image->bits.bits,
+	      dest_image->bits.bits,
+	      src_image->bits.rowstride,
+	      dest_image->bits.rowstride,
+	      PIXMAN_FORMAT_BPP (src_image->bits.format),
+	      PIXMAN_FORMAT_BPP (dest_image->bits.format),
+	      src_x, src_y, dest_x, dest_y, width, height);
+}
+
+/*
+ * Bilinear scaling. The vertical and horizontal interpolation are the
+ * same as in BILINEAR_INTERPOLATE_ONE_PIXEL in pixman-sse2.c, but four
+ * pixels are interpolated at once: the two 128 bit lanes of the "lo"
+ * registers hold pixels 0 and 2, and those of the "hi" registers hold
+ * pixels 1 and 3. The horizontal weights are tracked as 16 bit x
+ * coordinates, with one x per pixel, just like the SSE2 code does.
+ *
+ * Only the BILINEAR_INTERPOLATION_BITS < 8 case is handled here, which
+ * lets the horizontal interpolation be done with a single madd.
+ */
+#if BILINEAR_INTERPOLATION_BITS < 8
+
+#define BMSK ((1 << BILINEAR_INTERPOLATION_BITS) - 1)
+
+#define BILINEAR_DECLARE_VARIABLES						\
+    const __m256i ymm_wt = _mm256_set1_epi16 (wt);				\
+    const __m256i ymm_wb = _mm256_set1_epi16 (wb);				\
+    const __m256i ymm_xorc7 = _mm256_set1_epi32 (BMSK);			\
+    const __m256i ymm_addc7 = _mm256_set1_epi32 (1);				\
+    const __m256i ymm_ux1 = _mm256_set1_epi16 (unit_x);			\
+    const __m256i ymm_ux4 = _mm256_set1_epi16 (unit_x * 4);			\
+    const __m256i ymm_zero = _mm256_setzero_si256 ();				\
+    __m256i ymm_x_lo = _mm256_inserti128_si256 (				\
+	_mm256_castsi128_si256 (_mm_set1_epi16 (vx)),				\
+	_mm_set1_epi16 (vx + unit_x * 2), 1);					\
+    __m256i ymm_x_hi = _mm256_add_epi16 (ymm_x_lo, ymm_ux1)
+
+#define BILINEAR_INTERPOLATE_ONE_PIXEL(pix)					\
+do {										\
+    __m128i xmm_wh, a;								\
+    /* fetch 2x2 pixel block into sse2 registers */				\
+    __m128i tltr = _mm_loadl_epi64 (						\
+			    (__m128i *)&src_top[pixman_fixed_to_int (vx)]);	\
+    __m128i blbr = _mm_loadl_epi64 (						\
+			    (__m128i *)&src_bottom[pixman_fixed_to_int (vx)]);	\
+    vx += unit_x;								\
+    /* vertical interpolation */						\
+    a = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (			\
+					    tltr, _mm_setzero_si128 ()),	\
+					_mm256_castsi256_si128 (ymm_wt)),	\
+		       _mm_mullo_epi16 (_mm_unpacklo_epi8 (			\
+					    blbr, _mm_setzero_si128 ()),	\
+					_mm256_castsi256_si128 (ymm_wb)));	\
+    /* calculate horizontal weights */						\
+    xmm_wh = _mm_add_epi16 (_mm256_castsi256_si128 (ymm_addc7),		\
+			    _mm_xor_si128 (					\
+				_mm256_castsi256_si128 (ymm_xorc7),		\
+				_mm_srli_epi16 (				\
+				    _mm256_castsi256_si128 (ymm_x_lo),		\
+				    16 - BILINEAR_INTERPOLATION_BITS)));	\
+    ymm_x_lo = _mm256_add_epi16 (ymm_x_lo, ymm_ux1);				\
+    ymm_x_hi = _mm256_add_epi16 (ymm_x_hi, ymm_ux1);				\
+    /* horizontal interpolation */						\
+    a = _mm_madd_epi16 (_mm_unpackhi_epi16 (_mm_shuffle_epi32 (		\
+		a, _MM_SHUFFLE (1, 0, 3, 2)), a), xmm_wh);			\
+    /* shift and pack the result */						\
+    a = _mm_srli_epi32 (a, BILINEAR_INTERPOLATION_BITS * 2);			\
+    a = _mm_packs_epi32 (a, a);							\
+    a = _mm_packus_epi16 (a, a);						\
+    pix = _mm_cvtsi128_si32 (a);						\
+} while (0)
+
+#define BILINEAR_FETCH_TWO_PIXELS(row)						\
+    _mm_unpacklo_epi64 (							\
+	_mm_loadl_epi64 ((__m128i *)&row[pixman_fixed_to_int (vx)]),		\
+	_mm_loadl_epi64 ((__m128i *)&row[pixman_fixed_to_int (vx + unit_x)]))
+
+#define BILINEAR_INTERPOLATE_FOUR_PIXELS(pix)					\
+do {										\
+    __m256i tltr, blbr, a_lo, a_hi, wh_lo, wh_hi;				\
+    __m128i t01, b01, t23, b23;							\
+    /* fetch four 2x2 pixel blocks */						\
+    t01 = BILINEAR_FETCH_TWO_PIXELS (src_top);					\
+    b01 = BILINEAR_FETCH_TWO_PIXELS (src_bottom);				\
+    vx += unit_x * 2;								\
+    t23 = BILINEAR_FETCH_TWO_PIXELS (src_top);					\
+    b23 = BILINEAR_FETCH_TWO_PIXELS (src_bottom);				\
+    vx += unit_x * 2;								\
+    tltr = _mm256_inserti128_si256 (_mm256_castsi128_si256 (t01), t23, 1);	\
+    blbr = _mm256_inserti128_si256 (_mm256_castsi128_si256 (b01), b23, 1);	\
+    /* vertical interpolation */						\
+    a_lo = _mm256_add_epi16 (							\
+	_mm256_mullo_epi16 (_mm256_unpacklo_epi8 (tltr, ymm_zero), ymm_wt),	\
+	_mm256_mullo_epi16 (_mm256_unpacklo_epi8 (blbr, ymm_zero), ymm_wb));	\
+    a_hi = _mm256_add_epi16 (							\
+	_mm256_mullo_epi16 (_mm256_unpackhi_epi8 (tltr, ymm_zero), ymm_wt),	\
+	_mm256_mullo_epi16 (_mm256_unpackhi_epi8 (blbr, ymm_zero), ymm_wb));	\
+    /* calculate horizontal weights */						\
+    wh_lo = _mm256_add_epi16 (ymm_addc7, _mm256_xor_si256 (ymm_xorc7,		\
+	_mm256_srli_epi16 (ymm_x_lo, 16 - BILINEAR_INTERPOLATION_BITS)));	\
+    wh_hi = _mm256_add_epi16 (ymm_addc7, _mm256_xor_si256 (ymm_xorc7,		\
+	_mm256_srli_epi16 (ymm_x_hi, 16 - BILINEAR_INTERPOLATION_BITS)));	\
+    ymm_x_lo = _mm256_add_epi16 (ymm_x_lo, ymm_ux4);				\
+    ymm_x_hi = _mm256_add_epi16 (ymm_x_hi, ymm_ux4);				\
+    /* horizontal interpolation */						\
+    a_lo = _mm256_madd_epi16 (_mm256_unpackhi_epi16 (_mm256_shuffle_epi32 (	\
+		a_lo, _MM_SHUFFLE (1, 0, 3, 2)), a_lo), wh_lo);		\
+    a_hi = _mm256_madd_epi16 (_mm256_unpackhi_epi16 (_mm256_shuffle_epi32 (	\
+		a_hi, _MM_SHUFFLE (1, 0, 3, 2)), a_hi), wh_hi);		\
+    /* shift and pack the result */						\
+    a_lo = _mm256_srli_epi32 (a_lo, BILINEAR_INTERPOLATION_BITS * 2);		\
+    a_hi = _mm256_srli_epi32 (a_hi, BILINEAR_INTERPOLATION_BITS * 2);		\
+    a_lo = _mm256_packs_epi32 (a_lo, a_hi);					\
+    a_lo = _mm256_packus_epi16 (a_lo, a_lo);					\
+    a_lo = _mm256_permute4x64_epi64 (a_lo, _MM_SHUFFLE (3, 1, 2, 0));		\
+    pix = _mm256_castsi256_si128 (a_lo);					\
+} while (0)
+
+static force_inline void
+scaled_bilinear_scanline_avx2_8888_8888_SRC (uint32_t *       dst,
+					     const uint32_t * mask,
+					     const uint32_t * src_top,
+					     const uint32_t * src_bottom,
+					     int32_t          w,
+					     int              wt,
+					     int              wb,
+					     pixman_fixed_t   vx,
+					     pixman_fixed_t   unit_x,
+					     pixman_fixed_t   max_vx,
+					     pixman_bool_t    zero_src)
+{
+    BILINEAR_DECLARE_VARIABLES;
+    __m128i pix4;
+    uint32_t pix1;
+
+    while ((w -= 4) >= 0)
+    {
+	BILINEAR_INTERPOLATE_FOUR_PIXELS (pix4);
+	_mm_storeu_si128 ((__m128i *)dst, pix4);
+	dst += 4;
+    }
+
+    w += 4;
+
+    while (w--)
+    {
+	BILINEAR_INTERPOLATE_ONE_PIXEL (pix1);
+	*dst++ = pix1;
+    }
+}
+
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_cover_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       COVER, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_pad_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       PAD, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_none_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       NONE, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_normal_SRC,
+			       scaled_bilinear_scanline_avx2_8888_8888_SRC,
+			       uint32_t, uint32_t, uint32_t,
+			       NORMAL, FLAG_NONE)
+
+static force_inline void
+scaled_bilinear_scanline_avx2_8888_8888_OVER (uint32_t *       dst,
+					      const uint32_t * mask,
+					      const uint32_t * src_top,
+					      const uint32_t * src_bottom,
+					      int32_t          w,
+					      int              wt,
+					      int              wb,
+					      pixman_fixed_t   vx,
+					      pixman_fixed_t   unit_x,
+					      pixman_fixed_t   max_vx,
+					      pixman_bool_t    zero_src)
+{
+    BILINEAR_DECLARE_VARIABLES;
+    __m128i pix_lo, pix_hi;
+    uint32_t pix1, pix2;
+
+    while (w && ((uintptr_t)dst & 31))
+    {
+	BILINEAR_INTERPOLATE_ONE_PIXEL (pix1);
+
+	if (pix1)
+	{
+	    pix2 = *dst;
+	    *dst = core_combine_over_u_pixel_avx2 (pix1, pix2);
+	}
+
+	w--;
+	dst++;
+    }
+
+    while (w >= 8)
+    {
+	__m256i ymm_src;
+	__m256i ymm_src_hi, ymm_src_lo, ymm_dst_hi, ymm_dst_lo;
+	__m256i ymm_alpha_hi, ymm_alpha_lo;
+
+	BILINEAR_INTERPOLATE_FOUR_PIXELS (pix_lo);
+	BILINEAR_INTERPOLATE_FOUR_PIXELS (pix_hi);
+
+	ymm_src = _mm256_inserti128_si256 (
+	    _mm256_castsi128_si256 (pix_lo), pix_hi, 1);
+
+	if (!is_zero_256 (ymm_src))
+	{
+	    if (is_opaque_256 (ymm_src))
+	    {
+		save_256_aligned ((__m256i *)dst, ymm_src);
+	    }
+	    else
+	    {
+		__m256i ymm_dst = load_256_aligned ((__m256i *)dst);
+
+		unpack_256_2x256 (ymm_src, &ymm_src_lo, &ymm_src_hi);
+		unpack_256_2x256 (ymm_dst, &ymm_dst_lo, &ymm_dst_hi);
+
+		expand_alpha_2x256 (ymm_src_lo, ymm_src_hi,
+				    &ymm_alpha_lo, &ymm_alpha_hi);
+		over_2x256 (&ymm_src_lo, &ymm_src_hi,
+			    &ymm_alpha_lo, &ymm_alpha_hi,
+			    &ymm_dst_lo, &ymm_dst_hi);
+
+		save_256_aligned ((__m256i *)dst,
+				  pack_2x256_256 (ymm_dst_lo, ymm_dst_hi));
+	    }
+	}
+
+	w -= 8;
+	dst += 8;
+    }
+
+    while (w)
+    {
+	BILINEAR_INTERPOLATE_ONE_PIXEL (pix1);
+
+	if (pix1)
+	{
+	    pix2 = *dst;
+	    *dst = core_combine_over_u_pixel_avx2 (pix1, pix2);
+	}
+
+	w--;
+	dst++;
+    }
+}
+
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_cover_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       COVER, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_pad_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       PAD, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_none_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       NONE, FLAG_NONE)
+FAST_BILINEAR_MAINLOOP_COMMON (avx2_8888_8888_normal_OVER,
+			       scaled_bilinear_scanline_avx2_8888_8888_OVER,
+			       uint32_t, uint32_t, uint32_t,
+			       NORMAL, FLAG_NONE)
+
+#endif /* BILINEAR_INTERPOLATION_BITS < 8 */
+
+static const pixman_fast_path_t avx2_fast_paths[] =
+{
+    /* PIXMAN_OP_OVER */
+    PIXMAN_STD_FAST_PATH (OVER, a8r8g8b8, null, a8r8g8b8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8r8g8b8, null, x8r8g8b8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8b8g8r8, null, a8b8g8r8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, a8b8g8r8, null, x8b8g8r8, avx2_composite_over_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, a8r8g8b8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, x8r8g8b8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, a8b8g8r8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, solid, a8, x8b8g8r8, avx2_composite_over_n_8_8888),
+    PIXMAN_STD_FAST_PATH (OVER, x8r8g8b8, null, x8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (OVER, x8b8g8r8, null, x8b8g8r8, avx2_composite_copy_area),
+
+    /* PIXMAN_OP_ADD */
+    PIXMAN_STD_FAST_PATH (ADD, a8r8g8b8, null, a8r8g8b8, avx2_composite_add_8888_8888),
+    PIXMAN_STD_FAST_PATH (ADD, a8b8g8r8, null, a8b8g8r8, avx2_composite_add_8888_8888),
+
+    /* PIXMAN_OP_SRC */
+    PIXMAN_STD_FAST_PATH (SRC, x8r8g8b8, null, a8r8g8b8, avx2_composite_src_x888_8888),
+    PIXMAN_STD_FAST_PATH (SRC, x8b8g8r8, null, a8b8g8r8, avx2_composite_src_x888_8888),
+    PIXMAN_STD_FAST_PATH (SRC, a8r8g8b8, null, a8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, a8b8g8r8, null, a8b8g8r8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, a8r8g8b8, null, x8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, a8b8g8r8, null, x8b8g8r8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, x8r8g8b8, null, x8r8g8b8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, x8b8g8r8, null, x8b8g8r8, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, r5g6b5, null, r5g6b5, avx2_composite_copy_area),
+    PIXMAN_STD_FAST_PATH (SRC, b5g6r5, null, b5g6r5, avx2_composite_copy_area),
+
+#if BILINEAR_INTERPOLATION_BITS < 8
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8r8g8b8, a8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8r8g8b8, x8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, x8r8g8b8, x8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8b8g8r8, a8b8g8r8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, a8b8g8r8, x8b8g8r8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (SRC, x8b8g8r8, x8b8g8r8, avx2_8888_8888),
+
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8r8g8b8, x8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8b8g8r8, x8b8g8r8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, avx2_8888_8888),
+    SIMPLE_BILINEAR_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, avx2_8888_8888),
+#endif
+
+    { PIXMAN_OP_NONE },
+};
+
+static uint32_t *
+avx2_fetch_x8r8g8b8 (pixman_iter_t *iter, const uint32_t *mask)
+{
+    int w = iter->width;
+    __m256i ff000000 = mask_ff000000;
+    uint32_t *dst = iter->buffer;
+    uint32_t *src = (uint32_t *)iter->bits;
+
+    iter->bits += iter->stride;
+
+    while (w && ((uintptr_t)dst) & 0x1f)
+    {
+	*dst++ = (*src++) | 0xff000000;
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	save_256_aligned (
+	    (__m256i *)dst, _mm256_or_si256 (
+		load_256_unaligned ((__m256i *)src), ff000000));
+
+	dst += 8;
+	src += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	*dst++ = (*src++) | 0xff000000;
+	w--;
+    }
+
+    return iter->buffer;
+}
+
+static uint32_t *
+avx2_fetch_a8 (pixman_iter_t *iter, const uint32_t *mask)
+{
+    int w = iter->width;
+    uint32_t *dst = iter->buffer;
+    uint8_t *src = iter->bits;
+
+    iter->bits += iter->stride;
+
+    while (w && (((uintptr_t)dst) & 31))
+    {
+        *dst++ = *(src++) << 24;
+        w--;
+    }
+
+    while (w >= 16)
+    {
+	__m256i ymm0, ymm1;
+
+	ymm0 = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)(src + 0)));
+	ymm1 = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)(src + 8)));
+
+	save_256_aligned ((__m256i *)(dst + 0), _mm256_slli_epi32 (ymm0, 24));
+	save_256_aligned ((__m256i *)(dst + 8), _mm256_slli_epi32 (ymm1, 24));
+
+	dst += 16;
+	src += 16;
+	w -= 16;
+    }
+
+    while (w)
+    {
+	*dst++ = *(src++) << 24;
+	w--;
+    }
+
+    return iter->buffer;
+}
+
+typedef struct
+{
+    pixman_format_code_t	format;
+    pixman_iter_get_scanline_t	get_scanline;
+} fetcher_info_t;
+
+static const fetcher_info_t fetchers[] =
+{
+    { PIXMAN_x8r8g8b8,		avx2_fetch_x8r8g8b8 },
+    { PIXMAN_a8,		avx2_fetch_a8 },
+    { PIXMAN_null }
+};
+
+#ifdef AVX2_FLOAT_MATCHES_C
+
+/*
+ * Radial gradients
+ *
+ * Like the SSE2 version, but with four pixels per register, eight per
+ * iteration and the color ramp read with gathers.
+ */
+static force_inline __m256i
+avx2_gradient_ramp_lookup (pixman_gradient_walker_t *walker,
+			   __m256i                   x,
+			   pixman_repeat_t           repeat)
+{
+    __m256i ymm_one = _mm256_set1_epi32 (pixman_fixed_1);
+    __m256i keep = _mm256_set1_epi32 (-1);
+    __m256i m;
+
+    switch (repeat)
+    {
+    case PIXMAN_REPEAT_NORMAL:
+	x = _mm256_and_si256 (x, _mm256_set1_epi32 (0xffff));
+	break;
+
+    case PIXMAN_REPEAT_REFLECT:
+	x = _mm256_and_si256 (x, _mm256_set1_epi32 (0x1ffff));
+	x = _mm256_min_epi32 (x, _mm256_sub_epi32 (
+				  _mm256_slli_epi32 (ymm_one, 1), x));
+	break;
+
+    case PIXMAN_REPEAT_PAD:
+	x = _mm256_min_epi32 (_mm256_max_epi32 (x, _mm256_setzero_si256 ()),
+			      ymm_one);
+	break;
+
+    case PIXMAN_REPEAT_NONE:
+    default:
+	m = _mm256_or_si256 (
+	    _mm256_cmpgt_epi32 (_mm256_set1_epi32 (walker->stops[0].x), x),
+	    _mm256_cmpgt_epi32 (x, _mm256_set1_epi32 (
+				    walker->stops[walker->num_stops - 1].x - 1)));
+	keep = _mm256_andnot_si256 (m, keep);
+	x = _mm256_and_si256 (x, keep);
+	break;
+    }
+
+    /* Round to the nearest entry, like GRADIENT_RAMP_INDEX() */
+    x = _mm256_add_epi32 (
+	x, _mm256_set1_epi32 (1 << (15 - GRADIENT_RAMP_BITS)));
+    x = _mm256_srli_epi32 (x, 16 - GRADIENT_RAMP_BITS);
+
+    return _mm256_and_si256 (
+	_mm256_i32gather_epi32 ((const int *)walker->ramp, x, 4), keep);
+}
+
+static force_inline __m256d
+avx2_radial_gradient_root (__m256d         b,
+			   __m256d         c,
+			   __m256d         a,
+			   __m256d         inva,
+			   __m256d         dr,
+			   __m256d         mindr,
+			   pixman_repeat_t repeat,
+			   __m256d        *valid)
+{
+    __m256d zero = _mm256_setzero_pd ();
+    __m256d one = _mm256_set1_pd (pixman_fixed_1);
+    __m256d discr, sqrtdiscr, t0, t1, ok0, ok1;
+
+    discr = _mm256_sub_pd (_mm256_mul_pd (b, b), _mm256_mul_pd (a, c));
+    *valid = _mm256_cmp_pd (discr, zero, _CMP_GE_OQ);
+
+    sqrtdiscr = _mm256_sqrt_pd (_mm256_and_pd (discr, *valid));
+    t0 = _mm256_mul_pd (_mm256_add_pd (b, sqrtdiscr), inva);
+    t1 = _mm256_mul_pd (_mm256_sub_pd (b, sqrtdiscr), inva);
+
+    if (repeat == PIXMAN_REPEAT_NONE)
+    {
+	ok0 = _mm256_and_pd (_mm256_cmp_pd (zero, t0, _CMP_LE_OQ),
+			     _mm256_cmp_pd (t0, one, _CMP_LE_OQ));
+	ok1 = _mm256_and_pd (_mm256_cmp_pd (zero, t1, _CMP_LE_OQ),
+			     _mm256_cmp_pd (t1, one, _CMP_LE_OQ));
+    }
+    else
+    {
+	ok0 = _mm256_cmp_pd (_mm256_mul_pd (t0, dr), mindr, _CMP_GE_OQ);
+	ok1 = _mm256_cmp_pd (_mm256_mul_pd (t1, dr), mindr, _CMP_GE_OQ);
+    }
+
+    *valid = _mm256_and_pd (*valid, _mm256_or_pd (ok0, ok1));
+
+    /* The bigger root t0 wins if it is valid */
+    return _mm256_and_pd (*valid, _mm256_blendv_pd (t1, t0, ok0));
+}
+
+static force_inline void
+avx2_radial_gradient_span (uint32_t                 *buffer,
+			   pixman_gradient_walker_t *walker,
+			   radial_gradient_t        *radial,
+			   pixman_fixed_32_32_t      b,
+			   pixman_fixed_32_32_t      db,
+			   pixman_fixed_32_32_t      c,
+			   pixman_fixed_32_32_t      dc,
+			   pixman_fixed_32_32_t      ddc,
+			   int                       width,
+			   pixman_repeat_t           repeat)
+{
+    __m256d ymm_a = _mm256_set1_pd (radial->a);
+    __m256d ymm_inva = _mm256_set1_pd (radial->inva);
+    __m256d ymm_dr = _mm256_set1_pd (radial->delta.radius);
+    __m256d ymm_mindr = _mm256_set1_pd (radial->mindr);
+    __m256d ymm_sign = _mm256_set1_pd (-0.0);
+    __m256d ymm_limit = _mm256_set1_pd (2147483648.0);
+    int i;
+
+    for (i = 0; i < width; i += 8)
+    {
+	pixman_fixed_32_32_t cs[8];
+	__m256d t_lo, t_hi, ok_lo, ok_hi, in_range;
+	__m256i keep, p;
+	int j;
+
+	for (j = 0; j < 8; ++j)
+	{
+	    cs[j] = c;
+	    c += dc;
+	    dc += ddc;
+	}
+
+	t_lo = avx2_radial_gradient_root (
+	    _mm256_set_pd ((double)(b + 3 * db), (double)(b + 2 * db),
+			   (double)(b + db), (double)b),
+	    _mm256_set_pd ((double)cs[3], (double)cs[2],
+			   (double)cs[1], (double)cs[0]),
+	    ymm_a, ymm_inva, ymm_dr, ymm_mindr, repeat, &ok_lo);
+	t_hi = avx2_radial_gradient_root (
+	    _mm256_set_pd ((double)(b + 7 * db), (double)(b + 6 * db),
+			   (double)(b + 5 * db), (double)(b + 4 * db)),
+	    _mm256_set_pd ((double)cs[7], (double)cs[6],
+			   (double)cs[5], (double)cs[4]),
+	    ymm_a, ymm_inva, ymm_dr, ymm_mindr, repeat, &ok_hi);
+
+	b += 8 * db;
+
+	keep = _mm256_permute4x64_epi64 (
+	    _mm256_castps_si256 (_mm256_shuffle_ps (
+		_mm256_castpd_ps (ok_lo), _mm256_castpd_ps (ok_hi),
+		_MM_SHUFFLE (2, 0, 2, 0))),
+	    _MM_SHUFFLE (3, 1, 2, 0));
+
+	in_range = _mm256_and_pd (
+	    _mm256_cmp_pd (_mm256_andnot_pd (ymm_sign, t_lo), ymm_limit,
+			   _CMP_LT_OQ),
+	    _mm256_cmp_pd (_mm256_andnot_pd (ymm_sign, t_hi), ymm_limit,
+			   _CMP_LT_OQ));
+
+	if (_mm256_movemask_pd (in_range) == 0xf)
+	{
+	    __m256i x = _mm256_inserti128_si256 (
+		_mm256_castsi128_si256 (_mm256_cvttpd_epi32 (t_lo)),
+		_mm256_cvttpd_epi32 (t_hi), 1);
+
+	    p = _mm256_and_si256 (
+		avx2_gradient_ramp_lookup (walker, x, repeat), keep);
+	}
+	else
+	{
+	    /* Positions that don't fit in 32 bits, which only happens
+	     * for repeating gradients far away from the circles.
+	     */
+	    double t[8];
+	    uint32_t q[8];
+
+	    _mm256_storeu_pd (t, t_lo);
+	    _mm256_storeu_pd (t + 4, t_hi);
+
+	    for (j = 0; j < 8; ++j)
+		q[j] = _pixman_gradient_walker_pixel (walker, t[j]);
+
+	    p = _mm256_and_si256 (_mm256_loadu_si256 ((__m256i *)q), keep);
+	}
+
+	if (i + 8 <= width)
+	{
+	    _mm256_storeu_si256 ((__m256i *)(buffer + i), p);
+	}
+	else
+	{
+	    uint32_t q[8];
+
+	    _mm256_storeu_si256 ((__m256i *)q, p);
+
+	    for (j = 0; j < width - i; ++j)
+		buffer[i + j] = q[j];
+	}
+    }
+}
+
+static uint32_t *
+avx2_fetch_radial_gradient (pixman_iter_t *iter, const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    radial_gradient_t *radial = &image->radial;
+    pixman_gradient_walker_t walker;
+    pixman_fixed_32_32_t b, db, c, dc, ddc;
+
+    _pixman_gradient_walker_init (
+	&walker, &image->gradient, image->common.repeat);
+
+    if (!walker.ramp || radial->a == 0					||
+	!_pixman_radial_gradient_get_affine_coefficients (
+	    image, iter->x, iter->y, &b, &db, &c, &dc, &ddc))
+    {
+	return _pixman_radial_gradient_get_scanline_narrow (iter, mask);
+    }
+
+    switch (walker.repeat)
+    {
+    case PIXMAN_REPEAT_NORMAL:
+	avx2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_NORMAL);
+	break;
+
+    case PIXMAN_REPEAT_REFLECT:
+	avx2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_REFLECT);
+	break;
+
+    case PIXMAN_REPEAT_PAD:
+	avx2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_PAD);
+	break;
+
+    case PIXMAN_REPEAT_NONE:
+    default:
+	avx2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_NONE);
+	break;
+    }
+
+    iter->y++;
+
+    return iter->buffer;
+}
+
+/*
+ * Conical gradients
+ *
+ * This evaluates _pixman_conical_gradient_approximate_parameter() for
+ * eight pixels at a time with the same operations as the C code.
+ */
+static force_inline __m256
+avx2_conical_gradient_parameter (__m256 x, __m256 y, __m256 angle)
+{
+    __m256 zero = _mm256_setzero_ps ();
+    __m256 one = _mm256_set1_ps (1.f);
+    __m256 sign = _mm256_set1_ps (-0.f);
+    __m256 ax = _mm256_andnot_ps (sign, x);
+    __m256 ay = _mm256_andnot_ps (sign, y);
+    __m256 a, s, t;
+
+    a = _mm256_div_ps (
+	_mm256_min_ps (ax, ay),
+	_mm256_max_ps (_mm256_max_ps (ax, ay), _mm256_set1_ps (FLT_MIN)));
+    s = _mm256_mul_ps (a, a);
+
+    t = _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (CONICAL_ATAN_A9), s),
+		       _mm256_set1_ps (CONICAL_ATAN_A7));
+    t = _mm256_add_ps (_mm256_mul_ps (t, s), _mm256_set1_ps (CONICAL_ATAN_A5));
+    t = _mm256_add_ps (_mm256_mul_ps (t, s), _mm256_set1_ps (CONICAL_ATAN_A3));
+    t = _mm256_add_ps (_mm256_mul_ps (t, s), _mm256_set1_ps (CONICAL_ATAN_A1));
+    t = _mm256_mul_ps (t, a);
+
+    t = _mm256_blendv_ps (t, _mm256_sub_ps (_mm256_set1_ps (0.25f), t),
+			  _mm256_cmp_ps (ay, ax, _CMP_GT_OQ));
+    t = _mm256_blendv_ps (t, _mm256_sub_ps (_mm256_set1_ps (0.5f), t),
+			  _mm256_cmp_ps (x, zero, _CMP_LT_OQ));
+    t = _mm256_xor_ps (
+	t, _mm256_and_ps (_mm256_cmp_ps (y, zero, _CMP_LT_OQ), sign));
+
+    t = _mm256_add_ps (t, angle);
+    t = _mm256_add_ps (
+	t, _mm256_and_ps (_mm256_cmp_ps (t, zero, _CMP_LT_OQ), one));
+    t = _mm256_sub_ps (
+	t, _mm256_and_ps (_mm256_cmp_ps (t, one, _CMP_GE_OQ), one));
+
+    return _mm256_sub_ps (one, t);
+}
+
+static force_inline void
+avx2_conical_gradient_span (uint32_t                 *buffer,
+			    pixman_gradient_walker_t *walker,
+			    float                     x0,
+			    float                     y0,
+			    float                     dx,
+			    float                     dy,
+			    float                     angle,
+			    int                       width,
+			    pixman_repeat_t           repeat)
+{
+    __m256 ymm_x0 = _mm256_set1_ps (x0);
+    __m256 ymm_y0 = _mm256_set1_ps (y0);
+    __m256 ymm_dx = _mm256_set1_ps (dx);
+    __m256 ymm_dy = _mm256_set1_ps (dy);
+    __m256 ymm_angle = _mm256_set1_ps (angle);
+    __m256 ymm_i = _mm256_setr_ps (0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+    int i;
+
+    for (i = 0; i < width; i += 8)
+    {
+	__m256 t;
+	__m256i p;
+
+	t = avx2_conical_gradient_parameter (
+	    _mm256_add_ps (ymm_x0, _mm256_mul_ps (ymm_i, ymm_dx)),
+	    _mm256_add_ps (ymm_y0, _mm256_mul_ps (ymm_i, ymm_dy)),
+	    ymm_angle);
+
+	p = avx2_gradient_ramp_lookup (
+	    walker,
+	    _mm256_cvttps_epi32 (_mm256_mul_ps (t, _mm256_set1_ps (65536.f))),
+	    repeat);
+
+	if (i + 8 <= width)
+	{
+	    _mm256_storeu_si256 ((__m256i *)(buffer + i), p);
+	}
+	else
+	{
+	    uint32_t q[8];
+	    int j;
+
+	    _mm256_storeu_si256 ((__m256i *)q, p);
+
+	    for (j = 0; j < width - i; ++j)
+		buffer[i + j] = q[j];
+	}
+
+	ymm_i = _mm256_add_ps (ymm_i, _mm256_set1_ps (8.f));
+    }
+}
+
+static uint32_t *
+avx2_fetch_conical_gradient (pixman_iter_t *iter, const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    pixman_gradient_walker_t walker;
+    double rx, ry, cx, cy;
+    float angle;
+
+    if (!_pixman_conical_gradient_get_affine_position (
+	    image, iter->x, iter->y, &rx, &ry, &cx, &cy))
+    {
+	return _pixman_conical_gradient_get_scanline_narrow (iter, mask);
+    }
+
+    _pixman_gradient_walker_init (
+	&walker, &image->gradient, image->common.repeat);
+
+    angle = image->conical.angle * (1 / (2 * M_PI));
+
+    switch (walker.repeat)
+    {
+    case PIXMAN_REPEAT_NORMAL:
+	avx2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_NORMAL);
+	break;
+
+    case PIXMAN_REPEAT_REFLECT:
+	avx2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_REFLECT);
+	break;
+
+    case PIXMAN_REPEAT_PAD:
+	avx2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_PAD);
+	break;
+
+    case PIXMAN_REPEAT_NONE:
+    default:
+	avx2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_NONE);
+	break;
+    }
+
+    iter->y++;
+
+    return iter->buffer;
+}
+
+#endif
+
+/*
+ * Separable convolution
+ *
+ * Like the SSE2 fetchers, these compute the weights the way
+ * bits_image_fetch_separable_convolution_affine() does and are only
+ * used when all of them fit in 16 bits. One _mm256_madd_epi16()
+ * applies four taps to the four channels of four pixels.
+ */
+#define SEPARABLE_CONVOLUTION_MAX_WIDTH		256
+
+#define SEPARABLE_CONVOLUTION_FLAGS					\
+    (FAST_PATH_NO_ALPHA_MAP		|				\
+     FAST_PATH_NO_ACCESSORS		|				\
+     FAST_PATH_HAS_TRANSFORM		|				\
+     FAST_PATH_AFFINE_TRANSFORM		|				\
+     FAST_PATH_SEPARABLE_CONVOLUTION_FILTER)
+
+/* Adds the taps of one row of the filter to the per-channel totals in
+ * acc. Pixels are ORed with or_mask before they are weighted.
+ */
+static force_inline __m128i
+avx2_convolve_row (const uint32_t       *row,
+		   const pixman_fixed_t *x_params,
+		   pixman_fixed_t        fy,
+		   int                   cwidth,
+		   __m128i               xmm_or,
+		   __m128i               xmm_acc)
+{
+    __m256i ymm_fy = _mm256_set1_epi32 (fy);
+    __m256i ymm_round = _mm256_set1_epi32 (0x8000);
+    __m256i ymm_lo_pairs = _mm256_setr_epi32 (0, 0, 0, 0, 1, 1, 1, 1);
+    __m256i ymm_hi_pairs = _mm256_setr_epi32 (2, 2, 2, 2, 3, 3, 3, 3);
+    __m256i ymm_acc = _mm256_setzero_si256 ();
+    __m256i ymm_w, ymm_p;
+    __m128i xmm_w, xmm_p;
+    int j;
+
+    for (j = 0; j + 8 <= cwidth; j += 8)
+    {
+	ymm_w = _mm256_mullo_epi32 (
+	    _mm256_loadu_si256 ((__m256i *)(x_params + j)), ymm_fy);
+	ymm_w = _mm256_srai_epi32 (_mm256_add_epi32 (ymm_w, ymm_round), 16);
+	xmm_w = _mm_packs_epi32 (_mm256_castsi256_si128 (ymm_w),
+				 _mm256_extracti128_si256 (ymm_w, 1));
+	ymm_w = _mm256_castsi128_si256 (xmm_w);
+
+	/* Interleave the channels of pixels 0 and 1 in the low lane,
+	 * and those of pixels 2 and 3 in the high lane.
+	 */
+	ymm_p = _mm256_cvtepu8_epi16 (
+	    _mm_or_si128 (_mm_loadu_si128 ((__m128i *)(row + j)), xmm_or));
+	ymm_p = _mm256_unpacklo_epi16 (ymm_p, _mm256_srli_si256 (ymm_p, 8));
+	ymm_acc = _mm256_add_epi32 (ymm_acc, _mm256_madd_epi16 (
+	    ymm_p, _mm256_permutevar8x32_epi32 (ymm_w, ymm_lo_pairs)));
+
+	ymm_p = _mm256_cvtepu8_epi16 (
+	    _mm_or_si128 (_mm_loadu_si128 ((__m128i *)(row + j + 4)), xmm_or));
+	ymm_p = _mm256_unpacklo_epi16 (ymm_p, _mm256_srli_si256 (ymm_p, 8));
+	ymm_acc = _mm256_add_epi32 (ymm_acc, _mm256_madd_epi16 (
+	    ymm_p, _mm256_permutevar8x32_epi32 (ymm_w, ymm_hi_pairs)));
+    }
+
+    xmm_acc = _mm_add_epi32 (xmm_acc, _mm256_castsi256_si128 (ymm_acc));
+    xmm_acc = _mm_add_epi32 (xmm_acc, _mm256_extracti128_si256 (ymm_acc, 1));
+
+    if (j + 4 <= cwidth)
+    {
+	xmm_w = _mm_mullo_epi32 (
+	    _mm_loadu_si128 ((__m128i *)(x_params + j)),
+	    _mm256_castsi256_si128 (ymm_fy));
+	xmm_w = _mm_srai_epi32 (
+	    _mm_add_epi32 (xmm_w, _mm256_castsi256_si128 (ymm_round)), 16);
+	xmm_w = _mm_packs_epi32 (xmm_w, xmm_w);
+
+	ymm_p = _mm256_cvtepu8_epi16 (
+	    _mm_or_si128 (_mm_loadu_si128 ((__m128i *)(row + j)), xmm_or));
+	ymm_p = _mm256_unpacklo_epi16 (ymm_p, _mm256_srli_si256 (ymm_p, 8));
+	ymm_p = _mm256_madd_epi16 (
+	    ymm_p, _mm256_permutevar8x32_epi32 (
+		_mm256_castsi128_si256 (xmm_w), ymm_lo_pairs));
+
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm256_castsi256_si128 (ymm_p));
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm256_extracti128_si256 (ymm_p, 1));
+
+	j += 4;
+    }
+
+    for (; j + 2 <= cwidth; j += 2)
+    {
+	int32_t f0 = ((pixman_fixed_32_32_t)x_params[j] * fy + 0x8000) >> 16;
+	int32_t f1 = ((pixman_fixed_32_32_t)x_params[j + 1] * fy + 0x8000) >> 16;
+
+	xmm_p = _mm_or_si128 (_mm_loadl_epi64 ((__m128i *)(row + j)), xmm_or);
+	xmm_p = _mm_cvtepu8_epi16 (xmm_p);
+	xmm_p = _mm_unpacklo_epi16 (xmm_p, _mm_srli_si128 (xmm_p, 8));
+
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+				     xmm_p, _mm_set1_epi32 ((f0 & 0xffff) | ((uint32_t)f1 << 16))));
+    }
+
+    if (j < cwidth)
+    {
+	int32_t f = ((pixman_fixed_32_32_t)x_params[j] * fy + 0x8000) >> 16;
+
+	xmm_p = _mm_or_si128 (_mm_cvtsi32_si128 (row[j]), xmm_or);
+	xmm_p = _mm_cvtepu8_epi32 (xmm_p);
+
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+				     xmm_p, _mm_set1_epi32 (f & 0xffff)));
+    }
+
+    return xmm_acc;
+}
+
+static force_inline void
+avx2_fetch_separable_convolution (pixman_iter_t   *iter,
+				  const uint32_t  *mask,
+				  pixman_repeat_t  repeat_mode)
+{
+    pixman_image_t *image = iter->image;
+    bits_image_t *bits = &image->bits;
+    pixman_fixed_t *params = image->common.filter_params;
+    int cwidth = pixman_fixed_to_int (params[0]);
+    int cheight = pixman_fixed_to_int (params[1]);
+    int x_off = ((cwidth << 16) - pixman_fixed_1) >> 1;
+    int y_off = ((cheight << 16) - pixman_fixed_1) >> 1;
+    int x_phase_bits = pixman_fixed_to_int (params[2]);
+    int x_phase_shift = 16 - x_phase_bits;
+    int y_phase_shift = 16 - pixman_fixed_to_int (params[3]);
+    uint32_t or_mask = PIXMAN_FORMAT_A (bits->format) ? 0 : 0xff000000;
+    __m128i xmm_or = _mm_set1_epi32 (or_mask);
+    __m128i xmm_round = _mm_set1_epi32 (0x8000);
+    uint32_t *buffer = iter->buffer;
+    uint32_t tmp[SEPARABLE_CONVOLUTION_MAX_WIDTH];
+    int rx[SEPARABLE_CONVOLUTION_MAX_WIDTH];
+    pixman_fixed_t vx, vy, ux, uy;
+    pixman_vector_t v;
+    int i, j, k;
+
+    /* reference point is the center of the pixel */
+    v.vector[0] = pixman_int_to_fixed (iter->x) + pixman_fixed_1 / 2;
+    v.vector[1] = pixman_int_to_fixed (iter->y++) + pixman_fixed_1 / 2;
+    v.vector[2] = pixman_fixed_1;
+
+    if (!pixman_transform_point_3d (image->common.transform, &v))
+	return;
+
+    ux = image->common.transform->matrix[0][0];
+    uy = image->common.transform->matrix[1][0];
+
+    vx = v.vector[0];
+    vy = v.vector[1];
+
+    for (k = 0; k < iter->width; ++k, vx += ux, vy += uy)
+    {
+	const pixman_fixed_t *x_params, *y_params;
+	pixman_fixed_t x, y;
+	int32_t x1, y1;
+	pixman_bool_t inside;
+	__m128i xmm_acc;
+
+	if (mask && !mask[k])
+	    continue;
+
+	/* See bits_image_fetch_separable_convolution_affine() */
+	x = ((vx >> x_phase_shift) << x_phase_shift) + ((1 << x_phase_shift) >> 1);
+	y = ((vy >> y_phase_shift) << y_phase_shift) + ((1 << y_phase_shift) >> 1);
+
+	x_params = params + 4 + ((x & 0xffff) >> x_phase_shift) * cwidth;
+	y_params = params + 4 + (1 << x_phase_bits) * cwidth +
+	    ((y & 0xffff) >> y_phase_shift) * cheight;
+
+	x1 = pixman_fixed_to_int (x - pixman_fixed_e - x_off);
+	y1 = pixman_fixed_to_int (y - pixman_fixed_e - y_off);
+
+	inside = x1 >= 0 && x1 + cwidth <= bits->width;
+
+	if (!inside)
+	{
+	    for (j = 0; j < cwidth; ++j)
+	    {
+		rx[j] = x1 + j;
+
+		if (repeat_mode != PIXMAN_REPEAT_NONE)
+		    repeat (repeat_mode, &rx[j], bits->width);
+		else if (rx[j] < 0 || rx[j] >= bits->width)
+		    rx[j] = -1;
+	    }
+	}
+
+	xmm_acc = _mm_setzero_si128 ();
+
+	for (i = 0; i < cheight; ++i)
+	{
+	    pixman_fixed_t fy = y_params[i];
+	    const uint32_t *row;
+	    int ry = y1 + i;
+
+	    if (!fy)
+		continue;
+
+	    if (repeat_mode != PIXMAN_REPEAT_NONE)
+		repeat (repeat_mode, &ry, bits->height);
+	    else if (ry < 0 || ry >= bits->height)
+		continue;
+
+	    row = bits->bits + bits->rowstride * ry;
+
+	    if (inside)
+	    {
+		xmm_acc = avx2_convolve_row (
+		    row + x1, x_params, fy, cwidth, xmm_or, xmm_acc);
+	    }
+	    else
+	    {
+		for (j = 0; j < cwidth; ++j)
+		    tmp[j] = rx[j] < 0 ? 0 : row[rx[j]] | or_mask;
+
+		xmm_acc = avx2_convolve_row (
+		    tmp, x_params, fy, cwidth, _mm_setzero_si128 (), xmm_acc);
+	    }
+	}
+
+	xmm_acc = _mm_srai_epi32 (_mm_add_epi32 (xmm_acc, xmm_round), 16);
+	xmm_acc = _mm_packs_epi32 (xmm_acc, xmm_acc);
+	xmm_acc = _mm_packus_epi16 (xmm_acc, xmm_acc);
+
+	buffer[k] = _mm_cvtsi128_si32 (xmm_acc);
+    }
+}
+
+#define MAKE_SEPARABLE_CONVOLUTION_FETCHER(name, repeat_mode)		\
+    static uint32_t *							\
+    avx2_fetch_separable_convolution_ ## name (pixman_iter_t  *iter,	\
+					       const uint32_t *mask)	\
+    {									\
+	avx2_fetch_separable_convolution (iter, mask, repeat_mode);	\
+									\
+	return iter->buffer;						\
+    }
+
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (none,    PIXMAN_REPEAT_NONE)
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (normal,  PIXMAN_REPEAT_NORMAL)
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (pad,     PIXMAN_REPEAT_PAD)
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (reflect, PIXMAN_REPEAT_REFLECT)
+
+/* Separable scaling, see pixman-bits-image.c. The horizontal sums are
+ * computed for two source pixels at a time, with 32 bit products.
+ */
+static void
+avx2_separable_scale_filter_row (const separable_scale_t *scale,
+				 const uint32_t          *src,
+				 int32_t                 *row)
+{
+    __m256i ymm_lo_taps = _mm256_setr_epi32 (0, 0, 0, 0, 1, 1, 1, 1);
+    __m256i ymm_hi_taps = _mm256_setr_epi32 (2, 2, 2, 2, 3, 3, 3, 3);
+    __m128i xmm_or = _mm_set1_epi32 (scale->or_mask);
+    int cwidth = scale->cwidth;
+    int j, k;
+
+    for (k = scale->begin; k < scale->end; ++k)
+    {
+	const pixman_fixed_t *x_params = scale->x_params[k];
+	const uint32_t *p = src + scale->x1[k];
+	__m256i ymm_acc = _mm256_setzero_si256 ();
+	__m128i xmm_acc;
+
+	for (j = 0; j + 4 <= cwidth; j += 4)
+	{
+	    __m256i ymm_w = _mm256_castsi128_si256 (
+		_mm_loadu_si128 ((__m128i *)(x_params + j)));
+	    __m128i xmm_p = _mm_or_si128 (
+		_mm_loadu_si128 ((__m128i *)(p + j)), xmm_or);
+
+	    ymm_acc = _mm256_add_epi32 (ymm_acc, _mm256_mullo_epi32 (
+		_mm256_cvtepu8_epi32 (xmm_p),
+		_mm256_permutevar8x32_epi32 (ymm_w, ymm_lo_taps)));
+	    ymm_acc = _mm256_add_epi32 (ymm_acc, _mm256_mullo_epi32 (
+		_mm256_cvtepu8_epi32 (_mm_srli_si128 (xmm_p, 8)),
+		_mm256_permutevar8x32_epi32 (ymm_w, ymm_hi_taps)));
+	}
+
+	xmm_acc = _mm_add_epi32 (_mm256_castsi256_si128 (ymm_acc),
+				 _mm256_extracti128_si256 (ymm_acc, 1));
+
+	for (; j < cwidth; ++j)
+	{
+	    __m128i xmm_p = _mm_cvtsi32_si128 (p[j] | scale->or_mask);
+
+	    xmm_acc = _mm_add_epi32 (xmm_acc, _mm_mullo_epi32 (
+		_mm_cvtepu8_epi32 (xmm_p), _mm_set1_epi32 (x_params[j])));
+	}
+
+	_mm_storeu_si128 ((__m128i *)(row + 4 * k), xmm_acc);
+    }
+}
+
+static void
+avx2_separable_scale_combine_rows (uint32_t              *buffer,
+				   int                    width,
+				   const int32_t        **rows,
+				   const pixman_fixed_t  *weights,
+				   int                    n_rows)
+{
+    __m256i ymm_half = _mm256_set1_epi64x (0x80000000);
+    __m256i ymm_hi = _mm256_set1_epi64x ((int64_t)0xffffffff00000000ULL);
+    __m256i ymm_pixels = _mm256_setr_epi32 (0, 4, 0, 0, 0, 0, 0, 0);
+    int i, k;
+
+    for (k = 0; k + 2 <= width; k += 2)
+    {
+	/* The b and r sums in the even lanes, g and a in the odd ones */
+	__m256i ymm_even = ymm_half, ymm_odd = ymm_half;
+	__m256i ymm_pixel;
+
+	for (i = 0; i < n_rows; ++i)
+	{
+	    __m256i ymm_w = _mm256_set1_epi32 (weights[i]);
+	    __m256i ymm_h = _mm256_loadu_si256 (
+		(const __m256i *)(rows[i] + 4 * k));
+
+	    ymm_even = _mm256_add_epi64 (ymm_even, _mm256_mul_epi32 (ymm_h, ymm_w));
+	    ymm_odd = _mm256_add_epi64 (ymm_odd, _mm256_mul_epi32 (
+		_mm256_srli_epi64 (ymm_h, 32), ymm_w));
+	}
+
+	/* The upper halves of the rounded sums are the channels */
+	ymm_pixel = _mm256_or_si256 (_mm256_srli_epi64 (ymm_even, 32),
+				     _mm256_and_si256 (ymm_odd, ymm_hi));
+	ymm_pixel = _mm256_packs_epi32 (ymm_pixel, ymm_pixel);
+	ymm_pixel = _mm256_packus_epi16 (ymm_pixel, ymm_pixel);
+	ymm_pixel = _mm256_permutevar8x32_epi32 (ymm_pixel, ymm_pixels);
+
+	_mm_storel_epi64 ((__m128i *)(buffer + k),
+			  _mm256_castsi256_si128 (ymm_pixel));
+    }
+
+    if (k < width)
+    {
+	__m128i xmm_even = _mm256_castsi256_si128 (ymm_half);
+	__m128i xmm_odd = xmm_even;
+	__m128i xmm_pixel;
+
+	for (i = 0; i < n_rows; ++i)
+	{
+	    __m128i xmm_w = _mm_set1_epi32 (weights[i]);
+	    __m128i xmm_h = _mm_loadu_si128 ((const __m128i *)(rows[i] + 4 * k));
+
+	    xmm_even = _mm_add_epi64 (xmm_even, _mm_mul_epi32 (xmm_h, xmm_w));
+	    xmm_odd = _mm_add_epi64 (xmm_odd, _mm_mul_epi32 (
+		_mm_srli_epi64 (xmm_h, 32), xmm_w));
+	}
+
+	xmm_pixel = _mm_or_si128 (_mm_srli_epi64 (xmm_even, 32),
+				  _mm_and_si128 (xmm_odd,
+						 _mm256_castsi256_si128 (ymm_hi)));
+	xmm_pixel = _mm_packs_epi32 (xmm_pixel, xmm_pixel);
+	buffer[k] = _mm_cvtsi128_si32 (_mm_packus_epi16 (xmm_pixel, xmm_pixel));
+    }
+}
+
+static pixman_bool_t
+avx2_src_iter_init (pixman_implementation_t *imp, pixman_iter_t *iter)
+{
+    pixman_image_t *image = iter->image;
+
+#define FLAGS								\
+    (FAST_PATH_STANDARD_FLAGS | FAST_PATH_ID_TRANSFORM |		\
+     FAST_PATH_BITS_IMAGE | FAST_PATH_SAMPLES_COVER_CLIP_NEAREST)
+
+    if ((iter->iter_flags & ITER_NARROW)			&&
+	(iter->image_flags & FLAGS) == FLAGS)
+    {
+	const fetcher_info_t *f;
+
+	for (f = &fetchers[0]; f->format != PIXMAN_null; f++)
+	{
+	    if (image->common.extended_format_code == f->format)
+	    {
+		uint8_t *b = (uint8_t *)image->bits.bits;
+		int s = image->bits.rowstride * 4;
+
+		iter->bits = b + s * iter->y + iter->x * PIXMAN_FORMAT_BPP (f->format) / 8;
+		iter->stride = s;
+
+		iter->get_scanline = f->get_scanline;
+		return TRUE;
+	    }
+	}
+    }
+
+#ifdef AVX2_FLOAT_MATCHES_C
+    if ((iter->iter_flags & ITER_NARROW) && image->type == RADIAL &&
+	image->gradient.ramp)
+    {
+	iter->get_scanline = avx2_fetch_radial_gradient;
+	return TRUE;
+    }
+
+    if ((iter->iter_flags & ITER_NARROW) && image->type == CONICAL &&
+	image->gradient.ramp)
+    {
+	iter->get_scanline = avx2_fetch_conical_gradient;
+	return TRUE;
+    }
+#endif
+
+    if (_pixman_separable_scale_iter_init (
+	    iter, avx2_separable_scale_filter_row,
+	    avx2_separable_scale_combine_rows))
+    {
+	return TRUE;
+    }
+
+    if ((iter->iter_flags & ITER_NARROW)				&&
+	(iter->image_flags & SEPARABLE_CONVOLUTION_FLAGS) ==
+	SEPARABLE_CONVOLUTION_FLAGS					&&
+	(image->common.extended_format_code == PIXMAN_a8r8g8b8	||
+	 image->common.extended_format_code == PIXMAN_x8r8g8b8)	&&
+	pixman_fixed_to_int (image->common.filter_params[0]) <=
+	SEPARABLE_CONVOLUTION_MAX_WIDTH				&&
+	_pixman_separable_convolution_weights_fit_int16 (
+	    image->common.filter_params))
+    {
+	switch (image->common.repeat)
+	{
+	case PIXMAN_REPEAT_NONE:
+	    iter->get_scanline = avx2_fetch_separable_convolution_none;
+	    break;
+
+	case PIXMAN_REPEAT_NORMAL:
+	    iter->get_scanline = avx2_fetch_separable_convolution_normal;
+	    break;
+
+	case PIXMAN_REPEAT_PAD:
+	    iter->get_scanline = avx2_fetch_separable_convolution_pad;
+	    break;
+
+	case PIXMAN_REPEAT_REFLECT:
+	    iter->get_scanline = avx2_fetch_separable_convolution_reflect;
+	    break;
+	}
+
+	return TRUE;
+    }
+
+    return FALSE;
+}
+
+#if defined(__GNUC__) && !defined(__x86_64__) && !defined(__amd64__)
+__attribute__((__force_align_arg_pointer__))
+#endif
+pixman_implementation_t *
+_pixman_implementation_create_avx2 (pixman_implementation_t *fallback)
+{
+    pixman_implementation_t *imp = _pixman_implementation_create (fallback, avx2_fast_paths);
+
+    imp->name = "avx2";
+
+    /* AVX2 constants */
+    mask_0080 = _mm256_set1_epi16 (0x0080);
+    mask_00ff = _mm256_set1_epi16 (0x00ff);
+    mask_0101 = _mm256_set1_epi16 (0x0101);
+    mask_ff000000 = _mm256_set1_epi32 (0xff000000);
+
+    /* Set up function pointers */
+    imp->combine_32[PIXMAN_OP_OVER] = avx2_combine_over_u;
+    imp->combine_32[PIXMAN_OP_ADD] = avx2_combine_add_u;
+
+#ifdef AVX2_FLOAT_MATCHES_C
+    imp->combine_float[PIXMAN_OP_CLEAR] = avx2_combine_clear_u_float;
+    imp->combine_float[PIXMAN_OP_SRC] = avx2_combine_src_u_float;
+    imp->combine_float[PIXMAN_OP_DST] = avx2_combine_dst_u_float;
+    imp->combine_float[PIXMAN_OP_OVER] = avx2_combine_over_u_float;
+    imp->combine_float[PIXMAN_OP_OVER_REVERSE] = avx2_combine_over_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_IN] = avx2_combine_in_u_float;
+    imp->combine_float[PIXMAN_OP_IN_REVERSE] = avx2_combine_in_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_OUT] = avx2_combine_out_u_float;
+    imp->combine_float[PIXMAN_OP_OUT_REVERSE] = avx2_combine_out_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_ATOP] = avx2_combine_atop_u_float;
+    imp->combine_float[PIXMAN_OP_ATOP_REVERSE] = avx2_combine_atop_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_XOR] = avx2_combine_xor_u_float;
+    imp->combine_float[PIXMAN_OP_ADD] = avx2_combine_add_u_float;
+    imp->combine_float[PIXMAN_OP_SATURATE] = avx2_combine_saturate_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_CLEAR] = avx2_combine_disjoint_clear_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_SRC] = avx2_combine_disjoint_src_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_DST] = avx2_combine_disjoint_dst_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OVER] = avx2_combine_disjoint_over_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OVER_REVERSE] = avx2_combine_disjoint_over_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_IN] = avx2_combine_disjoint_in_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_IN_REVERSE] = avx2_combine_disjoint_in_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OUT] = avx2_combine_disjoint_out_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OUT_REVERSE] = avx2_combine_disjoint_out_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_ATOP] = avx2_combine_disjoint_atop_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_ATOP_REVERSE] = avx2_combine_disjoint_atop_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_XOR] = avx2_combine_disjoint_xor_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_CLEAR] = avx2_combine_conjoint_clear_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_SRC] = avx2_combine_conjoint_src_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_DST] = avx2_combine_conjoint_dst_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OVER] = avx2_combine_conjoint_over_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OVER_REVERSE] = avx2_combine_conjoint_over_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_IN] = avx2_combine_conjoint_in_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_IN_REVERSE] = avx2_combine_conjoint_in_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OUT] = avx2_combine_conjoint_out_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OUT_REVERSE] = avx2_combine_conjoint_out_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_ATOP] = avx2_combine_conjoint_atop_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_ATOP_REVERSE] = avx2_combine_conjoint_atop_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_XOR] = avx2_combine_conjoint_xor_u_float;
+    imp->combine_float[PIXMAN_OP_MULTIPLY] = avx2_combine_multiply_u_float;
+    imp->combine_float[PIXMAN_OP_SCREEN] = avx2_combine_screen_u_float;
+    imp->combine_float[PIXMAN_OP_OVERLAY] = avx2_combine_overlay_u_float;
+    imp->combine_float[PIXMAN_OP_DARKEN] = avx2_combine_darken_u_float;
+    imp->combine_float[PIXMAN_OP_LIGHTEN] = avx2_combine_lighten_u_float;
+    imp->combine_float[PIXMAN_OP_COLOR_DODGE] = avx2_combine_color_dodge_u_float;
+    imp->combine_float[PIXMAN_OP_COLOR_BURN] = avx2_combine_color_burn_u_float;
+    imp->combine_float[PIXMAN_OP_HARD_LIGHT] = avx2_combine_hard_light_u_float;
+    imp->combine_float[PIXMAN_OP_SOFT_LIGHT] = avx2_combine_soft_light_u_float;
+    imp->combine_float[PIXMAN_OP_DIFFERENCE] = avx2_combine_difference_u_float;
+    imp->combine_float[PIXMAN_OP_EXCLUSION] = avx2_combine_exclusion_u_float;
+
+    imp->combine_float_ca[PIXMAN_OP_CLEAR] = avx2_combine_clear_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SRC] = avx2_combine_src_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DST] = avx2_combine_dst_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OVER] = avx2_combine_over_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OVER_REVERSE] = avx2_combine_over_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_IN] = avx2_combine_in_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_IN_REVERSE] = avx2_combine_in_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OUT] = avx2_combine_out_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OUT_REVERSE] = avx2_combine_out_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_ATOP] = avx2_combine_atop_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_ATOP_REVERSE] = avx2_combine_atop_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_XOR] = avx2_combine_xor_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_ADD] = avx2_combine_add_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SATURATE] = avx2_combine_saturate_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_CLEAR] = avx2_combine_disjoint_clear_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_SRC] = avx2_combine_disjoint_src_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_DST] = avx2_combine_disjoint_dst_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OVER] = avx2_combine_disjoint_over_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OVER_REVERSE] = avx2_combine_disjoint_over_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_IN] = avx2_combine_disjoint_in_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_IN_REVERSE] = avx2_combine_disjoint_in_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OUT] = avx2_combine_disjoint_out_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OUT_REVERSE] = avx2_combine_disjoint_out_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_ATOP] = avx2_combine_disjoint_atop_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_ATOP_REVERSE] = avx2_combine_disjoint_atop_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_XOR] = avx2_combine_disjoint_xor_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_CLEAR] = avx2_combine_conjoint_clear_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_SRC] = avx2_combine_conjoint_src_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_DST] = avx2_combine_conjoint_dst_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OVER] = avx2_combine_conjoint_over_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OVER_REVERSE] = avx2_combine_conjoint_over_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_IN] = avx2_combine_conjoint_in_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_IN_REVERSE] = avx2_combine_conjoint_in_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OUT] = avx2_combine_conjoint_out_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OUT_REVERSE] = avx2_combine_conjoint_out_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_ATOP] = avx2_combine_conjoint_atop_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_ATOP_REVERSE] = avx2_combine_conjoint_atop_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_XOR] = avx2_combine_conjoint_xor_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_MULTIPLY] = avx2_combine_multiply_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SCREEN] = avx2_combine_screen_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OVERLAY] = avx2_combine_overlay_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DARKEN] = avx2_combine_darken_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_LIGHTEN] = avx2_combine_lighten_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_COLOR_DODGE] = avx2_combine_color_dodge_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_COLOR_BURN] = avx2_combine_color_burn_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_HARD_LIGHT] = avx2_combine_hard_light_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SOFT_LIGHT] = avx2_combine_soft_light_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DIFFERENCE] = avx2_combine_difference_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_EXCLUSION] = avx2_combine_exclusion_ca_float;
+#endif
+
+    imp->blt = avx2_blt;
+    imp->glyph_spans = avx2_glyph_spans;
+
+    imp->src_iter_init = avx2_src_iter_init;
+
+    return imp;
+}
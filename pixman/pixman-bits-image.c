@@ -1099,6 +1099,419 @@ convert_a8r8g8b8 (const uint8_t *row, int x)
     return *(((uint32_t *)row) + x);
 }
 
+/* Returns the largest absolute value of the n filter values in p */
+static int64_t
+separable_convolution_max_value (const pixman_fixed_t *p, int n)
+{
+    int64_t max = 0;
+    int i;
+
+    for (i = 0; i < n; ++i)
+    {
+	int64_t v = p[i];
+
+	if (v < 0)
+	    v = -v;
+
+	max = MAX (max, v);
+    }
+
+    return max;
+}
+
+/* Returns TRUE if, for the separable convolution filter parameters
+ * params, the product of every x and y filter value plus the rounding
+ * constant fits in an int32_t. Then the weights that
+ * bits_image_fetch_separable_convolution_affine() computes fit in an
+ * int16_t, which the SIMD fetchers rely on.
+ */
+pixman_bool_t
+_pixman_separable_convolution_weights_fit_int16 (const pixman_fixed_t *params)
+{
+    int n_x = (1 << pixman_fixed_to_int (params[2])) * pixman_fixed_to_int (params[0]);
+    int n_y = (1 << pixman_fixed_to_int (params[3])) * pixman_fixed_to_int (params[1]);
+    int64_t max_x = separable_convolution_max_value (params + 4, n_x);
+    int64_t max_y = separable_convolution_max_value (params + 4 + n_x, n_y);
+
+    return max_x * max_y + 0x8000 <= INT32_MAX;
+}
+
+/*
+ * Separable scaling
+ *
+ * When the transform is a scale, the source columns and the filter
+ * phases of the destination columns are the same on every scanline.
+ * The filter can then be applied in two passes: every source row is
+ * filtered horizontally once, into a ring of cheight cached rows, and
+ * each scanline is the vertically filtered sum of cheight of those.
+ * That is cwidth + cheight taps per pixel instead of cwidth * cheight.
+ *
+ * Both passes are exact: the horizontal sums are cached as int32_t, and
+ * the vertical ones multiply them by the 16.16 y filter values in 64
+ * bits, so the result is only rounded once, at the end. The products of
+ * the x and y filter values are not rounded to 16.16 first like the
+ * affine fetchers do it, so the results can be off by one from theirs.
+ * The implementations only differ in the row functions, which all have
+ * to give exactly the same results.
+ */
+#define SEPARABLE_SCALE_FLAGS						\
+    (FAST_PATH_NO_ALPHA_MAP		|				\
+     FAST_PATH_NO_ACCESSORS		|				\
+     FAST_PATH_HAS_TRANSFORM		|				\
+     FAST_PATH_SCALE_TRANSFORM		|				\
+     FAST_PATH_SEPARABLE_CONVOLUTION_FILTER)
+
+/* The tallest filter whose horizontal sums are cached */
+#define SEPARABLE_SCALE_MAX_ROWS	256
+
+static pixman_bool_t
+separable_scale_possible (pixman_iter_t *iter)
+{
+    pixman_image_t *image = iter->image;
+    pixman_fixed_t *params;
+    int cwidth, cheight, n_x, n_y;
+    int64_t max_x, max_y;
+
+    /* This only depends on the image and on the format of the iterator,
+     * never on the size of the area it covers, so that compositing in
+     * strips or tiles gives the same results as compositing at once.
+     */
+    if (!(iter->iter_flags & ITER_NARROW))
+	return FALSE;
+
+    if (image->type != BITS						||
+	(image->common.flags & SEPARABLE_SCALE_FLAGS) != SEPARABLE_SCALE_FLAGS ||
+	(image->common.extended_format_code != PIXMAN_a8r8g8b8		&&
+	 image->common.extended_format_code != PIXMAN_x8r8g8b8))
+    {
+	return FALSE;
+    }
+
+    params = image->common.filter_params;
+    cwidth = pixman_fixed_to_int (params[0]);
+    cheight = pixman_fixed_to_int (params[1]);
+    n_x = (1 << pixman_fixed_to_int (params[2])) * cwidth;
+    n_y = (1 << pixman_fixed_to_int (params[3])) * cheight;
+
+    if (cwidth <= 0 || cheight <= 0 || cheight > SEPARABLE_SCALE_MAX_ROWS)
+	return FALSE;
+
+    /* Leave filters with unreasonably large values to the affine
+     * fetchers, and make sure the horizontal sums fit in an int32_t.
+     * The vertical sums of up to SEPARABLE_SCALE_MAX_ROWS of them then
+     * stay below 2^57.
+     */
+    max_x = separable_convolution_max_value (params + 4, n_x);
+    max_y = separable_convolution_max_value (params + 4 + n_x, n_y);
+
+    return max_x <= pixman_int_to_fixed (4) &&
+	max_y <= pixman_int_to_fixed (4) &&
+	max_x * cwidth * 0xff <= INT32_MAX;
+}
+
+/* The horizontal sums of pixel k, which is near the edge of the image */
+static void
+separable_scale_filter_edge_pixel (const separable_scale_t *scale,
+				   bits_image_t            *bits,
+				   const uint32_t          *src,
+				   int                      k,
+				   int32_t                 *row)
+{
+    pixman_repeat_t repeat_mode = bits->common.repeat;
+    const pixman_fixed_t *x_params = scale->x_params[k];
+    int32_t satot, srtot, sgtot, sbtot;
+    int j;
+
+    satot = srtot = sgtot = sbtot = 0;
+
+    for (j = 0; j < scale->cwidth; ++j)
+    {
+	int rx = scale->x1[k] + j;
+	uint32_t pixel;
+
+	if (!repeat (repeat_mode, &rx, bits->width))
+	    continue;
+
+	pixel = src[rx] | scale->or_mask;
+
+	srtot += (int32_t)RED_8 (pixel) * x_params[j];
+	sgtot += (int32_t)GREEN_8 (pixel) * x_params[j];
+	sbtot += (int32_t)BLUE_8 (pixel) * x_params[j];
+	satot += (int32_t)ALPHA_8 (pixel) * x_params[j];
+    }
+
+    row[4 * k + 0] = sbtot;
+    row[4 * k + 1] = sgtot;
+    row[4 * k + 2] = srtot;
+    row[4 * k + 3] = satot;
+}
+
+/* Returns the horizontally filtered source row y, which is computed
+ * unless it is already cached.
+ */
+static const int32_t *
+separable_scale_get_row (pixman_iter_t *iter, int y)
+{
+    bits_image_t *bits = &iter->image->bits;
+    separable_scale_t *scale = iter->data;
+    int slot = MOD (y, scale->cheight);
+    int32_t *row = scale->rows + slot * iter->width * 4;
+    const uint32_t *src;
+    int k;
+
+    if (scale->row_y[slot] == y)
+	return row;
+
+    scale->row_y[slot] = y;
+
+    repeat (bits->common.repeat, &y, bits->height);
+    src = bits->bits + bits->rowstride * y;
+
+    for (k = 0; k < scale->begin; ++k)
+	separable_scale_filter_edge_pixel (scale, bits, src, k, row);
+
+    scale->filter_row (scale, src, row);
+
+    for (k = scale->end; k < iter->width; ++k)
+	separable_scale_filter_edge_pixel (scale, bits, src, k, row);
+
+    return row;
+}
+
+static uint32_t *
+separable_scale_get_scanline (pixman_iter_t *iter, const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    separable_scale_t *scale = iter->data;
+    pixman_fixed_t *params = image->common.filter_params;
+    int cwidth = scale->cwidth;
+    int cheight = scale->cheight;
+    int y_off = ((cheight << 16) - pixman_fixed_1) >> 1;
+    int x_phase_bits = pixman_fixed_to_int (params[2]);
+    int y_phase_shift = 16 - pixman_fixed_to_int (params[3]);
+    const pixman_fixed_t *y_params;
+    pixman_fixed_t y;
+    pixman_vector_t v;
+    int i, y1, n_rows;
+
+    /* reference point is the center of the pixel */
+    v.vector[0] = pixman_int_to_fixed (iter->x) + pixman_fixed_1 / 2;
+    v.vector[1] = pixman_int_to_fixed (iter->y++) + pixman_fixed_1 / 2;
+    v.vector[2] = pixman_fixed_1;
+
+    if (!pixman_transform_point_3d (image->common.transform, &v))
+	return iter->buffer;
+
+    /* See bits_image_fetch_separable_convolution_affine() */
+    y = ((v.vector[1] >> y_phase_shift) << y_phase_shift) +
+	((1 << y_phase_shift) >> 1);
+    y1 = pixman_fixed_to_int (y - pixman_fixed_e - y_off);
+    y_params = params + 4 + (1 << x_phase_bits) * cwidth +
+	((y & 0xffff) >> y_phase_shift) * cheight;
+
+    n_rows = 0;
+
+    for (i = 0; i < cheight; ++i)
+    {
+	if (!y_params[i])
+	    continue;
+
+	if (image->common.repeat == PIXMAN_REPEAT_NONE &&
+	    (y1 + i < 0 || y1 + i >= image->bits.height))
+	{
+	    continue;
+	}
+
+	scale->row_weights[n_rows] = y_params[i];
+	scale->row_list[n_rows] = separable_scale_get_row (iter, y1 + i);
+	n_rows++;
+    }
+
+    scale->combine_rows (iter->buffer, iter->width,
+			 scale->row_list, scale->row_weights, n_rows);
+
+    return iter->buffer;
+}
+
+static void
+separable_scale_filter_row (const separable_scale_t *scale,
+			    const uint32_t          *src,
+			    int32_t                 *row)
+{
+    int j, k;
+
+    for (k = scale->begin; k < scale->end; ++k)
+    {
+	const pixman_fixed_t *x_params = scale->x_params[k];
+	const uint32_t *p = src + scale->x1[k];
+	int32_t satot, srtot, sgtot, sbtot;
+
+	satot = srtot = sgtot = sbtot = 0;
+
+	for (j = 0; j < scale->cwidth; ++j)
+	{
+	    uint32_t pixel = p[j] | scale->or_mask;
+
+	    srtot += (int32_t)RED_8 (pixel) * x_params[j];
+	    sgtot += (int32_t)GREEN_8 (pixel) * x_params[j];
+	    sbtot += (int32_t)BLUE_8 (pixel) * x_params[j];
+	    satot += (int32_t)ALPHA_8 (pixel) * x_params[j];
+	}
+
+	row[4 * k + 0] = sbtot;
+	row[4 * k + 1] = sgtot;
+	row[4 * k + 2] = srtot;
+	row[4 * k + 3] = satot;
+    }
+}
+
+static force_inline uint32_t
+separable_scale_channel (int64_t sum, int shift)
+{
+    /* The sums are scaled by both the x and the y filter values */
+    int64_t v = (sum + ((int64_t)1 << 31)) >> 32;
+
+    return (uint32_t)CLIP (v, 0, 0xff) << shift;
+}
+
+static void
+separable_scale_combine_rows (uint32_t              *buffer,
+			      int                    width,
+			      const int32_t        **rows,
+			      const pixman_fixed_t  *weights,
+			      int                    n_rows)
+{
+    int i, k;
+
+    for (k = 0; k < width; ++k)
+    {
+	int64_t sb = 0, sg = 0, sr = 0, sa = 0;
+
+	for (i = 0; i < n_rows; ++i)
+	{
+	    const int32_t *h = rows[i] + 4 * k;
+
+	    sb += (int64_t)h[0] * weights[i];
+	    sg += (int64_t)h[1] * weights[i];
+	    sr += (int64_t)h[2] * weights[i];
+	    sa += (int64_t)h[3] * weights[i];
+	}
+
+	buffer[k] =
+	    separable_scale_channel (sb, 0) |
+	    separable_scale_channel (sg, 8) |
+	    separable_scale_channel (sr, 16) |
+	    separable_scale_channel (sa, 24);
+    }
+}
+
+static void
+separable_scale_iter_fini (pixman_iter_t *iter)
+{
+    free (iter->data);
+}
+
+pixman_bool_t
+_pixman_separable_scale_iter_init (pixman_iter_t                  *iter,
+				   separable_scale_filter_row_t    filter_row,
+				   separable_scale_combine_rows_t  combine_rows)
+{
+    pixman_image_t *image = iter->image;
+    int width = iter->width;
+    pixman_fixed_t *params;
+    int cwidth, cheight, x_off, x_phase_shift;
+    separable_scale_t *scale;
+    pixman_fixed_t vx, x;
+    pixman_vector_t v;
+    int k;
+
+    if (!separable_scale_possible (iter))
+	return FALSE;
+
+    params = image->common.filter_params;
+    cwidth = pixman_fixed_to_int (params[0]);
+    cheight = pixman_fixed_to_int (params[1]);
+    x_off = ((cwidth << 16) - pixman_fixed_1) >> 1;
+    x_phase_shift = 16 - pixman_fixed_to_int (params[2]);
+
+    /* The horizontal positions are the same on every scanline, so they
+     * can be computed from the first one.
+     */
+    v.vector[0] = pixman_int_to_fixed (iter->x) + pixman_fixed_1 / 2;
+    v.vector[1] = pixman_int_to_fixed (iter->y) + pixman_fixed_1 / 2;
+    v.vector[2] = pixman_fixed_1;
+
+    if (!pixman_transform_point_3d (image->common.transform, &v))
+	return FALSE;
+
+    scale = malloc (sizeof (separable_scale_t) +
+		    cheight * width * 4 * sizeof (int32_t) +
+		    cheight * sizeof (pixman_fixed_t) +
+		    cheight * sizeof (float *) +
+		    width * sizeof (pixman_fixed_t *) +
+		    (cheight + width) * sizeof (int));
+    if (!scale)
+	return FALSE;
+
+    scale->cwidth = cwidth;
+    scale->cheight = cheight;
+    scale->or_mask = PIXMAN_FORMAT_A (image->bits.format) ? 0 : 0xff000000;
+    /* The pointers come first, so that they are aligned */
+    scale->row_list = (const int32_t **)(scale + 1);
+    scale->x_params = (const pixman_fixed_t **)(scale->row_list + cheight);
+    scale->rows = (int32_t *)(scale->x_params + width);
+    scale->row_weights = (pixman_fixed_t *)(scale->rows + cheight * width * 4);
+    scale->row_y = (int *)(scale->row_weights + cheight);
+    scale->x1 = scale->row_y + cheight;
+    scale->filter_row = filter_row;
+    scale->combine_rows = combine_rows;
+
+    for (k = 0; k < cheight; ++k)
+	scale->row_y[k] = INT32_MIN;
+
+    /* The first source column only ever increases or decreases, so the
+     * pixels that don't need any repeat handling are contiguous.
+     */
+    scale->begin = width;
+    scale->end = width;
+
+    vx = v.vector[0];
+
+    for (k = 0; k < width; ++k)
+    {
+	x = ((vx >> x_phase_shift) << x_phase_shift) + ((1 << x_phase_shift) >> 1);
+
+	scale->x1[k] = pixman_fixed_to_int (x - pixman_fixed_e - x_off);
+	scale->x_params[k] =
+	    params + 4 + ((x & 0xffff) >> x_phase_shift) * cwidth;
+
+	if (scale->x1[k] >= 0 && scale->x1[k] + cwidth <= image->bits.width)
+	{
+	    if (scale->begin == width)
+		scale->begin = k;
+	    scale->end = k + 1;
+	}
+
+	vx += image->common.transform->matrix[0][0];
+    }
+
+    if (scale->begin == width)
+	scale->begin = scale->end = 0;
+
+    iter->data = scale;
+    iter->get_scanline = separable_scale_get_scanline;
+    iter->fini = separable_scale_iter_fini;
+
+    return TRUE;
+}
+
+static pixman_bool_t
+separable_scale_iter_init (pixman_iter_t *iter)
+{
+    return _pixman_separable_scale_iter_init (
+	iter, separable_scale_filter_row, separable_scale_combine_rows);
+}
+
 static force_inline uint32_t
 convert_x8r8g8b8 (const uint8_t *row, int x)
 {
@@ -1367,6 +1780,11 @@ typedef struct
     uint32_t			flags;
     pixman_iter_get_scanline_t	get_scanline_32;
     pixman_iter_get_scanline_t  get_scanline_float;
+
+    /* If not NULL, sets up the iterator, or returns FALSE if the
+     * fetcher can't be used after all.
+     */
+    pixman_bool_t		(* init) (pixman_iter_t *iter);
 } fetcher_info_t;
 
 static const fetcher_info_t fetcher_info[] =
@@ -1449,7 +1867,18 @@ static const fetcher_info_t fetcher_info[] =
     SEPARABLE_CONVOLUTION_AFFINE_FAST_PATH(name, format, repeat)	\
     BILINEAR_AFFINE_FAST_PATH(name, format, repeat)			\
     NEAREST_AFFINE_FAST_PATH(name, format, repeat)
-    
+
+#define SEPARABLE_SCALE_FAST_PATH(format)				\
+    { PIXMAN_ ## format,						\
+      SEPARABLE_SCALE_FLAGS,						\
+      separable_scale_get_scanline,					\
+      _pixman_image_get_scanline_generic_float,			\
+      separable_scale_iter_init					\
+    },
+
+    SEPARABLE_SCALE_FAST_PATH (a8r8g8b8)
+    SEPARABLE_SCALE_FAST_PATH (x8r8g8b8)
+
     AFFINE_FAST_PATHS (pad_a8r8g8b8, a8r8g8b8, PAD)
     AFFINE_FAST_PATHS (none_a8r8g8b8, a8r8g8b8, NONE)
     AFFINE_FAST_PATHS (reflect_a8r8g8b8, a8r8g8b8, REFLECT)
@@ -1488,6 +1917,7 @@ static void
 bits_image_property_changed (pixman_image_t *image)
 {
     _pixman_bits_image_setup_accessors (&image->bits);
+    _pixman_bits_image_update_mipmap (&image->bits);
 }
 
 void
@@ -1500,7 +1930,8 @@ _pixman_bits_image_src_iter_init (pixman_image_t *image, pixman_iter_t *iter)
     for (info = fetcher_info; info->format != PIXMAN_null; ++info)
     {
 	if ((info->format == format || info->format == PIXMAN_any)	&&
-	    (info->flags & flags) == info->flags)
+	    (info->flags & flags) == info->flags			&&
+	    (!info->init || info->init (iter)))
 	{
 	    if (iter->iter_flags & ITER_NARROW)
 	    {
@@ -1663,15 +2094,14 @@ _pixman_bits_image_dest_iter_init (pixman_image_t *image, pixman_iter_t *iter)
     }
 }
 
-static uint32_t *
-create_bits (pixman_format_code_t format,
-             int                  width,
-             int                  height,
-             int *		  rowstride_bytes,
-	     pixman_bool_t	  clear)
+static pixman_bool_t
+compute_bits_size (pixman_format_code_t format,
+		   int                  width,
+		   int                  height,
+		   int *		rowstride_bytes,
+		   size_t *		buf_size)
 {
     int stride;
-    size_t buf_size;
     int bpp;
 
     /* what follows is a long-winded way, avoiding any possibility of integer
@@ -1681,11 +2111,11 @@ create_bits (pixman_format_code_t format,
 
     bpp = PIXMAN_FORMAT_BPP (format);
     if (_pixman_multiply_overflows_int (width, bpp))
-	return NULL;
+	return FALSE;
 
     stride = width * bpp;
     if (_pixman_addition_overflows_int (stride, 0x1f))
-	return NULL;
+	return FALSE;
 
     stride += 0x1f;
     stride >>= 5;
@@ -1693,9 +2123,26 @@ create_bits (pixman_format_code_t format,
     stride *= sizeof (uint32_t);
 
     if (_pixman_multiply_overflows_size (height, stride))
-	return NULL;
+	return FALSE;
+
+    *buf_size = height * stride;
+    *rowstride_bytes = stride;
+
+    return TRUE;
+}
+
+static uint32_t *
+create_bits (pixman_format_code_t format,
+             int                  width,
+             int                  height,
+             int *		  rowstride_bytes,
+	     pixman_bool_t	  clear)
+{
+    size_t buf_size;
+    int stride;
 
-    buf_size = height * stride;
+    if (!compute_bits_size (format, width, height, &stride, &buf_size))
+	return NULL;
 
     if (rowstride_bytes)
 	*rowstride_bytes = stride;
@@ -1741,6 +2188,13 @@ _pixman_bits_image_init (pixman_image_t *     image,
     image->bits.write_func = NULL;
     image->bits.rowstride = rowstride;
     image->bits.indexed = NULL;
+    image->bits.mipmap = PIXMAN_MIPMAP_NONE;
+    image->bits.mipmap_levels = NULL;
+    image->bits.n_mipmap_levels = 0;
+    image->bits.mipmap_level = 0;
+    image->bits.mipmap_weight = 0;
+    image->bits.mipmap_prev = NULL;
+    image->bits.mipmap_next = NULL;
 
     image->common.property_changed = bits_image_property_changed;
 
@@ -1782,6 +2236,48 @@ create_bits_image_internal (pixman_format_code_t format,
     return image;
 }
 
+static void
+free_scratch_bits (pixman_image_t *image, void *data)
+{
+    _pixman_scratch_free (data);
+}
+
+/* Creates a cleared image for temporary use, with bits that come from
+ * the scratch memory of the calling thread.
+ */
+pixman_image_t *
+_pixman_image_create_scratch_bits (pixman_format_code_t format,
+				   int                  width,
+				   int                  height)
+{
+    pixman_image_t *image;
+    uint32_t *bits;
+    size_t buf_size;
+    int stride;
+
+    if (!width || !height)
+	return create_bits_image_internal (format, width, height, NULL, -1, TRUE);
+
+    if (!compute_bits_size (format, width, height, &stride, &buf_size))
+	return NULL;
+
+    if (!(bits = _pixman_scratch_alloc (buf_size)))
+	return NULL;
+
+    memset (bits, 0, buf_size);
+
+    if (!(image = create_bits_image_internal (
+	      format, width, height, bits, stride, FALSE)))
+    {
+	_pixman_scratch_free (bits);
+	return NULL;
+    }
+
+    pixman_image_set_destroy_function (image, free_scratch_bits, bits);
+
+    return image;
+}
+
 /* If bits is NULL, a buffer will be allocated and initialized to 0 */
 PIXMAN_EXPORT pixman_image_t *
 pixman_image_create_bits (pixman_format_code_t format,
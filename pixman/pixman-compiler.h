@@ -230,3 +230,60 @@
 #    error "Unknown thread local support for this system. Pixman will not work with multiple threads. Define PIXMAN_NO_TLS to acknowledge and accept this limitation and compile pixman without thread-safety support."
 
 #endif
+
+/* Locks and atomics
+ *
+ * Without pthreads the locks do nothing, and without the __atomic
+ * builtins atomic accesses are plain ones. Code that needs either to
+ * be real checks HAVE_PTHREADS or PIXMAN_HAVE_ATOMICS.
+ */
+#if defined(HAVE_PTHREADS)
+
+#include <pthread.h>
+
+typedef pthread_mutex_t pixman_mutex_t;
+
+#   define PIXMAN_MUTEX_INITIALIZER	PTHREAD_MUTEX_INITIALIZER
+#   define LOCK_INIT(l)			pthread_mutex_init ((l), NULL)
+#   define LOCK_FINI(l)			pthread_mutex_destroy (l)
+#   define LOCK(l)			pthread_mutex_lock (l)
+#   define TRYLOCK(l)			(pthread_mutex_trylock (l) == 0)
+#   define UNLOCK(l)			pthread_mutex_unlock (l)
+
+#else
+
+typedef int pixman_mutex_t;
+
+#   define PIXMAN_MUTEX_INITIALIZER	0
+#   define LOCK_INIT(l)
+#   define LOCK_FINI(l)
+#   define LOCK(l)
+#   define TRYLOCK(l)			TRUE
+#   define UNLOCK(l)
+
+#endif
+
+#if defined(__ATOMIC_SEQ_CST)
+
+#   define PIXMAN_HAVE_ATOMICS
+
+#   define ATOMIC_LOAD(p)		__atomic_load_n ((p), __ATOMIC_SEQ_CST)
+#   define ATOMIC_STORE(p, v)		__atomic_store_n ((p), (v), __ATOMIC_SEQ_CST)
+#   define ATOMIC_ADD(p, v)		__atomic_add_fetch ((p), (v), __ATOMIC_SEQ_CST)
+
+/* For values that don't order any other memory accesses */
+#   define ATOMIC_LOAD_RELAXED(p)	__atomic_load_n ((p), __ATOMIC_RELAXED)
+#   define ATOMIC_STORE_RELAXED(p, v)	__atomic_store_n ((p), (v), __ATOMIC_RELAXED)
+#   define ATOMIC_ADD_RELAXED(p, v)	__atomic_add_fetch ((p), (v), __ATOMIC_RELAXED)
+
+#else
+
+#   define ATOMIC_LOAD(p)		(*(p))
+#   define ATOMIC_STORE(p, v)		(*(p) = (v))
+#   define ATOMIC_ADD(p, v)		(*(p) += (v))
+
+#   define ATOMIC_LOAD_RELAXED(p)	(*(p))
+#   define ATOMIC_STORE_RELAXED(p, v)	(*(p) = (v))
+#   define ATOMIC_ADD_RELAXED(p, v)	(*(p) += (v))
+
+#endif
@@ -50,28 +50,27 @@ coordinates_to_parameter (double x, double y, double angle)
 				      */
 }
 
-static uint32_t *
-conical_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
+/*
+ * Computes the position of the center of pixel (x, y) relative to the
+ * center of the gradient, in pixels of gradient space, along with how
+ * much it moves from one pixel to the next. Returns FALSE if the
+ * transformation is projective or can't be applied.
+ */
+pixman_bool_t
+_pixman_conical_gradient_get_affine_position (pixman_image_t *image,
+					      int             x,
+					      int             y,
+					      double         *rx,
+					      double         *ry,
+					      double         *cx,
+					      double         *cy)
 {
-    pixman_image_t *image = iter->image;
-    int x = iter->x;
-    int y = iter->y;
-    int width = iter->width;
-    uint32_t *buffer = iter->buffer;
-
-    gradient_t *gradient = (gradient_t *)image;
     conical_gradient_t *conical = (conical_gradient_t *)image;
-    uint32_t       *end = buffer + width;
-    pixman_gradient_walker_t walker;
-    pixman_bool_t affine = TRUE;
-    double cx = 1.;
-    double cy = 0.;
-    double cz = 0.;
-    double rx = x + 0.5;
-    double ry = y + 0.5;
-    double rz = 1.;
 
-    _pixman_gradient_walker_init (&walker, gradient, image->common.repeat);
+    *cx = 1.;
+    *cy = 0.;
+    *rx = x + 0.5;
+    *ry = y + 0.5;
 
     if (image->common.transform)
     {
@@ -83,26 +82,49 @@ conical_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
 	v.vector[2] = pixman_fixed_1;
 
 	if (!pixman_transform_point_3d (image->common.transform, &v))
-	    return iter->buffer;
+	    return FALSE;
 
-	cx = image->common.transform->matrix[0][0] / 65536.;
-	cy = image->common.transform->matrix[1][0] / 65536.;
-	cz = image->common.transform->matrix[2][0] / 65536.;
+	if (image->common.transform->matrix[2][0] != 0 ||
+	    v.vector[2] != pixman_fixed_1)
+	{
+	    return FALSE;
+	}
 
-	rx = v.vector[0] / 65536.;
-	ry = v.vector[1] / 65536.;
-	rz = v.vector[2] / 65536.;
+	*cx = image->common.transform->matrix[0][0] / 65536.;
+	*cy = image->common.transform->matrix[1][0] / 65536.;
 
-	affine =
-	    image->common.transform->matrix[2][0] == 0 &&
-	    v.vector[2] == pixman_fixed_1;
+	*rx = v.vector[0] / 65536.;
+	*ry = v.vector[1] / 65536.;
     }
 
-    if (affine)
-    {
-	rx -= conical->center.x / 65536.;
-	ry -= conical->center.y / 65536.;
+    *rx -= conical->center.x / 65536.;
+    *ry -= conical->center.y / 65536.;
+
+    return TRUE;
+}
 
+uint32_t *
+_pixman_conical_gradient_get_scanline_narrow (pixman_iter_t  *iter,
+					      const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    int x = iter->x;
+    int y = iter->y;
+    int width = iter->width;
+    uint32_t *buffer = iter->buffer;
+
+    gradient_t *gradient = (gradient_t *)image;
+    conical_gradient_t *conical = (conical_gradient_t *)image;
+    uint32_t       *end = buffer + width;
+    pixman_gradient_walker_t walker;
+    double cx, cy, cz;
+    double rx, ry, rz;
+
+    _pixman_gradient_walker_init (&walker, gradient, image->common.repeat);
+
+    if (_pixman_conical_gradient_get_affine_position (
+	    image, x, y, &rx, &ry, &cx, &cy))
+    {
 	while (buffer < end)
 	{
 	    if (!mask || *mask++)
@@ -121,6 +143,24 @@ conical_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
     }
     else
     {
+	pixman_vector_t v;
+
+	/* projective transformation */
+	v.vector[0] = pixman_int_to_fixed (x) + pixman_fixed_1 / 2;
+	v.vector[1] = pixman_int_to_fixed (y) + pixman_fixed_1 / 2;
+	v.vector[2] = pixman_fixed_1;
+
+	if (!pixman_transform_point_3d (image->common.transform, &v))
+	    return iter->buffer;
+
+	cx = image->common.transform->matrix[0][0] / 65536.;
+	cy = image->common.transform->matrix[1][0] / 65536.;
+	cz = image->common.transform->matrix[2][0] / 65536.;
+
+	rx = v.vector[0] / 65536.;
+	ry = v.vector[1] / 65536.;
+	rz = v.vector[2] / 65536.;
+
 	while (buffer < end)
 	{
 	    double x, y;
@@ -160,10 +200,63 @@ conical_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
     return iter->buffer;
 }
 
+/*
+ * Unless the filter is PIXMAN_FILTER_BEST, affine scanlines use
+ * _pixman_conical_gradient_approximate_parameter() instead of atan2().
+ * The positions are computed in single precision as x₀ + i·dx, so that
+ * the SIMD fetchers get exactly the same results.
+ */
+static uint32_t *
+conical_get_scanline_fast (pixman_iter_t *iter, const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    uint32_t *buffer = iter->buffer;
+    conical_gradient_t *conical = (conical_gradient_t *)image;
+    pixman_gradient_walker_t walker;
+    double rx, ry, cx, cy;
+    float x0, y0, dx, dy, angle;
+    int i;
+
+    if (!_pixman_conical_gradient_get_affine_position (
+	    image, iter->x, iter->y, &rx, &ry, &cx, &cy))
+    {
+	return _pixman_conical_gradient_get_scanline_narrow (iter, mask);
+    }
+
+    _pixman_gradient_walker_init (
+	&walker, &conical->common, image->common.repeat);
+
+    x0 = rx;
+    y0 = ry;
+    dx = cx;
+    dy = cy;
+    angle = conical->angle * (1 / (2 * M_PI));
+
+    for (i = 0; i < iter->width; ++i)
+    {
+	if (!mask || mask[i])
+	{
+	    float t = _pixman_conical_gradient_approximate_parameter (
+		x0 + (float)i * dx, y0 + (float)i * dy, angle);
+
+	    buffer[i] = _pixman_gradient_walker_pixel (
+		&walker, (int32_t)(t * 65536.f));
+	}
+    }
+
+    iter->y++;
+    return iter->buffer;
+}
+
 static uint32_t *
 conical_get_scanline_wide (pixman_iter_t *iter, const uint32_t *mask)
 {
-    uint32_t *buffer = conical_get_scanline_narrow (iter, NULL);
+    uint32_t *buffer;
+
+    if (iter->image->common.filter == PIXMAN_FILTER_BEST)
+	buffer = _pixman_conical_gradient_get_scanline_narrow (iter, NULL);
+    else
+	buffer = conical_get_scanline_fast (iter, NULL);
 
     pixman_expand_to_float (
 	(argb_t *)buffer, buffer, PIXMAN_a8r8g8b8, iter->width);
@@ -174,10 +267,12 @@ conical_get_scanline_wide (pixman_iter_t *iter, const uint32_t *mask)
 void
 _pixman_conical_gradient_iter_init (pixman_image_t *image, pixman_iter_t *iter)
 {
-    if (iter->iter_flags & ITER_NARROW)
-	iter->get_scanline = conical_get_scanline_narrow;
-    else
+    if (!(iter->iter_flags & ITER_NARROW))
 	iter->get_scanline = conical_get_scanline_wide;
+    else if (image->common.filter == PIXMAN_FILTER_BEST)
+	iter->get_scanline = _pixman_conical_gradient_get_scanline_narrow;
+    else
+	iter->get_scanline = conical_get_scanline_fast;
 }
 
 PIXMAN_EXPORT pixman_image_t *
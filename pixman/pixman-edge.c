@@ -380,6 +380,8 @@ pixman_rasterize_edges (pixman_image_t *image,
 	pixman_rasterize_edges_accessors (image, l, r, t, b);
     else
 	pixman_rasterize_edges_no_accessors (image, l, r, t, b);
+
+    _pixman_image_pixels_written (image);
 }
 
 #endif
@@ -261,20 +261,44 @@ fast_composite_in_8_8 (pixman_implementation_t *imp,
     }
 }
 
+static force_inline void
+over_n_8_8888_row (uint32_t *dst, const uint8_t *mask, int32_t w, uint32_t src)
+{
+    uint32_t srca = src >> 24;
+    uint32_t d;
+    uint8_t m;
+
+    while (w--)
+    {
+	m = *mask++;
+	if (m == 0xff)
+	{
+	    if (srca == 0xff)
+		*dst = src;
+	    else
+		*dst = over (src, *dst);
+	}
+	else if (m)
+	{
+	    d = in (src, m);
+	    *dst = over (d, *dst);
+	}
+	dst++;
+    }
+}
+
 static void
 fast_composite_over_n_8_8888 (pixman_implementation_t *imp,
                               pixman_composite_info_t *info)
 {
     PIXMAN_COMPOSITE_ARGS (info);
-    uint32_t src, srca;
-    uint32_t    *dst_line, *dst, d;
-    uint8_t     *mask_line, *mask, m;
+    uint32_t src;
+    uint32_t    *dst_line;
+    uint8_t     *mask_line;
     int dst_stride, mask_stride;
-    int32_t w;
 
     src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
 
-    srca = src >> 24;
     if (src == 0)
 	return;
 
@@ -283,32 +307,25 @@ fast_composite_over_n_8_8888 (pixman_implementation_t *imp,
 
     while (height--)
     {
-	dst = dst_line;
+	over_n_8_8888_row (dst_line, mask_line, width, src);
+
 	dst_line += dst_stride;
-	mask = mask_line;
 	mask_line += mask_stride;
-	w = width;
-
-	while (w--)
-	{
-	    m = *mask++;
-	    if (m == 0xff)
-	    {
-		if (srca == 0xff)
-		    *dst = src;
-		else
-		    *dst = over (src, *dst);
-	    }
-	    else if (m)
-	    {
-		d = in (src, m);
-		*dst = over (d, *dst);
-	    }
-	    dst++;
-	}
     }
 }
 
+static void
+fast_glyph_spans (pixman_implementation_t   *imp,
+		  uint32_t                   src,
+		  const pixman_glyph_span_t *spans,
+		  int                        n_spans)
+{
+    int i;
+
+    for (i = 0; i < n_spans; ++i)
+	over_n_8_8888_row (spans[i].dest, spans[i].mask, spans[i].width, src);
+}
+
 static void
 fast_composite_add_n_8888_8888_ca (pixman_implementation_t *imp,
 				   pixman_composite_info_t *info)
@@ -1156,6 +1173,81 @@ fast_composite_solid_fill (pixman_implementation_t *imp,
                  src);
 }
 
+/*
+ * Gradients that are a single color on each row, see FAST_PATH_SOLID_ROWS
+ */
+
+static void
+fast_composite_src_solid_rows_8888 (pixman_implementation_t *imp,
+				    pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    int y;
+
+    for (y = 0; y < height; ++y)
+    {
+	uint32_t src = _pixman_linear_gradient_get_row_color (
+	    src_image, src_x, src_y + y);
+
+	pixman_fill (dest_image->bits.bits, dest_image->bits.rowstride, 32,
+		     dest_x, dest_y + y, width, 1, src);
+    }
+}
+
+/* The number of pixels of a translucent row color combined at once */
+#define SOLID_ROWS_BUFFER_LENGTH	256
+
+static void
+fast_composite_over_solid_rows_8888 (pixman_implementation_t *imp,
+				     pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    pixman_combine_32_func_t combine = NULL;
+    uint32_t buffer[SOLID_ROWS_BUFFER_LENGTH];
+    uint32_t *dst_line, *dst;
+    int dst_stride;
+    int32_t y, w, i;
+
+    PIXMAN_IMAGE_GET_LINE (dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+
+    for (y = 0; y < height; ++y)
+    {
+	uint32_t src = _pixman_linear_gradient_get_row_color (
+	    src_image, src_x, src_y + y);
+
+	dst = dst_line;
+	dst_line += dst_stride;
+
+	if ((src >> 24) == 0xff)
+	{
+	    pixman_fill (dest_image->bits.bits, dest_image->bits.rowstride, 32,
+			 dest_x, dest_y + y, width, 1, src);
+	}
+	else if (src)
+	{
+	    /* Translucent rows go through the best OVER combiner there
+	     * is, with the row color repeated in a buffer.
+	     */
+	    if (!combine)
+	    {
+		combine = _pixman_implementation_lookup_combiner (
+		    imp->toplevel, PIXMAN_OP_OVER, FALSE, TRUE);
+	    }
+
+	    for (i = 0; i < width && i < SOLID_ROWS_BUFFER_LENGTH; ++i)
+		buffer[i] = src;
+
+	    for (w = width; w > 0; w -= SOLID_ROWS_BUFFER_LENGTH)
+	    {
+		i = MIN (w, SOLID_ROWS_BUFFER_LENGTH);
+
+		combine (imp->toplevel, PIXMAN_OP_OVER, dst, buffer, NULL, i);
+		dst += i;
+	    }
+	}
+    }
+}
+
 static void
 fast_composite_src_memcpy (pixman_implementation_t *imp,
 			   pixman_composite_info_t *info)
@@ -1812,6 +1904,15 @@ FAST_SIMPLE_ROTATE (8, uint8_t)
 FAST_SIMPLE_ROTATE (565, uint16_t)
 FAST_SIMPLE_ROTATE (8888, uint32_t)
 
+/* Linear gradients that are a single color on each row */
+#define SOLID_ROWS_FAST_PATH(op, dest, func)				\
+    {   PIXMAN_OP_ ## op,						\
+	PIXMAN_unknown,	FAST_PATH_STANDARD_FLAGS | FAST_PATH_SOLID_ROWS,	\
+	PIXMAN_null, 0,							\
+	PIXMAN_ ## dest, FAST_PATH_STD_DEST_FLAGS,			\
+	func								\
+    }
+
 static const pixman_fast_path_t c_fast_paths[] =
 {
     PIXMAN_STD_FAST_PATH (OVER, solid, a8, r5g6b5, fast_composite_over_n_8_0565),
@@ -1852,6 +1953,10 @@ static const pixman_fast_path_t c_fast_paths[] =
     PIXMAN_STD_FAST_PATH (ADD, a1, null, a1, fast_composite_add_1_1),
     PIXMAN_STD_FAST_PATH_CA (ADD, solid, a8r8g8b8, a8r8g8b8, fast_composite_add_n_8888_8888_ca),
     PIXMAN_STD_FAST_PATH (ADD, solid, a8, a8, fast_composite_add_n_8_8),
+    SOLID_ROWS_FAST_PATH (SRC, a8r8g8b8, fast_composite_src_solid_rows_8888),
+    SOLID_ROWS_FAST_PATH (SRC, x8r8g8b8, fast_composite_src_solid_rows_8888),
+    SOLID_ROWS_FAST_PATH (OVER, a8r8g8b8, fast_composite_over_solid_rows_8888),
+    SOLID_ROWS_FAST_PATH (OVER, x8r8g8b8, fast_composite_over_solid_rows_8888),
     PIXMAN_STD_FAST_PATH (SRC, solid, null, a8r8g8b8, fast_composite_solid_fill),
     PIXMAN_STD_FAST_PATH (SRC, solid, null, x8r8g8b8, fast_composite_solid_fill),
     PIXMAN_STD_FAST_PATH (SRC, solid, null, a8b8g8r8, fast_composite_solid_fill),
@@ -2350,9 +2455,12 @@ _pixman_implementation_create_fast_path (pixman_implementation_t *fallback)
 {
     pixman_implementation_t *imp = _pixman_implementation_create (fallback, c_fast_paths);
 
+    imp->name = "fast";
+
     imp->fill = fast_path_fill;
     imp->src_iter_init = fast_src_iter_init;
     imp->dest_iter_init = fast_dest_iter_init;
+    imp->glyph_spans = fast_glyph_spans;
 
     return imp;
 }
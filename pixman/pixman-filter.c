@@ -295,6 +295,185 @@ create_1d_filter (int             *width,
     return params;
 }
 
+/*
+ * The 1D filters are expensive to compute, and programs tend to ask for
+ * the same few of them over and over, so the most recently used ones are
+ * kept in a cache that is shared by all threads. It holds at most
+ * FILTER_CACHE_SIZE filters and FILTER_CACHE_BYTES bytes of them.
+ * Filters are computed outside of the lock, and callers always get their
+ * own copy. Without pthreads there is no lock, so there is no cache
+ * either.
+ */
+#ifdef HAVE_PTHREADS
+
+#define FILTER_CACHE_SIZE	32
+#define FILTER_CACHE_BYTES	(1024 * 1024)
+
+typedef struct
+{
+    pixman_kernel_t	reconstruct;
+    pixman_kernel_t	sample;
+    double		scale;
+    int			n_phases;
+    int			width;
+    pixman_fixed_t *	params;
+} filter_cache_entry_t;
+
+/* Ordered from most to least recently used */
+static filter_cache_entry_t filter_cache[FILTER_CACHE_SIZE];
+static int n_filter_cache_entries;
+static size_t filter_cache_bytes;
+
+static pixman_mutex_t filter_cache_lock = PIXMAN_MUTEX_INITIALIZER;
+
+static size_t
+filter_cache_entry_bytes (const filter_cache_entry_t *entry)
+{
+    return entry->width * entry->n_phases * sizeof (pixman_fixed_t);
+}
+
+/* Moves entry i to the front of the cache */
+static void
+filter_cache_touch (int i)
+{
+    filter_cache_entry_t entry = filter_cache[i];
+
+    memmove (&filter_cache[1], &filter_cache[0], i * sizeof (filter_cache_entry_t));
+    filter_cache[0] = entry;
+}
+
+static int
+filter_cache_find (pixman_kernel_t  reconstruct,
+		   pixman_kernel_t  sample,
+		   double           scale,
+		   int              n_phases)
+{
+    int i;
+
+    for (i = 0; i < n_filter_cache_entries; ++i)
+    {
+	const filter_cache_entry_t *entry = &filter_cache[i];
+
+	if (entry->reconstruct == reconstruct	&&
+	    entry->sample == sample		&&
+	    entry->scale == scale		&&
+	    entry->n_phases == n_phases)
+	{
+	    return i;
+	}
+    }
+
+    return -1;
+}
+
+/* Adds a copy of params to the cache, evicting the least recently used
+ * filters to make room for it.
+ */
+static void
+filter_cache_insert (pixman_kernel_t       reconstruct,
+		     pixman_kernel_t       sample,
+		     double                scale,
+		     int                   n_phases,
+		     int                   width,
+		     const pixman_fixed_t *params)
+{
+    filter_cache_entry_t entry;
+    size_t bytes;
+
+    entry.reconstruct = reconstruct;
+    entry.sample = sample;
+    entry.scale = scale;
+    entry.n_phases = n_phases;
+    entry.width = width;
+
+    bytes = filter_cache_entry_bytes (&entry);
+    if (bytes > FILTER_CACHE_BYTES / 4)
+	return;
+
+    if (!(entry.params = malloc (bytes)))
+	return;
+
+    memcpy (entry.params, params, bytes);
+
+    LOCK (&filter_cache_lock);
+
+    /* Another thread may have added it in the meantime */
+    if (filter_cache_find (reconstruct, sample, scale, n_phases) >= 0)
+    {
+	UNLOCK (&filter_cache_lock);
+	free (entry.params);
+	return;
+    }
+
+    while (n_filter_cache_entries == FILTER_CACHE_SIZE ||
+	   filter_cache_bytes + bytes > FILTER_CACHE_BYTES)
+    {
+	filter_cache_entry_t *last = &filter_cache[--n_filter_cache_entries];
+
+	filter_cache_bytes -= filter_cache_entry_bytes (last);
+	free (last->params);
+    }
+
+    filter_cache[n_filter_cache_entries++] = entry;
+    filter_cache_bytes += bytes;
+    filter_cache_touch (n_filter_cache_entries - 1);
+
+    UNLOCK (&filter_cache_lock);
+}
+
+/* Like create_1d_filter(), but from the cache when possible */
+static pixman_fixed_t *
+get_1d_filter (int             *width,
+	       pixman_kernel_t  reconstruct,
+	       pixman_kernel_t  sample,
+	       double           scale,
+	       int              n_phases)
+{
+    pixman_fixed_t *params = NULL;
+    int i;
+
+    LOCK (&filter_cache_lock);
+
+    if ((i = filter_cache_find (reconstruct, sample, scale, n_phases)) >= 0)
+    {
+	size_t bytes = filter_cache_entry_bytes (&filter_cache[i]);
+
+	if ((params = malloc (bytes)))
+	{
+	    memcpy (params, filter_cache[i].params, bytes);
+	    *width = filter_cache[i].width;
+
+	    filter_cache_touch (i);
+	}
+    }
+
+    UNLOCK (&filter_cache_lock);
+
+    if (params)
+	return params;
+
+    params = create_1d_filter (width, reconstruct, sample, scale, n_phases);
+
+    if (params)
+	filter_cache_insert (reconstruct, sample, scale, n_phases, *width, params);
+
+    return params;
+}
+
+#else
+
+static pixman_fixed_t *
+get_1d_filter (int             *width,
+	       pixman_kernel_t  reconstruct,
+	       pixman_kernel_t  sample,
+	       double           scale,
+	       int              n_phases)
+{
+    return create_1d_filter (width, reconstruct, sample, scale, n_phases);
+}
+
+#endif
+
 /* Create the parameter list for a SEPARABLE_CONVOLUTION filter
  * with the given kernels and scale parameters
  */
@@ -318,8 +497,8 @@ pixman_filter_create_separable_convolution (int             *n_values,
     subsample_x = (1 << subsample_bits_x);
     subsample_y = (1 << subsample_bits_y);
 
-    horz = create_1d_filter (&width, reconstruct_x, sample_x, sx, subsample_x);
-    vert = create_1d_filter (&height, reconstruct_y, sample_y, sy, subsample_y);
+    horz = get_1d_filter (&width, reconstruct_x, sample_x, sx, subsample_x);
+    vert = get_1d_filter (&height, reconstruct_y, sample_y, sy, subsample_y);
 
     if (!horz || !vert)
         goto out;
@@ -103,22 +103,30 @@ static const op_info_t op_flags[PIXMAN_N_OPERATORS] =
     { 0,                     0                     }, /* SATURATE */
 };
 
+/* The scanline buffers of a chunk of columns are kept small enough for
+ * all three of them to stay in the L1 cache.
+ */
 #define SCANLINE_BUFFER_LENGTH 8192
 
+/* Number of column chunks whose iterators fit on the stack */
+#define N_STACK_CHUNKS 16
+
 static void
 general_composite_rect  (pixman_implementation_t *imp,
                          pixman_composite_info_t *info)
 {
     PIXMAN_COMPOSITE_ARGS (info);
-    uint64_t stack_scanline_buffer[(SCANLINE_BUFFER_LENGTH * 3 + 7) / 8];
-    uint8_t *scanline_buffer = (uint8_t *) stack_scanline_buffer;
-    uint8_t *src_buffer, *mask_buffer, *dest_buffer;
-    pixman_iter_t src_iter, mask_iter, dest_iter;
+    uint8_t stack_scanline_buffer[SCANLINE_BUFFER_LENGTH * 3 + 63];
+    uint8_t *scanline_buffer = stack_scanline_buffer;
+    uint8_t *buffers;
+    pixman_iter_t stack_iters[N_STACK_CHUNKS * 3];
+    pixman_iter_t *iters = stack_iters;
+    pixman_iter_t *src_iters, *mask_iters, *dest_iters;
     pixman_combine_32_func_t compose;
     pixman_bool_t component_alpha;
     iter_flags_t narrow, src_iter_flags;
-    int Bpp;
-    int i;
+    int Bpp, chunk_width, n_chunks;
+    int i, j;
 
     if ((src_image->common.flags & FAST_PATH_NARROW_FORMAT)		    &&
 	(!mask_image || mask_image->common.flags & FAST_PATH_NARROW_FORMAT) &&
@@ -133,34 +141,45 @@ general_composite_rect  (pixman_implementation_t *imp,
 	Bpp = 16;
     }
 
-    if (width * Bpp > SCANLINE_BUFFER_LENGTH)
+    /* Rows that don't fit in the buffers are composited in chunks of
+     * columns that do. Each chunk has its own iterators and buffers,
+     * since some iterators fill their buffer only once, when they are
+     * set up. Every chunk of a row is done before the next row is
+     * started.
+     */
+    chunk_width = SCANLINE_BUFFER_LENGTH / Bpp;
+    n_chunks = (width + chunk_width - 1) / chunk_width;
+
+    if (n_chunks > 1)
     {
-	scanline_buffer = pixman_malloc_abc (width, 3, Bpp);
+	/* One more buffer length leaves room for the alignment */
+	scanline_buffer = pixman_malloc_ab (
+	    n_chunks * 3 + 1, SCANLINE_BUFFER_LENGTH);
 
 	if (!scanline_buffer)
 	    return;
     }
 
-    src_buffer = scanline_buffer;
-    mask_buffer = src_buffer + width * Bpp;
-    dest_buffer = mask_buffer + width * Bpp;
-
-    if (!narrow)
+    if (n_chunks > N_STACK_CHUNKS)
     {
-	/* To make sure there aren't any NANs in the buffers */
-	memset (src_buffer, 0, width * Bpp);
-	memset (mask_buffer, 0, width * Bpp);
-	memset (dest_buffer, 0, width * Bpp);
+	iters = pixman_malloc_abc (n_chunks, 3, sizeof (pixman_iter_t));
+
+	if (!iters)
+	{
+	    free (scanline_buffer);
+	    return;
+	}
     }
-    
-    /* src iter */
-    src_iter_flags = narrow | op_flags[op].src;
 
-    _pixman_implementation_src_iter_init (imp->toplevel, &src_iter, src_image,
-					  src_x, src_y, width, height,
-					  src_buffer, src_iter_flags, info->src_flags);
+    src_iters = iters;
+    mask_iters = src_iters + n_chunks;
+    dest_iters = mask_iters + n_chunks;
+
+    /* Align to a cache line so that wide pixels never straddle two */
+    buffers = (uint8_t *)(((uintptr_t)scanline_buffer + 63) & ~63);
+
+    src_iter_flags = narrow | op_flags[op].src;
 
-    /* mask iter */
     if ((src_iter_flags & (ITER_IGNORE_ALPHA | ITER_IGNORE_RGB)) ==
 	(ITER_IGNORE_ALPHA | ITER_IGNORE_RGB))
     {
@@ -176,32 +195,72 @@ general_composite_rect  (pixman_implementation_t *imp,
         mask_image->common.component_alpha    &&
         PIXMAN_FORMAT_RGB (mask_image->bits.format);
 
-    _pixman_implementation_src_iter_init (
-	imp->toplevel, &mask_iter, mask_image, mask_x, mask_y, width, height,
-	mask_buffer, narrow | (component_alpha? 0 : ITER_IGNORE_RGB), info->mask_flags);
-
-    /* dest iter */
-    _pixman_implementation_dest_iter_init (
-	imp->toplevel, &dest_iter, dest_image, dest_x, dest_y, width, height,
-	dest_buffer, narrow | op_flags[op].dst, info->dest_flags);
-
     compose = _pixman_implementation_lookup_combiner (
 	imp->toplevel, op, component_alpha, narrow);
 
+    for (j = 0; j < n_chunks; ++j)
+    {
+	int x = j * chunk_width;
+	int w = MIN (width - x, chunk_width);
+	uint8_t *src_buffer = buffers + j * 3 * SCANLINE_BUFFER_LENGTH;
+	uint8_t *mask_buffer = src_buffer + SCANLINE_BUFFER_LENGTH;
+	uint8_t *dest_buffer = mask_buffer + SCANLINE_BUFFER_LENGTH;
+
+	if (!narrow)
+	{
+	    /* To make sure there aren't any NANs in the buffers */
+	    memset (src_buffer, 0, w * Bpp);
+	    memset (mask_buffer, 0, w * Bpp);
+	    memset (dest_buffer, 0, w * Bpp);
+	}
+
+	/* src iter */
+	_pixman_implementation_src_iter_init (
+	    imp->toplevel, &src_iters[j], src_image,
+	    src_x + x, src_y, w, height,
+	    src_buffer, src_iter_flags, info->src_flags);
+
+	/* mask iter */
+	_pixman_implementation_src_iter_init (
+	    imp->toplevel, &mask_iters[j], mask_image,
+	    mask_x + x, mask_y, w, height,
+	    mask_buffer, narrow | (component_alpha? 0 : ITER_IGNORE_RGB),
+	    info->mask_flags);
+
+	/* dest iter */
+	_pixman_implementation_dest_iter_init (
+	    imp->toplevel, &dest_iters[j], dest_image,
+	    dest_x + x, dest_y, w, height,
+	    dest_buffer, narrow | op_flags[op].dst, info->dest_flags);
+    }
+
     for (i = 0; i < height; ++i)
     {
-	uint32_t *s, *m, *d;
+	for (j = 0; j < n_chunks; ++j)
+	{
+	    int w = MIN (width - j * chunk_width, chunk_width);
+	    uint32_t *s, *m, *d;
 
-	m = mask_iter.get_scanline (&mask_iter, NULL);
-	s = src_iter.get_scanline (&src_iter, m);
-	d = dest_iter.get_scanline (&dest_iter, NULL);
+	    m = mask_iters[j].get_scanline (&mask_iters[j], NULL);
+	    s = src_iters[j].get_scanline (&src_iters[j], m);
+	    d = dest_iters[j].get_scanline (&dest_iters[j], NULL);
 
-	compose (imp->toplevel, op, d, s, m, width);
+	    compose (imp->toplevel, op, d, s, m, w);
 
-	dest_iter.write_back (&dest_iter);
+	    dest_iters[j].write_back (&dest_iters[j]);
+	}
     }
 
-    if (scanline_buffer != (uint8_t *) stack_scanline_buffer)
+    for (j = 0; j < n_chunks * 3; ++j)
+    {
+	if (iters[j].fini)
+	    iters[j].fini (&iters[j]);
+    }
+
+    if (iters != stack_iters)
+	free (iters);
+
+    if (scanline_buffer != stack_scanline_buffer)
 	free (scanline_buffer);
 }
 
@@ -216,6 +275,8 @@ _pixman_implementation_create_general (void)
 {
     pixman_implementation_t *imp = _pixman_implementation_create (NULL, general_fast_path);
 
+    imp->name = "general";
+
     _pixman_setup_combiner_functions_32 (imp);
     _pixman_setup_combiner_functions_float (imp);
 
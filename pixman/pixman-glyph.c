@@ -37,37 +37,369 @@ typedef struct glyph_t glyph_t;
 #define TOMBSTONE ((glyph_t *)0x1)
 
 /* XXX: These numbers are arbitrary---we've never done any measurements.
+ * They bound the number of glyphs, which the hash table needs, whether
+ * or not the cache has a budget in bytes too.
  */
 #define N_GLYPHS_HIGH_WATER  (16384)
 #define N_GLYPHS_LOW_WATER   (8192)
 #define HASH_SIZE (2 * N_GLYPHS_HIGH_WATER)
 #define HASH_MASK (HASH_SIZE - 1)
 
+/* A cache that goes over its budget evicts glyphs until it is down to
+ * three quarters of it, which leaves room for a few runs of new glyphs
+ * before the next eviction.
+ */
+#define BYTES_LOW_WATER(budget)	((budget) / 4 * 3)
+
+/* A concurrent cache splits its hash table into shards that are locked
+ * separately by inserts and removals. Lookups don't lock; they read each
+ * slot atomically, and glyphs that are removed are only freed when the
+ * threads that had the cache frozen at the time have thawed it.
+ */
+#define N_SHARDS	16
+#define SHARD_SIZE	(HASH_SIZE / N_SHARDS)
+
+/* The number of concurrent caches that a thread can have frozen at once
+ * and still let the others free glyphs while it does.
+ */
+#define N_FROZEN_CACHES	4
+
+#if defined (HAVE_PTHREADS) && defined (PIXMAN_HAVE_ATOMICS) && !defined (PIXMAN_NO_TLS)
+#define HAVE_CONCURRENT_CACHE
+#endif
+
+/* Glyphs are packed into atlases, which are shared images of one format,
+ * in shelves: rows of glyphs of about the same height, filled from left
+ * to right. Glyphs that are too big to share get an atlas of their own.
+ *
+ * Caches with a budget charge each glyph for the part of its shelf that
+ * it takes up, or for the whole atlas if it has one of its own. Space
+ * that removed glyphs leave behind is only reused once their shelf is
+ * empty, so the atlases can be bigger than what is charged. To keep the
+ * difference small, the shared atlases of such caches are made smaller,
+ * down to ATLAS_MAX_GLYPH_SIZE, so that one of them is at most
+ * 1 / ATLAS_BUDGET_SHARE of the budget.
+ */
+#define ATLAS_SIZE		512
+#define ATLAS_MAX_GLYPH_SIZE	(ATLAS_SIZE / 4)
+#define ATLAS_BUDGET_SHARE	16
+#define SHELF_ALIGN		4
+
+typedef struct glyph_atlas_t glyph_atlas_t;
+typedef struct glyph_shelf_t glyph_shelf_t;
+
+struct glyph_shelf_t
+{
+    int			y;
+    int			height;
+    int			x;		/* Where the next glyph goes */
+    int			n_glyphs;
+};
+
+struct glyph_atlas_t
+{
+    pixman_image_t *	image;
+    pixman_bool_t	dedicated;
+    size_t		n_bytes;	/* The image and this struct */
+    int			n_glyphs;
+    int			n_shelves;
+    int			shelves_size;
+    glyph_shelf_t *	shelves;
+    glyph_atlas_t *	next;
+};
+
 struct glyph_t
 {
     void *		font_key;
     void *		glyph_key;
     int			origin_x;
     int			origin_y;
-    pixman_image_t *	image;
-    pixman_link_t	mru_link;
+    pixman_image_t *	image;		/* The atlas image */
+    int			x, y;		/* Position in the atlas */
+    int			width, height;
+    size_t		n_bytes;	/* What the cache is charged */
+    glyph_atlas_t *	atlas;
+    int			shelf;
+    unsigned int	hash;
+    pixman_link_t	mru_link;	/* Not used by concurrent caches */
+    pixman_bool_t	used;		/* Used since the last eviction sweep */
+    pixman_bool_t	removed;	/* No longer in the table */
+    int			ref_count;	/* The cache's and those of runs */
+    glyph_t *		next_retired;
 };
 
-struct pixman_glyph_cache_t
+typedef struct
 {
+    pixman_mutex_t	lock;
     int			n_glyphs;
     int			n_tombstones;
+    unsigned int	mask;
+    glyph_t **		glyphs;
+    glyph_t *		retired;	/* Removed, but maybe still in use */
+} glyph_table_t;
+
+/* Threads that freeze a concurrent cache are counted under the phase of
+ * the cache at the time, or under UNKNOWN_PHASE if they can't remember
+ * it. Retired glyphs are freed after the phase changes and the count of
+ * the old phase drops to zero.
+ */
+#define UNKNOWN_PHASE	2
+
+struct pixman_glyph_cache_t
+{
+    pixman_bool_t	concurrent;
+    size_t		budget;		/* In bytes, or 0 for none */
+    int			n_glyphs;
+    size_t		n_bytes;
+    uint64_t		n_hits;
+    uint64_t		n_misses;
+    uint64_t		n_insertions;
+    uint64_t		n_evictions;
+    unsigned int	n_removals;	/* Glyphs that left the table */
+    int			n_retired;
     int			freeze_count;
+    int			phase;
+    int			readers[3];
+    glyph_t *		waiting;	/* Retired before the phase changed */
     pixman_list_t	mru;
+    pixman_mutex_t	lock;		/* Held while evicting or freeing */
+    pixman_mutex_t	atlas_lock;
+    glyph_atlas_t *	atlases;
+    int			n_tables;
+    glyph_table_t	tables[N_SHARDS];
     glyph_t *		glyphs[HASH_SIZE];
 };
 
+static glyph_atlas_t *
+create_atlas (pixman_glyph_cache_t *cache,
+	      pixman_format_code_t  format,
+	      int                   width,
+	      int                   height,
+	      pixman_bool_t         dedicated)
+{
+    glyph_atlas_t *atlas;
+
+    if (!(atlas = malloc (sizeof *atlas)))
+	return NULL;
+
+    if (!(atlas->image = pixman_image_create_bits (
+	      format, width, height, NULL, -1)))
+    {
+	free (atlas);
+	return NULL;
+    }
+
+    if (PIXMAN_FORMAT_A   (format) != 0	&&
+	PIXMAN_FORMAT_RGB (format) != 0)
+    {
+	pixman_image_set_component_alpha (atlas->image, TRUE);
+    }
+
+    _pixman_image_validate (atlas->image);
+
+    atlas->dedicated = dedicated;
+    atlas->n_bytes = sizeof *atlas +
+	(size_t)atlas->image->bits.rowstride * sizeof (uint32_t) * height;
+    atlas->n_glyphs = 0;
+    atlas->n_shelves = 0;
+    atlas->shelves_size = 0;
+    atlas->shelves = NULL;
+
+    atlas->next = cache->atlases;
+    cache->atlases = atlas;
+
+    return atlas;
+}
+
+static void
+free_atlas (pixman_glyph_cache_t *cache, glyph_atlas_t *atlas)
+{
+    glyph_atlas_t **a;
+
+    for (a = &cache->atlases; *a != atlas; a = &(*a)->next)
+	;
+
+    *a = atlas->next;
+
+    pixman_image_unref (atlas->image);
+    free (atlas->shelves);
+    free (atlas);
+}
+
+/* Finds room for a width x height glyph in the atlas, preferring shelves
+ * of just the right height, then a new shelf, then taller shelves.
+ */
+static pixman_bool_t
+atlas_allocate (glyph_atlas_t *atlas, glyph_t *glyph)
+{
+    int width = MAX (glyph->width, 1);
+    int height = MAX (glyph->height, 1);
+    int shelf_height = (height + SHELF_ALIGN - 1) & ~(SHELF_ALIGN - 1);
+    int atlas_width = atlas->image->bits.width;
+    int atlas_height = atlas->image->bits.height;
+    glyph_shelf_t *shelf = NULL;
+    int i, y;
+
+    for (i = 0; i < atlas->n_shelves; ++i)
+    {
+	glyph_shelf_t *s = &atlas->shelves[i];
+
+	if (s->height == shelf_height && s->x + width <= atlas_width)
+	{
+	    shelf = s;
+	    break;
+	}
+    }
+
+    y = atlas->n_shelves ?
+	atlas->shelves[atlas->n_shelves - 1].y +
+	atlas->shelves[atlas->n_shelves - 1].height : 0;
+
+    if (!shelf && y + height <= atlas_height && width <= atlas_width)
+    {
+	if (atlas->n_shelves == atlas->shelves_size)
+	{
+	    int size = atlas->shelves_size ? 2 * atlas->shelves_size : 16;
+	    glyph_shelf_t *shelves;
+
+	    shelves = realloc (atlas->shelves, size * sizeof (glyph_shelf_t));
+	    if (!shelves)
+		return FALSE;
+
+	    atlas->shelves = shelves;
+	    atlas->shelves_size = size;
+	}
+
+	shelf = &atlas->shelves[atlas->n_shelves++];
+	shelf->y = y;
+	shelf->height = MIN (shelf_height, atlas_height - y);
+	shelf->x = 0;
+	shelf->n_glyphs = 0;
+    }
+
+    for (i = 0; i < atlas->n_shelves && !shelf; ++i)
+    {
+	glyph_shelf_t *s = &atlas->shelves[i];
+
+	if (s->height >= shelf_height && s->height <= 2 * shelf_height &&
+	    s->x + width <= atlas_width)
+	{
+	    shelf = s;
+	}
+    }
+
+    if (!shelf)
+	return FALSE;
+
+    glyph->atlas = atlas;
+    glyph->shelf = shelf - atlas->shelves;
+    glyph->image = atlas->image;
+    glyph->x = shelf->x;
+    glyph->y = shelf->y;
+
+    if (atlas->dedicated)
+    {
+	glyph->n_bytes = sizeof (glyph_t) + atlas->n_bytes;
+    }
+    else
+    {
+	int bpp = PIXMAN_FORMAT_BPP (atlas->image->bits.format);
+
+	glyph->n_bytes = sizeof (glyph_t) +
+	    (size_t)((width * bpp + 7) / 8) * shelf->height;
+    }
+
+    shelf->x += width;
+    shelf->n_glyphs++;
+    atlas->n_glyphs++;
+
+    return TRUE;
+}
+
+static pixman_bool_t
+allocate_glyph (pixman_glyph_cache_t *cache,
+		pixman_format_code_t  format,
+		glyph_t              *glyph)
+{
+    glyph_atlas_t *atlas;
+    int size;
+
+    if (glyph->width > ATLAS_MAX_GLYPH_SIZE ||
+	glyph->height > ATLAS_MAX_GLYPH_SIZE)
+    {
+	atlas = create_atlas (cache, format,
+			      glyph->width, glyph->height, TRUE);
+
+	return atlas && atlas_allocate (atlas, glyph);
+    }
+
+    for (atlas = cache->atlases; atlas; atlas = atlas->next)
+    {
+	if (!atlas->dedicated			&&
+	    atlas->image->bits.format == format	&&
+	    atlas_allocate (atlas, glyph))
+	{
+	    return TRUE;
+	}
+    }
+
+    size = ATLAS_SIZE;
+
+    while (cache->budget && size > ATLAS_MAX_GLYPH_SIZE &&
+	   (uint64_t)size * size * PIXMAN_FORMAT_BPP (format) / 8 >
+	   cache->budget / ATLAS_BUDGET_SHARE)
+    {
+	size /= 2;
+    }
+
+    atlas = create_atlas (cache, format, size, size, FALSE);
+
+    return atlas && atlas_allocate (atlas, glyph);
+}
+
+/* Glyph runs only look at their glyphs again when the count of removals
+ * has changed, so the flag is set before the count is.
+ */
 static void
-free_glyph (glyph_t *glyph)
+mark_glyph_removed (pixman_glyph_cache_t *cache, glyph_t *glyph)
 {
-    pixman_list_unlink (&glyph->mru_link);
-    pixman_image_unref (glyph->image);
-    free (glyph);
+    ATOMIC_STORE (&glyph->removed, TRUE);
+    ATOMIC_ADD (&cache->n_removals, 1);
+}
+
+static void
+unref_glyph (glyph_t *glyph)
+{
+    if (ATOMIC_ADD (&glyph->ref_count, -1) == 0)
+	free (glyph);
+}
+
+/* Gives the space of the glyph back to its atlas. The glyph itself is
+ * only freed once no run holds it anymore.
+ */
+static void
+free_glyph (pixman_glyph_cache_t *cache, glyph_t *glyph)
+{
+    glyph_atlas_t *atlas = glyph->atlas;
+    glyph_shelf_t *shelf = &atlas->shelves[glyph->shelf];
+
+    if (!cache->concurrent)
+	pixman_list_unlink (&glyph->mru_link);
+
+    /* Space is reused once a whole shelf is empty */
+    if (--shelf->n_glyphs == 0)
+	shelf->x = 0;
+
+    while (atlas->n_shelves && atlas->shelves[atlas->n_shelves - 1].n_glyphs == 0)
+	atlas->n_shelves--;
+
+    if (--atlas->n_glyphs == 0)
+	free_atlas (cache, atlas);
+
+    if (!glyph->removed)
+	mark_glyph_removed (cache, glyph);
+
+    unref_glyph (glyph);
 }
 
 static unsigned int
@@ -91,16 +423,23 @@ hash (const void *font_key, const void *glyph_key)
     return key;
 }
 
+static glyph_table_t *
+get_table (pixman_glyph_cache_t *cache, unsigned int h)
+{
+    return &cache->tables[(h >> 16) % cache->n_tables];
+}
+
 static glyph_t *
-lookup_glyph (pixman_glyph_cache_t *cache,
-	      void                 *font_key,
-	      void                 *glyph_key)
+lookup_glyph (glyph_table_t *table,
+	      unsigned int   h,
+	      void          *font_key,
+	      void          *glyph_key)
 {
     unsigned idx;
     glyph_t *g;
 
-    idx = hash (font_key, glyph_key);
-    while ((g = cache->glyphs[idx++ & HASH_MASK]))
+    idx = h;
+    while ((g = ATOMIC_LOAD (&table->glyphs[idx++ & table->mask])))
     {
 	if (g != TOMBSTONE			&&
 	    g->font_key == font_key		&&
@@ -113,129 +452,640 @@ lookup_glyph (pixman_glyph_cache_t *cache,
     return NULL;
 }
 
+/* Stores the glyph in the table without counting it */
 static void
-insert_glyph (pixman_glyph_cache_t *cache,
-	      glyph_t              *glyph)
+place_glyph (glyph_table_t *table,
+	     glyph_t       *glyph)
 {
     unsigned idx;
     glyph_t **loc;
 
-    idx = hash (glyph->font_key, glyph->glyph_key);
+    idx = glyph->hash;
 
     /* Note: we assume that there is room in the table. If there isn't,
      * this will be an infinite loop.
      */
     do
     {
-	loc = &cache->glyphs[idx++ & HASH_MASK];
+	loc = &table->glyphs[idx++ & table->mask];
     } while (*loc && *loc != TOMBSTONE);
 
     if (*loc == TOMBSTONE)
-	cache->n_tombstones--;
-    cache->n_glyphs++;
+	table->n_tombstones--;
 
-    *loc = glyph;
+    ATOMIC_STORE (loc, glyph);
+}
+
+static void
+insert_glyph (pixman_glyph_cache_t *cache,
+	      glyph_table_t        *table,
+	      glyph_t              *glyph)
+{
+    place_glyph (table, glyph);
+
+    table->n_glyphs++;
+    ATOMIC_ADD (&cache->n_glyphs, 1);
+    ATOMIC_ADD (&cache->n_bytes, glyph->n_bytes);
 }
 
 static void
 remove_glyph (pixman_glyph_cache_t *cache,
+	      glyph_table_t        *table,
 	      glyph_t              *glyph)
 {
     unsigned idx;
 
-    idx = hash (glyph->font_key, glyph->glyph_key);
-    while (cache->glyphs[idx & HASH_MASK] != glyph)
+    idx = glyph->hash;
+    while (table->glyphs[idx & table->mask] != glyph)
 	idx++;
 
-    cache->glyphs[idx & HASH_MASK] = TOMBSTONE;
-    cache->n_tombstones++;
-    cache->n_glyphs--;
+    ATOMIC_STORE (&table->glyphs[idx & table->mask], TOMBSTONE);
+    mark_glyph_removed (cache, glyph);
+    table->n_tombstones++;
+    table->n_glyphs--;
+    ATOMIC_ADD (&cache->n_glyphs, -1);
+    ATOMIC_ADD (&cache->n_bytes, -glyph->n_bytes);
 
-    /* Eliminate tombstones if possible */
-    if (cache->glyphs[(idx + 1) & HASH_MASK] == NULL)
+    /* Eliminate tombstones if possible. This never hides a glyph from
+     * a concurrent lookup, because the probe would stop at the next
+     * slot anyway.
+     */
+    if (table->glyphs[(idx + 1) & table->mask] == NULL)
     {
-	while (cache->glyphs[idx & HASH_MASK] == TOMBSTONE)
+	while (table->glyphs[idx & table->mask] == TOMBSTONE)
 	{
-	    cache->glyphs[idx & HASH_MASK] = NULL;
-	    cache->n_tombstones--;
+	    ATOMIC_STORE (&table->glyphs[idx & table->mask], NULL);
+	    table->n_tombstones--;
 	    idx--;
 	}
     }
 }
 
+/* Rebuilds a concurrent table without tombstones. Lookups at the same
+ * time may miss glyphs while they are moved, which is harmless, since
+ * inserts look again with the table locked.
+ */
+static void
+rehash_table (glyph_table_t *table)
+{
+    glyph_t **glyphs;
+    unsigned int i;
+    int n = 0;
+
+    if (!(glyphs = malloc ((table->n_glyphs + 1) * sizeof (glyph_t *))))
+	return;
+
+    for (i = 0; i <= table->mask; ++i)
+    {
+	glyph_t *glyph = table->glyphs[i];
+
+	if (glyph && glyph != TOMBSTONE)
+	    glyphs[n++] = glyph;
+
+	ATOMIC_STORE (&table->glyphs[i], NULL);
+    }
+
+    table->n_tombstones = 0;
+
+    while (n--)
+	place_glyph (table, glyphs[n]);
+
+    free (glyphs);
+}
+
+static pixman_bool_t
+table_has_room (pixman_glyph_cache_t *cache, glyph_table_t *table)
+{
+    int limit = 3 * SHARD_SIZE / 4;
+
+    if (!cache->concurrent)
+	return cache->n_glyphs < HASH_SIZE;
+
+    if (table->n_glyphs + table->n_tombstones >= limit &&
+	table->n_tombstones > 0)
+    {
+	rehash_table (table);
+    }
+
+    return table->n_glyphs + table->n_tombstones < limit;
+}
+
+/* Takes a glyph out of a concurrent cache. It is freed later, by
+ * reclaim_glyphs(). Called with the table locked.
+ */
+static void
+retire_glyph (pixman_glyph_cache_t *cache,
+	      glyph_table_t        *table,
+	      glyph_t              *glyph)
+{
+    remove_glyph (cache, table, glyph);
+
+    glyph->next_retired = table->retired;
+    table->retired = glyph;
+
+    ATOMIC_ADD (&cache->n_retired, 1);
+}
+
+static void
+free_glyph_list (pixman_glyph_cache_t *cache, glyph_t *glyph)
+{
+    while (glyph)
+    {
+	glyph_t *next = glyph->next_retired;
+
+	ATOMIC_ADD (&cache->n_retired, -1);
+	free_glyph (cache, glyph);
+
+	glyph = next;
+    }
+}
+
+/* Frees the retired glyphs of a concurrent cache that no thread can be
+ * using anymore. Threads only use glyphs while they have the cache
+ * frozen, and they can't find retired glyphs after they are retired, so
+ * glyphs that were retired before the phase changed are safe to free
+ * once the threads counted under the old phase have all thawed the
+ * cache.
+ */
+static void
+reclaim_glyphs (pixman_glyph_cache_t *cache)
+{
+    int i;
+
+    if (!ATOMIC_LOAD (&cache->n_retired) || !TRYLOCK (&cache->lock))
+	return;
+
+    for (;;)
+    {
+	if (cache->waiting)
+	{
+	    if (ATOMIC_LOAD (&cache->readers[1 - cache->phase])	||
+		ATOMIC_LOAD (&cache->readers[UNKNOWN_PHASE]))
+	    {
+		break;
+	    }
+
+	    LOCK (&cache->atlas_lock);
+	    free_glyph_list (cache, cache->waiting);
+	    UNLOCK (&cache->atlas_lock);
+
+	    cache->waiting = NULL;
+	}
+
+	for (i = 0; i < N_SHARDS; ++i)
+	{
+	    glyph_table_t *table = &cache->tables[i];
+	    glyph_t *glyph;
+
+	    LOCK (&table->lock);
+
+	    if ((glyph = table->retired))
+	    {
+		while (glyph->next_retired)
+		    glyph = glyph->next_retired;
+
+		glyph->next_retired = cache->waiting;
+		cache->waiting = table->retired;
+		table->retired = NULL;
+	    }
+
+	    UNLOCK (&table->lock);
+	}
+
+	if (!cache->waiting)
+	    break;
+
+	ATOMIC_STORE (&cache->phase, 1 - cache->phase);
+    }
+
+    UNLOCK (&cache->lock);
+}
+
+static pixman_bool_t
+over_count (pixman_glyph_cache_t *cache)
+{
+    if (cache->concurrent)
+	return ATOMIC_LOAD (&cache->n_glyphs) > N_GLYPHS_HIGH_WATER;
+
+    return cache->tables[0].n_glyphs +
+	cache->tables[0].n_tombstones > N_GLYPHS_HIGH_WATER;
+}
+
+static pixman_bool_t
+over_budget (pixman_glyph_cache_t *cache)
+{
+    return cache->budget && ATOMIC_LOAD (&cache->n_bytes) > cache->budget;
+}
+
+/* Evicts glyphs from a concurrent cache with the clock algorithm: a
+ * first sweep over the tables evicts the glyphs that haven't been used
+ * since the last one, and makes the others unused, and a second one
+ * evicts any glyphs, until each table is down to its share of the glyph
+ * low water mark and the whole cache to the byte low water mark, as far
+ * as they were crossed. Glyphs are uncharged as soon as they are
+ * evicted, even though they are only freed later.
+ */
+static void
+evict_glyphs (pixman_glyph_cache_t *cache)
+{
+    int max_glyphs = INT32_MAX;
+    size_t max_bytes = (size_t)-1;
+    int i, pass;
+
+    if (over_count (cache))
+	max_glyphs = N_GLYPHS_LOW_WATER / N_SHARDS;
+    if (over_budget (cache))
+	max_bytes = BYTES_LOW_WATER (cache->budget);
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+	for (i = 0; i < N_SHARDS; ++i)
+	{
+	    glyph_table_t *table = &cache->tables[i];
+	    int n_evicted = 0;
+	    unsigned int j;
+
+	    LOCK (&table->lock);
+
+	    for (j = 0; j <= table->mask; ++j)
+	    {
+		glyph_t *glyph = table->glyphs[j];
+
+		if (table->n_glyphs <= max_glyphs			&&
+		    ATOMIC_LOAD (&cache->n_bytes) <= max_bytes)
+		{
+		    break;
+		}
+
+		if (!glyph || glyph == TOMBSTONE)
+		    continue;
+
+		if (pass == 0 && ATOMIC_LOAD_RELAXED (&glyph->used))
+		{
+		    ATOMIC_STORE_RELAXED (&glyph->used, FALSE);
+		}
+		else
+		{
+		    retire_glyph (cache, table, glyph);
+		    n_evicted++;
+		}
+	    }
+
+	    UNLOCK (&table->lock);
+
+	    ATOMIC_ADD (&cache->n_evictions, n_evicted);
+	}
+    }
+}
+
+static force_inline void
+touch_glyph (pixman_glyph_cache_t *cache, glyph_t *glyph)
+{
+    /* Concurrent caches only write when the glyph becomes used, so that
+     * threads rendering the same glyphs don't fight over cache lines.
+     * Sweeps clearing the flag at the same time only make eviction a
+     * little less accurate, so relaxed accesses are enough.
+     */
+    if (cache->concurrent)
+    {
+	if (!ATOMIC_LOAD_RELAXED (&glyph->used))
+	    ATOMIC_STORE_RELAXED (&glyph->used, TRUE);
+    }
+    else
+    {
+	pixman_list_move_to_front (&cache->mru, &glyph->mru_link);
+    }
+}
+
 static void
 clear_table (pixman_glyph_cache_t *cache)
 {
     int i;
 
-    for (i = 0; i < HASH_SIZE; ++i)
+    for (i = 0; i < cache->n_tables; ++i)
+    {
+	glyph_table_t *table = &cache->tables[i];
+	unsigned int j;
+
+	for (j = 0; j <= table->mask; ++j)
+	{
+	    glyph_t *glyph = table->glyphs[j];
+
+	    if (glyph && glyph != TOMBSTONE)
+		free_glyph (cache, glyph);
+
+	    table->glyphs[j] = NULL;
+	}
+
+	free_glyph_list (cache, table->retired);
+
+	table->retired = NULL;
+	table->n_glyphs = 0;
+	table->n_tombstones = 0;
+    }
+
+    free_glyph_list (cache, cache->waiting);
+
+    cache->waiting = NULL;
+    cache->n_glyphs = 0;
+    cache->n_bytes = 0;
+}
+
+/* The concurrent caches that a thread has frozen, and the phases it is
+ * counted under.
+ */
+typedef struct
+{
+    pixman_glyph_cache_t *	cache;
+    int				phase;
+    int				depth;
+    uint64_t			n_hits;
+    uint64_t			n_misses;
+} frozen_cache_t;
+
+typedef struct
+{
+    frozen_cache_t		caches[N_FROZEN_CACHES];
+} frozen_caches_t;
+
+PIXMAN_DEFINE_THREAD_LOCAL (frozen_caches_t, frozen_caches);
+
+static frozen_cache_t *
+find_frozen_cache (pixman_glyph_cache_t *cache)
+{
+    frozen_caches_t *frozen = PIXMAN_GET_THREAD_LOCAL (frozen_caches);
+    int i;
+
+    for (i = 0; frozen && i < N_FROZEN_CACHES; ++i)
+    {
+	if (frozen->caches[i].cache == cache)
+	    return &frozen->caches[i];
+    }
+
+    return NULL;
+}
+
+/* Threads that have a concurrent cache frozen count their lookups
+ * themselves until they thaw it, so that lookups don't write to memory
+ * that other threads use.
+ */
+static void
+count_lookup (pixman_glyph_cache_t *cache, pixman_bool_t hit)
+{
+    frozen_cache_t *frozen;
+
+    if (!cache->concurrent)
+    {
+	if (hit)
+	    cache->n_hits++;
+	else
+	    cache->n_misses++;
+    }
+    else if ((frozen = find_frozen_cache (cache)))
+    {
+	if (hit)
+	    frozen->n_hits++;
+	else
+	    frozen->n_misses++;
+    }
+    else if (hit)
+    {
+	ATOMIC_ADD_RELAXED (&cache->n_hits, 1);
+    }
+    else
+    {
+	ATOMIC_ADD_RELAXED (&cache->n_misses, 1);
+    }
+}
+
+static void
+flush_counts (pixman_glyph_cache_t *cache, frozen_cache_t *frozen)
+{
+    if (frozen->n_hits)
+	ATOMIC_ADD_RELAXED (&cache->n_hits, frozen->n_hits);
+    if (frozen->n_misses)
+	ATOMIC_ADD_RELAXED (&cache->n_misses, frozen->n_misses);
+}
+
+static pixman_bool_t
+is_frozen (pixman_glyph_cache_t *cache)
+{
+    if (!cache->concurrent)
+	return cache->freeze_count > 0;
+
+    return (ATOMIC_LOAD (&cache->readers[0]) +
+	    ATOMIC_LOAD (&cache->readers[1]) +
+	    ATOMIC_LOAD (&cache->readers[UNKNOWN_PHASE])) > 0;
+}
+
+static pixman_glyph_cache_t *
+create_cache (size_t budget, pixman_bool_t concurrent)
+{
+    pixman_glyph_cache_t *cache;
+    int i;
+
+    if (!(cache = malloc (sizeof *cache)))
+	return NULL;
+
+    memset (cache->glyphs, 0, sizeof (cache->glyphs));
+    cache->concurrent = concurrent;
+    cache->budget = budget;
+    cache->n_glyphs = 0;
+    cache->n_bytes = 0;
+    cache->n_hits = 0;
+    cache->n_misses = 0;
+    cache->n_insertions = 0;
+    cache->n_evictions = 0;
+    cache->n_removals = 0;
+    cache->n_retired = 0;
+    cache->freeze_count = 0;
+    cache->phase = 0;
+    cache->readers[0] = cache->readers[1] = cache->readers[UNKNOWN_PHASE] = 0;
+    cache->waiting = NULL;
+    cache->atlases = NULL;
+    cache->n_tables = concurrent ? N_SHARDS : 1;
+
+    for (i = 0; i < cache->n_tables; ++i)
     {
-	glyph_t *glyph = cache->glyphs[i];
+	glyph_table_t *table = &cache->tables[i];
+	int size = HASH_SIZE / cache->n_tables;
 
-	if (glyph && glyph != TOMBSTONE)
-	    free_glyph (glyph);
+	table->n_glyphs = 0;
+	table->n_tombstones = 0;
+	table->mask = size - 1;
+	table->glyphs = cache->glyphs + i * size;
+	table->retired = NULL;
 
-	cache->glyphs[i] = NULL;
+	if (concurrent)
+	    LOCK_INIT (&table->lock);
     }
 
-    cache->n_glyphs = 0;
-    cache->n_tombstones = 0;
+    if (concurrent)
+    {
+	LOCK_INIT (&cache->lock);
+	LOCK_INIT (&cache->atlas_lock);
+    }
+
+    pixman_list_init (&cache->mru);
+
+    return cache;
 }
 
 PIXMAN_EXPORT pixman_glyph_cache_t *
 pixman_glyph_cache_create (void)
 {
-    pixman_glyph_cache_t *cache;
+    return create_cache (0, FALSE);
+}
 
-    if (!(cache = malloc (sizeof *cache)))
-	return NULL;
+PIXMAN_EXPORT pixman_glyph_cache_t *
+pixman_glyph_cache_create_concurrent (void)
+{
+    return pixman_glyph_cache_create_with_budget (0, TRUE);
+}
 
-    memset (cache->glyphs, 0, sizeof (cache->glyphs));
-    cache->n_glyphs = 0;
-    cache->n_tombstones = 0;
-    cache->freeze_count = 0;
+PIXMAN_EXPORT pixman_glyph_cache_t *
+pixman_glyph_cache_create_with_budget (uint64_t      n_bytes,
+				       pixman_bool_t concurrent)
+{
+    size_t budget = n_bytes;
 
-    pixman_list_init (&cache->mru);
+    if (budget != n_bytes)
+	budget = (size_t)-1;
 
-    return cache;
+#ifndef HAVE_CONCURRENT_CACHE
+    if (concurrent)
+	return NULL;
+#endif
+
+    return create_cache (budget, concurrent);
 }
 
 PIXMAN_EXPORT void
 pixman_glyph_cache_destroy (pixman_glyph_cache_t *cache)
 {
-    return_if_fail (cache->freeze_count == 0);
+    int i;
+
+    return_if_fail (!is_frozen (cache));
 
     clear_table (cache);
 
+    if (cache->concurrent)
+    {
+	for (i = 0; i < cache->n_tables; ++i)
+	    LOCK_FINI (&cache->tables[i].lock);
+
+	LOCK_FINI (&cache->lock);
+	LOCK_FINI (&cache->atlas_lock);
+    }
+
     free (cache);
 }
 
 PIXMAN_EXPORT void
 pixman_glyph_cache_freeze (pixman_glyph_cache_t  *cache)
 {
-    cache->freeze_count++;
+    frozen_cache_t *frozen;
+    int phase;
+
+    if (!cache->concurrent)
+    {
+	cache->freeze_count++;
+	return;
+    }
+
+    if ((frozen = find_frozen_cache (cache)))
+    {
+	frozen->depth++;
+	return;
+    }
+
+    if (!(frozen = find_frozen_cache (NULL)))
+    {
+	ATOMIC_ADD (&cache->readers[UNKNOWN_PHASE], 1);
+	return;
+    }
+
+    /* If the phase changes before this thread is counted, reclaim_glyphs()
+     * may not see it, so count it under the new phase instead.
+     */
+    for (;;)
+    {
+	phase = ATOMIC_LOAD (&cache->phase);
+
+	ATOMIC_ADD (&cache->readers[phase], 1);
+
+	if (ATOMIC_LOAD (&cache->phase) == phase)
+	    break;
+
+	ATOMIC_ADD (&cache->readers[phase], -1);
+    }
+
+    frozen->cache = cache;
+    frozen->phase = phase;
+    frozen->depth = 1;
+    frozen->n_hits = 0;
+    frozen->n_misses = 0;
 }
 
 PIXMAN_EXPORT void
 pixman_glyph_cache_thaw (pixman_glyph_cache_t  *cache)
 {
-    if (--cache->freeze_count == 0					&&
-	cache->n_glyphs + cache->n_tombstones > N_GLYPHS_HIGH_WATER)
+    glyph_table_t *table = &cache->tables[0];
+
+    if (cache->concurrent)
+    {
+	frozen_cache_t *frozen = find_frozen_cache (cache);
+
+	if (frozen && --frozen->depth)
+	    return;
+
+	if ((over_count (cache) || over_budget (cache))	&&
+	    TRYLOCK (&cache->lock))
+	{
+	    evict_glyphs (cache);
+	    UNLOCK (&cache->lock);
+	}
+
+	if (frozen)
+	{
+	    flush_counts (cache, frozen);
+
+	    frozen->cache = NULL;
+	    ATOMIC_ADD (&cache->readers[frozen->phase], -1);
+	}
+	else
+	{
+	    ATOMIC_ADD (&cache->readers[UNKNOWN_PHASE], -1);
+	}
+
+	reclaim_glyphs (cache);
+    }
+    else if (--cache->freeze_count == 0)
     {
-	if (cache->n_tombstones > N_GLYPHS_HIGH_WATER)
+	pixman_bool_t too_many = over_count (cache);
+	pixman_bool_t too_big = over_budget (cache);
+
+	if (too_many && table->n_tombstones > N_GLYPHS_HIGH_WATER)
 	{
 	    /* More than half the entries are
 	     * tombstones. Just dump the whole table.
 	     */
+	    cache->n_evictions += table->n_glyphs;
+
 	    clear_table (cache);
 	}
 
-	while (cache->n_glyphs > N_GLYPHS_LOW_WATER)
+	/* The least recently used glyphs go first, whatever their size */
+	while ((too_many && table->n_glyphs > N_GLYPHS_LOW_WATER)	||
+	       (too_big &&
+		cache->n_bytes > BYTES_LOW_WATER (cache->budget)))
 	{
 	    glyph_t *glyph = CONTAINER_OF (glyph_t, mru_link, cache->mru.tail);
 
-	    remove_glyph (cache, glyph);
-	    free_glyph (glyph);
+	    remove_glyph (cache, table, glyph);
+	    free_glyph (cache, glyph);
+
+	    cache->n_evictions++;
 	}
     }
 }
@@ -245,7 +1095,14 @@ pixman_glyph_cache_lookup (pixman_glyph_cache_t  *cache,
 			   void                  *font_key,
 			   void                  *glyph_key)
 {
-    return lookup_glyph (cache, font_key, glyph_key);
+    unsigned int h = hash (font_key, glyph_key);
+    glyph_t *glyph;
+
+    glyph = lookup_glyph (get_table (cache, h), h, font_key, glyph_key);
+
+    count_lookup (cache, glyph != NULL);
+
+    return glyph;
 }
 
 PIXMAN_EXPORT const void *
@@ -256,47 +1113,70 @@ pixman_glyph_cache_insert (pixman_glyph_cache_t  *cache,
 			   int                    origin_y,
 			   pixman_image_t        *image)
 {
-    glyph_t *glyph;
-    int32_t width, height;
+    unsigned int h = hash (font_key, glyph_key);
+    glyph_table_t *table = get_table (cache, h);
+    glyph_t *glyph = NULL;
+    pixman_bool_t allocated;
 
-    return_val_if_fail (cache->freeze_count > 0, NULL);
+    return_val_if_fail (is_frozen (cache), NULL);
     return_val_if_fail (image->type == BITS, NULL);
 
-    width = image->bits.width;
-    height = image->bits.height;
+    if (cache->concurrent)
+    {
+	LOCK (&table->lock);
 
-    if (cache->n_glyphs >= HASH_SIZE)
-	return NULL;
+	/* Another thread may have inserted it already */
+	if ((glyph = lookup_glyph (table, h, font_key, glyph_key)))
+	    goto out;
+    }
+
+    if (!table_has_room (cache, table))
+	goto out;
 
     if (!(glyph = malloc (sizeof *glyph)))
-	return NULL;
+	goto out;
 
     glyph->font_key = font_key;
     glyph->glyph_key = glyph_key;
     glyph->origin_x = origin_x;
     glyph->origin_y = origin_y;
+    glyph->width = image->bits.width;
+    glyph->height = image->bits.height;
+    glyph->hash = h;
+    glyph->used = TRUE;
+    glyph->removed = FALSE;
+    glyph->ref_count = 1;
 
-    if (!(glyph->image = pixman_image_create_bits (
-	      image->bits.format, width, height, NULL, -1)))
+    if (cache->concurrent)
+	LOCK (&cache->atlas_lock);
+
+    allocated = allocate_glyph (cache, image->bits.format, glyph);
+
+    if (cache->concurrent)
+	UNLOCK (&cache->atlas_lock);
+
+    if (!allocated)
     {
 	free (glyph);
-	return NULL;
+	glyph = NULL;
+	goto out;
     }
 
+    /* Other threads may be reading other parts of the atlas */
     pixman_image_composite32 (PIXMAN_OP_SRC,
-			      image, NULL, glyph->image, 0, 0, 0, 0, 0, 0,
-			      width, height);
+			      image, NULL, glyph->image, 0, 0, 0, 0,
+			      glyph->x, glyph->y, glyph->width, glyph->height);
 
-    if (PIXMAN_FORMAT_A   (glyph->image->bits.format) != 0	&&
-	PIXMAN_FORMAT_RGB (glyph->image->bits.format) != 0)
-    {
-	pixman_image_set_component_alpha (glyph->image, TRUE);
-    }
+    if (!cache->concurrent)
+	pixman_list_prepend (&cache->mru, &glyph->mru_link);
 
-    pixman_list_prepend (&cache->mru, &glyph->mru_link);
+    insert_glyph (cache, table, glyph);
 
-    _pixman_image_validate (glyph->image);
-    insert_glyph (cache, glyph);
+    ATOMIC_ADD (&cache->n_insertions, 1);
+
+out:
+    if (cache->concurrent)
+	UNLOCK (&table->lock);
 
     return glyph;
 }
@@ -306,16 +1186,42 @@ pixman_glyph_cache_remove (pixman_glyph_cache_t  *cache,
 			   void                  *font_key,
 			   void                  *glyph_key)
 {
+    unsigned int h = hash (font_key, glyph_key);
+    glyph_table_t *table = get_table (cache, h);
     glyph_t *glyph;
 
-    if ((glyph = lookup_glyph (cache, font_key, glyph_key)))
+    if (cache->concurrent)
+    {
+	LOCK (&table->lock);
+
+	if ((glyph = lookup_glyph (table, h, font_key, glyph_key)))
+	    retire_glyph (cache, table, glyph);
+
+	UNLOCK (&table->lock);
+
+	reclaim_glyphs (cache);
+    }
+    else if ((glyph = lookup_glyph (table, h, font_key, glyph_key)))
     {
-	remove_glyph (cache, glyph);
+	remove_glyph (cache, table, glyph);
 
-	free_glyph (glyph);
+	free_glyph (cache, glyph);
     }
 }
 
+PIXMAN_EXPORT void
+pixman_glyph_cache_get_stats (pixman_glyph_cache_t       *cache,
+			      pixman_glyph_cache_stats_t *stats)
+{
+    stats->n_hits = ATOMIC_LOAD (&cache->n_hits);
+    stats->n_misses = ATOMIC_LOAD (&cache->n_misses);
+    stats->n_insertions = ATOMIC_LOAD (&cache->n_insertions);
+    stats->n_evictions = ATOMIC_LOAD (&cache->n_evictions);
+    stats->n_glyphs = ATOMIC_LOAD (&cache->n_glyphs);
+    stats->n_bytes = ATOMIC_LOAD (&cache->n_bytes);
+    stats->budget = cache->budget;
+}
+
 PIXMAN_EXPORT void
 pixman_glyph_get_extents (pixman_glyph_cache_t *cache,
 			  int                   n_glyphs,
@@ -334,8 +1240,8 @@ pixman_glyph_get_extents (pixman_glyph_cache_t *cache,
 
 	x1 = glyphs[i].x - glyph->origin_x;
 	y1 = glyphs[i].y - glyph->origin_y;
-	x2 = glyphs[i].x - glyph->origin_x + glyph->image->bits.width;
-	y2 = glyphs[i].y - glyph->origin_y + glyph->image->bits.height;
+	x2 = glyphs[i].x - glyph->origin_x + glyph->width;
+	y2 = glyphs[i].y - glyph->origin_y + glyph->height;
 
 	if (x1 < extents->x1)
 	    extents->x1 = x1;
@@ -391,6 +1297,174 @@ box32_intersect (pixman_box32_t *dest,
     return dest->x2 > dest->x1 && dest->y2 > dest->y1;
 }
 
+#define N_GLYPH_SPANS 128
+
+typedef struct
+{
+    pixman_implementation_t *	imp;
+    pixman_glyph_spans_func_t	func;
+    uint32_t			color;
+    int				n_spans;
+    pixman_glyph_span_t		spans[N_GLYPH_SPANS];
+} glyph_spans_t;
+
+static void
+flush_glyph_spans (glyph_spans_t *spans)
+{
+    if (spans->n_spans)
+	spans->func (spans->imp, spans->color, spans->spans, spans->n_spans);
+
+    spans->n_spans = 0;
+}
+
+/* Adds a span for each row of the glyph inside the region. The region
+ * boxes are sorted in y bands, so the first band that can intersect the
+ * glyph is found with a binary search.
+ */
+static void
+add_glyph_spans (glyph_spans_t        *spans,
+		 const glyph_t        *glyph,
+		 const pixman_box32_t *glyph_box,
+		 const pixman_box32_t *boxes,
+		 int                   n_boxes,
+		 uint32_t             *dest_bits,
+		 int                   dest_stride)
+{
+    const uint8_t *mask_bits = (const uint8_t *)glyph->image->bits.bits;
+    int mask_stride = glyph->image->bits.rowstride * 4;
+    int lo = 0, hi = n_boxes;
+
+    while (lo < hi)
+    {
+	int mid = (lo + hi) / 2;
+
+	if (boxes[mid].y2 <= glyph_box->y1)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    for (; lo < n_boxes && boxes[lo].y1 < glyph_box->y2; ++lo)
+    {
+	pixman_box32_t box;
+	uint32_t *dest;
+	const uint8_t *mask;
+	int y;
+
+	if (!box32_intersect (&box, &boxes[lo], glyph_box))
+	    continue;
+
+	dest = dest_bits + box.y1 * dest_stride + box.x1;
+	mask = mask_bits +
+	    (glyph->y + box.y1 - glyph_box->y1) * mask_stride +
+	    (glyph->x + box.x1 - glyph_box->x1);
+
+	for (y = box.y1; y < box.y2; ++y)
+	{
+	    pixman_glyph_span_t *span;
+
+	    if (spans->n_spans == N_GLYPH_SPANS)
+		flush_glyph_spans (spans);
+
+	    span = &spans->spans[spans->n_spans++];
+	    span->dest = dest;
+	    span->mask = mask;
+	    span->width = box.x2 - box.x1;
+
+	    dest += dest_stride;
+	    mask += mask_stride;
+	}
+    }
+}
+
+/* Composites a run of a8 glyphs OVER a solid source onto an 8888
+ * destination in a single pass, with the rows of the glyphs inside the
+ * clip handed to the implementation in batches of spans, instead of one
+ * composite for every glyph and clip box. Returns FALSE if the run is
+ * not like that.
+ */
+static pixman_bool_t
+composite_glyph_spans (pixman_op_t            op,
+		       pixman_image_t        *src,
+		       pixman_image_t        *dest,
+		       int32_t                dest_x,
+		       int32_t                dest_y,
+		       pixman_region32_t     *region,
+		       pixman_glyph_cache_t  *cache,
+		       int                    n_glyphs,
+		       const pixman_glyph_t  *glyphs)
+{
+    pixman_format_code_t dest_format = dest->common.extended_format_code;
+    const pixman_box32_t *boxes;
+    pixman_composite_func_t composite;
+    uint32_t glyph_flags = ~0;
+    glyph_spans_t spans;
+    int n_boxes, i;
+
+    if (op != PIXMAN_OP_OVER						||
+	src->common.extended_format_code != PIXMAN_solid		||
+	(src->common.flags & FAST_PATH_STANDARD_FLAGS) !=
+	FAST_PATH_STANDARD_FLAGS					||
+	(dest_format != PIXMAN_a8r8g8b8 && dest_format != PIXMAN_x8r8g8b8 &&
+	 dest_format != PIXMAN_a8b8g8r8 && dest_format != PIXMAN_x8b8g8r8) ||
+	(dest->common.flags & FAST_PATH_STD_DEST_FLAGS) !=
+	FAST_PATH_STD_DEST_FLAGS)
+    {
+	return FALSE;
+    }
+
+    for (i = 0; i < n_glyphs; ++i)
+    {
+	const glyph_t *glyph = glyphs[i].glyph;
+
+	if (glyph->image->common.extended_format_code != PIXMAN_a8)
+	    return FALSE;
+
+	glyph_flags &= glyph->image->common.flags;
+    }
+
+    /* The glyph spans are only used if the implementation that would
+     * composite the glyphs one by one has them.
+     */
+    _pixman_implementation_lookup_composite (
+	get_implementation (), op,
+	src->common.extended_format_code, src->common.flags,
+	PIXMAN_a8, glyph_flags | FAST_PATH_SAMPLES_COVER_CLIP_NEAREST,
+	dest_format, dest->common.flags,
+	&spans.imp, &composite);
+
+    if (!(spans.func = spans.imp->glyph_spans))
+	return FALSE;
+
+    spans.color = _pixman_image_get_solid (spans.imp, src, dest->bits.format);
+    spans.n_spans = 0;
+
+    boxes = pixman_region32_rectangles (region, &n_boxes);
+
+    for (i = 0; i < n_glyphs; ++i)
+    {
+	glyph_t *glyph = (glyph_t *)glyphs[i].glyph;
+	pixman_box32_t glyph_box;
+
+	glyph_box.x1 = dest_x + glyphs[i].x - glyph->origin_x;
+	glyph_box.y1 = dest_y + glyphs[i].y - glyph->origin_y;
+	glyph_box.x2 = glyph_box.x1 + glyph->width;
+	glyph_box.y2 = glyph_box.y1 + glyph->height;
+
+	if (spans.color)
+	{
+	    add_glyph_spans (&spans, glyph, &glyph_box, boxes, n_boxes,
+			     dest->bits.bits, dest->bits.rowstride);
+	}
+
+	touch_glyph (cache, glyph);
+    }
+
+    flush_glyph_spans (&spans);
+
+    return TRUE;
+}
+
 PIXMAN_EXPORT void
 pixman_composite_glyphs_no_mask (pixman_op_t            op,
 				 pixman_image_t        *src,
@@ -429,6 +1503,12 @@ pixman_composite_glyphs_no_mask (pixman_op_t            op,
 	goto out;
     }
 
+    if (composite_glyph_spans (op, src, dest, dest_x, dest_y, &region,
+			       cache, n_glyphs, glyphs))
+    {
+	goto out;
+    }
+
     info.op = op;
     info.src_image = src;
     info.dest_image = dest;
@@ -447,8 +1527,8 @@ pixman_composite_glyphs_no_mask (pixman_op_t            op,
 
 	glyph_box.x1 = dest_x + glyphs[i].x - glyph->origin_x;
 	glyph_box.y1 = dest_y + glyphs[i].y - glyph->origin_y;
-	glyph_box.x2 = glyph_box.x1 + glyph->image->bits.width;
-	glyph_box.y2 = glyph_box.y1 + glyph->image->bits.height;
+	glyph_box.x2 = glyph_box.x1 + glyph->width;
+	glyph_box.y2 = glyph_box.y1 + glyph->height;
 	
 	pbox = pixman_region32_rectangles (&region, &n);
 	
@@ -474,8 +1554,8 @@ pixman_composite_glyphs_no_mask (pixman_op_t            op,
 
 		info.src_x = src_x + composite_box.x1 - dest_x;
 		info.src_y = src_y + composite_box.y1 - dest_y;
-		info.mask_x = composite_box.x1 - (dest_x + glyphs[i].x - glyph->origin_x);
-		info.mask_y = composite_box.y1 - (dest_y + glyphs[i].y - glyph->origin_y);
+		info.mask_x = composite_box.x1 - glyph_box.x1 + glyph->x;
+		info.mask_y = composite_box.y1 - glyph_box.y1 + glyph->y;
 		info.dest_x = composite_box.x1;
 		info.dest_y = composite_box.y1;
 		info.width = composite_box.x2 - composite_box.x1;
@@ -488,10 +1568,12 @@ pixman_composite_glyphs_no_mask (pixman_op_t            op,
 
 	    pbox++;
 	}
-	pixman_list_move_to_front (&cache->mru, &glyph->mru_link);
+	touch_glyph (cache, glyph);
     }
 
 out:
+    _pixman_image_pixels_written (dest);
+
     pixman_region32_fini (&region);
 }
 
@@ -583,13 +1665,13 @@ add_glyphs (pixman_glyph_cache_t *cache,
 
 	glyph_box.x1 = glyphs[i].x - glyph->origin_x + off_x;
 	glyph_box.y1 = glyphs[i].y - glyph->origin_y + off_y;
-	glyph_box.x2 = glyph_box.x1 + glyph->image->bits.width;
-	glyph_box.y2 = glyph_box.y1 + glyph->image->bits.height;
+	glyph_box.x2 = glyph_box.x1 + glyph->width;
+	glyph_box.y2 = glyph_box.y1 + glyph->height;
 	
 	if (box32_intersect (&composite_box, &glyph_box, &dest_box))
 	{
-	    int src_x = composite_box.x1 - glyph_box.x1;
-	    int src_y = composite_box.y1 - glyph_box.y1;
+	    int src_x = composite_box.x1 - glyph_box.x1 + glyph->x;
+	    int src_y = composite_box.y1 - glyph_box.y1 + glyph->y;
 
 	    if (white_src)
 		info.mask_image = glyph_img;
@@ -605,7 +1687,7 @@ add_glyphs (pixman_glyph_cache_t *cache,
 
 	    func (implementation, &info);
 
-	    pixman_list_move_to_front (&cache->mru, &glyph->mru_link);
+	    touch_glyph (cache, glyph);
 	}
     }
 
@@ -649,7 +1731,7 @@ pixman_composite_glyphs (pixman_op_t            op,
 {
     pixman_image_t *mask;
 
-    if (!(mask = pixman_image_create_bits (mask_format, width, height, NULL, -1)))
+    if (!(mask = _pixman_image_create_scratch_bits (mask_format, width, height)))
 	return;
 
     if (PIXMAN_FORMAT_A   (mask_format) != 0 &&
@@ -668,3 +1750,202 @@ pixman_composite_glyphs (pixman_op_t            op,
 
     pixman_image_unref (mask);
 }
+
+/* Glyph runs
+ *
+ * A run keeps the keys of its glyphs, so that it can find them again
+ * after they have been taken out of the cache, and holds a reference to
+ * each glyph that it found, so that it can tell which ones were taken
+ * out. It also remembers how many glyphs had left the cache when it last
+ * looked, and doesn't look at its glyphs at all while that is unchanged.
+ */
+typedef struct
+{
+    void *		font_key;
+    void *		glyph_key;
+    unsigned int	hash;
+} glyph_run_key_t;
+
+struct pixman_glyph_run_t
+{
+    pixman_glyph_cache_t *	cache;
+    pixman_bool_t		valid;
+    unsigned int		n_removals;	/* Of the cache, when resolved */
+    pixman_box32_t		extents;
+    pixman_format_code_t	mask_format;
+    int				n_glyphs;
+    pixman_glyph_t *		glyphs;
+    glyph_run_key_t *		keys;
+};
+
+static void
+update_glyph_run (pixman_glyph_run_t *run)
+{
+    pixman_glyph_get_extents (
+	run->cache, run->n_glyphs, run->glyphs, &run->extents);
+    run->mask_format = pixman_glyph_get_mask_format (
+	run->cache, run->n_glyphs, run->glyphs);
+}
+
+/* Looks up the glyphs of the run that were taken out of the cache since
+ * they were found, and returns whether all of them are back.
+ */
+static pixman_bool_t
+resolve_glyph_run (pixman_glyph_run_t *run)
+{
+    pixman_glyph_cache_t *cache = run->cache;
+    unsigned int n_removals = ATOMIC_LOAD (&cache->n_removals);
+    pixman_bool_t changed = FALSE;
+    int i;
+
+    if (run->valid && run->n_removals == n_removals)
+	return TRUE;
+
+    for (i = 0; i < run->n_glyphs; ++i)
+    {
+	const glyph_run_key_t *key = &run->keys[i];
+	glyph_t *old = (glyph_t *)run->glyphs[i].glyph;
+	glyph_t *glyph;
+
+	if (!ATOMIC_LOAD (&old->removed))
+	    continue;
+
+	glyph = lookup_glyph (get_table (cache, key->hash), key->hash,
+			      key->font_key, key->glyph_key);
+
+	count_lookup (cache, glyph != NULL);
+
+	if (!glyph)
+	    return FALSE;
+
+	ATOMIC_ADD (&glyph->ref_count, 1);
+	unref_glyph (old);
+
+	run->glyphs[i].glyph = glyph;
+	changed = TRUE;
+    }
+
+    if (changed || !run->valid)
+	update_glyph_run (run);
+
+    run->n_removals = n_removals;
+
+    return TRUE;
+}
+
+PIXMAN_EXPORT pixman_glyph_run_t *
+pixman_glyph_run_create (pixman_glyph_cache_t *cache,
+			 int                   n_glyphs,
+			 const pixman_glyph_t *glyphs)
+{
+    pixman_glyph_run_t *run;
+    int i;
+
+    return_val_if_fail (n_glyphs >= 0, NULL);
+
+    if (!(run = malloc (sizeof *run)))
+	return NULL;
+
+    if (!(run->glyphs = pixman_malloc_ab (
+	      MAX (n_glyphs, 1), sizeof (pixman_glyph_t) + sizeof (glyph_run_key_t))))
+    {
+	free (run);
+	return NULL;
+    }
+
+    run->keys = (glyph_run_key_t *)(run->glyphs + n_glyphs);
+    run->cache = cache;
+    run->n_glyphs = n_glyphs;
+    run->valid = FALSE;
+
+    for (i = 0; i < n_glyphs; ++i)
+    {
+	glyph_t *glyph = (glyph_t *)glyphs[i].glyph;
+
+	ATOMIC_ADD (&glyph->ref_count, 1);
+
+	run->glyphs[i] = glyphs[i];
+	run->keys[i].font_key = glyph->font_key;
+	run->keys[i].glyph_key = glyph->glyph_key;
+	run->keys[i].hash = glyph->hash;
+    }
+
+    run->valid = resolve_glyph_run (run);
+
+    return run;
+}
+
+PIXMAN_EXPORT void
+pixman_glyph_run_destroy (pixman_glyph_run_t *run)
+{
+    int i;
+
+    for (i = 0; i < run->n_glyphs; ++i)
+	unref_glyph ((glyph_t *)run->glyphs[i].glyph);
+
+    free (run->glyphs);
+    free (run);
+}
+
+PIXMAN_EXPORT pixman_bool_t
+pixman_glyph_run_validate (pixman_glyph_run_t *run)
+{
+    run->valid = resolve_glyph_run (run);
+
+    return run->valid;
+}
+
+PIXMAN_EXPORT void
+pixman_glyph_run_get_extents (pixman_glyph_run_t *run,
+			      pixman_box32_t     *extents)
+{
+    *extents = run->extents;
+}
+
+PIXMAN_EXPORT pixman_format_code_t
+pixman_glyph_run_get_mask_format (pixman_glyph_run_t *run)
+{
+    return run->mask_format;
+}
+
+PIXMAN_EXPORT void
+pixman_composite_glyph_run (pixman_op_t            op,
+			    pixman_image_t        *src,
+			    pixman_image_t        *dest,
+			    pixman_format_code_t   mask_format,
+			    int32_t                src_x,
+			    int32_t                src_y,
+			    int32_t                mask_x,
+			    int32_t                mask_y,
+			    int32_t                dest_x,
+			    int32_t                dest_y,
+			    int32_t                width,
+			    int32_t                height,
+			    pixman_glyph_run_t    *run)
+{
+    if (!pixman_glyph_run_validate (run))
+	return;
+
+    pixman_composite_glyphs (op, src, dest, mask_format,
+			     src_x, src_y, mask_x, mask_y,
+			     dest_x, dest_y, width, height,
+			     run->cache, run->n_glyphs, run->glyphs);
+}
+
+PIXMAN_EXPORT void
+pixman_composite_glyph_run_no_mask (pixman_op_t            op,
+				    pixman_image_t        *src,
+				    pixman_image_t        *dest,
+				    int32_t                src_x,
+				    int32_t                src_y,
+				    int32_t                dest_x,
+				    int32_t                dest_y,
+				    pixman_glyph_run_t    *run)
+{
+    if (!pixman_glyph_run_validate (run))
+	return;
+
+    pixman_composite_glyphs_no_mask (op, src, dest,
+				     src_x, src_y, dest_x, dest_y,
+				     run->cache, run->n_glyphs, run->glyphs);
+}
@@ -26,6 +26,7 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <stdlib.h>
 #include "pixman-private.h"
 
 void
@@ -35,6 +36,7 @@ _pixman_gradient_walker_init (pixman_gradient_walker_t *walker,
 {
     walker->num_stops = gradient->n_stops;
     walker->stops     = gradient->stops;
+    walker->stops_sorted = gradient->stops_sorted;
     walker->left_x    = 0;
     walker->right_x   = 0x10000;
     walker->a_s       = 0.0f;
@@ -46,6 +48,10 @@ _pixman_gradient_walker_init (pixman_gradient_walker_t *walker,
     walker->b_s       = 0.0f;
     walker->b_b       = 0.0f;
     walker->repeat    = repeat;
+    walker->ramp      = NULL;
+
+    if (gradient->ramp && gradient->ramp_repeat == repeat)
+	walker->ramp = gradient->ramp;
 
     walker->need_reset = TRUE;
 }
@@ -76,13 +82,33 @@ gradient_walker_reset (pixman_gradient_walker_t *walker,
     {
 	x = pos;
     }
-    
-    for (n = 0; n < count; n++)
+
+    /* Find the first stop to the right of x, or count if there is none */
+    if (walker->stops_sorted)
     {
-	if (x < stops[n].x)
-	    break;
+	int lo = 0, hi = count;
+
+	while (lo < hi)
+	{
+	    int mid = (lo + hi) >> 1;
+
+	    if (x < stops[mid].x)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+
+	n = lo;
     }
-    
+    else
+    {
+	for (n = 0; n < count; n++)
+	{
+	    if (x < stops[n].x)
+		break;
+	}
+    }
+
     left_x =  stops[n - 1].x;
     left_c = &stops[n - 1].color;
     
@@ -170,8 +196,8 @@ gradient_walker_reset (pixman_gradient_walker_t *walker,
 }
 
 uint32_t
-_pixman_gradient_walker_pixel (pixman_gradient_walker_t *walker,
-                               pixman_fixed_48_16_t      x)
+_pixman_gradient_walker_interpolate (pixman_gradient_walker_t *walker,
+                                     pixman_fixed_48_16_t      x)
 {
     float a, r, g, b;
     uint8_t a8, r8, g8, b8;
@@ -200,3 +226,117 @@ _pixman_gradient_walker_pixel (pixman_gradient_walker_t *walker,
 
     return v;
 }
+
+/* Whether the premultiplied colors between two stops that are dx apart
+ * change slowly enough that the color half a ramp step away is within
+ * one of the exact one.
+ */
+static pixman_bool_t
+gradient_segment_is_smooth (const pixman_color_t *c0,
+			    const pixman_color_t *c1,
+			    pixman_fixed_t        dx)
+{
+    int64_t da, dc;
+
+    da = abs (c1->alpha - c0->alpha);
+    dc = MAX (abs (c1->red - c0->red),
+	      MAX (abs (c1->green - c0->green), abs (c1->blue - c0->blue)));
+
+    /* Premultiplied channels change by at most (da + dc) / 65535 * 255
+     * over the segment.
+     */
+    return (da + dc) * 255 * (1 << (15 - GRADIENT_RAMP_BITS)) <=
+	(int64_t)dx * 65535;
+}
+
+/* Whether looking up colors in the ramp for the given repeat mode gives
+ * the same colors as interpolating between the stops, give or take one.
+ * That requires the stops to be sorted, and no hard stops or otherwise
+ * steep color changes, including where NORMAL wraps around.
+ */
+static pixman_bool_t
+gradient_ramp_is_accurate (gradient_t *gradient, pixman_repeat_t repeat)
+{
+    pixman_gradient_stop_t *stops = gradient->stops;
+    int n = gradient->n_stops;
+    int i;
+
+    if (stops[0].x < 0 || stops[n - 1].x > pixman_fixed_1)
+	return FALSE;
+
+    for (i = 1; i < n; ++i)
+    {
+	if (stops[i].x < stops[i - 1].x					||
+	    !gradient_segment_is_smooth (&stops[i - 1].color, &stops[i].color,
+					 stops[i].x - stops[i - 1].x))
+	{
+	    return FALSE;
+	}
+    }
+
+    if (repeat == PIXMAN_REPEAT_NORMAL &&
+	!gradient_segment_is_smooth (&stops[n - 1].color, &stops[0].color,
+				     stops[0].x + pixman_fixed_1 - stops[n - 1].x))
+    {
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Builds the color ramp for the current repeat mode of the gradient. The
+ * ramp is only an approximation, so it is not used when the filter of
+ * the image is PIXMAN_FILTER_BEST, or when it wouldn't be within one of
+ * the exact colors. It also only covers positions in [0, 1], so
+ * gradients with stops outside of that don't get one, and neither do
+ * gradients for which it can't be allocated.
+ */
+void
+_pixman_gradient_build_ramp (gradient_t *gradient)
+{
+    pixman_repeat_t repeat = gradient->common.repeat;
+    pixman_gradient_walker_t walker;
+    pixman_fixed_t x, first, last;
+    int i;
+
+    if (gradient->common.filter == PIXMAN_FILTER_BEST ||
+	!gradient_ramp_is_accurate (gradient, repeat))
+    {
+	free (gradient->ramp);
+	gradient->ramp = NULL;
+	return;
+    }
+
+    if (gradient->ramp && gradient->ramp_repeat == repeat)
+	return;
+
+    if (!gradient->ramp)
+    {
+	gradient->ramp = pixman_malloc_ab (
+	    GRADIENT_RAMP_SIZE + 1, sizeof (uint32_t));
+
+	if (!gradient->ramp)
+	    return;
+    }
+
+    _pixman_gradient_walker_init (&walker, gradient, repeat);
+    walker.ramp = NULL;
+
+    /* Lookups round to the nearest entry, so for REPEAT_NONE the entries
+     * outside of the stops hold the colors at the ends, not transparent.
+     */
+    first = gradient->stops[0].x;
+    last = gradient->stops[gradient->n_stops - 1].x - 1;
+
+    for (i = 0; i <= GRADIENT_RAMP_SIZE; ++i)
+    {
+	x = i << (16 - GRADIENT_RAMP_BITS);
+
+	if (repeat == PIXMAN_REPEAT_NONE)
+	    x = CLIP (x, first, MAX (first, last));
+
+	gradient->ramp[i] = _pixman_gradient_walker_interpolate (&walker, x);
+    }
+
+    gradient->ramp_repeat = repeat;
+}
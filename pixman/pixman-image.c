@@ -73,6 +73,8 @@ gradient_property_changed (pixman_image_t *image)
 	end->color = stops[n - 1].color;
 	break;
     }
+
+    _pixman_gradient_build_ramp (gradient);
 }
 
 pixman_bool_t
@@ -80,6 +82,8 @@ _pixman_init_gradient (gradient_t *                  gradient,
                        const pixman_gradient_stop_t *stops,
                        int                           n_stops)
 {
+    int i;
+
     return_val_if_fail (n_stops > 0, FALSE);
 
     /* We allocate two extra stops, one before the beginning of the stop list,
@@ -100,6 +104,17 @@ _pixman_init_gradient (gradient_t *                  gradient,
     gradient->stops += 1;
     memcpy (gradient->stops, stops, n_stops * sizeof (pixman_gradient_stop_t));
     gradient->n_stops = n_stops;
+    gradient->ramp = NULL;
+
+    gradient->stops_sorted = TRUE;
+    for (i = 1; i < n_stops; ++i)
+    {
+	if (stops[i].x < stops[i - 1].x)
+	{
+	    gradient->stops_sorted = FALSE;
+	    break;
+	}
+    }
 
     gradient->common.property_changed = gradient_property_changed;
 
@@ -129,6 +144,7 @@ _pixman_image_init (pixman_image_t *image)
     common->destroy_func = NULL;
     common->destroy_data = NULL;
     common->dirty = TRUE;
+    common->serial = 0;
 }
 
 pixman_bool_t
@@ -161,6 +177,8 @@ _pixman_image_fini (pixman_image_t *image)
 		free (image->gradient.stops - 1);
 	    }
 
+	    free (image->gradient.ramp);
+
 	    /* This will trigger if someone adds a property_changed
 	     * method to the linear/radial/conical gradient overwriting
 	     * the general one.
@@ -169,6 +187,9 @@ _pixman_image_fini (pixman_image_t *image)
 		image->common.property_changed == gradient_property_changed);
 	}
 
+	if (image->type == BITS)
+	    _pixman_bits_image_fini_mipmap (&image->bits);
+
 	if (image->type == BITS && image->bits.free_me)
 	    free (image->bits.free_me);
 
@@ -193,6 +214,30 @@ static void
 image_property_changed (pixman_image_t *image)
 {
     image->common.dirty = TRUE;
+    image->common.serial++;
+}
+
+/* For changes to how the pixels of a bits image are read. The mipmap
+ * levels were made from the old pixels, so they are dropped, and made
+ * again when they are needed.
+ */
+static void
+bits_image_pixels_changed (pixman_image_t *image)
+{
+    if (image->type == BITS)
+	_pixman_bits_image_fini_mipmap (&image->bits);
+
+    image_property_changed (image);
+}
+
+/* For writes by pixman to the pixels of an image, which make the mipmap
+ * levels out of date in the same way.
+ */
+void
+_pixman_image_pixels_written (pixman_image_t *image)
+{
+    if (image->type == BITS && image->bits.n_mipmap_levels)
+	bits_image_pixels_changed (image);
 }
 
 /* Ref Counting */
@@ -481,6 +526,29 @@ compute_image_info (pixman_image_t *image)
     case LINEAR:
 	code = PIXMAN_unknown;
 
+	/* A linear gradient whose position doesn't change along the x
+	 * axis of an affine transformation is a single color on each row.
+	 * The differences have 33 bits and the matrix entries 32, so each
+	 * product fits in 64 bits, but their sum might not.
+	 */
+	if (image->type == LINEAR && (flags & FAST_PATH_AFFINE_TRANSFORM))
+	{
+	    pixman_fixed_48_16_t dx =
+		(pixman_fixed_48_16_t)image->linear.p2.x - image->linear.p1.x;
+	    pixman_fixed_48_16_t dy =
+		(pixman_fixed_48_16_t)image->linear.p2.y - image->linear.p1.y;
+	    pixman_fixed_48_16_t ux = pixman_fixed_1, uy = 0;
+
+	    if (image->common.transform)
+	    {
+		ux = image->common.transform->matrix[0][0];
+		uy = image->common.transform->matrix[1][0];
+	    }
+
+	    if (dx * ux == -(dy * uy))
+		flags |= FAST_PATH_SOLID_ROWS;
+	}
+
 	if (image->common.repeat != PIXMAN_REPEAT_NONE)
 	{
 	    int i;
@@ -684,6 +752,17 @@ pixman_image_set_filter (pixman_image_t *      image,
     if (params == common->filter_params && filter == common->filter)
 	return TRUE;
 
+    /* Images that are drawn over and over tend to get the same filter
+     * each time, often freshly made, so compare the values too.
+     */
+    if (filter == common->filter && n_params == common->n_filter_params &&
+	params && common->filter_params &&
+	memcmp (params, common->filter_params,
+		n_params * sizeof (pixman_fixed_t)) == 0)
+    {
+	return TRUE;
+    }
+
     if (filter == PIXMAN_FILTER_SEPARABLE_CONVOLUTION)
     {
 	int width = pixman_fixed_to_int (params[0]);
@@ -720,6 +799,20 @@ pixman_image_set_filter (pixman_image_t *      image,
     return TRUE;
 }
 
+PIXMAN_EXPORT void
+pixman_image_set_mipmap (pixman_image_t *image,
+                         pixman_mipmap_t mipmap)
+{
+    return_if_fail (image->type == BITS);
+
+    /* The levels are made from the pixels as they are now */
+    _pixman_bits_image_fini_mipmap (&image->bits);
+
+    image->bits.mipmap = mipmap;
+
+    image_property_changed (image);
+}
+
 PIXMAN_EXPORT void
 pixman_image_set_source_clipping (pixman_image_t *image,
                                   pixman_bool_t   clip_sources)
@@ -747,7 +840,7 @@ pixman_image_set_indexed (pixman_image_t *        image,
 
     bits->indexed = indexed;
 
-    image_property_changed (image);
+    bits_image_pixels_changed (image);
 }
 
 PIXMAN_EXPORT void
@@ -833,7 +926,7 @@ pixman_image_set_accessors (pixman_image_t *           image,
 	image->bits.read_func = read_func;
 	image->bits.write_func = write_func;
 
-	image_property_changed (image);
+	bits_image_pixels_changed (image);
     }
 }
 
@@ -924,6 +1017,9 @@ _pixman_image_get_solid (pixman_implementation_t *imp,
 	    ITER_NARROW, image->common.flags);
 	
 	result = *iter.get_scanline (&iter, NULL);
+
+	if (iter.fini)
+	    iter.fini (&iter);
     }
 
     /* If necessary, convert RGB <--> BGR. */
@@ -52,6 +52,269 @@ _pixman_implementation_create (pixman_implementation_t *fallback,
     return imp;
 }
 
+/*
+ * The fast path index
+ *
+ * Looking up a composite function by walking the fast path tables of
+ * all the implementations gets slow when the tables are long, so when
+ * the implementation chain has been set up, all the fast paths are
+ * gathered into a hash table keyed on (op, src, mask, dest) as written
+ * in the tables, PIXMAN_OP_any and PIXMAN_any included.
+ *
+ * A lookup then only needs to probe the key itself plus those wildcard
+ * combinations that actually occur in the tables. Each hash bucket
+ * holds its fast paths in table order, and every entry remembers its
+ * position in the overall walk, so picking the matching entry with the
+ * lowest position gives exactly the same result as the linear walk.
+ */
+#define N_KEY_PATTERNS		16
+
+#define PATTERN_ANY_OP		(1 << 0)
+#define PATTERN_ANY_SRC		(1 << 1)
+#define PATTERN_ANY_MASK	(1 << 2)
+#define PATTERN_ANY_DEST	(1 << 3)
+
+typedef struct
+{
+    uint32_t			order;
+    uint32_t			src_flags;
+    uint32_t			mask_flags;
+    uint32_t			dest_flags;
+    pixman_implementation_t *	imp;
+    pixman_composite_func_t	func;
+} index_entry_t;
+
+typedef struct
+{
+    pixman_op_t			op;
+    pixman_format_code_t	src_format;
+    pixman_format_code_t	mask_format;
+    pixman_format_code_t	dest_format;
+    int				first;
+    int				n_entries;
+} index_bucket_t;
+
+struct fast_path_index_t
+{
+    uint32_t			patterns;
+    uint32_t			mask;
+    index_bucket_t *		buckets;
+    index_entry_t *		entries;
+};
+
+static force_inline uint32_t
+index_hash (pixman_op_t          op,
+	    pixman_format_code_t src_format,
+	    pixman_format_code_t mask_format,
+	    pixman_format_code_t dest_format)
+{
+    uint32_t h;
+
+    h = (uint32_t)op * 0x9e3779b1;
+    h = (h ^ (uint32_t)src_format) * 0x85ebca6b;
+    h = (h ^ (uint32_t)mask_format) * 0xc2b2ae35;
+    h = (h ^ (uint32_t)dest_format) * 0x27d4eb2f;
+
+    return h ^ (h >> 15);
+}
+
+static index_bucket_t *
+index_find_bucket (const fast_path_index_t *index,
+		   pixman_op_t              op,
+		   pixman_format_code_t     src_format,
+		   pixman_format_code_t     mask_format,
+		   pixman_format_code_t     dest_format)
+{
+    uint32_t i = index_hash (op, src_format, mask_format, dest_format);
+
+    /* Linear probing; the table is never more than half full, so
+     * there is always an empty bucket to stop at.
+     */
+    for (;;)
+    {
+	index_bucket_t *b = &index->buckets[i & index->mask];
+
+	if (b->n_entries == 0 ||
+	    (b->op == op			&&
+	     b->src_format == src_format	&&
+	     b->mask_format == mask_format	&&
+	     b->dest_format == dest_format))
+	{
+	    return b;
+	}
+
+	i++;
+    }
+}
+
+static int
+key_pattern (const pixman_fast_path_t *info)
+{
+    int pattern = 0;
+
+    if (info->op == PIXMAN_OP_any)
+	pattern |= PATTERN_ANY_OP;
+    if (info->src_format == PIXMAN_any)
+	pattern |= PATTERN_ANY_SRC;
+    if (info->mask_format == PIXMAN_any)
+	pattern |= PATTERN_ANY_MASK;
+    if (info->dest_format == PIXMAN_any)
+	pattern |= PATTERN_ANY_DEST;
+
+    return pattern;
+}
+
+void
+_pixman_implementation_build_fast_path_index (pixman_implementation_t *toplevel)
+{
+    fast_path_index_t *index;
+    pixman_implementation_t *imp;
+    const pixman_fast_path_t *info;
+    uint32_t n_fast_paths, n_buckets, order, i;
+    int n_entries;
+
+    n_fast_paths = 0;
+    for (imp = toplevel; imp != NULL; imp = imp->fallback)
+    {
+	for (info = imp->fast_paths; info->op != PIXMAN_OP_NONE; ++info)
+	    n_fast_paths++;
+    }
+
+    n_buckets = 16;
+    while (n_buckets < 2 * n_fast_paths)
+	n_buckets *= 2;
+
+    index = malloc (sizeof (fast_path_index_t));
+    if (!index)
+	return;
+
+    index->buckets = calloc (n_buckets, sizeof (index_bucket_t));
+    index->entries = pixman_malloc_ab (n_fast_paths, sizeof (index_entry_t));
+
+    if (!index->buckets || !index->entries)
+    {
+	free (index->buckets);
+	free (index->entries);
+	free (index);
+	return;
+    }
+
+    index->patterns = 0;
+    index->mask = n_buckets - 1;
+
+    /* First pass: count the entries per key */
+    for (imp = toplevel; imp != NULL; imp = imp->fallback)
+    {
+	for (info = imp->fast_paths; info->op != PIXMAN_OP_NONE; ++info)
+	{
+	    index_bucket_t *b = index_find_bucket (
+		index, info->op,
+		info->src_format, info->mask_format, info->dest_format);
+
+	    b->op = info->op;
+	    b->src_format = info->src_format;
+	    b->mask_format = info->mask_format;
+	    b->dest_format = info->dest_format;
+	    b->n_entries++;
+
+	    index->patterns |= 1 << key_pattern (info);
+	}
+    }
+
+    /* Give each bucket its range of the entry array */
+    n_entries = 0;
+    for (i = 0; i < n_buckets; ++i)
+    {
+	index_bucket_t *b = &index->buckets[i];
+
+	b->first = n_entries;
+	n_entries += b->n_entries;
+	b->n_entries = 0;
+    }
+
+    /* Second pass: fill in the entries in walk order */
+    order = 0;
+    for (imp = toplevel; imp != NULL; imp = imp->fallback)
+    {
+	for (info = imp->fast_paths; info->op != PIXMAN_OP_NONE; ++info)
+	{
+	    index_bucket_t *b = index_find_bucket (
+		index, info->op,
+		info->src_format, info->mask_format, info->dest_format);
+	    index_entry_t *e = &index->entries[b->first + b->n_entries++];
+
+	    e->order = order++;
+	    e->src_flags = info->src_flags;
+	    e->mask_flags = info->mask_flags;
+	    e->dest_flags = info->dest_flags;
+	    e->imp = imp;
+	    e->func = info->func;
+	}
+    }
+
+    toplevel->fast_path_index = index;
+}
+
+static pixman_bool_t
+lookup_fast_path_index (const fast_path_index_t  *index,
+			pixman_op_t               op,
+			pixman_format_code_t      src_format,
+			uint32_t                  src_flags,
+			pixman_format_code_t      mask_format,
+			uint32_t                  mask_flags,
+			pixman_format_code_t      dest_format,
+			uint32_t                  dest_flags,
+			pixman_implementation_t **out_imp,
+			pixman_composite_func_t  *out_func)
+{
+    const index_entry_t *best = NULL;
+    int pattern;
+
+    for (pattern = 0; pattern < N_KEY_PATTERNS; ++pattern)
+    {
+	const index_bucket_t *b;
+	const index_entry_t *e, *end;
+
+	if (!(index->patterns & (1 << pattern)))
+	    continue;
+
+	b = index_find_bucket (
+	    index,
+	    (pattern & PATTERN_ANY_OP)? PIXMAN_OP_any : op,
+	    (pattern & PATTERN_ANY_SRC)? PIXMAN_any : src_format,
+	    (pattern & PATTERN_ANY_MASK)? PIXMAN_any : mask_format,
+	    (pattern & PATTERN_ANY_DEST)? PIXMAN_any : dest_format);
+
+	e = index->entries + b->first;
+	end = e + b->n_entries;
+
+	/* Entries are in walk order, so the first match is the
+	 * best one in this bucket.
+	 */
+	for (; e < end; ++e)
+	{
+	    if (best && e->order > best->order)
+		break;
+
+	    if ((e->src_flags & src_flags) == e->src_flags	&&
+		(e->mask_flags & mask_flags) == e->mask_flags	&&
+		(e->dest_flags & dest_flags) == e->dest_flags)
+	    {
+		best = e;
+		break;
+	    }
+	}
+    }
+
+    if (!best)
+	return FALSE;
+
+    *out_imp = best->imp;
+    *out_func = best->func;
+
+    return TRUE;
+}
+
 #define N_CACHED_FAST_PATHS 8
 
 typedef struct
@@ -115,6 +378,22 @@ _pixman_implementation_lookup_composite (pixman_implementation_t  *toplevel,
 	}
     }
 
+    if (toplevel->fast_path_index &&
+	lookup_fast_path_index (toplevel->fast_path_index, op,
+				src_format, src_flags,
+				mask_format, mask_flags,
+				dest_format, dest_flags,
+				out_imp, out_func))
+    {
+	/* Set i to the last spot in the cache so that the
+	 * move-to-front code below will work
+	 */
+	i = N_CACHED_FAST_PATHS - 1;
+
+	goto found;
+    }
+
+    /* Without an index, walk the tables */
     for (imp = toplevel; imp != NULL; imp = imp->fallback)
     {
 	const pixman_fast_path_t *info = imp->fast_paths;
@@ -142,7 +421,7 @@ _pixman_implementation_lookup_composite (pixman_implementation_t  *toplevel,
 		 */
 		i = N_CACHED_FAST_PATHS - 1;
 
-		goto update_cache;
+		goto found;
 	    }
 
 	    ++info;
@@ -161,6 +440,13 @@ _pixman_implementation_lookup_composite (pixman_implementation_t  *toplevel,
     *out_func = dummy_composite_rect;
     return;
 
+found:
+    if (_pixman_composite_stats_enabled)
+    {
+	_pixman_composite_stats_lookup (
+	    op, src_format, mask_format, dest_format, *out_imp);
+    }
+
 update_cache:
     if (i)
     {
@@ -305,6 +591,13 @@ _pixman_implementation_src_iter_init (pixman_implementation_t	*imp,
     iter->height = height;
     iter->iter_flags = iter_flags;
     iter->image_flags = image_flags;
+    iter->fini = NULL;
+
+    if (image && image->type == BITS &&
+	_pixman_bits_image_mipmap_iter_init (imp, iter))
+    {
+	return TRUE;
+    }
 
     while (imp)
     {
@@ -337,6 +630,7 @@ _pixman_implementation_dest_iter_init (pixman_implementation_t	*imp,
     iter->height = height;
     iter->iter_flags = iter_flags;
     iter->image_flags = image_flags;
+    iter->fini = NULL;
 
     while (imp)
     {
@@ -397,5 +691,10 @@ _pixman_choose_implementation (void)
 
     imp = _pixman_implementation_create_noop (imp);
 
+    _pixman_implementation_build_fast_path_index (imp);
+
+    _pixman_threads_init ();
+    _pixman_composite_stats_init ();
+
     return imp;
 }
@@ -88,9 +88,91 @@ linear_gradient_is_horizontal (pixman_image_t *image,
     return FALSE;
 }
 
-static uint32_t *
-linear_get_scanline_narrow (pixman_iter_t  *iter,
-			    const uint32_t *mask)
+static pixman_bool_t
+linear_gradient_map_point (pixman_image_t  *image,
+			   int              x,
+			   int              y,
+			   pixman_vector_t *v,
+			   pixman_vector_t *unit)
+{
+    /* reference point is the center of the pixel */
+    v->vector[0] = pixman_int_to_fixed (x) + pixman_fixed_1 / 2;
+    v->vector[1] = pixman_int_to_fixed (y) + pixman_fixed_1 / 2;
+    v->vector[2] = pixman_fixed_1;
+
+    if (image->common.transform)
+    {
+	if (!pixman_transform_point_3d (image->common.transform, v))
+	    return FALSE;
+
+	unit->vector[0] = image->common.transform->matrix[0][0];
+	unit->vector[1] = image->common.transform->matrix[1][0];
+	unit->vector[2] = image->common.transform->matrix[2][0];
+    }
+    else
+    {
+	unit->vector[0] = pixman_fixed_1;
+	unit->vector[1] = 0;
+	unit->vector[2] = 0;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Computes the gradient position of the center of pixel (x, y) and how
+ * much it changes from one pixel to the next along the scanline. The
+ * position of pixel i is then t + (pixman_fixed_32_32_t)(inc * i).
+ *
+ * Returns FALSE if the transformation is projective or can't be
+ * applied, in which case positions have to be computed per pixel.
+ */
+pixman_bool_t
+_pixman_linear_gradient_get_affine_position (pixman_image_t       *image,
+					     int                   x,
+					     int                   y,
+					     pixman_fixed_32_32_t *t,
+					     double               *inc)
+{
+    linear_gradient_t *linear = (linear_gradient_t *)image;
+    pixman_vector_t v, unit;
+    pixman_fixed_32_32_t l;
+    pixman_fixed_48_16_t dx, dy;
+
+    if (!linear_gradient_map_point (image, x, y, &v, &unit))
+	return FALSE;
+
+    dx = linear->p2.x - linear->p1.x;
+    dy = linear->p2.y - linear->p1.y;
+
+    l = dx * dx + dy * dy;
+
+    if (l != 0 && unit.vector[2] != 0)
+	return FALSE;
+
+    if (l == 0 || v.vector[2] == 0)
+    {
+	*t = 0;
+	*inc = 0;
+    }
+    else
+    {
+	double invden, v2;
+
+	invden = pixman_fixed_1 * (double) pixman_fixed_1 /
+	    (l * (double) v.vector[2]);
+	v2 = v.vector[2] * (1. / pixman_fixed_1);
+	*t = ((dx * v.vector[0] + dy * v.vector[1]) - 
+	      (dx * linear->p1.x + dy * linear->p1.y) * v2) * invden;
+	*inc = (dx * unit.vector[0] + dy * unit.vector[1]) * invden;
+    }
+
+    return TRUE;
+}
+
+uint32_t *
+_pixman_linear_gradient_get_scanline_narrow (pixman_iter_t  *iter,
+					     const uint32_t *mask)
 {
     pixman_image_t *image  = iter->image;
     int             x      = iter->x;
@@ -105,57 +187,14 @@ linear_get_scanline_narrow (pixman_iter_t  *iter,
     linear_gradient_t *linear = (linear_gradient_t *)image;
     uint32_t *end = buffer + width;
     pixman_gradient_walker_t walker;
+    pixman_fixed_32_32_t t, next_inc;
+    double inc;
 
     _pixman_gradient_walker_init (&walker, gradient, image->common.repeat);
 
-    /* reference point is the center of the pixel */
-    v.vector[0] = pixman_int_to_fixed (x) + pixman_fixed_1 / 2;
-    v.vector[1] = pixman_int_to_fixed (y) + pixman_fixed_1 / 2;
-    v.vector[2] = pixman_fixed_1;
-
-    if (image->common.transform)
-    {
-	if (!pixman_transform_point_3d (image->common.transform, &v))
-	    return iter->buffer;
-
-	unit.vector[0] = image->common.transform->matrix[0][0];
-	unit.vector[1] = image->common.transform->matrix[1][0];
-	unit.vector[2] = image->common.transform->matrix[2][0];
-    }
-    else
-    {
-	unit.vector[0] = pixman_fixed_1;
-	unit.vector[1] = 0;
-	unit.vector[2] = 0;
-    }
-
-    dx = linear->p2.x - linear->p1.x;
-    dy = linear->p2.y - linear->p1.y;
-
-    l = dx * dx + dy * dy;
-
-    if (l == 0 || unit.vector[2] == 0)
+    if (_pixman_linear_gradient_get_affine_position (image, x, y, &t, &inc))
     {
 	/* affine transformation only */
-        pixman_fixed_32_32_t t, next_inc;
-	double inc;
-
-	if (l == 0 || v.vector[2] == 0)
-	{
-	    t = 0;
-	    inc = 0;
-	}
-	else
-	{
-	    double invden, v2;
-
-	    invden = pixman_fixed_1 * (double) pixman_fixed_1 /
-		(l * (double) v.vector[2]);
-	    v2 = v.vector[2] * (1. / pixman_fixed_1);
-	    t = ((dx * v.vector[0] + dy * v.vector[1]) - 
-		 (dx * linear->p1.x + dy * linear->p1.y) * v2) * invden;
-	    inc = (dx * unit.vector[0] + dy * unit.vector[1]) * invden;
-	}
 	next_inc = 0;
 
 	if (((pixman_fixed_32_32_t )(inc * width)) == 0)
@@ -187,7 +226,13 @@ linear_get_scanline_narrow (pixman_iter_t  *iter,
     else
     {
 	/* projective transformation */
-        double t;
+	if (!linear_gradient_map_point (image, x, y, &v, &unit))
+	    return iter->buffer;
+
+	dx = linear->p2.x - linear->p1.x;
+	dy = linear->p2.y - linear->p1.y;
+
+	l = dx * dx + dy * dy;
 
 	t = 0;
 
@@ -222,10 +267,33 @@ linear_get_scanline_narrow (pixman_iter_t  *iter,
     return iter->buffer;
 }
 
+/*
+ * Returns the color of row y of a gradient that has FAST_PATH_SOLID_ROWS
+ * set, that is, the color of every pixel that
+ * _pixman_linear_gradient_get_scanline_narrow() would return for it.
+ */
+uint32_t
+_pixman_linear_gradient_get_row_color (pixman_image_t *image,
+				       int             x,
+				       int             y)
+{
+    pixman_gradient_walker_t walker;
+    pixman_fixed_32_32_t t;
+    double inc;
+
+    if (!_pixman_linear_gradient_get_affine_position (image, x, y, &t, &inc))
+	return 0;
+
+    _pixman_gradient_walker_init (
+	&walker, &image->gradient, image->common.repeat);
+
+    return _pixman_gradient_walker_pixel (&walker, t);
+}
+
 static uint32_t *
 linear_get_scanline_wide (pixman_iter_t *iter, const uint32_t *mask)
 {
-    uint32_t *buffer = linear_get_scanline_narrow (iter, NULL);
+    uint32_t *buffer = _pixman_linear_gradient_get_scanline_narrow (iter, NULL);
 
     pixman_expand_to_float (
 	(argb_t *)buffer, buffer, PIXMAN_a8r8g8b8, iter->width);
@@ -240,7 +308,7 @@ _pixman_linear_gradient_iter_init (pixman_image_t *image, pixman_iter_t  *iter)
 	    iter->image, iter->x, iter->y, iter->width, iter->height))
     {
 	if (iter->iter_flags & ITER_NARROW)
-	    linear_get_scanline_narrow (iter, NULL);
+	    _pixman_linear_gradient_get_scanline_narrow (iter, NULL);
 	else
 	    linear_get_scanline_wide (iter, NULL);
 
@@ -249,7 +317,7 @@ _pixman_linear_gradient_iter_init (pixman_image_t *image, pixman_iter_t  *iter)
     else
     {
 	if (iter->iter_flags & ITER_NARROW)
-	    iter->get_scanline = linear_get_scanline_narrow;
+	    iter->get_scanline = _pixman_linear_gradient_get_scanline_narrow;
 	else
 	    iter->get_scanline = linear_get_scanline_wide;
     }
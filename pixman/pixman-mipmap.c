@@ -0,0 +1,524 @@
+/*
+ * Copyright © 2026 The Pixman Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <math.h>
+#include "pixman-private.h"
+#include "pixman-combine32.h"
+
+/*
+ * Mipmaps
+ *
+ * A bits image with a mipmap mode is sampled from a pyramid of 2x2 box
+ * reduced copies of itself when its transform shrinks it by a factor of
+ * two or more. Level n of the pyramid is an a8r8g8b8 image of
+ * ceil (width / 2^n) x ceil (height / 2^n) pixels, with the transform
+ * of the image scaled by 2^-n, and the repeat mode and filter of the
+ * image.
+ *
+ * The level of detail is chosen from the transform whenever the image
+ * is validated, and the levels that it needs are built then, so that
+ * compositing on several threads never builds them. The levels are
+ * kept until the mipmap mode is set again, until the way the pixels are
+ * read changes, or until pixman writes to the image.
+ *
+ * Images that use a level are only composited through iterators, which
+ * come from the level, or, for PIXMAN_MIPMAP_LINEAR, from the two
+ * levels on either side of the level of detail. The fast paths look
+ * at the image itself, so its filter flags are removed to keep them
+ * from matching.
+ */
+
+/* The images that have levels, so that pixman_fill() and pixman_blt(),
+ * which only get a pointer to the pixels, can find the ones they write
+ * to.
+ */
+static pixman_mutex_t levels_lock = PIXMAN_MUTEX_INITIALIZER;
+static bits_image_t *images_with_levels;
+static int n_images_with_levels;
+
+static void
+add_image_with_levels (bits_image_t *image)
+{
+    LOCK (&levels_lock);
+
+    image->mipmap_prev = NULL;
+    image->mipmap_next = images_with_levels;
+    if (images_with_levels)
+	images_with_levels->mipmap_prev = image;
+    images_with_levels = image;
+
+    ATOMIC_STORE_RELAXED (&n_images_with_levels, n_images_with_levels + 1);
+
+    UNLOCK (&levels_lock);
+}
+
+static void
+remove_image_with_levels (bits_image_t *image)
+{
+    LOCK (&levels_lock);
+
+    if (image->mipmap_prev)
+	image->mipmap_prev->mipmap_next = image->mipmap_next;
+    else
+	images_with_levels = image->mipmap_next;
+    if (image->mipmap_next)
+	image->mipmap_next->mipmap_prev = image->mipmap_prev;
+
+    image->mipmap_prev = NULL;
+    image->mipmap_next = NULL;
+
+    ATOMIC_STORE_RELAXED (&n_images_with_levels, n_images_with_levels - 1);
+
+    UNLOCK (&levels_lock);
+}
+
+/* Returns the image for level n >= 1 */
+static pixman_image_t *
+mipmap_level (bits_image_t *image, int n)
+{
+    return image->mipmap_levels[n - 1];
+}
+
+/* Fills dst with the 2x2 box reduction of src */
+static pixman_bool_t
+mipmap_reduce (bits_image_t *src, bits_image_t *dst)
+{
+    uint32_t *rows;
+    int x, y;
+
+    rows = pixman_malloc_ab (src->width, 2 * sizeof (uint32_t));
+    if (!rows)
+	return FALSE;
+
+    for (y = 0; y < dst->height; ++y)
+    {
+	uint32_t *row0 = rows;
+	uint32_t *row1 = rows + src->width;
+	uint32_t *d = dst->bits + y * dst->rowstride;
+
+	src->fetch_scanline_32 (
+	    (pixman_image_t *)src, 0, 2 * y, src->width, row0, NULL);
+
+	if (2 * y + 1 < src->height)
+	{
+	    src->fetch_scanline_32 (
+		(pixman_image_t *)src, 0, 2 * y + 1, src->width, row1, NULL);
+	}
+	else
+	{
+	    row1 = row0;
+	}
+
+	for (x = 0; x < dst->width; ++x)
+	{
+	    int x1 = MIN (2 * x + 1, src->width - 1);
+	    uint32_t p00 = row0[2 * x], p01 = row0[x1];
+	    uint32_t p10 = row1[2 * x], p11 = row1[x1];
+	    uint32_t rb, ag;
+
+	    /* Each sum of four channels fits in the 16 bits it has */
+	    rb = (p00 & 0x00ff00ff) + (p01 & 0x00ff00ff) +
+		(p10 & 0x00ff00ff) + (p11 & 0x00ff00ff) + 0x00020002;
+	    ag = ((p00 >> 8) & 0x00ff00ff) + ((p01 >> 8) & 0x00ff00ff) +
+		((p10 >> 8) & 0x00ff00ff) + ((p11 >> 8) & 0x00ff00ff) + 0x00020002;
+
+	    d[x] = ((rb >> 2) & 0x00ff00ff) | ((ag << 6) & 0xff00ff00);
+	}
+    }
+
+    free (rows);
+
+    return TRUE;
+}
+
+/* Makes sure that levels 1 to n exist */
+static pixman_bool_t
+mipmap_build_levels (bits_image_t *image, int n)
+{
+    pixman_image_t **levels;
+    int i;
+
+    if (n <= image->n_mipmap_levels)
+	return TRUE;
+
+    levels = realloc (image->mipmap_levels, n * sizeof (pixman_image_t *));
+    if (!levels)
+	return FALSE;
+
+    image->mipmap_levels = levels;
+
+    for (i = image->n_mipmap_levels + 1; i <= n; ++i)
+    {
+	bits_image_t *src = i == 1 ? image : &mipmap_level (image, i - 1)->bits;
+	pixman_image_t *level;
+
+	level = pixman_image_create_bits_no_clear (
+	    PIXMAN_a8r8g8b8, (src->width + 1) / 2, (src->height + 1) / 2, NULL, 0);
+	if (!level)
+	    return FALSE;
+
+	_pixman_image_validate (level);
+
+	if (!mipmap_reduce (src, &level->bits))
+	{
+	    pixman_image_unref (level);
+	    return FALSE;
+	}
+
+	image->mipmap_levels[i - 1] = level;
+	image->n_mipmap_levels = i;
+
+	if (i == 1)
+	    add_image_with_levels (image);
+    }
+
+    return TRUE;
+}
+
+/* Gives level n the transform, repeat mode and filter of image */
+static pixman_bool_t
+mipmap_setup_level (bits_image_t *image, int n)
+{
+    pixman_image_t *level = mipmap_level (image, n);
+    pixman_transform_t transform = *image->common.transform;
+    int i, j;
+
+    /* Scale the image coordinates by 2^-n, rounding to nearest */
+    for (i = 0; i < 2; ++i)
+    {
+	for (j = 0; j < 3; ++j)
+	{
+	    int64_t v = transform.matrix[i][j];
+
+	    transform.matrix[i][j] = (v + ((int64_t)1 << (n - 1))) >> n;
+	}
+    }
+
+    if (!pixman_image_set_transform (level, &transform) ||
+	!pixman_image_set_filter (level, image->common.filter, NULL, 0))
+    {
+	return FALSE;
+    }
+
+    pixman_image_set_repeat (level, image->common.repeat);
+    _pixman_image_validate (level);
+
+    return TRUE;
+}
+
+#define MIPMAP_FLAGS							\
+    (FAST_PATH_NO_ALPHA_MAP		|				\
+     FAST_PATH_HAS_TRANSFORM		|				\
+     FAST_PATH_AFFINE_TRANSFORM		|				\
+     FAST_PATH_NARROW_FORMAT)
+
+/* The filter flags that are removed from images that use a level */
+#define MIPMAP_FILTER_FLAGS						\
+    (FAST_PATH_NEAREST_FILTER | FAST_PATH_BILINEAR_FILTER)
+
+void
+_pixman_bits_image_update_mipmap (bits_image_t *image)
+{
+    pixman_transform_t *t = image->common.transform;
+    int max_level, level, weight;
+    double sx, sy, lod;
+
+    image->mipmap_level = 0;
+    image->mipmap_weight = 0;
+
+    if (image->mipmap == PIXMAN_MIPMAP_NONE ||
+	(image->common.flags & MIPMAP_FLAGS) != MIPMAP_FLAGS)
+    {
+	return;
+    }
+
+    switch (image->common.filter)
+    {
+    case PIXMAN_FILTER_FAST:
+    case PIXMAN_FILTER_GOOD:
+    case PIXMAN_FILTER_BEST:
+    case PIXMAN_FILTER_NEAREST:
+    case PIXMAN_FILTER_BILINEAR:
+	break;
+
+    default:
+	return;
+    }
+
+    /* The level of detail is the log2 of the longest distance in the
+     * image between two adjacent destination pixels.
+     */
+    sx = hypot (pixman_fixed_to_double (t->matrix[0][0]),
+		pixman_fixed_to_double (t->matrix[1][0]));
+    sy = hypot (pixman_fixed_to_double (t->matrix[0][1]),
+		pixman_fixed_to_double (t->matrix[1][1]));
+
+    if (!(MAX (sx, sy) > 1.0))
+	return;
+
+    lod = log2 (MAX (sx, sy));
+
+    max_level = 0;
+    while ((image->width - 1) >> max_level || (image->height - 1) >> max_level)
+	max_level++;
+
+    if (image->mipmap == PIXMAN_MIPMAP_NEAREST)
+    {
+	level = floor (lod + 0.5);
+	weight = 0;
+    }
+    else
+    {
+	level = floor (lod);
+	weight = (int)((lod - level) * 255 + 0.5);
+
+	if (weight == 255)
+	{
+	    level++;
+	    weight = 0;
+	}
+    }
+
+    if (level >= max_level)
+    {
+	level = max_level;
+	weight = 0;
+    }
+
+    if (level < 0 || (level == 0 && weight == 0))
+	return;
+
+    if (!mipmap_build_levels (image, level + (weight ? 1 : 0)))
+	return;
+
+    if ((level > 0 && !mipmap_setup_level (image, level)) ||
+	(weight && !mipmap_setup_level (image, level + 1)))
+    {
+	return;
+    }
+
+    image->mipmap_level = level;
+    image->mipmap_weight = weight;
+
+    image->common.flags &= ~MIPMAP_FILTER_FLAGS;
+}
+
+void
+_pixman_bits_image_fini_mipmap (bits_image_t *image)
+{
+    int i;
+
+    if (image->n_mipmap_levels)
+	remove_image_with_levels (image);
+
+    for (i = 0; i < image->n_mipmap_levels; ++i)
+	pixman_image_unref (image->mipmap_levels[i]);
+
+    free (image->mipmap_levels);
+
+    image->mipmap_levels = NULL;
+    image->n_mipmap_levels = 0;
+}
+
+/* Drops the levels of the images whose pixels start at bits */
+void
+_pixman_mipmap_bits_written (const uint32_t *bits)
+{
+    bits_image_t *image;
+
+    if (!ATOMIC_LOAD_RELAXED (&n_images_with_levels))
+	return;
+
+    do
+    {
+	LOCK (&levels_lock);
+
+	for (image = images_with_levels; image; image = image->mipmap_next)
+	{
+	    if (image->bits == bits)
+		break;
+	}
+
+	UNLOCK (&levels_lock);
+
+	/* This takes the image out of the list */
+	if (image)
+	    _pixman_image_pixels_written ((pixman_image_t *)image);
+    }
+    while (image);
+}
+
+typedef struct
+{
+    pixman_iter_t	fine;
+    pixman_iter_t	coarse;
+    int			weight;
+} mipmap_iter_t;
+
+static pixman_bool_t
+mipmap_level_iter_init (pixman_implementation_t *imp,
+			pixman_iter_t           *iter,
+			pixman_iter_t           *level_iter,
+			int                      n,
+			uint8_t                 *buffer)
+{
+    pixman_image_t *image = iter->image;
+    uint32_t flags;
+
+    if (n > 0)
+    {
+	image = mipmap_level (&image->bits, n);
+	flags = image->common.flags;
+    }
+    else
+    {
+	/* Level 0 is the image itself. With a filter flag it is
+	 * sampled as usual, instead of coming back here.
+	 */
+	flags = iter->image_flags;
+
+	if (image->common.filter == PIXMAN_FILTER_FAST ||
+	    image->common.filter == PIXMAN_FILTER_NEAREST)
+	{
+	    flags |= FAST_PATH_NEAREST_FILTER;
+	}
+	else
+	{
+	    flags |= FAST_PATH_BILINEAR_FILTER;
+	}
+    }
+
+    return _pixman_implementation_src_iter_init (
+	imp, level_iter, image, iter->x, iter->y, iter->width, iter->height,
+	buffer, iter->iter_flags, flags);
+}
+
+static uint32_t *
+mipmap_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
+{
+    mipmap_iter_t *mipmap = iter->data;
+    uint32_t *fine = mipmap->fine.get_scanline (&mipmap->fine, mask);
+    uint32_t *coarse = mipmap->coarse.get_scanline (&mipmap->coarse, mask);
+    uint32_t *buffer = iter->buffer;
+    uint8_t w = mipmap->weight;
+    int i;
+
+    for (i = 0; i < iter->width; ++i)
+    {
+	uint32_t p = fine[i];
+
+	UN8x4_MUL_UN8_ADD_UN8x4_MUL_UN8 (p, 255 - w, coarse[i], w);
+
+	buffer[i] = p;
+    }
+
+    return buffer;
+}
+
+static uint32_t *
+mipmap_get_scanline_wide (pixman_iter_t *iter, const uint32_t *mask)
+{
+    mipmap_iter_t *mipmap = iter->data;
+    argb_t *fine = (argb_t *)mipmap->fine.get_scanline (&mipmap->fine, mask);
+    argb_t *coarse = (argb_t *)mipmap->coarse.get_scanline (&mipmap->coarse, mask);
+    argb_t *buffer = (argb_t *)iter->buffer;
+    float w = mipmap->weight * (1.0f / 255.0f);
+    int i;
+
+    for (i = 0; i < iter->width; ++i)
+    {
+	buffer[i].a = fine[i].a + (coarse[i].a - fine[i].a) * w;
+	buffer[i].r = fine[i].r + (coarse[i].r - fine[i].r) * w;
+	buffer[i].g = fine[i].g + (coarse[i].g - fine[i].g) * w;
+	buffer[i].b = fine[i].b + (coarse[i].b - fine[i].b) * w;
+    }
+
+    return iter->buffer;
+}
+
+static void
+mipmap_iter_fini (pixman_iter_t *iter)
+{
+    mipmap_iter_t *mipmap = iter->data;
+
+    if (mipmap->fine.fini)
+	mipmap->fine.fini (&mipmap->fine);
+    if (mipmap->coarse.fini)
+	mipmap->coarse.fini (&mipmap->coarse);
+
+    free (mipmap);
+}
+
+pixman_bool_t
+_pixman_bits_image_mipmap_iter_init (pixman_implementation_t *imp,
+				     pixman_iter_t           *iter)
+{
+    bits_image_t *image = &iter->image->bits;
+    int level = image->mipmap_level;
+    mipmap_iter_t *mipmap;
+    int bpp;
+
+    if ((!level && !image->mipmap_weight) ||
+	(iter->image_flags & MIPMAP_FILTER_FLAGS))
+    {
+	return FALSE;
+    }
+
+    if (!image->mipmap_weight)
+    {
+	return mipmap_level_iter_init (
+	    imp, iter, iter, level, (uint8_t *)iter->buffer);
+    }
+
+    /* The coarser level has its own buffer, after the state */
+    bpp = (iter->iter_flags & ITER_NARROW) ? sizeof (uint32_t) : sizeof (argb_t);
+
+    mipmap = malloc (sizeof (mipmap_iter_t) + iter->width * bpp);
+    if (!mipmap)
+	return FALSE;
+
+    mipmap->weight = image->mipmap_weight;
+
+    if (!mipmap_level_iter_init (
+	    imp, iter, &mipmap->fine, level, (uint8_t *)iter->buffer) ||
+	!mipmap_level_iter_init (
+	    imp, iter, &mipmap->coarse, level + 1, (uint8_t *)(mipmap + 1)))
+    {
+	free (mipmap);
+	return FALSE;
+    }
+
+    iter->data = mipmap;
+    iter->fini = mipmap_iter_fini;
+
+    if (iter->iter_flags & ITER_NARROW)
+	iter->get_scanline = mipmap_get_scanline_narrow;
+    else
+	iter->get_scanline = mipmap_get_scanline_wide;
+
+    return TRUE;
+}
@@ -102,6 +102,7 @@ struct image_common
 						     * the image is used as a source
 						     */
     pixman_bool_t		dirty;
+    uint32_t			serial;		    /* Bumped whenever a property changes */
     pixman_transform_t *        transform;
     pixman_repeat_t             repeat;
     pixman_filter_t             filter;
@@ -134,6 +135,19 @@ struct gradient
     image_common_t	    common;
     int                     n_stops;
     pixman_gradient_stop_t *stops;
+
+    /* Whether the stop positions are non-decreasing, in which case
+     * the gradient walker can binary search them.
+     */
+    pixman_bool_t	    stops_sorted;
+
+    /* Premultiplied colors at GRADIENT_RAMP_SIZE + 1 evenly spaced
+     * positions in [0, 1] for the repeat mode ramp_repeat, or NULL.
+     * It is built when the image is validated, see
+     * _pixman_gradient_build_ramp().
+     */
+    uint32_t *		    ramp;
+    pixman_repeat_t	    ramp_repeat;
 };
 
 struct linear_gradient
@@ -192,6 +206,20 @@ struct bits_image
     /* Used for indirect access to the bits */
     pixman_read_memory_func_t  read_func;
     pixman_write_memory_func_t write_func;
+
+    /* Mipmap levels 1 to n_mipmap_levels, and the level of detail: the
+     * level that is sampled, blended with weight / 255 of the next one.
+     * See pixman-mipmap.c.
+     */
+    pixman_mipmap_t            mipmap;
+    pixman_image_t **          mipmap_levels;
+    int                        n_mipmap_levels;
+    int                        mipmap_level;
+    int                        mipmap_weight;
+
+    /* The list of images that have levels */
+    bits_image_t *             mipmap_prev;
+    bits_image_t *             mipmap_next;
 };
 
 union pixman_image
@@ -209,6 +237,7 @@ union pixman_image
 typedef struct pixman_iter_t pixman_iter_t;
 typedef uint32_t *(* pixman_iter_get_scanline_t) (pixman_iter_t *iter, const uint32_t *mask);
 typedef void      (* pixman_iter_write_back_t)   (pixman_iter_t *iter);
+typedef void	  (* pixman_iter_fini_t)	 (pixman_iter_t *iter);
 
 typedef enum
 {
@@ -249,6 +278,9 @@ struct pixman_iter_t
     pixman_iter_get_scanline_t	get_scanline;
     pixman_iter_write_back_t	write_back;
 
+    /* If not NULL, called when the iterator is no longer used */
+    pixman_iter_fini_t		fini;
+
     /* These fields are scratch data that implementations can use */
     void *			data;
     uint8_t *			bits;
@@ -264,15 +296,123 @@ _pixman_bits_image_src_iter_init (pixman_image_t *image, pixman_iter_t *iter);
 void
 _pixman_bits_image_dest_iter_init (pixman_image_t *image, pixman_iter_t *iter);
 
+pixman_bool_t
+_pixman_separable_convolution_weights_fit_int16 (const pixman_fixed_t *params);
+
+/* State of the iterators that scale images with a separable convolution
+ * filter in two passes. See pixman-bits-image.c.
+ */
+typedef struct separable_scale separable_scale_t;
+
+/* Stores the horizontal sums of the pixels in [begin, end) of the
+ * source row src, in b, g, r, a order.
+ */
+typedef void (* separable_scale_filter_row_t) (const separable_scale_t *scale,
+					       const uint32_t          *src,
+					       int32_t                 *row);
+
+/* Stores the weighted sums of the n_rows horizontally filtered rows,
+ * computed exactly and rounded once.
+ */
+typedef void (* separable_scale_combine_rows_t) (uint32_t              *buffer,
+						 int                    width,
+						 const int32_t        **rows,
+						 const pixman_fixed_t  *weights,
+						 int                    n_rows);
+
+struct separable_scale
+{
+    int				cwidth;
+    int				cheight;
+    uint32_t			or_mask;
+
+    /* Pixels in [begin, end) don't need repeat handling */
+    int				begin, end;
+
+    /* First source column and filter values of each pixel */
+    int *			x1;
+    const pixman_fixed_t **	x_params;
+
+    /* Ring of cheight horizontally filtered rows, and the source row
+     * that each of them holds.
+     */
+    int32_t *			rows;
+    int *			row_y;
+
+    /* Scratch space for the rows of the current scanline */
+    const int32_t **		row_list;
+    pixman_fixed_t *		row_weights;
+
+    separable_scale_filter_row_t	filter_row;
+    separable_scale_combine_rows_t	combine_rows;
+};
+
+pixman_bool_t
+_pixman_separable_scale_iter_init (pixman_iter_t                  *iter,
+				   separable_scale_filter_row_t    filter_row,
+				   separable_scale_combine_rows_t  combine_rows);
+
+void
+_pixman_bits_image_update_mipmap (bits_image_t *image);
+
+void
+_pixman_bits_image_fini_mipmap (bits_image_t *image);
+
+void
+_pixman_mipmap_bits_written (const uint32_t *bits);
+
 void
 _pixman_linear_gradient_iter_init (pixman_image_t *image, pixman_iter_t  *iter);
 
+pixman_bool_t
+_pixman_linear_gradient_get_affine_position (pixman_image_t       *image,
+					     int                   x,
+					     int                   y,
+					     pixman_fixed_32_32_t *t,
+					     double               *inc);
+
+uint32_t *
+_pixman_linear_gradient_get_scanline_narrow (pixman_iter_t  *iter,
+					     const uint32_t *mask);
+
+uint32_t
+_pixman_linear_gradient_get_row_color (pixman_image_t *image,
+				       int             x,
+				       int             y);
+
 void
 _pixman_radial_gradient_iter_init (pixman_image_t *image, pixman_iter_t *iter);
 
+pixman_bool_t
+_pixman_radial_gradient_get_affine_coefficients (pixman_image_t       *image,
+						 int                   x,
+						 int                   y,
+						 pixman_fixed_32_32_t *b,
+						 pixman_fixed_32_32_t *db,
+						 pixman_fixed_32_32_t *c,
+						 pixman_fixed_32_32_t *dc,
+						 pixman_fixed_32_32_t *ddc);
+
+uint32_t *
+_pixman_radial_gradient_get_scanline_narrow (pixman_iter_t  *iter,
+					     const uint32_t *mask);
+
 void
 _pixman_conical_gradient_iter_init (pixman_image_t *image, pixman_iter_t *iter);
 
+pixman_bool_t
+_pixman_conical_gradient_get_affine_position (pixman_image_t *image,
+					      int             x,
+					      int             y,
+					      double         *rx,
+					      double         *ry,
+					      double         *cx,
+					      double         *cy);
+
+uint32_t *
+_pixman_conical_gradient_get_scanline_narrow (pixman_iter_t  *iter,
+					      const uint32_t *mask);
+
 void
 _pixman_image_init (pixman_image_t *image);
 
@@ -284,6 +424,12 @@ _pixman_bits_image_init (pixman_image_t *     image,
                          uint32_t *           bits,
                          int                  rowstride,
 			 pixman_bool_t	      clear);
+
+pixman_image_t *
+_pixman_image_create_scratch_bits (pixman_format_code_t format,
+				   int                  width,
+				   int                  height);
+
 pixman_bool_t
 _pixman_image_fini (pixman_image_t *image);
 
@@ -300,6 +446,9 @@ _pixman_image_reset_clip_region (pixman_image_t *image);
 void
 _pixman_image_validate (pixman_image_t *image);
 
+void
+_pixman_image_pixels_written (pixman_image_t *image);
+
 #define PIXMAN_IMAGE_GET_LINE(image, x, y, type, out_stride, line, mul)	\
     do									\
     {									\
@@ -328,11 +477,21 @@ typedef struct
 
     pixman_gradient_stop_t *stops;
     int                     num_stops;
+    pixman_bool_t	    stops_sorted;
     pixman_repeat_t	    repeat;
 
+    const uint32_t *	    ramp;
+
     pixman_bool_t           need_reset;
 } pixman_gradient_walker_t;
 
+#define GRADIENT_RAMP_BITS	12
+#define GRADIENT_RAMP_SIZE	(1 << GRADIENT_RAMP_BITS)
+
+/* The ramp entry nearest to a position in [0, 1] */
+#define GRADIENT_RAMP_INDEX(x)						\
+    (((x) + (1 << (15 - GRADIENT_RAMP_BITS))) >> (16 - GRADIENT_RAMP_BITS))
+
 void
 _pixman_gradient_walker_init (pixman_gradient_walker_t *walker,
                               gradient_t *              gradient,
@@ -343,8 +502,108 @@ _pixman_gradient_walker_reset (pixman_gradient_walker_t *walker,
                                pixman_fixed_48_16_t      pos);
 
 uint32_t
+_pixman_gradient_walker_interpolate (pixman_gradient_walker_t *walker,
+                                     pixman_fixed_48_16_t      x);
+
+void
+_pixman_gradient_build_ramp (gradient_t *gradient);
+
+/* Returns the color at position x, from the color ramp of the gradient
+ * if it has one, and otherwise by interpolating between the stops.
+ */
+static force_inline uint32_t
 _pixman_gradient_walker_pixel (pixman_gradient_walker_t *walker,
-                               pixman_fixed_48_16_t      x);
+                               pixman_fixed_48_16_t      x)
+{
+    if (walker->ramp)
+    {
+	switch (walker->repeat)
+	{
+	case PIXMAN_REPEAT_NORMAL:
+	    x &= 0xffff;
+	    break;
+
+	case PIXMAN_REPEAT_REFLECT:
+	    x &= 0x1ffff;
+	    if (x > pixman_fixed_1)
+		x = 2 * pixman_fixed_1 - x;
+	    break;
+
+	case PIXMAN_REPEAT_PAD:
+	    if (x < 0)
+		x = 0;
+	    else if (x > pixman_fixed_1)
+		x = pixman_fixed_1;
+	    break;
+
+	case PIXMAN_REPEAT_NONE:
+	default:
+	    if (x < walker->stops[0].x ||
+		x >= walker->stops[walker->num_stops - 1].x)
+	    {
+		return 0;
+	    }
+	    break;
+	}
+
+	return walker->ramp[GRADIENT_RAMP_INDEX (x)];
+    }
+
+    return _pixman_gradient_walker_interpolate (walker, x);
+}
+
+/*
+ * Conical gradients approximate atan2() with the polynomial from
+ * Abramowitz & Stegun 4.4.49, whose error is below 1e-5 radians, or
+ * about a tenth of a pixman_fixed_t step of the gradient parameter.
+ * The coefficients are scaled so that the result is in turns.
+ *
+ * The SIMD fetchers evaluate this with the same single precision
+ * operations in the same order, so any change here must be made
+ * there too.
+ */
+#define CONICAL_ATAN_A1		((float)( 0.9998660 / 6.28318530717958648))
+#define CONICAL_ATAN_A3		((float)(-0.3302995 / 6.28318530717958648))
+#define CONICAL_ATAN_A5		((float)( 0.1801410 / 6.28318530717958648))
+#define CONICAL_ATAN_A7		((float)(-0.0851330 / 6.28318530717958648))
+#define CONICAL_ATAN_A9		((float)( 0.0208351 / 6.28318530717958648))
+
+/* Returns the gradient parameter in [0, 1] for the point (x, y) relative
+ * to the center, given the angle of the gradient in turns.
+ */
+static force_inline float
+_pixman_conical_gradient_approximate_parameter (float x, float y, float angle)
+{
+    float ax = x < 0 ? -x : x;
+    float ay = y < 0 ? -y : y;
+    float lo = ax < ay ? ax : ay;
+    float hi = ax < ay ? ay : ax;
+    float a, s, t;
+
+    /* FLT_MIN keeps the center from dividing 0 by 0 */
+    a = lo / (hi > FLT_MIN ? hi : FLT_MIN);
+    s = a * a;
+
+    t = ((((CONICAL_ATAN_A9 * s + CONICAL_ATAN_A7) * s +
+	   CONICAL_ATAN_A5) * s + CONICAL_ATAN_A3) * s + CONICAL_ATAN_A1) * a;
+
+    if (ay > ax)
+	t = 0.25f - t;
+    if (x < 0)
+	t = 0.5f - t;
+    if (y < 0)
+	t = -t;
+
+    t += angle;
+
+    if (t < 0)
+	t += 1.f;
+    if (t >= 1.f)
+	t -= 1.f;
+
+    /* make rotation CCW */
+    return 1.f - t;
+}
 
 /*
  * Edges
@@ -457,6 +716,25 @@ typedef pixman_bool_t (*pixman_fill_func_t) (pixman_implementation_t *imp,
 typedef pixman_bool_t (*pixman_iter_init_func_t) (pixman_implementation_t *imp,
 						  pixman_iter_t           *iter);
 
+/* A row of an a8 glyph and the row of 32 bpp destination pixels that it
+ * covers.
+ */
+typedef struct
+{
+    uint32_t *		dest;
+    const uint8_t *	mask;
+    int			width;
+} pixman_glyph_span_t;
+
+/* Composites the solid color src OVER the destination of each span,
+ * through its mask. The destination format is one of the 8888 formats,
+ * and src is in that format.
+ */
+typedef void (*pixman_glyph_spans_func_t) (pixman_implementation_t   *imp,
+					   uint32_t                   src,
+					   const pixman_glyph_span_t *spans,
+					   int                        n_spans);
+
 void _pixman_setup_combiner_functions_32 (pixman_implementation_t *imp);
 void _pixman_setup_combiner_functions_float (pixman_implementation_t *imp);
 
@@ -472,16 +750,21 @@ typedef struct
     pixman_composite_func_t func;
 } pixman_fast_path_t;
 
+typedef struct fast_path_index_t fast_path_index_t;
+
 struct pixman_implementation_t
 {
+    const char *		name;
     pixman_implementation_t *	toplevel;
     pixman_implementation_t *	fallback;
     const pixman_fast_path_t *	fast_paths;
+    fast_path_index_t *		fast_path_index;
 
     pixman_blt_func_t		blt;
     pixman_fill_func_t		fill;
     pixman_iter_init_func_t     src_iter_init;
     pixman_iter_init_func_t     dest_iter_init;
+    pixman_glyph_spans_func_t	glyph_spans;
 
     pixman_combine_32_func_t	combine_32[PIXMAN_N_OPERATORS];
     pixman_combine_32_func_t	combine_32_ca[PIXMAN_N_OPERATORS];
@@ -498,6 +781,9 @@ pixman_implementation_t *
 _pixman_implementation_create (pixman_implementation_t *fallback,
 			       const pixman_fast_path_t *fast_paths);
 
+void
+_pixman_implementation_build_fast_path_index (pixman_implementation_t *toplevel);
+
 void
 _pixman_implementation_lookup_composite (pixman_implementation_t  *toplevel,
 					 pixman_op_t               op,
@@ -566,6 +852,10 @@ _pixman_implementation_dest_iter_init (pixman_implementation_t       *imp,
 				       iter_flags_t                   flags,
 				       uint32_t                       image_flags);
 
+pixman_bool_t
+_pixman_bits_image_mipmap_iter_init (pixman_implementation_t *imp,
+				     pixman_iter_t           *iter);
+
 /* Specific implementations */
 pixman_implementation_t *
 _pixman_implementation_create_general (void);
@@ -586,6 +876,11 @@ pixman_implementation_t *
 _pixman_implementation_create_sse2 (pixman_implementation_t *fallback);
 #endif
 
+#ifdef USE_AVX2
+pixman_implementation_t *
+_pixman_implementation_create_avx2 (pixman_implementation_t *fallback);
+#endif
+
 #ifdef USE_ARM_SIMD
 pixman_implementation_t *
 _pixman_implementation_create_arm_simd (pixman_implementation_t *fallback);
@@ -627,6 +922,49 @@ _pixman_choose_implementation (void);
 pixman_bool_t
 _pixman_disabled (const char *name);
 
+/*
+ * Threads
+ */
+void
+_pixman_threads_init (void);
+
+pixman_bool_t
+_pixman_composite_parallel (pixman_implementation_t *imp,
+			    pixman_composite_func_t  func,
+			    pixman_composite_info_t *info,
+			    const pixman_box32_t    *boxes,
+			    int                      n_boxes,
+			    int32_t                  src_dx,
+			    int32_t                  src_dy,
+			    int32_t                  mask_dx,
+			    int32_t                  mask_dy);
+
+/*
+ * Composite statistics
+ */
+extern int _pixman_composite_stats_enabled;
+
+void
+_pixman_composite_stats_init (void);
+
+uint64_t
+_pixman_composite_stats_stamp (void);
+
+void
+_pixman_composite_stats_record (pixman_op_t              op,
+				pixman_format_code_t     src_format,
+				pixman_format_code_t     mask_format,
+				pixman_format_code_t     dest_format,
+				pixman_implementation_t *imp,
+				uint64_t                 n_pixels,
+				uint64_t                 n_cycles);
+
+void
+_pixman_composite_stats_lookup (pixman_op_t              op,
+				pixman_format_code_t     src_format,
+				pixman_format_code_t     mask_format,
+				pixman_format_code_t     dest_format,
+				pixman_implementation_t *imp);
 
 /*
  * Utilities
@@ -686,6 +1024,7 @@ _pixman_iter_get_scanline_noop (pixman_iter_t *iter, const uint32_t *mask);
 #define FAST_PATH_SAMPLES_COVER_CLIP_BILINEAR	(1 << 24)
 #define FAST_PATH_BITS_IMAGE			(1 << 25)
 #define FAST_PATH_SEPARABLE_CONVOLUTION_FILTER  (1 << 26)
+#define FAST_PATH_SOLID_ROWS			(1 << 27)
 
 #define FAST_PATH_PAD_REPEAT						\
     (FAST_PATH_NO_NONE_REPEAT		|				\
@@ -777,6 +1116,13 @@ pixman_malloc_ab (unsigned int n, unsigned int b);
 void *
 pixman_malloc_abc (unsigned int a, unsigned int b, unsigned int c);
 
+/* Scratch memory, from a per-thread cache */
+void *
+_pixman_scratch_alloc (size_t size);
+
+void
+_pixman_scratch_free (void *data);
+
 pixman_bool_t
 _pixman_multiply_overflows_size (size_t a, size_t b);
 
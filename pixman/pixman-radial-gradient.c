@@ -155,8 +155,123 @@ radial_compute_color (double                    a,
     return 0;
 }
 
-static uint32_t *
-radial_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
+static pixman_bool_t
+radial_gradient_map_point (pixman_image_t  *image,
+			   int              x,
+			   int              y,
+			   pixman_vector_t *v,
+			   pixman_vector_t *unit)
+{
+    /* reference point is the center of the pixel */
+    v->vector[0] = pixman_int_to_fixed (x) + pixman_fixed_1 / 2;
+    v->vector[1] = pixman_int_to_fixed (y) + pixman_fixed_1 / 2;
+    v->vector[2] = pixman_fixed_1;
+
+    if (image->common.transform)
+    {
+	if (!pixman_transform_point_3d (image->common.transform, v))
+	    return FALSE;
+
+	unit->vector[0] = image->common.transform->matrix[0][0];
+	unit->vector[1] = image->common.transform->matrix[1][0];
+	unit->vector[2] = image->common.transform->matrix[2][0];
+    }
+    else
+    {
+	unit->vector[0] = pixman_fixed_1;
+	unit->vector[1] = 0;
+	unit->vector[2] = 0;
+    }
+
+    return TRUE;
+}
+
+/*
+ * For affine transformations, computes B and C of the quadratic that
+ * radial_get_scanline_narrow() solves for the center of pixel (x, y),
+ * along with their differences from one pixel to the next:
+ *
+ *     B(n + 1) = B(n) + db
+ *     C(n + 1) = C(n) + dc(n)
+ *     dc(n + 1) = dc(n) + ddc
+ *
+ * Returns FALSE if the transformation is projective or can't be
+ * applied.
+ */
+pixman_bool_t
+_pixman_radial_gradient_get_affine_coefficients (pixman_image_t       *image,
+						 int                   x,
+						 int                   y,
+						 pixman_fixed_32_32_t *b,
+						 pixman_fixed_32_32_t *db,
+						 pixman_fixed_32_32_t *c,
+						 pixman_fixed_32_32_t *dc,
+						 pixman_fixed_32_32_t *ddc)
+{
+    radial_gradient_t *radial = (radial_gradient_t *)image;
+    pixman_vector_t v, unit;
+
+    if (!radial_gradient_map_point (image, x, y, &v, &unit))
+	return FALSE;
+
+    if (unit.vector[2] != 0 || v.vector[2] != pixman_fixed_1)
+	return FALSE;
+
+    /*
+     * Given:
+     *
+     * t = (B ± ⎷(B² - A·C)) / A
+     *
+     * where
+     *
+     * A = cdx² + cdy² - dr²
+     * B = pdx·cdx + pdy·cdy + r₁·dr
+     * C = pdx² + pdy² - r₁²
+     * det = B² - A·C
+     *
+     * Since we have an affine transformation, we know that (pdx, pdy)
+     * increase linearly with each pixel,
+     *
+     * pdx = pdx₀ + n·ux,
+     * pdy = pdy₀ + n·uy,
+     *
+     * we can then express B, C and det through multiple differentiation.
+     */
+
+    /* warning: this computation may overflow */
+    v.vector[0] -= radial->c1.x;
+    v.vector[1] -= radial->c1.y;
+
+    /*
+     * B and C are computed and updated exactly.
+     * If fdot was used instead of dot, in the worst case it would
+     * lose 11 bits of precision in each of the multiplication and
+     * summing up would zero out all the bit that were preserved,
+     * thus making the result 0 instead of the correct one.
+     * This would mean a worst case of unbound relative error or
+     * about 2^10 absolute error
+     */
+    *b = dot (v.vector[0], v.vector[1], radial->c1.radius,
+	      radial->delta.x, radial->delta.y, radial->delta.radius);
+    *db = dot (unit.vector[0], unit.vector[1], 0,
+	       radial->delta.x, radial->delta.y, 0);
+
+    *c = dot (v.vector[0], v.vector[1],
+	      -((pixman_fixed_48_16_t) radial->c1.radius),
+	      v.vector[0], v.vector[1], radial->c1.radius);
+    *dc = dot (2 * (pixman_fixed_48_16_t) v.vector[0] + unit.vector[0],
+	       2 * (pixman_fixed_48_16_t) v.vector[1] + unit.vector[1],
+	       0,
+	       unit.vector[0], unit.vector[1], 0);
+    *ddc = 2 * dot (unit.vector[0], unit.vector[1], 0,
+		    unit.vector[0], unit.vector[1], 0);
+
+    return TRUE;
+}
+
+uint32_t *
+_pixman_radial_gradient_get_scanline_narrow (pixman_iter_t  *iter,
+					     const uint32_t *mask)
 {
     /*
      * Implementation of radial gradients following the PDF specification.
@@ -250,82 +365,13 @@ radial_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
     uint32_t *end = buffer + width;
     pixman_gradient_walker_t walker;
     pixman_vector_t v, unit;
-
-    /* reference point is the center of the pixel */
-    v.vector[0] = pixman_int_to_fixed (x) + pixman_fixed_1 / 2;
-    v.vector[1] = pixman_int_to_fixed (y) + pixman_fixed_1 / 2;
-    v.vector[2] = pixman_fixed_1;
+    pixman_fixed_32_32_t b, db, c, dc, ddc;
 
     _pixman_gradient_walker_init (&walker, gradient, image->common.repeat);
 
-    if (image->common.transform)
-    {
-	if (!pixman_transform_point_3d (image->common.transform, &v))
-	    return iter->buffer;
-
-	unit.vector[0] = image->common.transform->matrix[0][0];
-	unit.vector[1] = image->common.transform->matrix[1][0];
-	unit.vector[2] = image->common.transform->matrix[2][0];
-    }
-    else
-    {
-	unit.vector[0] = pixman_fixed_1;
-	unit.vector[1] = 0;
-	unit.vector[2] = 0;
-    }
-
-    if (unit.vector[2] == 0 && v.vector[2] == pixman_fixed_1)
+    if (_pixman_radial_gradient_get_affine_coefficients (
+	    image, x, y, &b, &db, &c, &dc, &ddc))
     {
-	/*
-	 * Given:
-	 *
-	 * t = (B ± ⎷(B² - A·C)) / A
-	 *
-	 * where
-	 *
-	 * A = cdx² + cdy² - dr²
-	 * B = pdx·cdx + pdy·cdy + r₁·dr
-	 * C = pdx² + pdy² - r₁²
-	 * det = B² - A·C
-	 *
-	 * Since we have an affine transformation, we know that (pdx, pdy)
-	 * increase linearly with each pixel,
-	 *
-	 * pdx = pdx₀ + n·ux,
-	 * pdy = pdy₀ + n·uy,
-	 *
-	 * we can then express B, C and det through multiple differentiation.
-	 */
-	pixman_fixed_32_32_t b, db, c, dc, ddc;
-
-	/* warning: this computation may overflow */
-	v.vector[0] -= radial->c1.x;
-	v.vector[1] -= radial->c1.y;
-
-	/*
-	 * B and C are computed and updated exactly.
-	 * If fdot was used instead of dot, in the worst case it would
-	 * lose 11 bits of precision in each of the multiplication and
-	 * summing up would zero out all the bit that were preserved,
-	 * thus making the result 0 instead of the correct one.
-	 * This would mean a worst case of unbound relative error or
-	 * about 2^10 absolute error
-	 */
-	b = dot (v.vector[0], v.vector[1], radial->c1.radius,
-		 radial->delta.x, radial->delta.y, radial->delta.radius);
-	db = dot (unit.vector[0], unit.vector[1], 0,
-		  radial->delta.x, radial->delta.y, 0);
-
-	c = dot (v.vector[0], v.vector[1],
-		 -((pixman_fixed_48_16_t) radial->c1.radius),
-		 v.vector[0], v.vector[1], radial->c1.radius);
-	dc = dot (2 * (pixman_fixed_48_16_t) v.vector[0] + unit.vector[0],
-		  2 * (pixman_fixed_48_16_t) v.vector[1] + unit.vector[1],
-		  0,
-		  unit.vector[0], unit.vector[1], 0);
-	ddc = 2 * dot (unit.vector[0], unit.vector[1], 0,
-		       unit.vector[0], unit.vector[1], 0);
-
 	while (buffer < end)
 	{
 	    if (!mask || *mask++)
@@ -350,6 +396,9 @@ radial_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
 	/* Warning:
 	 * error propagation guarantees are much looser than in the affine case
 	 */
+	if (!radial_gradient_map_point (image, x, y, &v, &unit))
+	    return iter->buffer;
+
 	while (buffer < end)
 	{
 	    if (!mask || *mask++)
@@ -403,7 +452,7 @@ radial_get_scanline_narrow (pixman_iter_t *iter, const uint32_t *mask)
 static uint32_t *
 radial_get_scanline_wide (pixman_iter_t *iter, const uint32_t *mask)
 {
-    uint32_t *buffer = radial_get_scanline_narrow (iter, NULL);
+    uint32_t *buffer = _pixman_radial_gradient_get_scanline_narrow (iter, NULL);
 
     pixman_expand_to_float (
 	(argb_t *)buffer, buffer, PIXMAN_a8r8g8b8, iter->width);
@@ -415,7 +464,7 @@ void
 _pixman_radial_gradient_iter_init (pixman_image_t *image, pixman_iter_t *iter)
 {
     if (iter->iter_flags & ITER_NARROW)
-	iter->get_scanline = radial_get_scanline_narrow;
+	iter->get_scanline = _pixman_radial_gradient_get_scanline_narrow;
     else
 	iter->get_scanline = radial_get_scanline_wide;
 }
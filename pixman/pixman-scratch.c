@@ -0,0 +1,229 @@
+/*
+ * Copyright © 2026 The Pixman Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include "pixman-private.h"
+
+/*
+ * Scratch memory
+ *
+ * Temporary buffers that only live for the duration of a call, such as
+ * the masks that trapezoids and glyphs are rasterized into, are taken
+ * from a per-thread cache of blocks instead of the heap. Blocks come in
+ * power of two size classes, and a thread keeps at most
+ * SCRATCH_CACHE_LIMIT bytes of them around. Anything bigger than the
+ * largest size class goes straight to malloc() and free().
+ */
+
+#define SCRATCH_MIN_SHIFT	12	/* 4 KB */
+#define SCRATCH_N_CLASSES	11	/* Up to 4 MB */
+#define SCRATCH_CACHE_LIMIT	(8 * 1024 * 1024)
+
+typedef union scratch_header_t scratch_header_t;
+
+union scratch_header_t
+{
+    struct
+    {
+	scratch_header_t *	next;	/* When in the cache */
+	int			size_class;
+    } s;
+
+    /* Keep the memory handed out 16 byte aligned */
+    uint8_t			pad[16];
+};
+
+typedef struct
+{
+    scratch_header_t *		blocks[SCRATCH_N_CLASSES];
+    size_t			n_cached_bytes;
+} scratch_t;
+
+#define CLASS_SIZE(c)		((size_t)1 << ((c) + SCRATCH_MIN_SHIFT))
+
+static void
+release_blocks (scratch_t *scratch)
+{
+    int i;
+
+    for (i = 0; i < SCRATCH_N_CLASSES; ++i)
+    {
+	while (scratch->blocks[i])
+	{
+	    scratch_header_t *block = scratch->blocks[i];
+
+	    scratch->blocks[i] = block->s.next;
+	    free (block);
+	}
+    }
+
+    scratch->n_cached_bytes = 0;
+}
+
+#ifdef HAVE_PTHREADS
+
+/* With pthreads, the cache of a thread is released when it exits */
+
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t scratch_key;
+
+static void
+destroy_scratch (void *data)
+{
+    release_blocks (data);
+    free (data);
+}
+
+static void
+make_scratch_key (void)
+{
+    pthread_key_create (&scratch_key, destroy_scratch);
+}
+
+static scratch_t *
+get_scratch (void)
+{
+    scratch_t *scratch;
+
+    if (pthread_once (&scratch_once, make_scratch_key) != 0)
+	return NULL;
+
+    if (!(scratch = pthread_getspecific (scratch_key)))
+    {
+	if ((scratch = calloc (1, sizeof (scratch_t))) &&
+	    pthread_setspecific (scratch_key, scratch) != 0)
+	{
+	    free (scratch);
+	    scratch = NULL;
+	}
+    }
+
+    return scratch;
+}
+
+/* Like get_scratch(), but doesn't make a cache for threads that don't
+ * have one yet.
+ */
+static scratch_t *
+find_scratch (void)
+{
+    if (pthread_once (&scratch_once, make_scratch_key) != 0)
+	return NULL;
+
+    return pthread_getspecific (scratch_key);
+}
+
+#else
+
+PIXMAN_DEFINE_THREAD_LOCAL (scratch_t, scratch);
+
+static scratch_t *
+get_scratch (void)
+{
+    return PIXMAN_GET_THREAD_LOCAL (scratch);
+}
+
+static scratch_t *
+find_scratch (void)
+{
+    return PIXMAN_GET_THREAD_LOCAL (scratch);
+}
+
+#endif
+
+void *
+_pixman_scratch_alloc (size_t size)
+{
+    scratch_header_t *block;
+    scratch_t *scratch;
+    int c;
+
+    if (size > CLASS_SIZE (SCRATCH_N_CLASSES - 1) - sizeof (scratch_header_t))
+    {
+	if (size > SIZE_MAX - sizeof (scratch_header_t) ||
+	    !(block = malloc (size + sizeof (scratch_header_t))))
+	{
+	    return NULL;
+	}
+
+	block->s.size_class = -1;
+
+	return block + 1;
+    }
+
+    c = 0;
+    while (CLASS_SIZE (c) - sizeof (scratch_header_t) < size)
+	c++;
+
+    if ((scratch = get_scratch ()) && (block = scratch->blocks[c]))
+    {
+	scratch->blocks[c] = block->s.next;
+	scratch->n_cached_bytes -= CLASS_SIZE (c);
+    }
+    else if (!(block = malloc (CLASS_SIZE (c))))
+    {
+	return NULL;
+    }
+
+    block->s.size_class = c;
+
+    return block + 1;
+}
+
+void
+_pixman_scratch_free (void *data)
+{
+    scratch_header_t *block;
+    scratch_t *scratch;
+    int c;
+
+    if (!data)
+	return;
+
+    block = (scratch_header_t *)data - 1;
+    c = block->s.size_class;
+
+    if (c < 0								||
+	!(scratch = get_scratch ())					||
+	scratch->n_cached_bytes + CLASS_SIZE (c) > SCRATCH_CACHE_LIMIT)
+    {
+	free (block);
+	return;
+    }
+
+    block->s.next = scratch->blocks[c];
+    scratch->blocks[c] = block;
+    scratch->n_cached_bytes += CLASS_SIZE (c);
+}
+
+PIXMAN_EXPORT void
+pixman_release_scratch (void)
+{
+    scratch_t *scratch;
+
+    if ((scratch = find_scratch ()))
+	release_blocks (scratch);
+}
@@ -30,18 +30,29 @@
 #include <config.h>
 #endif
 
+#include <float.h>
+#include <math.h>
 #include <xmmintrin.h> /* for _mm_shuffle_pi16 and _MM_SHUFFLE */
 #include <emmintrin.h> /* for SSE2 intrinsics */
 #include "pixman-private.h"
 #include "pixman-combine32.h"
 #include "pixman-inlines.h"
 
+/* 32 bit x86 compilers tend to do the floating point math of the C code
+ * on the x87 unit, with more precision than SSE2 has, so code that has
+ * to give the same results as the C combiners is only used on x86-64.
+ */
+#if defined (__x86_64__) || defined (__amd64__) || defined (_M_AMD64)
+#define SSE2_FLOAT_MATCHES_C
+#endif
+
 static __m128i mask_0080;
 static __m128i mask_00ff;
 static __m128i mask_0101;
 static __m128i mask_ffff;
 static __m128i mask_ff000000;
 static __m128i mask_alpha;
+static __m128i mask_ffff_alpha;
 
 static __m128i mask_565_r;
 static __m128i mask_565_g1, mask_565_g2;
@@ -2365,243 +2376,1275 @@ sse2_combine_add_ca (pixman_implementation_t *imp,
     }
 }
 
+/*
+ * PDF separable blend modes
+ *
+ * These compute exactly what the C combiners in pixman-combine32.c do.
+ * The blend functions below rely on the colors being premultiplied,
+ * which keeps every intermediate result within 16 bits, so blocks of
+ * four pixels that aren't are handed to the C combiners instead, as are
+ * the pixels left over at the end of a scanline.
+ */
+
+static pixman_combine_32_func_t pdf_combine_u[PIXMAN_N_OPERATORS];
+static pixman_combine_32_func_t pdf_combine_ca[PIXMAN_N_OPERATORS];
+
+typedef __m128i (* pdf_blend_func_t) (__m128i d, __m128i da, __m128i s, __m128i sa);
+
 static force_inline __m128i
-create_mask_16_128 (uint16_t mask)
+div_one_un8_128 (__m128i x)
 {
-    return _mm_set1_epi16 (mask);
+    return _mm_mulhi_epu16 (_mm_add_epi16 (x, mask_0080), mask_0101);
 }
 
-/* Work around a code generation bug in Sun Studio 12. */
-#if defined(__SUNPRO_C) && (__SUNPRO_C >= 0x590)
-# define create_mask_2x32_128(mask0, mask1)				\
-    (_mm_set_epi32 ((mask0), (mask1), (mask0), (mask1)))
-#else
 static force_inline __m128i
-create_mask_2x32_128 (uint32_t mask0,
-                      uint32_t mask1)
+select_128 (__m128i mask, __m128i a, __m128i b)
 {
-    return _mm_set_epi32 (mask0, mask1, mask0, mask1);
+    return _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b));
 }
-#endif
 
-static void
-sse2_composite_over_n_8888 (pixman_implementation_t *imp,
-                            pixman_composite_info_t *info)
+static force_inline pixman_bool_t
+is_premultiplied_2x128 (__m128i lo, __m128i hi, __m128i alpha_lo, __m128i alpha_hi)
 {
-    PIXMAN_COMPOSITE_ARGS (info);
-    uint32_t src;
-    uint32_t    *dst_line, *dst, d;
-    int32_t w;
-    int dst_stride;
-    __m128i xmm_src, xmm_alpha;
-    __m128i xmm_dst, xmm_dst_lo, xmm_dst_hi;
-
-    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+    return _mm_movemask_epi8 (
+	_mm_or_si128 (_mm_cmpgt_epi16 (lo, alpha_lo),
+		      _mm_cmpgt_epi16 (hi, alpha_hi))) == 0;
+}
 
-    if (src == 0)
-	return;
+/* The C combiners add the blend result to the rest of the formula with
+ * a plain 32 bit addition, so a channel that overflows carries into the
+ * next one instead of saturating.
+ */
+static force_inline __m128i
+pdf_pack_2x128 (__m128i lo, __m128i hi)
+{
+    uint16_t c[16];
+    uint32_t p[4];
+    int i;
 
-    PIXMAN_IMAGE_GET_LINE (
-	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    if (!_mm_movemask_epi8 (_mm_or_si128 (_mm_cmpgt_epi16 (lo, mask_00ff),
+					  _mm_cmpgt_epi16 (hi, mask_00ff))))
+    {
+	return _mm_packus_epi16 (lo, hi);
+    }
 
-    xmm_src = expand_pixel_32_1x128 (src);
-    xmm_alpha = expand_alpha_1x128 (xmm_src);
+    _mm_storeu_si128 ((__m128i *)c, lo);
+    _mm_storeu_si128 ((__m128i *)(c + 8), hi);
 
-    while (height--)
+    for (i = 0; i < 4; ++i)
     {
-	dst = dst_line;
+	p[i] = c[4 * i] + (c[4 * i + 1] << 8) + (c[4 * i + 2] << 16) +
+	    ((uint32_t)c[4 * i + 3] << 24);
+    }
 
-	dst_line += dst_stride;
-	w = width;
+    return _mm_loadu_si128 ((__m128i *)p);
+}
 
-	while (w && (uintptr_t)dst & 15)
-	{
-	    d = *dst;
-	    *dst++ = pack_1x128_32 (over_1x128 (xmm_src,
-						xmm_alpha,
-						unpack_32_1x128 (d)));
-	    w--;
-	}
+/* Composites four pixels with the blend function, given the source and
+ * its per-channel alpha, which is the source alpha multiplied by the
+ * mask for component alpha. Returns FALSE without writing anything if
+ * the pixels are not premultiplied.
+ */
+static force_inline pixman_bool_t
+pdf_combine_4 (pdf_blend_func_t blend, uint32_t *pd, __m128i s_lo, __m128i s_hi,
+	       __m128i sa_lo, __m128i sa_hi)
+{
+    __m128i d_lo, d_hi, da_lo, da_hi;
+    __m128i r_lo, r_hi, b_lo, b_hi;
+    __m128i isa_lo, isa_hi, ida_lo, ida_hi;
 
-	while (w >= 4)
-	{
-	    xmm_dst = load_128_aligned ((__m128i*)dst);
+    unpack_128_2x128 (load_128_unaligned ((__m128i *)pd), &d_lo, &d_hi);
+    expand_alpha_2x128 (d_lo, d_hi, &da_lo, &da_hi);
 
-	    unpack_128_2x128 (xmm_dst, &xmm_dst_lo, &xmm_dst_hi);
+    if (!is_premultiplied_2x128 (s_lo, s_hi, sa_lo, sa_hi) ||
+	!is_premultiplied_2x128 (d_lo, d_hi, da_lo, da_hi))
+    {
+	return FALSE;
+    }
 
-	    over_2x128 (&xmm_src, &xmm_src,
-			&xmm_alpha, &xmm_alpha,
-			&xmm_dst_lo, &xmm_dst_hi);
+    negate_2x128 (sa_lo, sa_hi, &isa_lo, &isa_hi);
+    negate_2x128 (da_lo, da_hi, &ida_lo, &ida_hi);
 
-	    /* rebuid the 4 pixel data and save*/
-	    save_128_aligned (
-		(__m128i*)dst, pack_2x128_128 (xmm_dst_lo, xmm_dst_hi));
+    pix_add_multiply_2x128 (&d_lo, &d_hi, &isa_lo, &isa_hi,
+			    &s_lo, &s_hi, &ida_lo, &ida_hi,
+			    &r_lo, &r_hi);
 
-	    w -= 4;
-	    dst += 4;
-	}
+    b_lo = select_128 (mask_ffff_alpha,
+		       pix_multiply_1x128 (sa_lo, da_lo),
+		       blend (d_lo, da_lo, s_lo, sa_lo));
+    b_hi = select_128 (mask_ffff_alpha,
+		       pix_multiply_1x128 (sa_hi, da_hi),
+		       blend (d_hi, da_hi, s_hi, sa_hi));
 
-	while (w)
-	{
-	    d = *dst;
-	    *dst++ = pack_1x128_32 (over_1x128 (xmm_src,
-						xmm_alpha,
-						unpack_32_1x128 (d)));
-	    w--;
-	}
+    save_128_unaligned ((__m128i *)pd,
+			pdf_pack_2x128 (_mm_add_epi16 (r_lo, b_lo),
+					_mm_add_epi16 (r_hi, b_hi)));
 
-    }
+    return TRUE;
 }
 
-static void
-sse2_composite_over_n_0565 (pixman_implementation_t *imp,
-                            pixman_composite_info_t *info)
+static force_inline void
+pdf_combine_u_sse2 (pdf_blend_func_t         blend,
+		    pixman_implementation_t *imp,
+		    pixman_op_t              op,
+		    uint32_t *               pd,
+		    const uint32_t *         ps,
+		    const uint32_t *         pm,
+		    int                      w)
 {
-    PIXMAN_COMPOSITE_ARGS (info);
-    uint32_t src;
-    uint16_t    *dst_line, *dst, d;
-    int32_t w;
-    int dst_stride;
-    __m128i xmm_src, xmm_alpha;
-    __m128i xmm_dst, xmm_dst0, xmm_dst1, xmm_dst2, xmm_dst3;
+    __m128i s_lo, s_hi, sa_lo, sa_hi;
 
-    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+    while (w >= 4)
+    {
+	unpack_128_2x128 (combine4 ((__m128i *)ps, (__m128i *)pm), &s_lo, &s_hi);
+	expand_alpha_2x128 (s_lo, s_hi, &sa_lo, &sa_hi);
 
-    if (src == 0)
-	return;
+	if (!pdf_combine_4 (blend, pd, s_lo, s_hi, sa_lo, sa_hi))
+	    pdf_combine_u[op] (imp, op, pd, ps, pm, 4);
 
-    PIXMAN_IMAGE_GET_LINE (
-	dest_image, dest_x, dest_y, uint16_t, dst_stride, dst_line, 1);
+	pd += 4;
+	ps += 4;
+	if (pm)
+	    pm += 4;
+	w -= 4;
+    }
 
-    xmm_src = expand_pixel_32_1x128 (src);
-    xmm_alpha = expand_alpha_1x128 (xmm_src);
+    if (w)
+	pdf_combine_u[op] (imp, op, pd, ps, pm, w);
+}
 
-    while (height--)
+static force_inline void
+pdf_combine_ca_sse2 (pdf_blend_func_t         blend,
+		     pixman_implementation_t *imp,
+		     pixman_op_t              op,
+		     uint32_t *               pd,
+		     const uint32_t *         ps,
+		     const uint32_t *         pm,
+		     int                      w)
+{
+    __m128i s_lo, s_hi, m_lo, m_hi, sa_lo, sa_hi;
+
+    while (w >= 4)
     {
-	dst = dst_line;
+	unpack_128_2x128 (load_128_unaligned ((__m128i *)ps), &s_lo, &s_hi);
+	unpack_128_2x128 (load_128_unaligned ((__m128i *)pm), &m_lo, &m_hi);
+	expand_alpha_2x128 (s_lo, s_hi, &sa_lo, &sa_hi);
 
-	dst_line += dst_stride;
-	w = width;
+	pix_multiply_2x128 (&s_lo, &s_hi, &m_lo, &m_hi, &s_lo, &s_hi);
+	pix_multiply_2x128 (&m_lo, &m_hi, &sa_lo, &sa_hi, &m_lo, &m_hi);
 
-	while (w && (uintptr_t)dst & 15)
-	{
-	    d = *dst;
+	if (!pdf_combine_4 (blend, pd, s_lo, s_hi, m_lo, m_hi))
+	    pdf_combine_ca[op] (imp, op, pd, ps, pm, 4);
 
-	    *dst++ = pack_565_32_16 (
-		pack_1x128_32 (over_1x128 (xmm_src,
-					   xmm_alpha,
-					   expand565_16_1x128 (d))));
-	    w--;
-	}
+	pd += 4;
+	ps += 4;
+	pm += 4;
+	w -= 4;
+    }
 
-	while (w >= 8)
-	{
-	    xmm_dst = load_128_aligned ((__m128i*)dst);
+    if (w)
+	pdf_combine_ca[op] (imp, op, pd, ps, pm, w);
+}
 
-	    unpack_565_128_4x128 (xmm_dst,
-				  &xmm_dst0, &xmm_dst1, &xmm_dst2, &xmm_dst3);
+#define SSE2_PDF_SEPARABLE_BLEND_MODE(name)				\
+    static void								\
+    sse2_combine_ ## name ## _u (pixman_implementation_t *imp,		\
+				 pixman_op_t              op,		\
+				 uint32_t *               pd,		\
+				 const uint32_t *         ps,		\
+				 const uint32_t *         pm,		\
+				 int                      w)		\
+    {									\
+	pdf_combine_u_sse2 (blend_ ## name, imp, op, pd, ps, pm, w);	\
+    }									\
+									\
+    static void								\
+    sse2_combine_ ## name ## _ca (pixman_implementation_t *imp,	\
+				  pixman_op_t              op,		\
+				  uint32_t *               pd,		\
+				  const uint32_t *         ps,		\
+				  const uint32_t *         pm,		\
+				  int                      w)		\
+    {									\
+	pdf_combine_ca_sse2 (blend_ ## name, imp, op, pd, ps, pm, w);	\
+    }
 
-	    over_2x128 (&xmm_src, &xmm_src,
-			&xmm_alpha, &xmm_alpha,
-			&xmm_dst0, &xmm_dst1);
-	    over_2x128 (&xmm_src, &xmm_src,
-			&xmm_alpha, &xmm_alpha,
-			&xmm_dst2, &xmm_dst3);
+/*
+ * Multiply
+ *
+ * The C combiners use saturating arithmetic here, so this works on any
+ * pixels.
+ */
+static void
+sse2_combine_multiply_u (pixman_implementation_t *imp,
+			 pixman_op_t              op,
+			 uint32_t *               pd,
+			 const uint32_t *         ps,
+			 const uint32_t *         pm,
+			 int                      w)
+{
+    __m128i s_lo, s_hi, d_lo, d_hi;
+    __m128i isa_lo, isa_hi, ida_lo, ida_hi;
+    __m128i r_lo, r_hi;
 
-	    xmm_dst = pack_565_4x128_128 (
-		&xmm_dst0, &xmm_dst1, &xmm_dst2, &xmm_dst3);
+    while (w >= 4)
+    {
+	unpack_128_2x128 (combine4 ((__m128i *)ps, (__m128i *)pm), &s_lo, &s_hi);
+	unpack_128_2x128 (load_128_unaligned ((__m128i *)pd), &d_lo, &d_hi);
 
-	    save_128_aligned ((__m128i*)dst, xmm_dst);
+	expand_alpha_2x128 (s_lo, s_hi, &isa_lo, &isa_hi);
+	expand_alpha_2x128 (d_lo, d_hi, &ida_lo, &ida_hi);
+	negate_2x128 (isa_lo, isa_hi, &isa_lo, &isa_hi);
+	negate_2x128 (ida_lo, ida_hi, &ida_lo, &ida_hi);
 
-	    dst += 8;
-	    w -= 8;
-	}
+	pix_add_multiply_2x128 (&s_lo, &s_hi, &ida_lo, &ida_hi,
+				&d_lo, &d_hi, &isa_lo, &isa_hi,
+				&r_lo, &r_hi);
+	pix_multiply_2x128 (&d_lo, &d_hi, &s_lo, &s_hi, &d_lo, &d_hi);
 
-	while (w--)
-	{
-	    d = *dst;
-	    *dst++ = pack_565_32_16 (
-		pack_1x128_32 (over_1x128 (xmm_src, xmm_alpha,
-					   expand565_16_1x128 (d))));
-	}
+	save_128_unaligned ((__m128i *)pd, pack_2x128_128 (
+				_mm_adds_epu8 (r_lo, d_lo),
+				_mm_adds_epu8 (r_hi, d_hi)));
+
+	pd += 4;
+	ps += 4;
+	if (pm)
+	    pm += 4;
+	w -= 4;
     }
 
+    if (w)
+	pdf_combine_u[op] (imp, op, pd, ps, pm, w);
 }
 
 static void
-sse2_composite_add_n_8888_8888_ca (pixman_implementation_t *imp,
-				   pixman_composite_info_t *info)
+sse2_combine_multiply_ca (pixman_implementation_t *imp,
+			  pixman_op_t              op,
+			  uint32_t *               pd,
+			  const uint32_t *         ps,
+			  const uint32_t *         pm,
+			  int                      w)
 {
-    PIXMAN_COMPOSITE_ARGS (info);
-    uint32_t src;
-    uint32_t    *dst_line, d;
-    uint32_t    *mask_line, m;
-    uint32_t pack_cmp;
-    int dst_stride, mask_stride;
+    __m128i s_lo, s_hi, m_lo, m_hi, d_lo, d_hi;
+    __m128i sa_lo, sa_hi, ida_lo, ida_hi;
+    __m128i r_lo, r_hi;
 
-    __m128i xmm_src;
-    __m128i xmm_dst;
-    __m128i xmm_mask, xmm_mask_lo, xmm_mask_hi;
+    while (w >= 4)
+    {
+	unpack_128_2x128 (load_128_unaligned ((__m128i *)ps), &s_lo, &s_hi);
+	unpack_128_2x128 (load_128_unaligned ((__m128i *)pm), &m_lo, &m_hi);
+	unpack_128_2x128 (load_128_unaligned ((__m128i *)pd), &d_lo, &d_hi);
 
-    __m128i mmx_src, mmx_mask, mmx_dest;
+	expand_alpha_2x128 (s_lo, s_hi, &sa_lo, &sa_hi);
+	expand_alpha_2x128 (d_lo, d_hi, &ida_lo, &ida_hi);
+	negate_2x128 (ida_lo, ida_hi, &ida_lo, &ida_hi);
 
-    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+	pix_multiply_2x128 (&s_lo, &s_hi, &m_lo, &m_hi, &s_lo, &s_hi);
+	pix_multiply_2x128 (&m_lo, &m_hi, &sa_lo, &sa_hi, &m_lo, &m_hi);
+	negate_2x128 (m_lo, m_hi, &m_lo, &m_hi);
 
-    if (src == 0)
-	return;
+	pix_add_multiply_2x128 (&d_lo, &d_hi, &m_lo, &m_hi,
+				&s_lo, &s_hi, &ida_lo, &ida_hi,
+				&r_lo, &r_hi);
+	pix_multiply_2x128 (&d_lo, &d_hi, &s_lo, &s_hi, &d_lo, &d_hi);
 
-    PIXMAN_IMAGE_GET_LINE (
-	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
-    PIXMAN_IMAGE_GET_LINE (
-	mask_image, mask_x, mask_y, uint32_t, mask_stride, mask_line, 1);
+	save_128_unaligned ((__m128i *)pd, pack_2x128_128 (
+				_mm_adds_epu8 (r_lo, d_lo),
+				_mm_adds_epu8 (r_hi, d_hi)));
 
-    xmm_src = _mm_unpacklo_epi8 (
-	create_mask_2x32_128 (src, src), _mm_setzero_si128 ());
-    mmx_src   = xmm_src;
+	pd += 4;
+	ps += 4;
+	pm += 4;
+	w -= 4;
+    }
 
-    while (height--)
-    {
-	int w = width;
-	const uint32_t *pm = (uint32_t *)mask_line;
-	uint32_t *pd = (uint32_t *)dst_line;
+    if (w)
+	pdf_combine_ca[op] (imp, op, pd, ps, pm, w);
+}
 
-	dst_line += dst_stride;
-	mask_line += mask_stride;
+/*
+ * Screen
+ * B(Dca, ad, Sca, as) = Dca.sa + Sca.da - Dca.Sca
+ */
+static force_inline __m128i
+blend_screen (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    return div_one_un8_128 (
+	_mm_add_epi16 (_mm_mullo_epi16 (s, da),
+		       _mm_mullo_epi16 (d, _mm_sub_epi16 (sa, s))));
+}
 
-	while (w && (uintptr_t)pd & 15)
-	{
-	    m = *pm++;
+SSE2_PDF_SEPARABLE_BLEND_MODE (screen)
 
-	    if (m)
-	    {
-		d = *pd;
+/*
+ * Overlay, and hard light with the roles of the source and destination
+ * swapped in the test
+ * B(Dca, Da, Sca, Sa) =
+ *   if 2.Dca < Da
+ *     2.Sca.Dca
+ *   otherwise
+ *     Sa.Da - 2.(Da - Dca).(Sa - Sca)
+ */
+static force_inline __m128i
+blend_overlay_or_hard_light (__m128i test, __m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i a, b;
 
-		mmx_mask = unpack_32_1x128 (m);
-		mmx_dest = unpack_32_1x128 (d);
+    a = _mm_slli_epi16 (_mm_mullo_epi16 (s, d), 1);
+    b = _mm_sub_epi16 (
+	_mm_mullo_epi16 (sa, da),
+	_mm_slli_epi16 (_mm_mullo_epi16 (_mm_sub_epi16 (da, d),
+					 _mm_sub_epi16 (sa, s)), 1));
 
-		*pd = pack_1x128_32 (
-		    _mm_adds_epu8 (pix_multiply_1x128 (mmx_mask, mmx_src),
-				   mmx_dest));
-	    }
+    return div_one_un8_128 (select_128 (test, a, b));
+}
 
-	    pd++;
-	    w--;
-	}
+static force_inline __m128i
+blend_overlay (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    return blend_overlay_or_hard_light (
+	_mm_cmplt_epi16 (_mm_slli_epi16 (d, 1), da), d, da, s, sa);
+}
 
-	while (w >= 4)
-	{
-	    xmm_mask = load_128_unaligned ((__m128i*)pm);
+SSE2_PDF_SEPARABLE_BLEND_MODE (overlay)
 
-	    pack_cmp =
-		_mm_movemask_epi8 (
-		    _mm_cmpeq_epi32 (xmm_mask, _mm_setzero_si128 ()));
+/*
+ * Darken
+ * B(Dca, Da, Sca, Sa) = min (Sca.Da, Dca.Sa)
+ */
+static force_inline __m128i
+blend_darken (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i sda = _mm_mullo_epi16 (s, da);
+    __m128i dsa = _mm_mullo_epi16 (d, sa);
 
-	    /* if all bits in mask are zero, pack_cmp are equal to 0xffff */
-	    if (pack_cmp != 0xffff)
-	    {
-		xmm_dst = load_128_aligned ((__m128i*)pd);
+    return div_one_un8_128 (_mm_sub_epi16 (sda, _mm_subs_epu16 (sda, dsa)));
+}
 
-		unpack_128_2x128 (xmm_mask, &xmm_mask_lo, &xmm_mask_hi);
+SSE2_PDF_SEPARABLE_BLEND_MODE (darken)
+
+/*
+ * Lighten
+ * B(Dca, Da, Sca, Sa) = max (Sca.Da, Dca.Sa)
+ */
+static force_inline __m128i
+blend_lighten (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i sda = _mm_mullo_epi16 (s, da);
+    __m128i dsa = _mm_mullo_epi16 (d, sa);
+
+    return div_one_un8_128 (_mm_add_epi16 (sda, _mm_subs_epu16 (dsa, sda)));
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (lighten)
+
+/* Computes MIN (trunc (n / d), limit) for all lanes, where d is not 0.
+ * Single precision is enough for the quotient of a 16 bit and an 8 bit
+ * number to truncate to the right integer.
+ */
+static force_inline __m128i
+div_min_128 (__m128i n, __m128i d, __m128i limit)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128 lo, hi;
+
+    lo = _mm_div_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (n, zero)),
+		     _mm_cvtepi32_ps (_mm_unpacklo_epi16 (d, zero)));
+    hi = _mm_div_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (n, zero)),
+		     _mm_cvtepi32_ps (_mm_unpackhi_epi16 (d, zero)));
+
+    lo = _mm_min_ps (lo, _mm_cvtepi32_ps (_mm_unpacklo_epi16 (limit, zero)));
+    hi = _mm_min_ps (hi, _mm_cvtepi32_ps (_mm_unpackhi_epi16 (limit, zero)));
+
+    return _mm_packs_epi32 (_mm_cvttps_epi32 (lo), _mm_cvttps_epi32 (hi));
+}
+
+/*
+ * Color dodge
+ * B(Dca, Da, Sca, Sa) =
+ *   if Dca == 0
+ *     0
+ *   if Sca == Sa
+ *     Sa.Da
+ *   otherwise
+ *     Sa.Da. min (1, Dca / Da / (1 - Sca/Sa))
+ */
+static force_inline __m128i
+blend_color_dodge (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i opaque = _mm_cmpeq_epi16 (s, sa);
+    __m128i den = select_128 (opaque, mask_0101, _mm_sub_epi16 (sa, s));
+    __m128i rca = div_min_128 (_mm_mullo_epi16 (d, sa), den, da);
+
+    rca = select_128 (opaque,
+		      _mm_andnot_si128 (_mm_cmpeq_epi16 (d, _mm_setzero_si128 ()), da),
+		      rca);
+
+    return div_one_un8_128 (_mm_mullo_epi16 (sa, rca));
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (color_dodge)
+
+/*
+ * Color burn
+ * B(Dca, Da, Sca, Sa) =
+ *   if Dca == Da
+ *     Sa.Da
+ *   if Sca == 0
+ *     0
+ *   otherwise
+ *     Sa.Da.(1 - min (1, (1 - Dca/Da).Sa / Sca))
+ */
+static force_inline __m128i
+blend_color_burn (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i zero = _mm_cmpeq_epi16 (s, _mm_setzero_si128 ());
+    __m128i den = select_128 (zero, mask_0101, s);
+    __m128i rca = div_min_128 (_mm_mullo_epi16 (_mm_sub_epi16 (da, d), sa), den, da);
+
+    rca = select_128 (zero, _mm_andnot_si128 (_mm_cmpeq_epi16 (d, da), da), rca);
+
+    return div_one_un8_128 (_mm_mullo_epi16 (sa, _mm_sub_epi16 (da, rca)));
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (color_burn)
+
+/*
+ * Hard light
+ * B(Dca, Da, Sca, Sa) =
+ *   if 2.Sca < Sa
+ *     2.Sca.Dca
+ *   otherwise
+ *     Sa.Da - 2.(Da - Dca).(Sa - Sca)
+ */
+static force_inline __m128i
+blend_hard_light (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    return blend_overlay_or_hard_light (
+	_mm_cmplt_epi16 (_mm_slli_epi16 (s, 1), sa), d, da, s, sa);
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (hard_light)
+
+#ifdef SSE2_FLOAT_MATCHES_C
+
+static force_inline __m128d
+blend_soft_light_pd (__m128d dca, __m128d da, __m128d sca, __m128d sa)
+{
+    __m128d zero = _mm_setzero_pd ();
+    __m128d two = _mm_set1_pd (2.0);
+    __m128d sca2 = _mm_mul_pd (two, sca);
+    __m128d dasafe, dcasa, r1, r2, r3, t;
+
+    /* Avoid dividing by zero in lanes that don't use the result */
+    dasafe = _mm_or_pd (_mm_and_pd (_mm_cmpeq_pd (da, zero), _mm_set1_pd (1.0)),
+			_mm_andnot_pd (_mm_cmpeq_pd (da, zero), da));
+    dcasa = _mm_mul_pd (dca, sa);
+
+    /* dca * sa - dca * (da - dca) * (sa - 2 * sca) / da */
+    r1 = _mm_sub_pd (dcasa,
+		     _mm_div_pd (_mm_mul_pd (_mm_mul_pd (dca, _mm_sub_pd (da, dca)),
+					     _mm_sub_pd (sa, sca2)),
+				 dasafe));
+    r1 = _mm_or_pd (_mm_and_pd (_mm_cmpeq_pd (da, zero), dcasa),
+		    _mm_andnot_pd (_mm_cmpeq_pd (da, zero), r1));
+
+    /* dca * sa + (2 * sca - sa) * dca * ((16 * dca / da - 12) * dca / da + 3) */
+    t = _mm_div_pd (_mm_mul_pd (_mm_set1_pd (16.0), dca), dasafe);
+    t = _mm_div_pd (_mm_mul_pd (_mm_sub_pd (t, _mm_set1_pd (12.0)), dca), dasafe);
+    t = _mm_add_pd (t, _mm_set1_pd (3.0));
+    r2 = _mm_add_pd (dcasa,
+		     _mm_mul_pd (_mm_mul_pd (_mm_sub_pd (sca2, sa), dca), t));
+
+    /* dca * sa + (sqrt (dca * da) - dca) * (2 * sca - sa) */
+    r3 = _mm_add_pd (dcasa,
+		     _mm_mul_pd (_mm_sub_pd (_mm_sqrt_pd (_mm_mul_pd (dca, da)), dca),
+				 _mm_sub_pd (sca2, sa)));
+
+    t = _mm_cmple_pd (_mm_mul_pd (_mm_set1_pd (4.0), dca), da);
+    r2 = _mm_or_pd (_mm_and_pd (t, r2), _mm_andnot_pd (t, r3));
+    r2 = _mm_andnot_pd (_mm_cmpeq_pd (da, zero), r2);
+
+    t = _mm_cmplt_pd (sca2, sa);
+    return _mm_or_pd (_mm_and_pd (t, r1), _mm_andnot_pd (t, r2));
+}
+
+/* Converts two 32 bit integers to doubles scaled to [0, 1] */
+static force_inline __m128d
+unpack_unorm_pd (__m128i v)
+{
+    return _mm_mul_pd (_mm_cvtepi32_pd (v), _mm_set1_pd (1.0 / MASK));
+}
+
+static force_inline __m128i
+soft_light_2x32 (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128d r = blend_soft_light_pd (unpack_unorm_pd (d), unpack_unorm_pd (da),
+				     unpack_unorm_pd (s), unpack_unorm_pd (sa));
+
+    return _mm_cvttpd_epi32 (_mm_add_pd (_mm_mul_pd (r, _mm_set1_pd (MASK)),
+					 _mm_set1_pd (0.5)));
+}
+
+/*
+ * Soft light
+ * B(Dca, Da, Sca, Sa) =
+ *   if (2.Sca <= Sa)
+ *     Dca.(Sa - (1 - Dca/Da).(2.Sca - Sa))
+ *   otherwise if Dca.4 <= Da
+ *     Dca.(Sa + (2.Sca - Sa).((16.Dca/Da - 12).Dca/Da + 3)
+ *   otherwise
+ *     (Dca.Sa + (SQRT (Dca/Da).Da - Dca).(2.Sca - Sa))
+ */
+static force_inline __m128i
+blend_soft_light (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i d32, da32, s32, sa32, r0, r1, r2, r3;
+
+    d32 = _mm_unpacklo_epi16 (d, zero);
+    da32 = _mm_unpacklo_epi16 (da, zero);
+    s32 = _mm_unpacklo_epi16 (s, zero);
+    sa32 = _mm_unpacklo_epi16 (sa, zero);
+
+    r0 = soft_light_2x32 (d32, da32, s32, sa32);
+    r1 = soft_light_2x32 (_mm_srli_si128 (d32, 8), _mm_srli_si128 (da32, 8),
+			  _mm_srli_si128 (s32, 8), _mm_srli_si128 (sa32, 8));
+
+    d32 = _mm_unpackhi_epi16 (d, zero);
+    da32 = _mm_unpackhi_epi16 (da, zero);
+    s32 = _mm_unpackhi_epi16 (s, zero);
+    sa32 = _mm_unpackhi_epi16 (sa, zero);
+
+    r2 = soft_light_2x32 (d32, da32, s32, sa32);
+    r3 = soft_light_2x32 (_mm_srli_si128 (d32, 8), _mm_srli_si128 (da32, 8),
+			  _mm_srli_si128 (s32, 8), _mm_srli_si128 (sa32, 8));
+
+    return _mm_packs_epi32 (_mm_unpacklo_epi64 (r0, r1),
+			    _mm_unpacklo_epi64 (r2, r3));
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (soft_light)
+
+#endif
+
+/*
+ * Difference
+ * B(Dca, Da, Sca, Sa) = abs (Dca.Sa - Sca.Da)
+ */
+static force_inline __m128i
+blend_difference (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    __m128i dsa = _mm_mullo_epi16 (d, sa);
+    __m128i sda = _mm_mullo_epi16 (s, da);
+
+    return div_one_un8_128 (_mm_or_si128 (_mm_subs_epu16 (dsa, sda),
+					  _mm_subs_epu16 (sda, dsa)));
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (difference)
+
+/*
+ * Exclusion
+ * B(Dca, Da, Sca, Sa) = (Sca.Da + Dca.Sa - 2.Sca.Dca)
+ */
+static force_inline __m128i
+blend_exclusion (__m128i d, __m128i da, __m128i s, __m128i sa)
+{
+    return div_one_un8_128 (
+	_mm_add_epi16 (_mm_mullo_epi16 (s, _mm_sub_epi16 (da, d)),
+		       _mm_mullo_epi16 (d, _mm_sub_epi16 (sa, s))));
+}
+
+SSE2_PDF_SEPARABLE_BLEND_MODE (exclusion)
+
+#undef SSE2_PDF_SEPARABLE_BLEND_MODE
+
+#ifdef SSE2_FLOAT_MATCHES_C
+
+/*
+ * Float combiners
+ *
+ * Each pixel is stored as four floats, a, r, g, b, so it fits in one
+ * register, and the alpha channel of the source and destination is
+ * broadcast to all lanes. Everything is computed with the same
+ * operations in the same order as in pixman-combine-float.c, so the
+ * results are identical to the C combiners. The non-separable PDF blend
+ * modes are left to those.
+ */
+
+typedef __m128 (* combine_float_channel_t) (__m128 sa, __m128 s, __m128 da, __m128 d);
+
+static force_inline __m128
+expand_alpha_ps (__m128 x)
+{
+    return _mm_shuffle_ps (x, x, _MM_SHUFFLE (0, 0, 0, 0));
+}
+
+static force_inline __m128
+cmplt_ps (__m128 a, __m128 b)
+{
+    return _mm_cmplt_ps (a, b);
+}
+
+static force_inline __m128
+cmple_ps (__m128 a, __m128 b)
+{
+    return _mm_cmple_ps (a, b);
+}
+
+static force_inline __m128
+select_ps (__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+}
+
+/* The lane that holds the alpha channel */
+static force_inline __m128
+alpha_lane_ps (void)
+{
+    return _mm_castsi128_ps (_mm_set_epi32 (0, 0, 0, -1));
+}
+
+static force_inline void
+combine_float_inner (pixman_bool_t component,
+		     float *dest, const float *src, const float *mask, int n_pixels,
+		     combine_float_channel_t combine)
+{
+    int i;
+
+    for (i = 0; i < 4 * n_pixels; i += 4)
+    {
+	__m128 s = _mm_loadu_ps (src + i);
+	__m128 d = _mm_loadu_ps (dest + i);
+	__m128 sa;
+
+	if (!mask)
+	{
+	    sa = expand_alpha_ps (s);
+	}
+	else if (component)
+	{
+	    __m128 m = _mm_loadu_ps (mask + i);
+
+	    sa = _mm_mul_ps (m, expand_alpha_ps (s));
+	    s = _mm_mul_ps (s, m);
+	}
+	else
+	{
+	    s = _mm_mul_ps (s, expand_alpha_ps (_mm_loadu_ps (mask + i)));
+	    sa = expand_alpha_ps (s);
+	}
+
+	_mm_storeu_ps (dest + i, combine (sa, s, expand_alpha_ps (d), d));
+    }
+}
+
+#define MAKE_FLOAT_COMBINER(name, component, combine)			\
+    static void								\
+    sse2_combine_ ## name ## _float (pixman_implementation_t *imp,	\
+				     pixman_op_t              op,	\
+				     float                   *dest,	\
+				     const float             *src,	\
+				     const float             *mask,	\
+				     int                      n_pixels)	\
+    {									\
+	combine_float_inner (component, dest, src, mask, n_pixels,	\
+			     combine);					\
+    }
+
+#define MAKE_FLOAT_COMBINERS(name, combine)				\
+    MAKE_FLOAT_COMBINER (name ## _ca, TRUE, combine)			\
+    MAKE_FLOAT_COMBINER (name ## _u, FALSE, combine)
+
+/*
+ * Porter/Duff operators
+ */
+typedef enum
+{
+    ZERO,
+    ONE,
+    SRC_ALPHA,
+    DEST_ALPHA,
+    INV_SA,
+    INV_DA,
+    SA_OVER_DA,
+    DA_OVER_SA,
+    INV_SA_OVER_DA,
+    INV_DA_OVER_SA,
+    ONE_MINUS_SA_OVER_DA,
+    ONE_MINUS_DA_OVER_SA,
+    ONE_MINUS_INV_DA_OVER_SA,
+    ONE_MINUS_INV_SA_OVER_DA
+} combine_factor_t;
+
+/* FLOAT_IS_ZERO () for all lanes */
+static force_inline __m128
+is_zero_ps (__m128 f)
+{
+    return _mm_and_ps (cmplt_ps (_mm_set1_ps (-FLT_MIN), f),
+		       cmplt_ps (f, _mm_set1_ps (FLT_MIN)));
+}
+
+static force_inline __m128
+clamp_ps (__m128 f)
+{
+    return _mm_min_ps (_mm_set1_ps (1.0f), _mm_max_ps (_mm_setzero_ps (), f));
+}
+
+/* Computes n / d, or if d is zero, which is passed in as a mask, z */
+static force_inline __m128
+div_or_ps (__m128 n, __m128 d, __m128 zero, __m128 z)
+{
+    return select_ps (zero, z, _mm_div_ps (n, select_ps (zero, _mm_set1_ps (1.0f), d)));
+}
+
+static force_inline __m128
+get_factor_ps (combine_factor_t factor, __m128 sa, __m128 da)
+{
+    __m128 one = _mm_set1_ps (1.0f);
+    __m128 zero = _mm_setzero_ps ();
+    __m128 sa_zero = is_zero_ps (sa);
+    __m128 da_zero = is_zero_ps (da);
+    __m128 f = _mm_set1_ps (-1.0f);
+
+    switch (factor)
+    {
+    case ZERO:
+	f = zero;
+	break;
+
+    case ONE:
+	f = one;
+	break;
+
+    case SRC_ALPHA:
+	f = sa;
+	break;
+
+    case DEST_ALPHA:
+	f = da;
+	break;
+
+    case INV_SA:
+	f = _mm_sub_ps (one, sa);
+	break;
+
+    case INV_DA:
+	f = _mm_sub_ps (one, da);
+	break;
+
+    case SA_OVER_DA:
+	f = div_or_ps (sa, da, da_zero, one);
+	f = select_ps (da_zero, one, clamp_ps (f));
+	break;
+
+    case DA_OVER_SA:
+	f = div_or_ps (da, sa, sa_zero, one);
+	f = select_ps (sa_zero, one, clamp_ps (f));
+	break;
+
+    case INV_SA_OVER_DA:
+	f = div_or_ps (_mm_sub_ps (one, sa), da, da_zero, one);
+	f = select_ps (da_zero, one, clamp_ps (f));
+	break;
+
+    case INV_DA_OVER_SA:
+	f = div_or_ps (_mm_sub_ps (one, da), sa, sa_zero, one);
+	f = select_ps (sa_zero, one, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_SA_OVER_DA:
+	f = _mm_sub_ps (one, div_or_ps (sa, da, da_zero, one));
+	f = select_ps (da_zero, zero, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_DA_OVER_SA:
+	f = _mm_sub_ps (one, div_or_ps (da, sa, sa_zero, one));
+	f = select_ps (sa_zero, zero, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_INV_DA_OVER_SA:
+	f = _mm_sub_ps (one, div_or_ps (_mm_sub_ps (one, da), sa, sa_zero, one));
+	f = select_ps (sa_zero, zero, clamp_ps (f));
+	break;
+
+    case ONE_MINUS_INV_SA_OVER_DA:
+	f = _mm_sub_ps (one, div_or_ps (_mm_sub_ps (one, sa), da, da_zero, one));
+	f = select_ps (da_zero, zero, clamp_ps (f));
+	break;
+    }
+
+    return f;
+}
+
+#define MAKE_PD_COMBINERS(name, a, b)					\
+    static force_inline __m128						\
+    pd_combine_ ## name (__m128 sa, __m128 s, __m128 da, __m128 d)	\
+    {									\
+	const __m128 fa = get_factor_ps (a, sa, da);			\
+	const __m128 fb = get_factor_ps (b, sa, da);			\
+									\
+	return _mm_min_ps (_mm_set1_ps (1.0f),				\
+			   _mm_add_ps (_mm_mul_ps (s, fa),		\
+				       _mm_mul_ps (d, fb)));		\
+    }									\
+									\
+    MAKE_FLOAT_COMBINERS (name, pd_combine_ ## name)
+
+MAKE_PD_COMBINERS (clear,			ZERO,				ZERO)
+MAKE_PD_COMBINERS (src,				ONE,				ZERO)
+MAKE_PD_COMBINERS (dst,				ZERO,				ONE)
+MAKE_PD_COMBINERS (over,			ONE,				INV_SA)
+MAKE_PD_COMBINERS (over_reverse,		INV_DA,				ONE)
+MAKE_PD_COMBINERS (in,				DEST_ALPHA,			ZERO)
+MAKE_PD_COMBINERS (in_reverse,			ZERO,				SRC_ALPHA)
+MAKE_PD_COMBINERS (out,				INV_DA,				ZERO)
+MAKE_PD_COMBINERS (out_reverse,			ZERO,				INV_SA)
+MAKE_PD_COMBINERS (atop,			DEST_ALPHA,			INV_SA)
+MAKE_PD_COMBINERS (atop_reverse,		INV_DA,				SRC_ALPHA)
+MAKE_PD_COMBINERS (xor,				INV_DA,				INV_SA)
+MAKE_PD_COMBINERS (add,				ONE,				ONE)
+
+MAKE_PD_COMBINERS (saturate,			INV_DA_OVER_SA,			ONE)
+
+MAKE_PD_COMBINERS (disjoint_clear,		ZERO,				ZERO)
+MAKE_PD_COMBINERS (disjoint_src,		ONE,				ZERO)
+MAKE_PD_COMBINERS (disjoint_dst,		ZERO,				ONE)
+MAKE_PD_COMBINERS (disjoint_over,		ONE,				INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_over_reverse,	INV_DA_OVER_SA,			ONE)
+MAKE_PD_COMBINERS (disjoint_in,			ONE_MINUS_INV_DA_OVER_SA,	ZERO)
+MAKE_PD_COMBINERS (disjoint_in_reverse,		ZERO,				ONE_MINUS_INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_out,		INV_DA_OVER_SA,			ZERO)
+MAKE_PD_COMBINERS (disjoint_out_reverse,	ZERO,				INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_atop,		ONE_MINUS_INV_DA_OVER_SA,	INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_atop_reverse,	INV_DA_OVER_SA,			ONE_MINUS_INV_SA_OVER_DA)
+MAKE_PD_COMBINERS (disjoint_xor,		INV_DA_OVER_SA,			INV_SA_OVER_DA)
+
+MAKE_PD_COMBINERS (conjoint_clear,		ZERO,				ZERO)
+MAKE_PD_COMBINERS (conjoint_src,		ONE,				ZERO)
+MAKE_PD_COMBINERS (conjoint_dst,		ZERO,				ONE)
+MAKE_PD_COMBINERS (conjoint_over,		ONE,				ONE_MINUS_SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_over_reverse,	ONE_MINUS_DA_OVER_SA,		ONE)
+MAKE_PD_COMBINERS (conjoint_in,			DA_OVER_SA,			ZERO)
+MAKE_PD_COMBINERS (conjoint_in_reverse,		ZERO,				SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_out,		ONE_MINUS_DA_OVER_SA,		ZERO)
+MAKE_PD_COMBINERS (conjoint_out_reverse,	ZERO,				ONE_MINUS_SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_atop,		DA_OVER_SA,			ONE_MINUS_SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_atop_reverse,	ONE_MINUS_DA_OVER_SA,		SA_OVER_DA)
+MAKE_PD_COMBINERS (conjoint_xor,		ONE_MINUS_DA_OVER_SA,		ONE_MINUS_SA_OVER_DA)
+
+/*
+ * PDF separable blend modes
+ */
+#define MAKE_SEPARABLE_PDF_COMBINERS(name)				\
+    static force_inline __m128						\
+    combine_ ## name (__m128 sa, __m128 s, __m128 da, __m128 d)	\
+    {									\
+	__m128 one = _mm_set1_ps (1.0f);				\
+	__m128 a, c;							\
+									\
+	a = _mm_sub_ps (_mm_add_ps (da, sa), _mm_mul_ps (da, sa));	\
+	c = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (one, sa), d),		\
+			_mm_mul_ps (_mm_sub_ps (one, da), s));		\
+	c = _mm_add_ps (c, blend_ ## name ## _ps (sa, s, da, d));	\
+									\
+	return select_ps (alpha_lane_ps (), a, c);			\
+    }									\
+									\
+    MAKE_FLOAT_COMBINERS (name, combine_ ## name)
+
+static force_inline __m128
+blend_multiply_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    return _mm_mul_ps (d, s);
+}
+
+static force_inline __m128
+blend_screen_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    return _mm_sub_ps (_mm_add_ps (_mm_mul_ps (d, sa), _mm_mul_ps (s, da)),
+		       _mm_mul_ps (s, d));
+}
+
+/* sa * da - 2 * (da - d) * (sa - s) */
+static force_inline __m128
+blend_hard_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    return _mm_sub_ps (_mm_mul_ps (sa, da),
+		       _mm_mul_ps (_mm_mul_ps (_mm_set1_ps (2.0f), _mm_sub_ps (da, d)),
+				   _mm_sub_ps (sa, s)));
+}
+
+static force_inline __m128
+blend_overlay_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    __m128 two = _mm_set1_ps (2.0f);
+
+    return select_ps (cmplt_ps (_mm_mul_ps (two, d), da),
+		      _mm_mul_ps (_mm_mul_ps (two, s), d),
+		      blend_hard_ps (sa, s, da, d));
+}
+
+static force_inline __m128
+blend_darken_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    s = _mm_mul_ps (s, da);
+    d = _mm_mul_ps (d, sa);
+
+    return select_ps (cmplt_ps (d, s), d, s);
+}
+
+static force_inline __m128
+blend_lighten_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    s = _mm_mul_ps (s, da);
+    d = _mm_mul_ps (d, sa);
+
+    return select_ps (cmplt_ps (d, s), s, d);
+}
+
+static force_inline __m128
+blend_color_dodge_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    __m128 sada = _mm_mul_ps (sa, da);
+    __m128 r;
+
+    r = div_or_ps (_mm_mul_ps (_mm_mul_ps (sa, sa), d), _mm_sub_ps (sa, s),
+		   is_zero_ps (_mm_sub_ps (sa, s)), sada);
+    r = select_ps (cmple_ps (_mm_sub_ps (sada, _mm_mul_ps (s, da)), _mm_mul_ps (d, sa)),
+		   sada, r);
+
+    return _mm_andnot_ps (is_zero_ps (d), r);
+}
+
+static force_inline __m128
+blend_color_burn_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    __m128 zero = _mm_setzero_ps ();
+    __m128 t = _mm_mul_ps (sa, _mm_sub_ps (da, d));
+    __m128 r;
+
+    r = _mm_mul_ps (sa, _mm_sub_ps (da, div_or_ps (t, s, is_zero_ps (s), zero)));
+    r = select_ps (_mm_or_ps (cmple_ps (_mm_mul_ps (s, da), t), is_zero_ps (s)),
+		   zero, r);
+
+    return select_ps (cmple_ps (da, d), _mm_mul_ps (sa, da), r);
+}
+
+static force_inline __m128
+blend_hard_light_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    __m128 two = _mm_set1_ps (2.0f);
+
+    return select_ps (cmplt_ps (_mm_mul_ps (two, s), sa),
+		      _mm_mul_ps (_mm_mul_ps (two, s), d),
+		      blend_hard_ps (sa, s, da, d));
+}
+
+static force_inline __m128
+blend_soft_light_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    __m128 two = _mm_set1_ps (2.0f);
+    __m128 zero = _mm_setzero_ps ();
+    __m128 da_zero = is_zero_ps (da);
+    __m128 dsa = _mm_mul_ps (d, sa);
+    __m128 s2 = _mm_mul_ps (two, s);
+    __m128 r1, r2, r3, t;
+
+    /* d * sa - d * (da - d) * (sa - 2 * s) / da */
+    t = _mm_mul_ps (_mm_mul_ps (d, _mm_sub_ps (da, d)), _mm_sub_ps (sa, s2));
+    r1 = select_ps (da_zero, dsa, _mm_sub_ps (dsa, div_or_ps (t, da, da_zero, zero)));
+
+    /* d * sa + (2 * s - sa) * d * ((16 * d / da - 12) * d / da + 3) */
+    t = div_or_ps (_mm_mul_ps (_mm_set1_ps (16.0f), d), da, da_zero, zero);
+    t = div_or_ps (_mm_mul_ps (_mm_sub_ps (t, _mm_set1_ps (12.0f)), d), da, da_zero, zero);
+    t = _mm_add_ps (t, _mm_set1_ps (3.0f));
+    r2 = _mm_add_ps (dsa, _mm_mul_ps (_mm_mul_ps (_mm_sub_ps (s2, sa), d), t));
+
+    /* d * sa + (sqrtf (d * da) - d) * (2 * s - sa) */
+    r3 = _mm_add_ps (dsa, _mm_mul_ps (_mm_sub_ps (_mm_sqrt_ps (_mm_mul_ps (d, da)), d),
+				      _mm_sub_ps (s2, sa)));
+
+    r2 = select_ps (cmple_ps (_mm_mul_ps (_mm_set1_ps (4.0f), d), da), r2, r3);
+    r2 = _mm_andnot_ps (da_zero, r2);
+
+    return select_ps (cmplt_ps (s2, sa), r1, r2);
+}
+
+static force_inline __m128
+blend_difference_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    __m128 dsa = _mm_mul_ps (d, sa);
+    __m128 sda = _mm_mul_ps (s, da);
+
+    return select_ps (cmplt_ps (sda, dsa),
+		      _mm_sub_ps (dsa, sda), _mm_sub_ps (sda, dsa));
+}
+
+static force_inline __m128
+blend_exclusion_ps (__m128 sa, __m128 s, __m128 da, __m128 d)
+{
+    return _mm_sub_ps (_mm_add_ps (_mm_mul_ps (s, da), _mm_mul_ps (d, sa)),
+		       _mm_mul_ps (_mm_mul_ps (_mm_set1_ps (2.0f), d), s));
+}
+
+MAKE_SEPARABLE_PDF_COMBINERS (multiply)
+MAKE_SEPARABLE_PDF_COMBINERS (screen)
+MAKE_SEPARABLE_PDF_COMBINERS (overlay)
+MAKE_SEPARABLE_PDF_COMBINERS (darken)
+MAKE_SEPARABLE_PDF_COMBINERS (lighten)
+MAKE_SEPARABLE_PDF_COMBINERS (color_dodge)
+MAKE_SEPARABLE_PDF_COMBINERS (color_burn)
+MAKE_SEPARABLE_PDF_COMBINERS (hard_light)
+MAKE_SEPARABLE_PDF_COMBINERS (soft_light)
+MAKE_SEPARABLE_PDF_COMBINERS (difference)
+MAKE_SEPARABLE_PDF_COMBINERS (exclusion)
+
+#undef MAKE_SEPARABLE_PDF_COMBINERS
+#undef MAKE_PD_COMBINERS
+#undef MAKE_FLOAT_COMBINERS
+#undef MAKE_FLOAT_COMBINER
+
+#endif /* SSE2_FLOAT_MATCHES_C */
+
+static force_inline __m128i
+create_mask_16_128 (uint16_t mask)
+{
+    return _mm_set1_epi16 (mask);
+}
+
+/* Work around a code generation bug in Sun Studio 12. */
+#if defined(__SUNPRO_C) && (__SUNPRO_C >= 0x590)
+# define create_mask_2x32_128(mask0, mask1)				\
+    (_mm_set_epi32 ((mask0), (mask1), (mask0), (mask1)))
+#else
+static force_inline __m128i
+create_mask_2x32_128 (uint32_t mask0,
+                      uint32_t mask1)
+{
+    return _mm_set_epi32 (mask0, mask1, mask0, mask1);
+}
+#endif
+
+static void
+sse2_composite_over_n_8888 (pixman_implementation_t *imp,
+                            pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t src;
+    uint32_t    *dst_line, *dst, d;
+    int32_t w;
+    int dst_stride;
+    __m128i xmm_src, xmm_alpha;
+    __m128i xmm_dst, xmm_dst_lo, xmm_dst_hi;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+
+    if (src == 0)
+	return;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+
+    xmm_src = expand_pixel_32_1x128 (src);
+    xmm_alpha = expand_alpha_1x128 (xmm_src);
+
+    while (height--)
+    {
+	dst = dst_line;
+
+	dst_line += dst_stride;
+	w = width;
+
+	while (w && (uintptr_t)dst & 15)
+	{
+	    d = *dst;
+	    *dst++ = pack_1x128_32 (over_1x128 (xmm_src,
+						xmm_alpha,
+						unpack_32_1x128 (d)));
+	    w--;
+	}
+
+	while (w >= 4)
+	{
+	    xmm_dst = load_128_aligned ((__m128i*)dst);
+
+	    unpack_128_2x128 (xmm_dst, &xmm_dst_lo, &xmm_dst_hi);
+
+	    over_2x128 (&xmm_src, &xmm_src,
+			&xmm_alpha, &xmm_alpha,
+			&xmm_dst_lo, &xmm_dst_hi);
+
+	    /* rebuid the 4 pixel data and save*/
+	    save_128_aligned (
+		(__m128i*)dst, pack_2x128_128 (xmm_dst_lo, xmm_dst_hi));
+
+	    w -= 4;
+	    dst += 4;
+	}
+
+	while (w)
+	{
+	    d = *dst;
+	    *dst++ = pack_1x128_32 (over_1x128 (xmm_src,
+						xmm_alpha,
+						unpack_32_1x128 (d)));
+	    w--;
+	}
+
+    }
+}
+
+static void
+sse2_composite_over_n_0565 (pixman_implementation_t *imp,
+                            pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t src;
+    uint16_t    *dst_line, *dst, d;
+    int32_t w;
+    int dst_stride;
+    __m128i xmm_src, xmm_alpha;
+    __m128i xmm_dst, xmm_dst0, xmm_dst1, xmm_dst2, xmm_dst3;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+
+    if (src == 0)
+	return;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint16_t, dst_stride, dst_line, 1);
+
+    xmm_src = expand_pixel_32_1x128 (src);
+    xmm_alpha = expand_alpha_1x128 (xmm_src);
+
+    while (height--)
+    {
+	dst = dst_line;
+
+	dst_line += dst_stride;
+	w = width;
+
+	while (w && (uintptr_t)dst & 15)
+	{
+	    d = *dst;
+
+	    *dst++ = pack_565_32_16 (
+		pack_1x128_32 (over_1x128 (xmm_src,
+					   xmm_alpha,
+					   expand565_16_1x128 (d))));
+	    w--;
+	}
+
+	while (w >= 8)
+	{
+	    xmm_dst = load_128_aligned ((__m128i*)dst);
+
+	    unpack_565_128_4x128 (xmm_dst,
+				  &xmm_dst0, &xmm_dst1, &xmm_dst2, &xmm_dst3);
+
+	    over_2x128 (&xmm_src, &xmm_src,
+			&xmm_alpha, &xmm_alpha,
+			&xmm_dst0, &xmm_dst1);
+	    over_2x128 (&xmm_src, &xmm_src,
+			&xmm_alpha, &xmm_alpha,
+			&xmm_dst2, &xmm_dst3);
+
+	    xmm_dst = pack_565_4x128_128 (
+		&xmm_dst0, &xmm_dst1, &xmm_dst2, &xmm_dst3);
+
+	    save_128_aligned ((__m128i*)dst, xmm_dst);
+
+	    dst += 8;
+	    w -= 8;
+	}
+
+	while (w--)
+	{
+	    d = *dst;
+	    *dst++ = pack_565_32_16 (
+		pack_1x128_32 (over_1x128 (xmm_src, xmm_alpha,
+					   expand565_16_1x128 (d))));
+	}
+    }
+
+}
+
+static void
+sse2_composite_add_n_8888_8888_ca (pixman_implementation_t *imp,
+				   pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    uint32_t src;
+    uint32_t    *dst_line, d;
+    uint32_t    *mask_line, m;
+    uint32_t pack_cmp;
+    int dst_stride, mask_stride;
+
+    __m128i xmm_src;
+    __m128i xmm_dst;
+    __m128i xmm_mask, xmm_mask_lo, xmm_mask_hi;
+
+    __m128i mmx_src, mmx_mask, mmx_dest;
+
+    src = _pixman_image_get_solid (imp, src_image, dest_image->bits.format);
+
+    if (src == 0)
+	return;
+
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	mask_image, mask_x, mask_y, uint32_t, mask_stride, mask_line, 1);
+
+    xmm_src = _mm_unpacklo_epi8 (
+	create_mask_2x32_128 (src, src), _mm_setzero_si128 ());
+    mmx_src   = xmm_src;
+
+    while (height--)
+    {
+	int w = width;
+	const uint32_t *pm = (uint32_t *)mask_line;
+	uint32_t *pd = (uint32_t *)dst_line;
+
+	dst_line += dst_stride;
+	mask_line += mask_stride;
+
+	while (w && (uintptr_t)pd & 15)
+	{
+	    m = *pm++;
+
+	    if (m)
+	    {
+		d = *pd;
+
+		mmx_mask = unpack_32_1x128 (m);
+		mmx_dest = unpack_32_1x128 (d);
+
+		*pd = pack_1x128_32 (
+		    _mm_adds_epu8 (pix_multiply_1x128 (mmx_mask, mmx_src),
+				   mmx_dest));
+	    }
+
+	    pd++;
+	    w--;
+	}
+
+	while (w >= 4)
+	{
+	    xmm_mask = load_128_unaligned ((__m128i*)pm);
+
+	    pack_cmp =
+		_mm_movemask_epi8 (
+		    _mm_cmpeq_epi32 (xmm_mask, _mm_setzero_si128 ()));
+
+	    /* if all bits in mask are zero, pack_cmp are equal to 0xffff */
+	    if (pack_cmp != 0xffff)
+	    {
+		xmm_dst = load_128_aligned ((__m128i*)pd);
+
+		unpack_128_2x128 (xmm_mask, &xmm_mask_lo, &xmm_mask_hi);
 
 		pix_multiply_2x128 (&xmm_src, &xmm_src,
 				    &xmm_mask_lo, &xmm_mask_hi,
@@ -3292,21 +4335,105 @@ sse2_composite_over_n_8_8888 (pixman_implementation_t *imp,
 
 	    if (m)
 	    {
-		d = *dst;
+		d = *dst;
+		mmx_mask = expand_pixel_8_1x128 (m);
+		mmx_dest = unpack_32_1x128 (d);
+
+		*dst = pack_1x128_32 (in_over_1x128 (&mmx_src,
+		                                   &mmx_alpha,
+		                                   &mmx_mask,
+		                                   &mmx_dest));
+	    }
+
+	    w--;
+	    dst++;
+	}
+    }
+
+}
+
+/* Glyph spans are short, so they are composited four pixels at a time
+ * without aligning the destination first.
+ */
+#if defined(__GNUC__) && !defined(__x86_64__) && !defined(__amd64__)
+__attribute__((__force_align_arg_pointer__))
+#endif
+static void
+sse2_glyph_spans (pixman_implementation_t   *imp,
+		  uint32_t                   src,
+		  const pixman_glyph_span_t *spans,
+		  int                        n_spans)
+{
+    uint32_t srca = src >> 24;
+    __m128i xmm_src, xmm_alpha, xmm_def;
+    __m128i xmm_dst, xmm_dst_lo, xmm_dst_hi;
+    __m128i xmm_mask, xmm_mask_lo, xmm_mask_hi;
+    __m128i mmx_mask, mmx_dest;
+    int i;
+
+    xmm_def = create_mask_2x32_128 (src, src);
+    xmm_src = expand_pixel_32_1x128 (src);
+    xmm_alpha = expand_alpha_1x128 (xmm_src);
+
+    for (i = 0; i < n_spans; ++i)
+    {
+	uint32_t *dst = spans[i].dest;
+	const uint8_t *mask = spans[i].mask;
+	int32_t w = spans[i].width;
+	uint32_t m;
+
+	while (w >= 4)
+	{
+	    memcpy (&m, mask, sizeof (m));
+
+	    if (srca == 0xff && m == 0xffffffff)
+	    {
+		save_128_unaligned ((__m128i*)dst, xmm_def);
+	    }
+	    else if (m)
+	    {
+		xmm_dst = load_128_unaligned ((__m128i*) dst);
+		xmm_mask = unpack_32_1x128 (m);
+		xmm_mask = _mm_unpacklo_epi8 (xmm_mask, _mm_setzero_si128 ());
+
+		unpack_128_2x128 (xmm_dst, &xmm_dst_lo, &xmm_dst_hi);
+		unpack_128_2x128 (xmm_mask, &xmm_mask_lo, &xmm_mask_hi);
+
+		expand_alpha_rev_2x128 (xmm_mask_lo, xmm_mask_hi,
+					&xmm_mask_lo, &xmm_mask_hi);
+
+		in_over_2x128 (&xmm_src, &xmm_src,
+			       &xmm_alpha, &xmm_alpha,
+			       &xmm_mask_lo, &xmm_mask_hi,
+			       &xmm_dst_lo, &xmm_dst_hi);
+
+		save_128_unaligned (
+		    (__m128i*)dst, pack_2x128_128 (xmm_dst_lo, xmm_dst_hi));
+	    }
+
+	    w -= 4;
+	    dst += 4;
+	    mask += 4;
+	}
+
+	while (w--)
+	{
+	    uint8_t m = *mask++;
+
+	    if (m)
+	    {
 		mmx_mask = expand_pixel_8_1x128 (m);
-		mmx_dest = unpack_32_1x128 (d);
+		mmx_dest = unpack_32_1x128 (*dst);
 
-		*dst = pack_1x128_32 (in_over_1x128 (&mmx_src,
-		                                   &mmx_alpha,
-		                                   &mmx_mask,
-		                                   &mmx_dest));
+		*dst = pack_1x128_32 (in_over_1x128 (&xmm_src,
+						     &xmm_alpha,
+						     &mmx_mask,
+						     &mmx_dest));
 	    }
 
-	    w--;
 	    dst++;
 	}
     }
-
 }
 
 #if defined(__GNUC__) && !defined(__x86_64__) && !defined(__amd64__)
@@ -4525,6 +5652,36 @@ sse2_composite_add_8888_8888 (pixman_implementation_t *imp,
     }
 }
 
+/* Any of the PDF separable blend modes. This is only used with a8r8g8b8
+ * images, because for pixels that are not premultiplied the result of
+ * the combiners depends on the order of the channels.
+ */
+static void
+sse2_composite_pdf_8888_8888 (pixman_implementation_t *imp,
+                              pixman_composite_info_t *info)
+{
+    PIXMAN_COMPOSITE_ARGS (info);
+    pixman_combine_32_func_t combine = imp->combine_32[op];
+    uint32_t    *dst_line, *dst;
+    uint32_t    *src_line, *src;
+    int dst_stride, src_stride;
+
+    PIXMAN_IMAGE_GET_LINE (
+	src_image, src_x, src_y, uint32_t, src_stride, src_line, 1);
+    PIXMAN_IMAGE_GET_LINE (
+	dest_image, dest_x, dest_y, uint32_t, dst_stride, dst_line, 1);
+
+    while (height--)
+    {
+	dst = dst_line;
+	dst_line += dst_stride;
+	src = src_line;
+	src_line += src_stride;
+
+	combine (imp, op, dst, src, NULL, width);
+    }
+}
+
 static void
 sse2_composite_add_n_8888 (pixman_implementation_t *imp,
 			   pixman_composite_info_t *info)
@@ -6128,6 +7285,21 @@ static const pixman_fast_path_t sse2_fast_paths[] =
     PIXMAN_STD_FAST_PATH (ADD, solid, a8, x8b8g8r8, sse2_composite_add_n_8_8888),
     PIXMAN_STD_FAST_PATH (ADD, solid, a8, a8b8g8r8, sse2_composite_add_n_8_8888),
 
+    /* PDF separable blend modes */
+    PIXMAN_STD_FAST_PATH (MULTIPLY, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (SCREEN, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (OVERLAY, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (DARKEN, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (LIGHTEN, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (COLOR_DODGE, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (COLOR_BURN, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (HARD_LIGHT, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+#ifdef SSE2_FLOAT_MATCHES_C
+    PIXMAN_STD_FAST_PATH (SOFT_LIGHT, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+#endif
+    PIXMAN_STD_FAST_PATH (DIFFERENCE, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+    PIXMAN_STD_FAST_PATH (EXCLUSION, a8r8g8b8, null, a8r8g8b8, sse2_composite_pdf_8888_8888),
+
     /* PIXMAN_OP_SRC */
     PIXMAN_STD_FAST_PATH (SRC, solid, a8, a8r8g8b8, sse2_composite_src_n_8_8888),
     PIXMAN_STD_FAST_PATH (SRC, solid, a8, x8r8g8b8, sse2_composite_src_n_8_8888),
@@ -6191,160 +7363,1027 @@ static const pixman_fast_path_t sse2_fast_paths[] =
     SIMPLE_BILINEAR_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, sse2_8888_8888),
     SIMPLE_BILINEAR_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, sse2_8888_8888),
 
-    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8r8g8b8, x8r8g8b8, sse2_8888_n_8888),
-    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8b8g8r8, x8b8g8r8, sse2_8888_n_8888),
-    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, sse2_8888_n_8888),
-    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, sse2_8888_n_8888),
+    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8r8g8b8, x8r8g8b8, sse2_8888_n_8888),
+    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8b8g8r8, x8b8g8r8, sse2_8888_n_8888),
+    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, sse2_8888_n_8888),
+    SIMPLE_BILINEAR_SOLID_MASK_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, sse2_8888_n_8888),
+
+    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8r8g8b8, x8r8g8b8, sse2_8888_8_8888),
+    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8b8g8r8, x8b8g8r8, sse2_8888_8_8888),
+    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, sse2_8888_8_8888),
+    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, sse2_8888_8_8888),
+
+    { PIXMAN_OP_NONE },
+};
+
+static uint32_t *
+sse2_fetch_x8r8g8b8 (pixman_iter_t *iter, const uint32_t *mask)
+{
+    int w = iter->width;
+    __m128i ff000000 = mask_ff000000;
+    uint32_t *dst = iter->buffer;
+    uint32_t *src = (uint32_t *)iter->bits;
+
+    iter->bits += iter->stride;
+
+    while (w && ((uintptr_t)dst) & 0x0f)
+    {
+	*dst++ = (*src++) | 0xff000000;
+	w--;
+    }
+
+    while (w >= 4)
+    {
+	save_128_aligned (
+	    (__m128i *)dst, _mm_or_si128 (
+		load_128_unaligned ((__m128i *)src), ff000000));
+
+	dst += 4;
+	src += 4;
+	w -= 4;
+    }
+
+    while (w)
+    {
+	*dst++ = (*src++) | 0xff000000;
+	w--;
+    }
+
+    return iter->buffer;
+}
+
+static uint32_t *
+sse2_fetch_r5g6b5 (pixman_iter_t *iter, const uint32_t *mask)
+{
+    int w = iter->width;
+    uint32_t *dst = iter->buffer;
+    uint16_t *src = (uint16_t *)iter->bits;
+    __m128i ff000000 = mask_ff000000;
+
+    iter->bits += iter->stride;
+
+    while (w && ((uintptr_t)dst) & 0x0f)
+    {
+	uint16_t s = *src++;
+
+	*dst++ = convert_0565_to_8888 (s);
+	w--;
+    }
+
+    while (w >= 8)
+    {
+	__m128i lo, hi, s;
+
+	s = _mm_loadu_si128 ((__m128i *)src);
+
+	lo = unpack_565_to_8888 (_mm_unpacklo_epi16 (s, _mm_setzero_si128 ()));
+	hi = unpack_565_to_8888 (_mm_unpackhi_epi16 (s, _mm_setzero_si128 ()));
+
+	save_128_aligned ((__m128i *)(dst + 0), _mm_or_si128 (lo, ff000000));
+	save_128_aligned ((__m128i *)(dst + 4), _mm_or_si128 (hi, ff000000));
+
+	dst += 8;
+	src += 8;
+	w -= 8;
+    }
+
+    while (w)
+    {
+	uint16_t s = *src++;
+
+	*dst++ = convert_0565_to_8888 (s);
+	w--;
+    }
+
+    return iter->buffer;
+}
+
+static uint32_t *
+sse2_fetch_a8 (pixman_iter_t *iter, const uint32_t *mask)
+{
+    int w = iter->width;
+    uint32_t *dst = iter->buffer;
+    uint8_t *src = iter->bits;
+    __m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6;
+
+    iter->bits += iter->stride;
+
+    while (w && (((uintptr_t)dst) & 15))
+    {
+        *dst++ = *(src++) << 24;
+        w--;
+    }
+
+    while (w >= 16)
+    {
+	xmm0 = _mm_loadu_si128((__m128i *)src);
+
+	xmm1 = _mm_unpacklo_epi8  (_mm_setzero_si128(), xmm0);
+	xmm2 = _mm_unpackhi_epi8  (_mm_setzero_si128(), xmm0);
+	xmm3 = _mm_unpacklo_epi16 (_mm_setzero_si128(), xmm1);
+	xmm4 = _mm_unpackhi_epi16 (_mm_setzero_si128(), xmm1);
+	xmm5 = _mm_unpacklo_epi16 (_mm_setzero_si128(), xmm2);
+	xmm6 = _mm_unpackhi_epi16 (_mm_setzero_si128(), xmm2);
+
+	_mm_store_si128(((__m128i *)(dst +  0)), xmm3);
+	_mm_store_si128(((__m128i *)(dst +  4)), xmm4);
+	_mm_store_si128(((__m128i *)(dst +  8)), xmm5);
+	_mm_store_si128(((__m128i *)(dst + 12)), xmm6);
+
+	dst += 16;
+	src += 16;
+	w -= 16;
+    }
+
+    while (w)
+    {
+	*dst++ = *(src++) << 24;
+	w--;
+    }
+
+    return iter->buffer;
+}
+
+typedef struct
+{
+    pixman_format_code_t	format;
+    pixman_iter_get_scanline_t	get_scanline;
+} fetcher_info_t;
+
+static const fetcher_info_t fetchers[] =
+{
+    { PIXMAN_x8r8g8b8,		sse2_fetch_x8r8g8b8 },
+    { PIXMAN_r5g6b5,		sse2_fetch_r5g6b5 },
+    { PIXMAN_a8,		sse2_fetch_a8 },
+    { PIXMAN_null }
+};
+
+#ifdef SSE2_FLOAT_MATCHES_C
+
+/*
+ * Gradients
+ *
+ * Positions are computed for four pixels at a time, using the same
+ * double precision arithmetic as the C fetchers so that the results
+ * are identical. They are then reduced according to the repeat mode
+ * the way _pixman_gradient_walker_pixel() does it and looked up in the
+ * gradient's color ramp.
+ */
+static force_inline __m128i
+sse2_gradient_ramp_lookup (pixman_gradient_walker_t *walker,
+			   __m128i                   x,
+			   pixman_repeat_t           repeat)
+{
+    const uint32_t *ramp = walker->ramp;
+    __m128i xmm_one = _mm_set1_epi32 (pixman_fixed_1);
+    __m128i keep = _mm_set1_epi32 (-1);
+    __m128i m, p;
+
+    switch (repeat)
+    {
+    case PIXMAN_REPEAT_NORMAL:
+	x = _mm_and_si128 (x, _mm_set1_epi32 (0xffff));
+	break;
+
+    case PIXMAN_REPEAT_REFLECT:
+	x = _mm_and_si128 (x, _mm_set1_epi32 (0x1ffff));
+	m = _mm_cmpgt_epi32 (x, xmm_one);
+	x = _mm_or_si128 (
+	    _mm_and_si128 (m, _mm_sub_epi32 (_mm_slli_epi32 (xmm_one, 1), x)),
+	    _mm_andnot_si128 (m, x));
+	break;
+
+    case PIXMAN_REPEAT_PAD:
+	x = _mm_andnot_si128 (_mm_srai_epi32 (x, 31), x);
+	m = _mm_cmpgt_epi32 (x, xmm_one);
+	x = _mm_or_si128 (_mm_and_si128 (m, xmm_one),
+			  _mm_andnot_si128 (m, x));
+	break;
+
+    case PIXMAN_REPEAT_NONE:
+    default:
+	m = _mm_or_si128 (
+	    _mm_cmplt_epi32 (x, _mm_set1_epi32 (walker->stops[0].x)),
+	    _mm_cmpgt_epi32 (x, _mm_set1_epi32 (
+				 walker->stops[walker->num_stops - 1].x - 1)));
+	keep = _mm_andnot_si128 (m, keep);
+	x = _mm_and_si128 (x, keep);
+	break;
+    }
+
+    /* Round to the nearest entry, like GRADIENT_RAMP_INDEX() */
+    x = _mm_add_epi32 (
+	x, _mm_set1_epi32 (1 << (15 - GRADIENT_RAMP_BITS)));
+    x = _mm_srli_epi32 (x, 16 - GRADIENT_RAMP_BITS);
+
+    p = _mm_set_epi32 (
+	ramp[_mm_cvtsi128_si32 (_mm_shuffle_epi32 (x, _MM_SHUFFLE (3, 3, 3, 3)))],
+	ramp[_mm_cvtsi128_si32 (_mm_shuffle_epi32 (x, _MM_SHUFFLE (2, 2, 2, 2)))],
+	ramp[_mm_cvtsi128_si32 (_mm_shuffle_epi32 (x, _MM_SHUFFLE (1, 1, 1, 1)))],
+	ramp[_mm_cvtsi128_si32 (x)]);
+
+    return _mm_and_si128 (p, keep);
+}
+
+static force_inline void
+sse2_linear_gradient_span (uint32_t                 *buffer,
+			   pixman_gradient_walker_t *walker,
+			   pixman_fixed_32_32_t      t,
+			   double                    inc,
+			   int                       width,
+			   pixman_repeat_t           repeat)
+{
+    __m128i xmm_t = _mm_set1_epi32 ((int32_t)t);
+    __m128d xmm_inc = _mm_set1_pd (inc);
+    __m128d xmm_i01 = _mm_set_pd (1, 0);
+    __m128d xmm_i23 = _mm_set_pd (3, 2);
+    __m128d xmm_four = _mm_set1_pd (4);
+    int i;
+
+    for (i = 0; i + 4 <= width; i += 4)
+    {
+	__m128i x;
+
+	x = _mm_unpacklo_epi64 (
+	    _mm_cvttpd_epi32 (_mm_mul_pd (xmm_inc, xmm_i01)),
+	    _mm_cvttpd_epi32 (_mm_mul_pd (xmm_inc, xmm_i23)));
+	x = _mm_add_epi32 (x, xmm_t);
+
+	_mm_storeu_si128 ((__m128i *)(buffer + i),
+			  sse2_gradient_ramp_lookup (walker, x, repeat));
+
+	xmm_i01 = _mm_add_pd (xmm_i01, xmm_four);
+	xmm_i23 = _mm_add_pd (xmm_i23, xmm_four);
+    }
+
+    for (; i < width; ++i)
+    {
+	buffer[i] = _pixman_gradient_walker_pixel (
+	    walker, t + (pixman_fixed_32_32_t)(inc * i));
+    }
+}
+
+static uint32_t *
+sse2_fetch_linear_gradient (pixman_iter_t *iter, const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    uint32_t *buffer = iter->buffer;
+    int width = iter->width;
+    pixman_gradient_walker_t walker;
+    pixman_fixed_32_32_t t;
+    double inc;
+
+    _pixman_gradient_walker_init (
+	&walker, &image->gradient, image->common.repeat);
+
+    /* The positions are computed in 32 bit lanes, so anything that
+     * might not fit is left to the C code.
+     */
+    if (!walker.ramp							||
+	!_pixman_linear_gradient_get_affine_position (
+	    image, iter->x, iter->y, &t, &inc)				||
+	t < -0x40000000 || t > 0x40000000				||
+	!(inc * width > -0x40000000 && inc * width < 0x40000000))
+    {
+	return _pixman_linear_gradient_get_scanline_narrow (iter, mask);
+    }
+
+    if ((pixman_fixed_32_32_t)(inc * width) == 0)
+    {
+	uint32_t color = _pixman_gradient_walker_pixel (&walker, t);
+	int i;
+
+	for (i = 0; i < width; ++i)
+	    buffer[i] = color;
+    }
+    else
+    {
+	switch (walker.repeat)
+	{
+	case PIXMAN_REPEAT_NORMAL:
+	    sse2_linear_gradient_span (
+		buffer, &walker, t, inc, width, PIXMAN_REPEAT_NORMAL);
+	    break;
+
+	case PIXMAN_REPEAT_REFLECT:
+	    sse2_linear_gradient_span (
+		buffer, &walker, t, inc, width, PIXMAN_REPEAT_REFLECT);
+	    break;
+
+	case PIXMAN_REPEAT_PAD:
+	    sse2_linear_gradient_span (
+		buffer, &walker, t, inc, width, PIXMAN_REPEAT_PAD);
+	    break;
+
+	case PIXMAN_REPEAT_NONE:
+	default:
+	    sse2_linear_gradient_span (
+		buffer, &walker, t, inc, width, PIXMAN_REPEAT_NONE);
+	    break;
+	}
+    }
+
+    iter->y++;
+
+    return iter->buffer;
+}
+
+/*
+ * Radial gradients
+ *
+ * The roots of the quadratic are computed two pixels per register. The
+ * discriminant B² - A·C suffers from cancellation when the two terms are
+ * close, so this is done in double precision like the C code instead of
+ * in single precision, which would lose most of the bits.
+ */
+static force_inline __m128d
+sse2_radial_gradient_root (__m128d         b,
+			   __m128d         c,
+			   __m128d         a,
+			   __m128d         inva,
+			   __m128d         dr,
+			   __m128d         mindr,
+			   pixman_repeat_t repeat,
+			   __m128d        *valid)
+{
+    __m128d zero = _mm_setzero_pd ();
+    __m128d one = _mm_set1_pd (pixman_fixed_1);
+    __m128d discr, sqrtdiscr, t0, t1, ok0, ok1;
+
+    discr = _mm_sub_pd (_mm_mul_pd (b, b), _mm_mul_pd (a, c));
+    *valid = _mm_cmpge_pd (discr, zero);
+
+    sqrtdiscr = _mm_sqrt_pd (_mm_and_pd (discr, *valid));
+    t0 = _mm_mul_pd (_mm_add_pd (b, sqrtdiscr), inva);
+    t1 = _mm_mul_pd (_mm_sub_pd (b, sqrtdiscr), inva);
+
+    if (repeat == PIXMAN_REPEAT_NONE)
+    {
+	ok0 = _mm_and_pd (_mm_cmple_pd (zero, t0), _mm_cmple_pd (t0, one));
+	ok1 = _mm_and_pd (_mm_cmple_pd (zero, t1), _mm_cmple_pd (t1, one));
+    }
+    else
+    {
+	ok0 = _mm_cmpge_pd (_mm_mul_pd (t0, dr), mindr);
+	ok1 = _mm_cmpge_pd (_mm_mul_pd (t1, dr), mindr);
+    }
+
+    *valid = _mm_and_pd (*valid, _mm_or_pd (ok0, ok1));
+
+    /* The bigger root t0 wins if it is valid */
+    return _mm_and_pd (*valid, _mm_or_pd (_mm_and_pd (ok0, t0),
+					  _mm_andnot_pd (ok0, t1)));
+}
+
+static force_inline void
+sse2_radial_gradient_span (uint32_t                 *buffer,
+			   pixman_gradient_walker_t *walker,
+			   radial_gradient_t        *radial,
+			   pixman_fixed_32_32_t      b,
+			   pixman_fixed_32_32_t      db,
+			   pixman_fixed_32_32_t      c,
+			   pixman_fixed_32_32_t      dc,
+			   pixman_fixed_32_32_t      ddc,
+			   int                       width,
+			   pixman_repeat_t           repeat)
+{
+    __m128d xmm_a = _mm_set1_pd (radial->a);
+    __m128d xmm_inva = _mm_set1_pd (radial->inva);
+    __m128d xmm_dr = _mm_set1_pd (radial->delta.radius);
+    __m128d xmm_mindr = _mm_set1_pd (radial->mindr);
+    __m128d xmm_sign = _mm_set1_pd (-0.0);
+    __m128d xmm_limit = _mm_set1_pd (2147483648.0);
+    int i;
+
+    for (i = 0; i < width; i += 4)
+    {
+	pixman_fixed_32_32_t c1, c2, c3;
+	__m128d t01, t23, ok01, ok23;
+	__m128i x, keep, p;
+
+	c1 = c + dc;
+	dc += ddc;
+	c2 = c1 + dc;
+	dc += ddc;
+	c3 = c2 + dc;
+	dc += ddc;
+
+	t01 = sse2_radial_gradient_root (
+	    _mm_set_pd ((double)(b + db), (double)b),
+	    _mm_set_pd ((double)c1, (double)c),
+	    xmm_a, xmm_inva, xmm_dr, xmm_mindr, repeat, &ok01);
+	t23 = sse2_radial_gradient_root (
+	    _mm_set_pd ((double)(b + 3 * db), (double)(b + 2 * db)),
+	    _mm_set_pd ((double)c3, (double)c2),
+	    xmm_a, xmm_inva, xmm_dr, xmm_mindr, repeat, &ok23);
+
+	b += 4 * db;
+	c = c3 + dc;
+	dc += ddc;
+
+	keep = _mm_castps_si128 (
+	    _mm_shuffle_ps (_mm_castpd_ps (ok01), _mm_castpd_ps (ok23),
+			    _MM_SHUFFLE (2, 0, 2, 0)));
+
+	if (_mm_movemask_pd (
+		_mm_and_pd (
+		    _mm_cmplt_pd (_mm_andnot_pd (xmm_sign, t01), xmm_limit),
+		    _mm_cmplt_pd (_mm_andnot_pd (xmm_sign, t23), xmm_limit))) == 3)
+	{
+	    x = _mm_unpacklo_epi64 (_mm_cvttpd_epi32 (t01),
+				    _mm_cvttpd_epi32 (t23));
+
+	    p = _mm_and_si128 (
+		sse2_gradient_ramp_lookup (walker, x, repeat), keep);
+	}
+	else
+	{
+	    /* Positions that don't fit in 32 bits, which only happens
+	     * for repeating gradients far away from the circles.
+	     */
+	    double t[4];
+	    uint32_t q[4];
+	    int j;
+
+	    _mm_storeu_pd (t, t01);
+	    _mm_storeu_pd (t + 2, t23);
 
-    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8r8g8b8, x8r8g8b8, sse2_8888_8_8888),
-    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8b8g8r8, x8b8g8r8, sse2_8888_8_8888),
-    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8r8g8b8, a8r8g8b8, sse2_8888_8_8888),
-    SIMPLE_BILINEAR_A8_MASK_FAST_PATH (OVER, a8b8g8r8, a8b8g8r8, sse2_8888_8_8888),
+	    for (j = 0; j < 4; ++j)
+		q[j] = _pixman_gradient_walker_pixel (walker, t[j]);
 
-    { PIXMAN_OP_NONE },
-};
+	    p = _mm_and_si128 (_mm_loadu_si128 ((__m128i *)q), keep);
+	}
+
+	if (i + 4 <= width)
+	{
+	    _mm_storeu_si128 ((__m128i *)(buffer + i), p);
+	}
+	else
+	{
+	    uint32_t q[4];
+	    int j;
+
+	    _mm_storeu_si128 ((__m128i *)q, p);
+
+	    for (j = 0; j < width - i; ++j)
+		buffer[i + j] = q[j];
+	}
+    }
+}
 
 static uint32_t *
-sse2_fetch_x8r8g8b8 (pixman_iter_t *iter, const uint32_t *mask)
+sse2_fetch_radial_gradient (pixman_iter_t *iter, const uint32_t *mask)
 {
-    int w = iter->width;
-    __m128i ff000000 = mask_ff000000;
-    uint32_t *dst = iter->buffer;
-    uint32_t *src = (uint32_t *)iter->bits;
+    pixman_image_t *image = iter->image;
+    radial_gradient_t *radial = &image->radial;
+    pixman_gradient_walker_t walker;
+    pixman_fixed_32_32_t b, db, c, dc, ddc;
 
-    iter->bits += iter->stride;
+    _pixman_gradient_walker_init (
+	&walker, &image->gradient, image->common.repeat);
 
-    while (w && ((uintptr_t)dst) & 0x0f)
+    /* When A is 0 the quadratic degenerates, which is rare enough that
+     * it is left to the C code along with projective transformations.
+     */
+    if (!walker.ramp || radial->a == 0					||
+	!_pixman_radial_gradient_get_affine_coefficients (
+	    image, iter->x, iter->y, &b, &db, &c, &dc, &ddc))
     {
-	*dst++ = (*src++) | 0xff000000;
-	w--;
+	return _pixman_radial_gradient_get_scanline_narrow (iter, mask);
     }
 
-    while (w >= 4)
+    switch (walker.repeat)
     {
-	save_128_aligned (
-	    (__m128i *)dst, _mm_or_si128 (
-		load_128_unaligned ((__m128i *)src), ff000000));
+    case PIXMAN_REPEAT_NORMAL:
+	sse2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_NORMAL);
+	break;
 
-	dst += 4;
-	src += 4;
-	w -= 4;
-    }
+    case PIXMAN_REPEAT_REFLECT:
+	sse2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_REFLECT);
+	break;
 
-    while (w)
-    {
-	*dst++ = (*src++) | 0xff000000;
-	w--;
+    case PIXMAN_REPEAT_PAD:
+	sse2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_PAD);
+	break;
+
+    case PIXMAN_REPEAT_NONE:
+    default:
+	sse2_radial_gradient_span (iter->buffer, &walker, radial,
+				   b, db, c, dc, ddc, iter->width,
+				   PIXMAN_REPEAT_NONE);
+	break;
     }
 
+    iter->y++;
+
     return iter->buffer;
 }
 
-static uint32_t *
-sse2_fetch_r5g6b5 (pixman_iter_t *iter, const uint32_t *mask)
+/*
+ * Conical gradients
+ *
+ * This evaluates _pixman_conical_gradient_approximate_parameter() for
+ * four pixels at a time with the same operations as the C code.
+ */
+static force_inline __m128
+sse2_conical_gradient_parameter (__m128 x, __m128 y, __m128 angle)
 {
-    int w = iter->width;
-    uint32_t *dst = iter->buffer;
-    uint16_t *src = (uint16_t *)iter->bits;
-    __m128i ff000000 = mask_ff000000;
+    __m128 zero = _mm_setzero_ps ();
+    __m128 one = _mm_set1_ps (1.f);
+    __m128 sign = _mm_set1_ps (-0.f);
+    __m128 ax = _mm_andnot_ps (sign, x);
+    __m128 ay = _mm_andnot_ps (sign, y);
+    __m128 a, s, t, m;
+
+    a = _mm_div_ps (_mm_min_ps (ax, ay),
+		    _mm_max_ps (_mm_max_ps (ax, ay), _mm_set1_ps (FLT_MIN)));
+    s = _mm_mul_ps (a, a);
+
+    t = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (CONICAL_ATAN_A9), s),
+		    _mm_set1_ps (CONICAL_ATAN_A7));
+    t = _mm_add_ps (_mm_mul_ps (t, s), _mm_set1_ps (CONICAL_ATAN_A5));
+    t = _mm_add_ps (_mm_mul_ps (t, s), _mm_set1_ps (CONICAL_ATAN_A3));
+    t = _mm_add_ps (_mm_mul_ps (t, s), _mm_set1_ps (CONICAL_ATAN_A1));
+    t = _mm_mul_ps (t, a);
+
+    m = _mm_cmpgt_ps (ay, ax);
+    t = _mm_or_ps (_mm_and_ps (m, _mm_sub_ps (_mm_set1_ps (0.25f), t)),
+		   _mm_andnot_ps (m, t));
+    m = _mm_cmplt_ps (x, zero);
+    t = _mm_or_ps (_mm_and_ps (m, _mm_sub_ps (_mm_set1_ps (0.5f), t)),
+		   _mm_andnot_ps (m, t));
+    t = _mm_xor_ps (t, _mm_and_ps (_mm_cmplt_ps (y, zero), sign));
+
+    t = _mm_add_ps (t, angle);
+    t = _mm_add_ps (t, _mm_and_ps (_mm_cmplt_ps (t, zero), one));
+    t = _mm_sub_ps (t, _mm_and_ps (_mm_cmpge_ps (t, one), one));
+
+    return _mm_sub_ps (one, t);
+}
 
-    iter->bits += iter->stride;
+static force_inline void
+sse2_conical_gradient_span (uint32_t                 *buffer,
+			    pixman_gradient_walker_t *walker,
+			    float                     x0,
+			    float                     y0,
+			    float                     dx,
+			    float                     dy,
+			    float                     angle,
+			    int                       width,
+			    pixman_repeat_t           repeat)
+{
+    __m128 xmm_x0 = _mm_set1_ps (x0);
+    __m128 xmm_y0 = _mm_set1_ps (y0);
+    __m128 xmm_dx = _mm_set1_ps (dx);
+    __m128 xmm_dy = _mm_set1_ps (dy);
+    __m128 xmm_angle = _mm_set1_ps (angle);
+    __m128 xmm_i = _mm_setr_ps (0.f, 1.f, 2.f, 3.f);
+    int i;
+
+    for (i = 0; i < width; i += 4)
+    {
+	__m128 t;
+	__m128i p;
+
+	t = sse2_conical_gradient_parameter (
+	    _mm_add_ps (xmm_x0, _mm_mul_ps (xmm_i, xmm_dx)),
+	    _mm_add_ps (xmm_y0, _mm_mul_ps (xmm_i, xmm_dy)),
+	    xmm_angle);
+
+	p = sse2_gradient_ramp_lookup (
+	    walker,
+	    _mm_cvttps_epi32 (_mm_mul_ps (t, _mm_set1_ps (65536.f))),
+	    repeat);
+
+	if (i + 4 <= width)
+	{
+	    _mm_storeu_si128 ((__m128i *)(buffer + i), p);
+	}
+	else
+	{
+	    uint32_t q[4];
+	    int j;
 
-    while (w && ((uintptr_t)dst) & 0x0f)
-    {
-	uint16_t s = *src++;
+	    _mm_storeu_si128 ((__m128i *)q, p);
 
-	*dst++ = convert_0565_to_8888 (s);
-	w--;
+	    for (j = 0; j < width - i; ++j)
+		buffer[i + j] = q[j];
+	}
+
+	xmm_i = _mm_add_ps (xmm_i, _mm_set1_ps (4.f));
     }
+}
 
-    while (w >= 8)
+static uint32_t *
+sse2_fetch_conical_gradient (pixman_iter_t *iter, const uint32_t *mask)
+{
+    pixman_image_t *image = iter->image;
+    pixman_gradient_walker_t walker;
+    double rx, ry, cx, cy;
+    float angle;
+
+    if (!_pixman_conical_gradient_get_affine_position (
+	    image, iter->x, iter->y, &rx, &ry, &cx, &cy))
     {
-	__m128i lo, hi, s;
+	return _pixman_conical_gradient_get_scanline_narrow (iter, mask);
+    }
 
-	s = _mm_loadu_si128 ((__m128i *)src);
+    _pixman_gradient_walker_init (
+	&walker, &image->gradient, image->common.repeat);
 
-	lo = unpack_565_to_8888 (_mm_unpacklo_epi16 (s, _mm_setzero_si128 ()));
-	hi = unpack_565_to_8888 (_mm_unpackhi_epi16 (s, _mm_setzero_si128 ()));
+    angle = image->conical.angle * (1 / (2 * M_PI));
 
-	save_128_aligned ((__m128i *)(dst + 0), _mm_or_si128 (lo, ff000000));
-	save_128_aligned ((__m128i *)(dst + 4), _mm_or_si128 (hi, ff000000));
+    switch (walker.repeat)
+    {
+    case PIXMAN_REPEAT_NORMAL:
+	sse2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_NORMAL);
+	break;
 
-	dst += 8;
-	src += 8;
-	w -= 8;
-    }
+    case PIXMAN_REPEAT_REFLECT:
+	sse2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_REFLECT);
+	break;
 
-    while (w)
-    {
-	uint16_t s = *src++;
+    case PIXMAN_REPEAT_PAD:
+	sse2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_PAD);
+	break;
 
-	*dst++ = convert_0565_to_8888 (s);
-	w--;
+    case PIXMAN_REPEAT_NONE:
+    default:
+	sse2_conical_gradient_span (iter->buffer, &walker,
+				    rx, ry, cx, cy, angle, iter->width,
+				    PIXMAN_REPEAT_NONE);
+	break;
     }
 
+    iter->y++;
+
     return iter->buffer;
 }
 
-static uint32_t *
-sse2_fetch_a8 (pixman_iter_t *iter, const uint32_t *mask)
+#endif
+
+/*
+ * Separable convolution
+ *
+ * The weights are computed the way
+ * bits_image_fetch_separable_convolution_affine() computes them, and
+ * the weighted channels are summed in 32 bits, so the results are the
+ * same as those of the C fetcher. The fetchers are only used when all
+ * weights fit in 16 bits, see
+ * _pixman_separable_convolution_weights_fit_int16(). Then the weights
+ * can be computed with 32 bit multiplications, and one _mm_madd_epi16()
+ * applies two taps to the four channels of two pixels.
+ */
+#define SEPARABLE_CONVOLUTION_MAX_WIDTH		256
+
+#define SEPARABLE_CONVOLUTION_FLAGS					\
+    (FAST_PATH_NO_ALPHA_MAP		|				\
+     FAST_PATH_NO_ACCESSORS		|				\
+     FAST_PATH_HAS_TRANSFORM		|				\
+     FAST_PATH_AFFINE_TRANSFORM		|				\
+     FAST_PATH_SEPARABLE_CONVOLUTION_FILTER)
+
+/* The low 32 bits of the products of the lanes of a and b */
+static force_inline __m128i
+sse2_mullo_epi32 (__m128i a, __m128i b)
 {
-    int w = iter->width;
-    uint32_t *dst = iter->buffer;
-    uint8_t *src = iter->bits;
-    __m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6;
+    __m128i even = _mm_mul_epu32 (a, b);
+    __m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
 
-    iter->bits += iter->stride;
+    return _mm_unpacklo_epi32 (
+	_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+	_mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+}
 
-    while (w && (((uintptr_t)dst) & 15))
+/* Adds the taps of one row of the filter to the per-channel totals in
+ * acc. Pixels are ORed with or_mask before they are weighted.
+ */
+static force_inline __m128i
+sse2_convolve_row (const uint32_t       *row,
+		   const pixman_fixed_t *x_params,
+		   pixman_fixed_t        fy,
+		   int                   cwidth,
+		   __m128i               xmm_or,
+		   __m128i               xmm_acc)
+{
+    __m128i xmm_fy = _mm_set1_epi32 (fy);
+    __m128i xmm_round = _mm_set1_epi32 (0x8000);
+    __m128i xmm_zero = _mm_setzero_si128 ();
+    __m128i xmm_w, xmm_p, xmm_lo, xmm_hi;
+    int j;
+
+    for (j = 0; j + 4 <= cwidth; j += 4)
     {
-        *dst++ = *(src++) << 24;
-        w--;
+	xmm_w = sse2_mullo_epi32 (
+	    _mm_loadu_si128 ((__m128i *)(x_params + j)), xmm_fy);
+	xmm_w = _mm_srai_epi32 (_mm_add_epi32 (xmm_w, xmm_round), 16);
+	xmm_w = _mm_packs_epi32 (xmm_w, xmm_w);
+
+	xmm_p = _mm_or_si128 (_mm_loadu_si128 ((__m128i *)(row + j)), xmm_or);
+
+	/* Interleave the channels of pixels 0 and 1, and of 2 and 3 */
+	xmm_lo = _mm_unpacklo_epi8 (xmm_p, xmm_zero);
+	xmm_lo = _mm_unpacklo_epi16 (xmm_lo, _mm_srli_si128 (xmm_lo, 8));
+	xmm_hi = _mm_unpackhi_epi8 (xmm_p, xmm_zero);
+	xmm_hi = _mm_unpacklo_epi16 (xmm_hi, _mm_srli_si128 (xmm_hi, 8));
+
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+				     xmm_lo, _mm_shuffle_epi32 (xmm_w, 0x00)));
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+				     xmm_hi, _mm_shuffle_epi32 (xmm_w, 0x55)));
     }
 
-    while (w >= 16)
+    for (; j + 2 <= cwidth; j += 2)
     {
-	xmm0 = _mm_loadu_si128((__m128i *)src);
+	int32_t f0 = ((pixman_fixed_32_32_t)x_params[j] * fy + 0x8000) >> 16;
+	int32_t f1 = ((pixman_fixed_32_32_t)x_params[j + 1] * fy + 0x8000) >> 16;
 
-	xmm1 = _mm_unpacklo_epi8  (_mm_setzero_si128(), xmm0);
-	xmm2 = _mm_unpackhi_epi8  (_mm_setzero_si128(), xmm0);
-	xmm3 = _mm_unpacklo_epi16 (_mm_setzero_si128(), xmm1);
-	xmm4 = _mm_unpackhi_epi16 (_mm_setzero_si128(), xmm1);
-	xmm5 = _mm_unpacklo_epi16 (_mm_setzero_si128(), xmm2);
-	xmm6 = _mm_unpackhi_epi16 (_mm_setzero_si128(), xmm2);
+	xmm_p = _mm_or_si128 (_mm_loadl_epi64 ((__m128i *)(row + j)), xmm_or);
+	xmm_p = _mm_unpacklo_epi8 (xmm_p, xmm_zero);
+	xmm_p = _mm_unpacklo_epi16 (xmm_p, _mm_srli_si128 (xmm_p, 8));
 
-	_mm_store_si128(((__m128i *)(dst +  0)), xmm3);
-	_mm_store_si128(((__m128i *)(dst +  4)), xmm4);
-	_mm_store_si128(((__m128i *)(dst +  8)), xmm5);
-	_mm_store_si128(((__m128i *)(dst + 12)), xmm6);
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+				     xmm_p, _mm_set1_epi32 ((f0 & 0xffff) | ((uint32_t)f1 << 16))));
+    }
 
-	dst += 16;
-	src += 16;
-	w -= 16;
+    if (j < cwidth)
+    {
+	int32_t f = ((pixman_fixed_32_32_t)x_params[j] * fy + 0x8000) >> 16;
+
+	xmm_p = _mm_or_si128 (_mm_cvtsi32_si128 (row[j]), xmm_or);
+	xmm_p = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (xmm_p, xmm_zero), xmm_zero);
+
+	xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+				     xmm_p, _mm_set1_epi32 (f & 0xffff)));
     }
 
-    while (w)
+    return xmm_acc;
+}
+
+static force_inline void
+sse2_fetch_separable_convolution (pixman_iter_t   *iter,
+				  const uint32_t  *mask,
+				  pixman_repeat_t  repeat_mode)
+{
+    pixman_image_t *image = iter->image;
+    bits_image_t *bits = &image->bits;
+    pixman_fixed_t *params = image->common.filter_params;
+    int cwidth = pixman_fixed_to_int (params[0]);
+    int cheight = pixman_fixed_to_int (params[1]);
+    int x_off = ((cwidth << 16) - pixman_fixed_1) >> 1;
+    int y_off = ((cheight << 16) - pixman_fixed_1) >> 1;
+    int x_phase_bits = pixman_fixed_to_int (params[2]);
+    int x_phase_shift = 16 - x_phase_bits;
+    int y_phase_shift = 16 - pixman_fixed_to_int (params[3]);
+    uint32_t or_mask = PIXMAN_FORMAT_A (bits->format) ? 0 : 0xff000000;
+    __m128i xmm_or = _mm_set1_epi32 (or_mask);
+    __m128i xmm_round = _mm_set1_epi32 (0x8000);
+    uint32_t *buffer = iter->buffer;
+    uint32_t tmp[SEPARABLE_CONVOLUTION_MAX_WIDTH];
+    int rx[SEPARABLE_CONVOLUTION_MAX_WIDTH];
+    pixman_fixed_t vx, vy, ux, uy;
+    pixman_vector_t v;
+    int i, j, k;
+
+    /* reference point is the center of the pixel */
+    v.vector[0] = pixman_int_to_fixed (iter->x) + pixman_fixed_1 / 2;
+    v.vector[1] = pixman_int_to_fixed (iter->y++) + pixman_fixed_1 / 2;
+    v.vector[2] = pixman_fixed_1;
+
+    if (!pixman_transform_point_3d (image->common.transform, &v))
+	return;
+
+    ux = image->common.transform->matrix[0][0];
+    uy = image->common.transform->matrix[1][0];
+
+    vx = v.vector[0];
+    vy = v.vector[1];
+
+    for (k = 0; k < iter->width; ++k, vx += ux, vy += uy)
     {
-	*dst++ = *(src++) << 24;
-	w--;
+	const pixman_fixed_t *x_params, *y_params;
+	pixman_fixed_t x, y;
+	int32_t x1, y1;
+	pixman_bool_t inside;
+	__m128i xmm_acc;
+
+	if (mask && !mask[k])
+	    continue;
+
+	/* See bits_image_fetch_separable_convolution_affine() */
+	x = ((vx >> x_phase_shift) << x_phase_shift) + ((1 << x_phase_shift) >> 1);
+	y = ((vy >> y_phase_shift) << y_phase_shift) + ((1 << y_phase_shift) >> 1);
+
+	x_params = params + 4 + ((x & 0xffff) >> x_phase_shift) * cwidth;
+	y_params = params + 4 + (1 << x_phase_bits) * cwidth +
+	    ((y & 0xffff) >> y_phase_shift) * cheight;
+
+	x1 = pixman_fixed_to_int (x - pixman_fixed_e - x_off);
+	y1 = pixman_fixed_to_int (y - pixman_fixed_e - y_off);
+
+	inside = x1 >= 0 && x1 + cwidth <= bits->width;
+
+	if (!inside)
+	{
+	    for (j = 0; j < cwidth; ++j)
+	    {
+		rx[j] = x1 + j;
+
+		if (repeat_mode != PIXMAN_REPEAT_NONE)
+		    repeat (repeat_mode, &rx[j], bits->width);
+		else if (rx[j] < 0 || rx[j] >= bits->width)
+		    rx[j] = -1;
+	    }
+	}
+
+	xmm_acc = _mm_setzero_si128 ();
+
+	for (i = 0; i < cheight; ++i)
+	{
+	    pixman_fixed_t fy = y_params[i];
+	    const uint32_t *row;
+	    int ry = y1 + i;
+
+	    if (!fy)
+		continue;
+
+	    if (repeat_mode != PIXMAN_REPEAT_NONE)
+		repeat (repeat_mode, &ry, bits->height);
+	    else if (ry < 0 || ry >= bits->height)
+		continue;
+
+	    row = bits->bits + bits->rowstride * ry;
+
+	    if (inside)
+	    {
+		xmm_acc = sse2_convolve_row (
+		    row + x1, x_params, fy, cwidth, xmm_or, xmm_acc);
+	    }
+	    else
+	    {
+		for (j = 0; j < cwidth; ++j)
+		    tmp[j] = rx[j] < 0 ? 0 : row[rx[j]] | or_mask;
+
+		xmm_acc = sse2_convolve_row (
+		    tmp, x_params, fy, cwidth, _mm_setzero_si128 (), xmm_acc);
+	    }
+	}
+
+	xmm_acc = _mm_srai_epi32 (_mm_add_epi32 (xmm_acc, xmm_round), 16);
+	xmm_acc = _mm_packs_epi32 (xmm_acc, xmm_acc);
+	xmm_acc = _mm_packus_epi16 (xmm_acc, xmm_acc);
+
+	buffer[k] = _mm_cvtsi128_si32 (xmm_acc);
     }
+}
 
-    return iter->buffer;
+#define MAKE_SEPARABLE_CONVOLUTION_FETCHER(name, repeat_mode)		\
+    static uint32_t *							\
+    sse2_fetch_separable_convolution_ ## name (pixman_iter_t  *iter,	\
+					       const uint32_t *mask)	\
+    {									\
+	sse2_fetch_separable_convolution (iter, mask, repeat_mode);	\
+									\
+	return iter->buffer;						\
+    }
+
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (none,    PIXMAN_REPEAT_NONE)
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (normal,  PIXMAN_REPEAT_NORMAL)
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (pad,     PIXMAN_REPEAT_PAD)
+MAKE_SEPARABLE_CONVOLUTION_FETCHER (reflect, PIXMAN_REPEAT_REFLECT)
+
+/* Separable scaling, see pixman-bits-image.c. The horizontal sums have
+ * to be exact, but the filter values don't fit in 16 bits, so each one
+ * is split as f = (f >> 7) * 128 + (f & 127) and multiplied with the
+ * channel pairs (c << 7, c) by pmaddwd.
+ */
+static force_inline __m128i
+sse2_split_weights (__m128i xmm_f)
+{
+    return _mm_or_si128 (
+	_mm_and_si128 (_mm_srai_epi32 (xmm_f, 7), _mm_set1_epi32 (0xffff)),
+	_mm_slli_epi32 (_mm_and_si128 (xmm_f, _mm_set1_epi32 (127)), 16));
 }
 
-typedef struct
+static force_inline __m128i
+sse2_split_channels (__m128i xmm_c)
 {
-    pixman_format_code_t	format;
-    pixman_iter_get_scanline_t	get_scanline;
-} fetcher_info_t;
+    return _mm_unpacklo_epi16 (_mm_slli_epi16 (xmm_c, 7), xmm_c);
+}
 
-static const fetcher_info_t fetchers[] =
+static void
+sse2_separable_scale_filter_row (const separable_scale_t *scale,
+				 const uint32_t          *src,
+				 int32_t                 *row)
 {
-    { PIXMAN_x8r8g8b8,		sse2_fetch_x8r8g8b8 },
-    { PIXMAN_r5g6b5,		sse2_fetch_r5g6b5 },
-    { PIXMAN_a8,		sse2_fetch_a8 },
-    { PIXMAN_null }
-};
+    __m128i xmm_or = _mm_set1_epi32 (scale->or_mask);
+    __m128i xmm_zero = _mm_setzero_si128 ();
+    int cwidth = scale->cwidth;
+    int j, k;
+
+    for (k = scale->begin; k < scale->end; ++k)
+    {
+	const pixman_fixed_t *x_params = scale->x_params[k];
+	const uint32_t *p = src + scale->x1[k];
+	__m128i xmm_acc = _mm_setzero_si128 ();
+
+	for (j = 0; j + 4 <= cwidth; j += 4)
+	{
+	    __m128i xmm_w = sse2_split_weights (
+		_mm_loadu_si128 ((__m128i *)(x_params + j)));
+	    __m128i xmm_p = _mm_or_si128 (
+		_mm_loadu_si128 ((__m128i *)(p + j)), xmm_or);
+	    __m128i xmm_lo = _mm_unpacklo_epi8 (xmm_p, xmm_zero);
+	    __m128i xmm_hi = _mm_unpackhi_epi8 (xmm_p, xmm_zero);
+
+	    xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+		sse2_split_channels (xmm_lo),
+		_mm_shuffle_epi32 (xmm_w, _MM_SHUFFLE (0, 0, 0, 0))));
+	    xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+		sse2_split_channels (_mm_srli_si128 (xmm_lo, 8)),
+		_mm_shuffle_epi32 (xmm_w, _MM_SHUFFLE (1, 1, 1, 1))));
+	    xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+		sse2_split_channels (xmm_hi),
+		_mm_shuffle_epi32 (xmm_w, _MM_SHUFFLE (2, 2, 2, 2))));
+	    xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+		sse2_split_channels (_mm_srli_si128 (xmm_hi, 8)),
+		_mm_shuffle_epi32 (xmm_w, _MM_SHUFFLE (3, 3, 3, 3))));
+	}
+
+	for (; j < cwidth; ++j)
+	{
+	    __m128i xmm_w = sse2_split_weights (_mm_cvtsi32_si128 (x_params[j]));
+	    __m128i xmm_p = _mm_cvtsi32_si128 (p[j] | scale->or_mask);
+
+	    xmm_acc = _mm_add_epi32 (xmm_acc, _mm_madd_epi16 (
+		sse2_split_channels (_mm_unpacklo_epi8 (xmm_p, xmm_zero)),
+		_mm_shuffle_epi32 (xmm_w, _MM_SHUFFLE (0, 0, 0, 0))));
+	}
+
+	_mm_storeu_si128 ((__m128i *)(row + 4 * k), xmm_acc);
+    }
+}
+
+/* Multiplies the even 32 bit lanes of a and b to signed 64 bit
+ * products. _mm_mul_epu32() gives the unsigned products, which are
+ * 2^32 * b too big where a is negative, and 2^32 * a where b is.
+ */
+static force_inline __m128i
+sse2_mul_epi32 (__m128i a, __m128i b)
+{
+    __m128i xmm_fix = _mm_add_epi32 (
+	_mm_and_si128 (_mm_srai_epi32 (a, 31), b),
+	_mm_and_si128 (_mm_srai_epi32 (b, 31), a));
+
+    return _mm_sub_epi64 (_mm_mul_epu32 (a, b), _mm_slli_epi64 (xmm_fix, 32));
+}
+
+static void
+sse2_separable_scale_combine_rows (uint32_t              *buffer,
+				   int                    width,
+				   const int32_t        **rows,
+				   const pixman_fixed_t  *weights,
+				   int                    n_rows)
+{
+    __m128i xmm_half = _mm_set_epi32 (0, 0x80000000, 0, 0x80000000);
+    __m128i xmm_hi = _mm_set_epi32 (-1, 0, -1, 0);
+    int i, k;
+
+    for (k = 0; k < width; ++k)
+    {
+	/* The b and r sums in the even lanes, g and a in the odd ones */
+	__m128i xmm_even = xmm_half, xmm_odd = xmm_half;
+	__m128i xmm_pixel;
+
+	for (i = 0; i < n_rows; ++i)
+	{
+	    __m128i xmm_w = _mm_set1_epi32 (weights[i]);
+	    __m128i xmm_h = _mm_loadu_si128 ((const __m128i *)(rows[i] + 4 * k));
+
+	    xmm_even = _mm_add_epi64 (xmm_even, sse2_mul_epi32 (xmm_h, xmm_w));
+	    xmm_odd = _mm_add_epi64 (xmm_odd, sse2_mul_epi32 (
+		_mm_srli_epi64 (xmm_h, 32), xmm_w));
+	}
+
+	/* The upper halves of the rounded sums are the channels */
+	xmm_pixel = _mm_or_si128 (_mm_srli_epi64 (xmm_even, 32),
+				  _mm_and_si128 (xmm_odd, xmm_hi));
+	xmm_pixel = _mm_packs_epi32 (xmm_pixel, xmm_pixel);
+	buffer[k] = _mm_cvtsi128_si32 (_mm_packus_epi16 (xmm_pixel, xmm_pixel));
+    }
+}
 
 static pixman_bool_t
 sse2_src_iter_init (pixman_implementation_t *imp, pixman_iter_t *iter)
@@ -6376,6 +8415,77 @@ sse2_src_iter_init (pixman_implementation_t *imp, pixman_iter_t *iter)
 	}
     }
 
+#ifdef SSE2_FLOAT_MATCHES_C
+    if ((iter->iter_flags & ITER_NARROW) && image->type == LINEAR)
+    {
+	/* The C code takes care of gradients that are the same on
+	 * every scanline and only computes them once.
+	 */
+	_pixman_linear_gradient_iter_init (image, iter);
+
+	if (iter->get_scanline == _pixman_linear_gradient_get_scanline_narrow &&
+	    image->gradient.ramp)
+	{
+	    iter->get_scanline = sse2_fetch_linear_gradient;
+	}
+
+	return TRUE;
+    }
+
+    if ((iter->iter_flags & ITER_NARROW) && image->type == RADIAL &&
+	image->gradient.ramp)
+    {
+	iter->get_scanline = sse2_fetch_radial_gradient;
+	return TRUE;
+    }
+
+    if ((iter->iter_flags & ITER_NARROW) && image->type == CONICAL &&
+	image->gradient.ramp)
+    {
+	iter->get_scanline = sse2_fetch_conical_gradient;
+	return TRUE;
+    }
+#endif
+
+    if (_pixman_separable_scale_iter_init (
+	    iter, sse2_separable_scale_filter_row,
+	    sse2_separable_scale_combine_rows))
+    {
+	return TRUE;
+    }
+
+    if ((iter->iter_flags & ITER_NARROW)				&&
+	(iter->image_flags & SEPARABLE_CONVOLUTION_FLAGS) ==
+	SEPARABLE_CONVOLUTION_FLAGS					&&
+	(image->common.extended_format_code == PIXMAN_a8r8g8b8	||
+	 image->common.extended_format_code == PIXMAN_x8r8g8b8)	&&
+	pixman_fixed_to_int (image->common.filter_params[0]) <=
+	SEPARABLE_CONVOLUTION_MAX_WIDTH				&&
+	_pixman_separable_convolution_weights_fit_int16 (
+	    image->common.filter_params))
+    {
+	switch (image->common.repeat)
+	{
+	case PIXMAN_REPEAT_NONE:
+	    iter->get_scanline = sse2_fetch_separable_convolution_none;
+	    break;
+
+	case PIXMAN_REPEAT_NORMAL:
+	    iter->get_scanline = sse2_fetch_separable_convolution_normal;
+	    break;
+
+	case PIXMAN_REPEAT_PAD:
+	    iter->get_scanline = sse2_fetch_separable_convolution_pad;
+	    break;
+
+	case PIXMAN_REPEAT_REFLECT:
+	    iter->get_scanline = sse2_fetch_separable_convolution_reflect;
+	    break;
+	}
+
+	return TRUE;
+    }
+
     return FALSE;
 }
 
@@ -6386,6 +8496,9 @@ pixman_implementation_t *
 _pixman_implementation_create_sse2 (pixman_implementation_t *fallback)
 {
     pixman_implementation_t *imp = _pixman_implementation_create (fallback, sse2_fast_paths);
+    int op;
+
+    imp->name = "sse2";
 
     /* SSE2 constants */
     mask_565_r  = create_mask_2x32_128 (0x00f80000, 0x00f80000);
@@ -6403,6 +8516,7 @@ _pixman_implementation_create_sse2 (pixman_implementation_t *fallback)
     mask_ffff = create_mask_16_128 (0xffff);
     mask_ff000000 = create_mask_2x32_128 (0xff000000, 0xff000000);
     mask_alpha = create_mask_2x32_128 (0x00ff0000, 0x00000000);
+    mask_ffff_alpha = create_mask_2x32_128 (0xffff0000, 0x00000000);
     mask_565_rb = create_mask_2x32_128 (0x00f800f8, 0x00f800f8);
     mask_565_pack_multiplier = create_mask_2x32_128 (0x20000004, 0x20000004);
 
@@ -6432,8 +8546,142 @@ _pixman_implementation_create_sse2 (pixman_implementation_t *fallback)
     imp->combine_32_ca[PIXMAN_OP_XOR] = sse2_combine_xor_ca;
     imp->combine_32_ca[PIXMAN_OP_ADD] = sse2_combine_add_ca;
 
+    for (op = PIXMAN_OP_MULTIPLY; op <= PIXMAN_OP_EXCLUSION; ++op)
+    {
+	pdf_combine_u[op] = _pixman_implementation_lookup_combiner (fallback, op, FALSE, TRUE);
+	pdf_combine_ca[op] = _pixman_implementation_lookup_combiner (fallback, op, TRUE, TRUE);
+    }
+
+    imp->combine_32[PIXMAN_OP_MULTIPLY] = sse2_combine_multiply_u;
+    imp->combine_32_ca[PIXMAN_OP_MULTIPLY] = sse2_combine_multiply_ca;
+    imp->combine_32[PIXMAN_OP_SCREEN] = sse2_combine_screen_u;
+    imp->combine_32_ca[PIXMAN_OP_SCREEN] = sse2_combine_screen_ca;
+    imp->combine_32[PIXMAN_OP_OVERLAY] = sse2_combine_overlay_u;
+    imp->combine_32_ca[PIXMAN_OP_OVERLAY] = sse2_combine_overlay_ca;
+    imp->combine_32[PIXMAN_OP_DARKEN] = sse2_combine_darken_u;
+    imp->combine_32_ca[PIXMAN_OP_DARKEN] = sse2_combine_darken_ca;
+    imp->combine_32[PIXMAN_OP_LIGHTEN] = sse2_combine_lighten_u;
+    imp->combine_32_ca[PIXMAN_OP_LIGHTEN] = sse2_combine_lighten_ca;
+    imp->combine_32[PIXMAN_OP_COLOR_DODGE] = sse2_combine_color_dodge_u;
+    imp->combine_32_ca[PIXMAN_OP_COLOR_DODGE] = sse2_combine_color_dodge_ca;
+    imp->combine_32[PIXMAN_OP_COLOR_BURN] = sse2_combine_color_burn_u;
+    imp->combine_32_ca[PIXMAN_OP_COLOR_BURN] = sse2_combine_color_burn_ca;
+    imp->combine_32[PIXMAN_OP_HARD_LIGHT] = sse2_combine_hard_light_u;
+    imp->combine_32_ca[PIXMAN_OP_HARD_LIGHT] = sse2_combine_hard_light_ca;
+#ifdef SSE2_FLOAT_MATCHES_C
+    imp->combine_32[PIXMAN_OP_SOFT_LIGHT] = sse2_combine_soft_light_u;
+    imp->combine_32_ca[PIXMAN_OP_SOFT_LIGHT] = sse2_combine_soft_light_ca;
+#endif
+    imp->combine_32[PIXMAN_OP_DIFFERENCE] = sse2_combine_difference_u;
+    imp->combine_32_ca[PIXMAN_OP_DIFFERENCE] = sse2_combine_difference_ca;
+    imp->combine_32[PIXMAN_OP_EXCLUSION] = sse2_combine_exclusion_u;
+    imp->combine_32_ca[PIXMAN_OP_EXCLUSION] = sse2_combine_exclusion_ca;
+
+#ifdef SSE2_FLOAT_MATCHES_C
+    imp->combine_float[PIXMAN_OP_CLEAR] = sse2_combine_clear_u_float;
+    imp->combine_float[PIXMAN_OP_SRC] = sse2_combine_src_u_float;
+    imp->combine_float[PIXMAN_OP_DST] = sse2_combine_dst_u_float;
+    imp->combine_float[PIXMAN_OP_OVER] = sse2_combine_over_u_float;
+    imp->combine_float[PIXMAN_OP_OVER_REVERSE] = sse2_combine_over_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_IN] = sse2_combine_in_u_float;
+    imp->combine_float[PIXMAN_OP_IN_REVERSE] = sse2_combine_in_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_OUT] = sse2_combine_out_u_float;
+    imp->combine_float[PIXMAN_OP_OUT_REVERSE] = sse2_combine_out_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_ATOP] = sse2_combine_atop_u_float;
+    imp->combine_float[PIXMAN_OP_ATOP_REVERSE] = sse2_combine_atop_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_XOR] = sse2_combine_xor_u_float;
+    imp->combine_float[PIXMAN_OP_ADD] = sse2_combine_add_u_float;
+    imp->combine_float[PIXMAN_OP_SATURATE] = sse2_combine_saturate_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_CLEAR] = sse2_combine_disjoint_clear_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_SRC] = sse2_combine_disjoint_src_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_DST] = sse2_combine_disjoint_dst_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OVER] = sse2_combine_disjoint_over_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OVER_REVERSE] = sse2_combine_disjoint_over_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_IN] = sse2_combine_disjoint_in_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_IN_REVERSE] = sse2_combine_disjoint_in_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OUT] = sse2_combine_disjoint_out_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_OUT_REVERSE] = sse2_combine_disjoint_out_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_ATOP] = sse2_combine_disjoint_atop_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_ATOP_REVERSE] = sse2_combine_disjoint_atop_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_DISJOINT_XOR] = sse2_combine_disjoint_xor_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_CLEAR] = sse2_combine_conjoint_clear_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_SRC] = sse2_combine_conjoint_src_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_DST] = sse2_combine_conjoint_dst_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OVER] = sse2_combine_conjoint_over_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OVER_REVERSE] = sse2_combine_conjoint_over_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_IN] = sse2_combine_conjoint_in_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_IN_REVERSE] = sse2_combine_conjoint_in_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OUT] = sse2_combine_conjoint_out_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_OUT_REVERSE] = sse2_combine_conjoint_out_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_ATOP] = sse2_combine_conjoint_atop_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_ATOP_REVERSE] = sse2_combine_conjoint_atop_reverse_u_float;
+    imp->combine_float[PIXMAN_OP_CONJOINT_XOR] = sse2_combine_conjoint_xor_u_float;
+    imp->combine_float[PIXMAN_OP_MULTIPLY] = sse2_combine_multiply_u_float;
+    imp->combine_float[PIXMAN_OP_SCREEN] = sse2_combine_screen_u_float;
+    imp->combine_float[PIXMAN_OP_OVERLAY] = sse2_combine_overlay_u_float;
+    imp->combine_float[PIXMAN_OP_DARKEN] = sse2_combine_darken_u_float;
+    imp->combine_float[PIXMAN_OP_LIGHTEN] = sse2_combine_lighten_u_float;
+    imp->combine_float[PIXMAN_OP_COLOR_DODGE] = sse2_combine_color_dodge_u_float;
+    imp->combine_float[PIXMAN_OP_COLOR_BURN] = sse2_combine_color_burn_u_float;
+    imp->combine_float[PIXMAN_OP_HARD_LIGHT] = sse2_combine_hard_light_u_float;
+    imp->combine_float[PIXMAN_OP_SOFT_LIGHT] = sse2_combine_soft_light_u_float;
+    imp->combine_float[PIXMAN_OP_DIFFERENCE] = sse2_combine_difference_u_float;
+    imp->combine_float[PIXMAN_OP_EXCLUSION] = sse2_combine_exclusion_u_float;
+
+    imp->combine_float_ca[PIXMAN_OP_CLEAR] = sse2_combine_clear_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SRC] = sse2_combine_src_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DST] = sse2_combine_dst_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OVER] = sse2_combine_over_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OVER_REVERSE] = sse2_combine_over_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_IN] = sse2_combine_in_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_IN_REVERSE] = sse2_combine_in_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OUT] = sse2_combine_out_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OUT_REVERSE] = sse2_combine_out_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_ATOP] = sse2_combine_atop_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_ATOP_REVERSE] = sse2_combine_atop_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_XOR] = sse2_combine_xor_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_ADD] = sse2_combine_add_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SATURATE] = sse2_combine_saturate_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_CLEAR] = sse2_combine_disjoint_clear_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_SRC] = sse2_combine_disjoint_src_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_DST] = sse2_combine_disjoint_dst_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OVER] = sse2_combine_disjoint_over_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OVER_REVERSE] = sse2_combine_disjoint_over_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_IN] = sse2_combine_disjoint_in_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_IN_REVERSE] = sse2_combine_disjoint_in_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OUT] = sse2_combine_disjoint_out_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_OUT_REVERSE] = sse2_combine_disjoint_out_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_ATOP] = sse2_combine_disjoint_atop_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_ATOP_REVERSE] = sse2_combine_disjoint_atop_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DISJOINT_XOR] = sse2_combine_disjoint_xor_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_CLEAR] = sse2_combine_conjoint_clear_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_SRC] = sse2_combine_conjoint_src_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_DST] = sse2_combine_conjoint_dst_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OVER] = sse2_combine_conjoint_over_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OVER_REVERSE] = sse2_combine_conjoint_over_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_IN] = sse2_combine_conjoint_in_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_IN_REVERSE] = sse2_combine_conjoint_in_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OUT] = sse2_combine_conjoint_out_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_OUT_REVERSE] = sse2_combine_conjoint_out_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_ATOP] = sse2_combine_conjoint_atop_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_ATOP_REVERSE] = sse2_combine_conjoint_atop_reverse_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_CONJOINT_XOR] = sse2_combine_conjoint_xor_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_MULTIPLY] = sse2_combine_multiply_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SCREEN] = sse2_combine_screen_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_OVERLAY] = sse2_combine_overlay_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DARKEN] = sse2_combine_darken_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_LIGHTEN] = sse2_combine_lighten_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_COLOR_DODGE] = sse2_combine_color_dodge_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_COLOR_BURN] = sse2_combine_color_burn_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_HARD_LIGHT] = sse2_combine_hard_light_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_SOFT_LIGHT] = sse2_combine_soft_light_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_DIFFERENCE] = sse2_combine_difference_ca_float;
+    imp->combine_float_ca[PIXMAN_OP_EXCLUSION] = sse2_combine_exclusion_ca_float;
+#endif
+
     imp->blt = sse2_blt;
     imp->fill = sse2_fill;
+    imp->glyph_spans = sse2_glyph_spans;
 
     imp->src_iter_init = sse2_src_iter_init;
 
@@ -0,0 +1,288 @@
+/*
+ * Copyright © 2026 The Pixman Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pixman-private.h"
+
+#if defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64))
+#include <intrin.h>
+#endif
+
+/*
+ * Composite statistics
+ *
+ * Composites are counted in a small hash table keyed by the operator,
+ * the formats and the implementation the composite function came from.
+ * Nothing is recorded unless the statistics have been enabled, so the
+ * only cost otherwise is a test of _pixman_composite_stats_enabled.
+ */
+
+#define N_STATS		1024	/* Must be a power of two */
+
+typedef struct
+{
+    pixman_implementation_t *	imp;	/* NULL for unused entries */
+    pixman_composite_stat_t	stat;
+} stats_entry_t;
+
+int _pixman_composite_stats_enabled;
+
+static stats_entry_t stats[N_STATS];
+static int n_stats;
+
+static pixman_mutex_t stats_lock = PIXMAN_MUTEX_INITIALIZER;
+
+uint64_t
+_pixman_composite_stats_stamp (void)
+{
+#if defined (__GNUC__) && (defined (__i386__) || defined (__x86_64__))
+    uint32_t hi, lo;
+
+    __asm__ __volatile__ ("rdtsc\n" : "=a" (lo), "=d" (hi));
+
+    return lo | (((uint64_t)hi) << 32);
+#elif defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64))
+    return __rdtsc ();
+#else
+    return 0;
+#endif
+}
+
+/* Returns the entry for the given key, adding it if necessary, or NULL
+ * if the table is full. Called with the lock held.
+ */
+static pixman_composite_stat_t *
+find_stat (pixman_op_t              op,
+	   pixman_format_code_t     src_format,
+	   pixman_format_code_t     mask_format,
+	   pixman_format_code_t     dest_format,
+	   pixman_implementation_t *imp)
+{
+    uint32_t hash;
+    int i;
+
+    hash = op;
+    hash = hash * 31 + src_format;
+    hash = hash * 31 + mask_format;
+    hash = hash * 31 + dest_format;
+    hash = hash * 31 + (uint32_t)(uintptr_t)imp;
+    hash ^= hash >> 16;
+
+    for (i = hash & (N_STATS - 1); stats[i].imp; i = (i + 1) & (N_STATS - 1))
+    {
+	pixman_composite_stat_t *stat = &stats[i].stat;
+
+	if (stats[i].imp == imp			&&
+	    stat->op == op			&&
+	    stat->src_format == src_format	&&
+	    stat->mask_format == mask_format	&&
+	    stat->dest_format == dest_format)
+	{
+	    return stat;
+	}
+    }
+
+    /* Keep one entry free so that probing always terminates */
+    if (n_stats == N_STATS - 1)
+	return NULL;
+
+    n_stats++;
+
+    stats[i].imp = imp;
+    stats[i].stat.op = op;
+    stats[i].stat.src_format = src_format;
+    stats[i].stat.mask_format = mask_format;
+    stats[i].stat.dest_format = dest_format;
+    stats[i].stat.implementation = imp->name;
+    stats[i].stat.general = imp->fallback == NULL;
+
+    return &stats[i].stat;
+}
+
+void
+_pixman_composite_stats_record (pixman_op_t              op,
+				pixman_format_code_t     src_format,
+				pixman_format_code_t     mask_format,
+				pixman_format_code_t     dest_format,
+				pixman_implementation_t *imp,
+				uint64_t                 n_pixels,
+				uint64_t                 n_cycles)
+{
+    pixman_composite_stat_t *stat;
+
+    if (!imp)
+	return;
+
+    LOCK (&stats_lock);
+
+    if ((stat = find_stat (op, src_format, mask_format, dest_format, imp)))
+    {
+	stat->n_calls++;
+	stat->n_pixels += n_pixels;
+	stat->n_cycles += n_cycles;
+    }
+
+    UNLOCK (&stats_lock);
+}
+
+void
+_pixman_composite_stats_lookup (pixman_op_t              op,
+				pixman_format_code_t     src_format,
+				pixman_format_code_t     mask_format,
+				pixman_format_code_t     dest_format,
+				pixman_implementation_t *imp)
+{
+    pixman_composite_stat_t *stat;
+
+    if (!imp)
+	return;
+
+    LOCK (&stats_lock);
+
+    if ((stat = find_stat (op, src_format, mask_format, dest_format, imp)))
+	stat->n_lookups++;
+
+    UNLOCK (&stats_lock);
+}
+
+static int
+compare_cycles (const void *a, const void *b)
+{
+    const pixman_composite_stat_t *sa = a;
+    const pixman_composite_stat_t *sb = b;
+
+    if (sa->n_cycles != sb->n_cycles)
+	return sa->n_cycles < sb->n_cycles ? 1 : -1;
+
+    if (sa->n_pixels != sb->n_pixels)
+	return sa->n_pixels < sb->n_pixels ? 1 : -1;
+
+    return 0;
+}
+
+static void
+dump_stats (void)
+{
+    pixman_composite_stat_t *list;
+    int i, n, n_list;
+
+    n_list = pixman_composite_stats_get (NULL, 0);
+    list = pixman_malloc_ab (n_list + 1, sizeof (pixman_composite_stat_t));
+    if (!list)
+	return;
+
+    /* The count includes combinations that other threads added after
+     * the list was allocated, and those are not in it.
+     */
+    n = pixman_composite_stats_get (list, n_list);
+    if (n > n_list)
+	n = n_list;
+
+    qsort (list, n, sizeof (pixman_composite_stat_t), compare_cycles);
+
+    fprintf (stderr,
+	     "pixman composite statistics, most expensive first:\n"
+	     "%3s %-10s %-10s %-10s %-10s %-7s %10s %8s %12s %14s\n",
+	     "op", "src", "mask", "dest", "imp", "path",
+	     "calls", "lookups", "pixels", "cycles");
+
+    for (i = 0; i < n; ++i)
+    {
+	const pixman_composite_stat_t *s = &list[i];
+
+	fprintf (stderr,
+		 "%3d 0x%08x 0x%08x 0x%08x %-10s %-7s %10llu %8llu %12llu %14llu\n",
+		 s->op, s->src_format, s->mask_format, s->dest_format,
+		 s->implementation ? s->implementation : "?",
+		 s->general ? "general" : "fast",
+		 (unsigned long long)s->n_calls,
+		 (unsigned long long)s->n_lookups,
+		 (unsigned long long)s->n_pixels,
+		 (unsigned long long)s->n_cycles);
+    }
+
+    free (list);
+}
+
+void
+_pixman_composite_stats_init (void)
+{
+    const char *env;
+
+    if ((env = getenv ("PIXMAN_STATS")) && *env)
+    {
+	_pixman_composite_stats_enabled = TRUE;
+
+	atexit (dump_stats);
+    }
+}
+
+PIXMAN_EXPORT void
+pixman_composite_stats_enable (pixman_bool_t enable)
+{
+    _pixman_composite_stats_enabled = !!enable;
+}
+
+/* Copies up to @n_list entries into @list and returns the number of
+ * entries there are in total.
+ */
+PIXMAN_EXPORT int
+pixman_composite_stats_get (pixman_composite_stat_t *list,
+			    int                      n_list)
+{
+    int i, n;
+
+    LOCK (&stats_lock);
+
+    n = 0;
+    for (i = 0; i < N_STATS; ++i)
+    {
+	if (!stats[i].imp)
+	    continue;
+
+	if (n < n_list)
+	    list[n] = stats[i].stat;
+
+	n++;
+    }
+
+    UNLOCK (&stats_lock);
+
+    return n;
+}
+
+PIXMAN_EXPORT void
+pixman_composite_stats_reset (void)
+{
+    LOCK (&stats_lock);
+
+    memset (stats, 0, sizeof (stats));
+    n_stats = 0;
+
+    UNLOCK (&stats_lock);
+}
@@ -0,0 +1,412 @@
+/*
+ * Copyright © 2026 The Pixman Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include "pixman-private.h"
+
+/*
+ * Band-parallel compositing
+ *
+ * Composite functions only write to the destination rectangle they are
+ * given, and every destination pixel only depends on its own position,
+ * so a large rectangle can be cut into horizontal bands that are
+ * composited concurrently with exactly the same result.
+ *
+ * This is off by default. pixman_set_thread_count() or the
+ * PIXMAN_THREADS environment variable turn it on; the calling thread
+ * always takes part, so n threads means n - 1 workers.
+ */
+
+#define MAX_THREADS		64
+
+/* Composites smaller than this are not worth waking up workers for */
+#define MIN_PARALLEL_PIXELS	(256 * 256)
+
+/* Don't cut bands thinner than this many rows */
+#define MIN_BAND_HEIGHT		16
+
+#define N_STACK_BANDS		64
+
+/* Read by every composite, and may be changed by another thread while
+ * they run. It doesn't order any other memory accesses.
+ */
+static int n_threads = 1;
+
+#ifdef HAVE_PTHREADS
+
+typedef struct
+{
+    pixman_implementation_t *	imp;
+    pixman_composite_func_t	func;
+    pixman_composite_info_t *	info;
+    const pixman_box32_t *	bands;
+    int				n_bands;
+    int32_t			src_dx, src_dy;
+    int32_t			mask_dx, mask_dy;
+
+    /* Protected by pool.lock */
+    int				next_band;
+    int				n_done;
+} job_t;
+
+static struct
+{
+    pixman_mutex_t		lock;
+    pthread_cond_t		work_available;
+    pthread_cond_t		job_done;
+    job_t *			job;
+    pixman_bool_t		quit;
+    int				n_workers;
+    pthread_t			workers[MAX_THREADS];
+
+    /* Only one composite at a time gets to use the workers. Also held
+     * while they are stopped.
+     */
+    pixman_mutex_t		job_lock;
+} pool =
+{
+    PIXMAN_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    NULL,
+    FALSE,
+    0,
+    { 0 },
+    PIXMAN_MUTEX_INITIALIZER
+};
+
+static void
+run_band (job_t *job, int i)
+{
+    const pixman_box32_t *band = &job->bands[i];
+    pixman_composite_info_t info = *job->info;
+
+    info.src_x = band->x1 + job->src_dx;
+    info.src_y = band->y1 + job->src_dy;
+    info.mask_x = band->x1 + job->mask_dx;
+    info.mask_y = band->y1 + job->mask_dy;
+    info.dest_x = band->x1;
+    info.dest_y = band->y1;
+    info.width = band->x2 - band->x1;
+    info.height = band->y2 - band->y1;
+
+    job->func (job->imp, &info);
+}
+
+/* Runs bands of the current job until there are none left to take.
+ * Called and returns with pool.lock held.
+ */
+static void
+run_bands (job_t *job)
+{
+    while (job->next_band < job->n_bands)
+    {
+	int i = job->next_band++;
+
+	UNLOCK (&pool.lock);
+
+	run_band (job, i);
+
+	LOCK (&pool.lock);
+
+	if (++job->n_done == job->n_bands)
+	    pthread_cond_signal (&pool.job_done);
+    }
+}
+
+static void *
+worker_main (void *data)
+{
+    LOCK (&pool.lock);
+
+    for (;;)
+    {
+	while (!pool.quit &&
+	       (!pool.job || pool.job->next_band >= pool.job->n_bands))
+	{
+	    pthread_cond_wait (&pool.work_available, &pool.lock);
+	}
+
+	if (pool.quit)
+	    break;
+
+	run_bands (pool.job);
+    }
+
+    UNLOCK (&pool.lock);
+
+    return NULL;
+}
+
+/* Makes sure there are at least threads - 1 workers. Called with
+ * pool.lock held.
+ */
+static void
+start_workers (int threads)
+{
+    while (pool.n_workers < threads - 1)
+    {
+	if (pthread_create (&pool.workers[pool.n_workers],
+			    NULL, worker_main, NULL) != 0)
+	{
+	    break;
+	}
+
+	pool.n_workers++;
+    }
+}
+
+/* Wakes up the workers, tells them to exit and waits until they have */
+static void
+stop_workers (void)
+{
+    int i;
+
+    LOCK (&pool.job_lock);
+    LOCK (&pool.lock);
+
+    pool.quit = TRUE;
+    pthread_cond_broadcast (&pool.work_available);
+
+    UNLOCK (&pool.lock);
+
+    for (i = 0; i < pool.n_workers; ++i)
+	pthread_join (pool.workers[i], NULL);
+
+    pool.n_workers = 0;
+    pool.quit = FALSE;
+
+    UNLOCK (&pool.job_lock);
+}
+
+#ifdef TOOLCHAIN_SUPPORTS_ATTRIBUTE_CONSTRUCTOR
+/* Don't leave workers behind when pixman is unloaded */
+static void __attribute__((destructor))
+pixman_threads_destructor (void)
+{
+    stop_workers ();
+}
+#endif
+
+static void
+run_job (job_t *job, int threads)
+{
+    LOCK (&pool.lock);
+
+    start_workers (threads);
+
+    pool.job = job;
+    pthread_cond_broadcast (&pool.work_available);
+
+    run_bands (job);
+
+    while (job->n_done < job->n_bands)
+	pthread_cond_wait (&pool.job_done, &pool.lock);
+
+    pool.job = NULL;
+
+    UNLOCK (&pool.lock);
+}
+
+static pixman_bool_t
+images_overlap (pixman_image_t *image, pixman_image_t *dest)
+{
+    uint8_t *a0, *a1, *b0, *b1;
+    int stride;
+
+    if (!image || image->type != BITS)
+	return FALSE;
+
+    if (image == dest)
+	return TRUE;
+
+    stride = image->bits.rowstride * (int) sizeof (uint32_t);
+    a0 = (uint8_t *)image->bits.bits;
+    a1 = a0 + stride * image->bits.height;
+    if (a1 < a0)
+    {
+	uint8_t *t = a0;
+	a0 = a1 - stride;
+	a1 = t - stride;
+    }
+
+    stride = dest->bits.rowstride * (int) sizeof (uint32_t);
+    b0 = (uint8_t *)dest->bits.bits;
+    b1 = b0 + stride * dest->bits.height;
+    if (b1 < b0)
+    {
+	uint8_t *t = b0;
+	b0 = b1 - stride;
+	b1 = t - stride;
+    }
+
+    return a0 < b1 && b0 < a1;
+}
+
+/* Alpha maps are not covered by FAST_PATH_NO_ACCESSORS, and they are
+ * rare enough that composites using them just stay single-threaded.
+ */
+static pixman_bool_t
+has_accessors (pixman_image_t *image)
+{
+    return image &&
+	(!(image->common.flags & FAST_PATH_NO_ACCESSORS) || image->common.alpha_map);
+}
+
+#endif
+
+pixman_bool_t
+_pixman_composite_parallel (pixman_implementation_t *imp,
+			    pixman_composite_func_t  func,
+			    pixman_composite_info_t *info,
+			    const pixman_box32_t    *boxes,
+			    int                      n_boxes,
+			    int32_t                  src_dx,
+			    int32_t                  src_dy,
+			    int32_t                  mask_dx,
+			    int32_t                  mask_dy)
+{
+#ifdef HAVE_PTHREADS
+    pixman_box32_t stack_bands[N_STACK_BANDS];
+    pixman_box32_t *bands;
+    int64_t n_pixels;
+    int threads, n_bands, i;
+    job_t job;
+
+    threads = ATOMIC_LOAD_RELAXED (&n_threads);
+    if (threads <= 1)
+	return FALSE;
+
+    n_pixels = 0;
+    n_bands = 0;
+    for (i = 0; i < n_boxes; ++i)
+    {
+	int height = boxes[i].y2 - boxes[i].y1;
+
+	n_pixels += (int64_t)(boxes[i].x2 - boxes[i].x1) * height;
+	n_bands += CLIP (height / MIN_BAND_HEIGHT, 1, threads);
+    }
+
+    if (n_pixels < MIN_PARALLEL_PIXELS)
+	return FALSE;
+
+    /* Accessors are user callbacks that may not be thread safe, and
+     * when the source or mask shares memory with the destination, the
+     * order the rows are written in matters.
+     */
+    if (has_accessors (info->src_image)			||
+	has_accessors (info->mask_image)			||
+	has_accessors (info->dest_image)			||
+	images_overlap (info->src_image, info->dest_image)	||
+	images_overlap (info->mask_image, info->dest_image))
+    {
+	return FALSE;
+    }
+
+    if (!TRYLOCK (&pool.job_lock))
+	return FALSE;
+
+    bands = stack_bands;
+    if (n_bands > N_STACK_BANDS)
+    {
+	bands = pixman_malloc_ab (n_bands, sizeof (pixman_box32_t));
+	if (!bands)
+	{
+	    UNLOCK (&pool.job_lock);
+	    return FALSE;
+	}
+    }
+
+    n_bands = 0;
+    for (i = 0; i < n_boxes; ++i)
+    {
+	const pixman_box32_t *box = &boxes[i];
+	int height = box->y2 - box->y1;
+	int n = CLIP (height / MIN_BAND_HEIGHT, 1, threads);
+	int j;
+
+	for (j = 0; j < n; ++j)
+	{
+	    pixman_box32_t *band = &bands[n_bands++];
+
+	    band->x1 = box->x1;
+	    band->x2 = box->x2;
+	    band->y1 = box->y1 + (int)((int64_t)height * j / n);
+	    band->y2 = box->y1 + (int)((int64_t)height * (j + 1) / n);
+	}
+    }
+
+    job.imp = imp;
+    job.func = func;
+    job.info = info;
+    job.bands = bands;
+    job.n_bands = n_bands;
+    job.src_dx = src_dx;
+    job.src_dy = src_dy;
+    job.mask_dx = mask_dx;
+    job.mask_dy = mask_dy;
+    job.next_band = 0;
+    job.n_done = 0;
+
+    run_job (&job, threads);
+
+    if (bands != stack_bands)
+	free (bands);
+
+    UNLOCK (&pool.job_lock);
+
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+void
+_pixman_threads_init (void)
+{
+    const char *env;
+
+    if ((env = getenv ("PIXMAN_THREADS")))
+	pixman_set_thread_count (atoi (env));
+}
+
+PIXMAN_EXPORT void
+pixman_set_thread_count (int count)
+{
+#ifdef HAVE_PTHREADS
+    ATOMIC_STORE_RELAXED (&n_threads, CLIP (count, 1, MAX_THREADS));
+
+    /* Going back to one thread stops the workers */
+    if (count <= 1)
+	stop_workers ();
+#endif
+}
+
+PIXMAN_EXPORT int
+pixman_get_thread_count (void)
+{
+    return ATOMIC_LOAD_RELAXED (&n_threads);
+}
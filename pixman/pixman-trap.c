@@ -523,8 +523,8 @@ pixman_composite_trapezoids (pixman_op_t		op,
 	if (!get_trap_extents (op, dst, traps, n_traps, &box))
 	    return;
 	
-	if (!(tmp = pixman_image_create_bits (
-		  mask_format, box.x2 - box.x1, box.y2 - box.y1, NULL, -1)))
+	if (!(tmp = _pixman_image_create_scratch_bits (
+		  mask_format, box.x2 - box.x1, box.y2 - box.y1)))
 	    return;
 	
 	for (i = 0; i < n_traps; ++i)
@@ -658,7 +658,10 @@ convert_triangles (int n_tris, const pixman_triangle_t *tris)
     if (n_tris <= 0)
 	return NULL;
     
-    traps = pixman_malloc_ab (n_tris, 2 * sizeof (pixman_trapezoid_t));
+    if (_pixman_multiply_overflows_size (n_tris, 2 * sizeof (pixman_trapezoid_t)))
+	return NULL;
+
+    traps = _pixman_scratch_alloc (n_tris * 2 * sizeof (pixman_trapezoid_t));
     if (!traps)
 	return NULL;
 
@@ -688,7 +691,7 @@ pixman_composite_triangles (pixman_op_t			op,
 				     x_src, y_src, x_dst, y_dst,
 				     n_tris * 2, traps);
 	
-	free (traps);
+	_pixman_scratch_free (traps);
     }
 }
 
@@ -706,6 +709,6 @@ pixman_add_triangles (pixman_image_t          *image,
 	pixman_add_trapezoids (image, x_off, y_off,
 			       n_tris * 2, traps);
 
-	free (traps);
+	_pixman_scratch_free (traps);
     }
 }
@@ -25,7 +25,7 @@
 
 #include "pixman-private.h"
 
-#if defined(USE_X86_MMX) || defined (USE_SSE2)
+#if defined(USE_X86_MMX) || defined (USE_SSE2) || defined (USE_AVX2)
 
 /* The CPU detection code needs to be in a file not compiled with
  * "-mmmx -msse", as gcc would generate CMOV instructions otherwise
@@ -39,7 +39,8 @@ typedef enum
     X86_MMX_EXTENSIONS		= (1 << 1),
     X86_SSE			= (1 << 2) | X86_MMX_EXTENSIONS,
     X86_SSE2			= (1 << 3),
-    X86_CMOV			= (1 << 4)
+    X86_CMOV			= (1 << 4),
+    X86_AVX2			= (1 << 5)
 } cpu_features_t;
 
 #ifdef HAVE_GETISAX
@@ -50,20 +51,25 @@ static cpu_features_t
 detect_cpu_features (void)
 {
     cpu_features_t features = 0;
-    unsigned int result = 0;
+    unsigned int result[2] = { 0, 0 };
+    unsigned int n;
 
-    if (getisax (&result, 1))
+    if ((n = getisax (result, 2)))
     {
-	if (result & AV_386_CMOV)
+	if (result[0] & AV_386_CMOV)
 	    features |= X86_CMOV;
-	if (result & AV_386_MMX)
+	if (result[0] & AV_386_MMX)
 	    features |= X86_MMX;
-	if (result & AV_386_AMD_MMX)
+	if (result[0] & AV_386_AMD_MMX)
 	    features |= X86_MMX_EXTENSIONS;
-	if (result & AV_386_SSE)
+	if (result[0] & AV_386_SSE)
 	    features |= X86_SSE;
-	if (result & AV_386_SSE2)
+	if (result[0] & AV_386_SSE2)
 	    features |= X86_SSE2;
+#ifdef AV_386_2_AVX2
+	if (n > 1 && (result[1] & AV_386_2_AVX2))
+	    features |= X86_AVX2;
+#endif
     }
 
     return features;
@@ -71,6 +77,10 @@ detect_cpu_features (void)
 
 #else
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define _PIXMAN_X86_64							\
     (defined(__amd64__) || defined(__x86_64__) || defined(_M_AMD64))
 
@@ -107,7 +117,7 @@ have_cpuid (void)
 }
 
 static void
-pixman_cpuid (uint32_t feature,
+pixman_cpuid (uint32_t feature, uint32_t subleaf,
 	      uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
 {
 #if defined (__GNUC__)
@@ -116,7 +126,7 @@ pixman_cpuid (uint32_t feature,
     __asm__ volatile (
         "cpuid"				"\n\t"
 	: "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
-	: "a" (feature));
+	: "a" (feature), "c" (subleaf));
 #else
     /* On x86-32 we need to be careful about the handling of %ebx
      * and %esp. We can't declare either one as clobbered
@@ -131,13 +141,13 @@ pixman_cpuid (uint32_t feature,
 	"cpuid"				"\n\t"
 	"xchg %%ebx, %1"		"\n\t"
 	: "=a" (*a), "=r" (*b), "=c" (*c), "=d" (*d)
-	: "a" (feature));
+	: "a" (feature), "c" (subleaf));
 #endif
 
 #elif defined (_MSC_VER)
     int info[4];
 
-    __cpuid (info, feature);
+    __cpuidex (info, feature, subleaf);
 
     *a = info[0];
     *b = info[1];
@@ -148,6 +158,30 @@ pixman_cpuid (uint32_t feature,
 #endif
 }
 
+/* Reads the XCR0 register, which tells which register states the
+ * OS saves on context switches. Only call this when CPUID reports
+ * OSXSAVE.
+ */
+static uint32_t
+pixman_xgetbv (void)
+{
+#if defined (__GNUC__)
+    uint32_t eax, edx;
+
+    /* xgetbv, spelled out for assemblers that don't know it */
+    __asm__ volatile (
+	".byte 0x0f, 0x01, 0xd0"	"\n\t"
+	: "=a" (eax), "=d" (edx)
+	: "c" (0));
+
+    return eax;
+#elif defined (_MSC_VER)
+    return (uint32_t)_xgetbv (0);
+#else
+#error Unknown compiler
+#endif
+}
+
 static cpu_features_t
 detect_cpu_features (void)
 {
@@ -158,7 +192,7 @@ detect_cpu_features (void)
 	return features;
 
     /* Get feature bits */
-    pixman_cpuid (0x01, &a, &b, &c, &d);
+    pixman_cpuid (0x01, 0, &a, &b, &c, &d);
     if (d & (1 << 15))
 	features |= X86_CMOV;
     if (d & (1 << 23))
@@ -168,6 +202,20 @@ detect_cpu_features (void)
     if (d & (1 << 26))
 	features |= X86_SSE2;
 
+    /* AVX2 needs both the CPU support (leaf 7) and the OS saving
+     * the YMM registers (OSXSAVE + AVX, and XCR0 bits 1 and 2).
+     */
+    if ((c & (1 << 27)) && (c & (1 << 28)) && (pixman_xgetbv () & 0x6) == 0x6)
+    {
+	pixman_cpuid (0x00, 0, &a, &b, &c, &d);
+	if (a >= 0x07)
+	{
+	    pixman_cpuid (0x07, 0, &a, &b, &c, &d);
+	    if (b & (1 << 5))
+		features |= X86_AVX2;
+	}
+    }
+
     /* Check for AMD specific features */
     if ((features & X86_MMX) && !(features & X86_SSE))
     {
@@ -176,7 +224,7 @@ detect_cpu_features (void)
 	/* Get vendor string */
 	memset (vendor, 0, sizeof vendor);
 
-	pixman_cpuid (0x00, &a, &b, &c, &d);
+	pixman_cpuid (0x00, 0, &a, &b, &c, &d);
 	memcpy (vendor + 0, &b, 4);
 	memcpy (vendor + 4, &d, 4);
 	memcpy (vendor + 8, &c, 4);
@@ -184,10 +232,10 @@ detect_cpu_features (void)
 	if (strcmp (vendor, "AuthenticAMD") == 0 ||
 	    strcmp (vendor, "Geode by NSC") == 0)
 	{
-	    pixman_cpuid (0x80000000, &a, &b, &c, &d);
+	    pixman_cpuid (0x80000000, 0, &a, &b, &c, &d);
 	    if (a >= 0x80000001)
 	    {
-		pixman_cpuid (0x80000001, &a, &b, &c, &d);
+		pixman_cpuid (0x80000001, 0, &a, &b, &c, &d);
 
 		if (d & (1 << 22))
 		    features |= X86_MMX_EXTENSIONS;
@@ -222,6 +270,7 @@ _pixman_x86_get_implementations (pixman_implementation_t *imp)
 {
 #define MMX_BITS  (X86_MMX | X86_MMX_EXTENSIONS)
 #define SSE2_BITS (X86_MMX | X86_MMX_EXTENSIONS | X86_SSE | X86_SSE2)
+#define AVX2_BITS (SSE2_BITS | X86_AVX2)
 
 #ifdef USE_X86_MMX
     if (!_pixman_disabled ("mmx") && have_feature (MMX_BITS))
@@ -233,5 +282,10 @@ _pixman_x86_get_implementations (pixman_implementation_t *imp)
 	imp = _pixman_implementation_create_sse2 (imp);
 #endif
 
+#if defined (USE_SSE2) && defined (USE_AVX2)
+    if (!_pixman_disabled ("avx2") && have_feature (AVX2_BITS))
+	imp = _pixman_implementation_create_avx2 (imp);
+#endif
+
     return imp;
 }
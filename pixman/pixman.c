@@ -564,92 +564,137 @@ analyze_extent (pixman_image_t       *image,
  * See https://bugs.freedesktop.org/show_bug.cgi?id=15693
  */
 #if defined (USE_SSE2) && defined(__GNUC__) && !defined(__x86_64__) && !defined(__amd64__)
-__attribute__((__force_align_arg_pointer__))
+#define FORCE_ALIGN_ARG_POINTER __attribute__((__force_align_arg_pointer__))
+#else
+#define FORCE_ALIGN_ARG_POINTER
 #endif
-PIXMAN_EXPORT void
-pixman_image_composite32 (pixman_op_t      op,
-                          pixman_image_t * src,
-                          pixman_image_t * mask,
-                          pixman_image_t * dest,
-                          int32_t          src_x,
-                          int32_t          src_y,
-                          int32_t          mask_x,
-                          int32_t          mask_y,
-                          int32_t          dest_x,
-                          int32_t          dest_y,
-                          int32_t          width,
-                          int32_t          height)
+
+/* The result of the last composite function lookup done by a batch */
+typedef struct
 {
-    pixman_format_code_t src_format, mask_format, dest_format;
-    pixman_region32_t region;
-    pixman_box32_t extents;
-    pixman_implementation_t *imp;
-    pixman_composite_func_t func;
-    pixman_composite_info_t info;
-    const pixman_box32_t *pbox;
-    int n;
+    pixman_implementation_t *	imp;
+    pixman_fast_path_t		fast_path;
+} composite_dispatch_t;
+
+static void
+composite_boxes (pixman_implementation_t *imp,
+		 pixman_composite_func_t  func,
+		 pixman_composite_info_t *info,
+		 const pixman_box32_t    *pbox,
+		 int                      n,
+		 int32_t                  src_dx,
+		 int32_t                  src_dy,
+		 int32_t                  mask_dx,
+		 int32_t                  mask_dy)
+{
+    if (_pixman_composite_parallel (imp, func, info, pbox, n,
+				    src_dx, src_dy, mask_dx, mask_dy))
+    {
+	return;
+    }
 
-    _pixman_image_validate (src);
-    if (mask)
-	_pixman_image_validate (mask);
-    _pixman_image_validate (dest);
+    while (n--)
+    {
+	info->src_x = pbox->x1 + src_dx;
+	info->src_y = pbox->y1 + src_dy;
+	info->mask_x = pbox->x1 + mask_dx;
+	info->mask_y = pbox->y1 + mask_dy;
+	info->dest_x = pbox->x1;
+	info->dest_y = pbox->y1;
+	info->width = pbox->x2 - pbox->x1;
+	info->height = pbox->y2 - pbox->y1;
 
-    src_format = src->common.extended_format_code;
-    info.src_flags = src->common.flags;
+	func (imp, info);
+
+	pbox++;
+    }
+}
+
+/* The formats of a composite, and the extents in source and mask space
+ * that its flags were computed for.
+ */
+typedef struct
+{
+    pixman_format_code_t	src_format;
+    pixman_format_code_t	mask_format;
+    pixman_format_code_t	dest_format;
+    pixman_box32_t		src_extents;
+    pixman_box32_t		mask_extents;
+} composite_analysis_t;
+
+/* Computes the formats, flags and operator of a composite whose clipped
+ * destination area is @region. Returns FALSE if nothing should be
+ * composited.
+ */
+static pixman_bool_t
+analyze_composite (pixman_op_t              op,
+		   pixman_image_t *         src,
+		   pixman_image_t *         mask,
+		   pixman_image_t *         dest,
+		   int32_t                  src_x,
+		   int32_t                  src_y,
+		   int32_t                  mask_x,
+		   int32_t                  mask_y,
+		   int32_t                  dest_x,
+		   int32_t                  dest_y,
+		   pixman_region32_t *      region,
+		   composite_analysis_t *   analysis,
+		   pixman_composite_info_t *info)
+{
+    pixman_box32_t extents;
+
+    analysis->src_format = src->common.extended_format_code;
+    info->src_flags = src->common.flags;
 
     if (mask && !(mask->common.flags & FAST_PATH_IS_OPAQUE))
     {
-	mask_format = mask->common.extended_format_code;
-	info.mask_flags = mask->common.flags;
+	analysis->mask_format = mask->common.extended_format_code;
+	info->mask_flags = mask->common.flags;
     }
     else
     {
-	mask_format = PIXMAN_null;
-	info.mask_flags = FAST_PATH_IS_OPAQUE;
+	analysis->mask_format = PIXMAN_null;
+	info->mask_flags = FAST_PATH_IS_OPAQUE;
     }
 
-    dest_format = dest->common.extended_format_code;
-    info.dest_flags = dest->common.flags;
+    analysis->dest_format = dest->common.extended_format_code;
+    info->dest_flags = dest->common.flags;
 
     /* Check for pixbufs */
-    if ((mask_format == PIXMAN_a8r8g8b8 || mask_format == PIXMAN_a8b8g8r8) &&
+    if ((analysis->mask_format == PIXMAN_a8r8g8b8 ||
+	 analysis->mask_format == PIXMAN_a8b8g8r8)			   &&
 	(src->type == BITS && src->bits.bits == mask->bits.bits)	   &&
 	(src->common.repeat == mask->common.repeat)			   &&
-	(info.src_flags & info.mask_flags & FAST_PATH_ID_TRANSFORM)	   &&
+	(info->src_flags & info->mask_flags & FAST_PATH_ID_TRANSFORM)	   &&
 	(src_x == mask_x && src_y == mask_y))
     {
-	if (src_format == PIXMAN_x8b8g8r8)
-	    src_format = mask_format = PIXMAN_pixbuf;
-	else if (src_format == PIXMAN_x8r8g8b8)
-	    src_format = mask_format = PIXMAN_rpixbuf;
+	if (analysis->src_format == PIXMAN_x8b8g8r8)
+	    analysis->src_format = analysis->mask_format = PIXMAN_pixbuf;
+	else if (analysis->src_format == PIXMAN_x8r8g8b8)
+	    analysis->src_format = analysis->mask_format = PIXMAN_rpixbuf;
     }
 
-    pixman_region32_init (&region);
-
-    if (!_pixman_compute_composite_region32 (
-	    &region, src, mask, dest,
-	    src_x, src_y, mask_x, mask_y, dest_x, dest_y, width, height))
-    {
-	goto out;
-    }
-
-    extents = *pixman_region32_extents (&region);
+    extents = *pixman_region32_extents (region);
 
     extents.x1 -= dest_x - src_x;
     extents.y1 -= dest_y - src_y;
     extents.x2 -= dest_x - src_x;
     extents.y2 -= dest_y - src_y;
 
-    if (!analyze_extent (src, &extents, &info.src_flags))
-	goto out;
+    analysis->src_extents = extents;
+
+    if (!analyze_extent (src, &extents, &info->src_flags))
+	return FALSE;
 
     extents.x1 -= src_x - mask_x;
     extents.y1 -= src_y - mask_y;
     extents.x2 -= src_x - mask_x;
     extents.y2 -= src_y - mask_y;
 
-    if (!analyze_extent (mask, &extents, &info.mask_flags))
-	goto out;
+    analysis->mask_extents = extents;
+
+    if (!analyze_extent (mask, &extents, &info->mask_flags))
+	return FALSE;
 
     /* If the clip is within the source samples, and the samples are
      * opaque, then the source is effectively opaque.
@@ -661,16 +706,16 @@ pixman_image_composite32 (pixman_op_t      op,
 			 FAST_PATH_BILINEAR_FILTER |			\
 			 FAST_PATH_SAMPLES_COVER_CLIP_BILINEAR)
 
-    if ((info.src_flags & NEAREST_OPAQUE) == NEAREST_OPAQUE ||
-	(info.src_flags & BILINEAR_OPAQUE) == BILINEAR_OPAQUE)
+    if ((info->src_flags & NEAREST_OPAQUE) == NEAREST_OPAQUE ||
+	(info->src_flags & BILINEAR_OPAQUE) == BILINEAR_OPAQUE)
     {
-	info.src_flags |= FAST_PATH_IS_OPAQUE;
+	info->src_flags |= FAST_PATH_IS_OPAQUE;
     }
 
-    if ((info.mask_flags & NEAREST_OPAQUE) == NEAREST_OPAQUE ||
-	(info.mask_flags & BILINEAR_OPAQUE) == BILINEAR_OPAQUE)
+    if ((info->mask_flags & NEAREST_OPAQUE) == NEAREST_OPAQUE ||
+	(info->mask_flags & BILINEAR_OPAQUE) == BILINEAR_OPAQUE)
     {
-	info.mask_flags |= FAST_PATH_IS_OPAQUE;
+	info->mask_flags |= FAST_PATH_IS_OPAQUE;
     }
 
     /*
@@ -678,41 +723,428 @@ pixman_image_composite32 (pixman_op_t      op,
      * if the src or dest are opaque. The output operator should be
      * mathematically equivalent to the source.
      */
-    info.op = optimize_operator (op, info.src_flags, info.mask_flags, info.dest_flags);
+    info->op = optimize_operator (op, info->src_flags, info->mask_flags, info->dest_flags);
 
-    _pixman_implementation_lookup_composite (
-	get_implementation (), info.op,
-	src_format, info.src_flags,
-	mask_format, info.mask_flags,
-	dest_format, info.dest_flags,
-	&imp, &func);
+    return TRUE;
+}
+
+/* Composites the boxes of @region with the function that was looked up
+ * for @info.
+ */
+static void
+composite_region (pixman_implementation_t    *imp,
+		  pixman_composite_func_t     func,
+		  pixman_composite_info_t    *info,
+		  const composite_analysis_t *analysis,
+		  pixman_region32_t          *region,
+		  int32_t                     src_dx,
+		  int32_t                     src_dy,
+		  int32_t                     mask_dx,
+		  int32_t                     mask_dy)
+{
+    const pixman_box32_t *pbox;
+    int n;
+
+    pbox = pixman_region32_rectangles (region, &n);
+
+    if (_pixman_composite_stats_enabled)
+    {
+	uint64_t n_pixels = 0, stamp;
+	int i;
+
+	for (i = 0; i < n; ++i)
+	    n_pixels += (uint64_t)(pbox[i].x2 - pbox[i].x1) * (pbox[i].y2 - pbox[i].y1);
+
+	stamp = _pixman_composite_stats_stamp ();
+
+	composite_boxes (imp, func, info, pbox, n,
+			 src_dx, src_dy, mask_dx, mask_dy);
+
+	_pixman_composite_stats_record (
+	    info->op, analysis->src_format, analysis->mask_format,
+	    analysis->dest_format, imp,
+	    n_pixels, _pixman_composite_stats_stamp () - stamp);
+    }
+    else
+    {
+	composite_boxes (imp, func, info, pbox, n,
+			 src_dx, src_dy, mask_dx, mask_dy);
+    }
+}
+
+/* Composites with images that have already been validated. If
+ * @dispatch is not NULL, the lookup result it holds is used when the
+ * operator, formats and flags are the same, and updated otherwise.
+ */
+static void
+image_composite (pixman_op_t           op,
+		 pixman_image_t *      src,
+		 pixman_image_t *      mask,
+		 pixman_image_t *      dest,
+		 int32_t               src_x,
+		 int32_t               src_y,
+		 int32_t               mask_x,
+		 int32_t               mask_y,
+		 int32_t               dest_x,
+		 int32_t               dest_y,
+		 int32_t               width,
+		 int32_t               height,
+		 composite_dispatch_t *dispatch)
+{
+    composite_analysis_t analysis;
+    pixman_region32_t region;
+    pixman_implementation_t *imp;
+    pixman_composite_func_t func;
+    pixman_composite_info_t info;
+
+    pixman_region32_init (&region);
+
+    if (!_pixman_compute_composite_region32 (
+	    &region, src, mask, dest,
+	    src_x, src_y, mask_x, mask_y, dest_x, dest_y, width, height))
+    {
+	goto out;
+    }
+
+    if (!analyze_composite (op, src, mask, dest,
+			    src_x, src_y, mask_x, mask_y, dest_x, dest_y,
+			    &region, &analysis, &info))
+    {
+	goto out;
+    }
+
+    if (dispatch							&&
+	dispatch->fast_path.func					&&
+	dispatch->fast_path.op == info.op				&&
+	dispatch->fast_path.src_format == analysis.src_format		&&
+	dispatch->fast_path.src_flags == info.src_flags			&&
+	dispatch->fast_path.mask_format == analysis.mask_format		&&
+	dispatch->fast_path.mask_flags == info.mask_flags		&&
+	dispatch->fast_path.dest_format == analysis.dest_format		&&
+	dispatch->fast_path.dest_flags == info.dest_flags)
+    {
+	imp = dispatch->imp;
+	func = dispatch->fast_path.func;
+    }
+    else
+    {
+	_pixman_implementation_lookup_composite (
+	    get_implementation (), info.op,
+	    analysis.src_format, info.src_flags,
+	    analysis.mask_format, info.mask_flags,
+	    analysis.dest_format, info.dest_flags,
+	    &imp, &func);
+
+	if (dispatch)
+	{
+	    dispatch->imp = imp;
+	    dispatch->fast_path.op = info.op;
+	    dispatch->fast_path.src_format = analysis.src_format;
+	    dispatch->fast_path.src_flags = info.src_flags;
+	    dispatch->fast_path.mask_format = analysis.mask_format;
+	    dispatch->fast_path.mask_flags = info.mask_flags;
+	    dispatch->fast_path.dest_format = analysis.dest_format;
+	    dispatch->fast_path.dest_flags = info.dest_flags;
+	    dispatch->fast_path.func = func;
+	}
+    }
 
     info.src_image = src;
     info.mask_image = mask;
     info.dest_image = dest;
 
-    pbox = pixman_region32_rectangles (&region, &n);
+    composite_region (imp, func, &info, &analysis, &region,
+		      src_x - dest_x, src_y - dest_y,
+		      mask_x - dest_x, mask_y - dest_y);
 
-    while (n--)
+out:
+    pixman_region32_fini (&region);
+}
+
+FORCE_ALIGN_ARG_POINTER
+PIXMAN_EXPORT void
+pixman_image_composite32 (pixman_op_t      op,
+                          pixman_image_t * src,
+                          pixman_image_t * mask,
+                          pixman_image_t * dest,
+                          int32_t          src_x,
+                          int32_t          src_y,
+                          int32_t          mask_x,
+                          int32_t          mask_y,
+                          int32_t          dest_x,
+                          int32_t          dest_y,
+                          int32_t          width,
+                          int32_t          height)
+{
+    _pixman_image_validate (src);
+    if (mask)
+	_pixman_image_validate (mask);
+    _pixman_image_validate (dest);
+
+    image_composite (op, src, mask, dest,
+		     src_x, src_y, mask_x, mask_y, dest_x, dest_y,
+		     width, height, NULL);
+
+    _pixman_image_pixels_written (dest);
+}
+
+FORCE_ALIGN_ARG_POINTER
+PIXMAN_EXPORT void
+pixman_image_composite_batch (pixman_image_t                  *dest,
+			      int                              n_records,
+			      const pixman_composite_record_t *records)
+{
+    composite_dispatch_t dispatch;
+    pixman_image_t *last_src = NULL;
+    pixman_image_t *last_mask = NULL;
+    int i;
+
+    if (n_records <= 0)
+	return;
+
+    memset (&dispatch, 0, sizeof dispatch);
+
+    _pixman_image_validate (dest);
+
+    for (i = 0; i < n_records; ++i)
     {
-	info.src_x = pbox->x1 + src_x - dest_x;
-	info.src_y = pbox->y1 + src_y - dest_y;
-	info.mask_x = pbox->x1 + mask_x - dest_x;
-	info.mask_y = pbox->y1 + mask_y - dest_y;
-	info.dest_x = pbox->x1;
-	info.dest_y = pbox->y1;
-	info.width = pbox->x2 - pbox->x1;
-	info.height = pbox->y2 - pbox->y1;
+	const pixman_composite_record_t *r = &records[i];
 
-	func (imp, &info);
+	/* Nothing can change the images while the batch runs, so
+	 * they only need to be validated when they differ from the
+	 * ones of the previous record.
+	 */
+	if (r->src != last_src)
+	{
+	    _pixman_image_validate (r->src);
+	    last_src = r->src;
+	}
 
-	pbox++;
+	if (r->mask && r->mask != last_mask)
+	{
+	    _pixman_image_validate (r->mask);
+	    last_mask = r->mask;
+	}
+
+	image_composite (r->op, r->src, r->mask, dest,
+			 r->src_x, r->src_y, r->mask_x, r->mask_y,
+			 r->dest_x, r->dest_y, r->width, r->height,
+			 &dispatch);
     }
 
+    _pixman_image_pixels_written (dest);
+}
+
+struct pixman_composite_plan
+{
+    pixman_op_t			op;
+    pixman_image_t *		src;
+    pixman_image_t *		mask;
+    pixman_image_t *		dest;
+
+    /* The last analysis, and what it was made for */
+    pixman_bool_t		analyzed;
+    uint32_t			src_serial;
+    uint32_t			mask_serial;
+    uint32_t			dest_serial;
+    int32_t			mask_src_dx;
+    int32_t			mask_src_dy;
+    composite_analysis_t	analysis;
+    pixman_composite_info_t	info;
+    pixman_implementation_t *	imp;
+    pixman_composite_func_t	func;
+};
+
+PIXMAN_EXPORT pixman_composite_plan_t *
+pixman_composite_plan_create (pixman_op_t     op,
+			      pixman_image_t *src,
+			      pixman_image_t *mask,
+			      pixman_image_t *dest)
+{
+    pixman_composite_plan_t *plan;
+
+    return_val_if_fail (src != NULL && dest != NULL, NULL);
+    return_val_if_fail (dest->type == BITS, NULL);
+
+    if (!(plan = malloc (sizeof (pixman_composite_plan_t))))
+	return NULL;
+
+    plan->op = op;
+    plan->src = pixman_image_ref (src);
+    plan->mask = mask ? pixman_image_ref (mask) : NULL;
+    plan->dest = pixman_image_ref (dest);
+    plan->analyzed = FALSE;
+
+    return plan;
+}
+
+static pixman_bool_t
+box_contains (const pixman_box32_t *outer, const pixman_box32_t *inner)
+{
+    return inner->x1 >= outer->x1 && inner->y1 >= outer->y1 &&
+	inner->x2 <= outer->x2 && inner->y2 <= outer->y2;
+}
+
+/* Whether analyze_extent() sets the same flags for every part of an
+ * area whose flags are @flags. Only images that cover the area with
+ * all of the sampling modes they could have can't gain any.
+ */
+static pixman_bool_t
+extent_flags_final (pixman_image_t *image, uint32_t flags)
+{
+    uint32_t cover;
+
+    if (!image || image->common.type != BITS)
+	return TRUE;
+
+    if ((image->common.flags & FAST_PATH_ID_TRANSFORM) == FAST_PATH_ID_TRANSFORM)
+	cover = FAST_PATH_SAMPLES_COVER_CLIP_NEAREST;
+    else
+	cover = FAST_PATH_SAMPLES_COVER_CLIP_NEAREST | FAST_PATH_SAMPLES_COVER_CLIP_BILINEAR;
+
+    return (flags & cover) == cover;
+}
+
+/* Whether the flags of the last analysis also hold for a composite at
+ * the new coordinates, which is the case when the images are unchanged
+ * and the new area lies within the old one of each image where nothing
+ * about it could change.
+ */
+static pixman_bool_t
+plan_analysis_holds (pixman_composite_plan_t *plan,
+		     pixman_region32_t       *region,
+		     int32_t                  src_x,
+		     int32_t                  src_y,
+		     int32_t                  mask_x,
+		     int32_t                  mask_y,
+		     int32_t                  dest_x,
+		     int32_t                  dest_y)
+{
+    pixman_image_t *mask = plan->mask;
+    pixman_box32_t extents;
+
+    if (!plan->analyzed						||
+	plan->src->common.serial != plan->src_serial		||
+	plan->dest->common.serial != plan->dest_serial)
+    {
+	return FALSE;
+    }
+
+    /* The offset of the mask decides whether it's a pixbuf */
+    if (mask && (mask->common.serial != plan->mask_serial	||
+		 mask_x - src_x != plan->mask_src_dx		||
+		 mask_y - src_y != plan->mask_src_dy))
+    {
+	return FALSE;
+    }
+
+    if (!extent_flags_final (plan->src, plan->info.src_flags)	||
+	!extent_flags_final (mask, plan->info.mask_flags))
+    {
+	return FALSE;
+    }
+
+    extents = *pixman_region32_extents (region);
+
+    extents.x1 -= dest_x - src_x;
+    extents.y1 -= dest_y - src_y;
+    extents.x2 -= dest_x - src_x;
+    extents.y2 -= dest_y - src_y;
+
+    if (!box_contains (&plan->analysis.src_extents, &extents))
+	return FALSE;
+
+    extents.x1 -= src_x - mask_x;
+    extents.y1 -= src_y - mask_y;
+    extents.x2 -= src_x - mask_x;
+    extents.y2 -= src_y - mask_y;
+
+    return box_contains (&plan->analysis.mask_extents, &extents);
+}
+
+FORCE_ALIGN_ARG_POINTER
+PIXMAN_EXPORT void
+pixman_composite_plan_execute (pixman_composite_plan_t *plan,
+			       int32_t                  src_x,
+			       int32_t                  src_y,
+			       int32_t                  mask_x,
+			       int32_t                  mask_y,
+			       int32_t                  dest_x,
+			       int32_t                  dest_y,
+			       int32_t                  width,
+			       int32_t                  height)
+{
+    pixman_image_t *src = plan->src;
+    pixman_image_t *mask = plan->mask;
+    pixman_image_t *dest = plan->dest;
+    pixman_region32_t region;
+
+    _pixman_image_validate (src);
+    if (mask)
+	_pixman_image_validate (mask);
+    _pixman_image_validate (dest);
+
+    pixman_region32_init (&region);
+
+    if (!_pixman_compute_composite_region32 (
+	    &region, src, mask, dest,
+	    src_x, src_y, mask_x, mask_y, dest_x, dest_y, width, height))
+    {
+	goto out;
+    }
+
+    if (!plan_analysis_holds (plan, &region,
+			      src_x, src_y, mask_x, mask_y, dest_x, dest_y))
+    {
+	plan->analyzed = FALSE;
+
+	if (!analyze_composite (plan->op, src, mask, dest,
+				src_x, src_y, mask_x, mask_y, dest_x, dest_y,
+				&region, &plan->analysis, &plan->info))
+	{
+	    goto out;
+	}
+
+	_pixman_implementation_lookup_composite (
+	    get_implementation (), plan->info.op,
+	    plan->analysis.src_format, plan->info.src_flags,
+	    plan->analysis.mask_format, plan->info.mask_flags,
+	    plan->analysis.dest_format, plan->info.dest_flags,
+	    &plan->imp, &plan->func);
+
+	plan->info.src_image = src;
+	plan->info.mask_image = mask;
+	plan->info.dest_image = dest;
+
+	plan->analyzed = TRUE;
+	plan->src_serial = src->common.serial;
+	plan->mask_serial = mask ? mask->common.serial : 0;
+	plan->dest_serial = dest->common.serial;
+	plan->mask_src_dx = mask_x - src_x;
+	plan->mask_src_dy = mask_y - src_y;
+    }
+
+    composite_region (plan->imp, plan->func, &plan->info, &plan->analysis,
+		      &region, src_x - dest_x, src_y - dest_y,
+		      mask_x - dest_x, mask_y - dest_y);
+
+    _pixman_image_pixels_written (dest);
+
 out:
     pixman_region32_fini (&region);
 }
 
+PIXMAN_EXPORT void
+pixman_composite_plan_destroy (pixman_composite_plan_t *plan)
+{
+    pixman_image_unref (plan->src);
+    if (plan->mask)
+	pixman_image_unref (plan->mask);
+    pixman_image_unref (plan->dest);
+
+    free (plan);
+}
+
 PIXMAN_EXPORT void
 pixman_image_composite (pixman_op_t      op,
                         pixman_image_t * src,
@@ -745,12 +1177,19 @@ pixman_blt (uint32_t *src_bits,
             int       width,
             int       height)
 {
-    return _pixman_implementation_blt (get_implementation(),
-				       src_bits, dst_bits, src_stride, dst_stride,
-                                       src_bpp, dst_bpp,
-                                       src_x, src_y,
-                                       dest_x, dest_y,
-                                       width, height);
+    if (!_pixman_implementation_blt (get_implementation(),
+				     src_bits, dst_bits, src_stride, dst_stride,
+				     src_bpp, dst_bpp,
+				     src_x, src_y,
+				     dest_x, dest_y,
+				     width, height))
+    {
+	return FALSE;
+    }
+
+    _pixman_mipmap_bits_written (dst_bits);
+
+    return TRUE;
 }
 
 PIXMAN_EXPORT pixman_bool_t
@@ -763,8 +1202,15 @@ pixman_fill (uint32_t *bits,
              int       height,
              uint32_t  filler)
 {
-    return _pixman_implementation_fill (
-	get_implementation(), bits, stride, bpp, x, y, width, height, filler);
+    if (!_pixman_implementation_fill (
+	    get_implementation(), bits, stride, bpp, x, y, width, height, filler))
+    {
+	return FALSE;
+    }
+
+    _pixman_mipmap_bits_written (bits);
+
+    return TRUE;
 }
 
 static uint32_t
@@ -316,6 +316,18 @@ typedef enum
     PIXMAN_FILTER_SEPARABLE_CONVOLUTION
 } pixman_filter_t;
 
+/* Bits images with a mipmap mode are sampled from 2x2 box reduced copies
+ * of themselves when their transform shrinks them by a factor of two or
+ * more, with their filter if it is NEAREST or BILINEAR (or FAST, GOOD or
+ * BEST). NEAREST uses the closest level, LINEAR blends the two closest.
+ */
+typedef enum
+{
+    PIXMAN_MIPMAP_NONE,
+    PIXMAN_MIPMAP_NEAREST,
+    PIXMAN_MIPMAP_LINEAR
+} pixman_mipmap_t;
+
 typedef enum
 {
     PIXMAN_OP_CLEAR			= 0x00,
@@ -811,6 +823,14 @@ pixman_bool_t   pixman_image_set_filter              (pixman_image_t
 						      pixman_filter_t               filter,
 						      const pixman_fixed_t         *filter_params,
 						      int                           n_filter_params);
+/* The reduced copies are made when they are first needed. They are
+ * dropped when the mipmap mode is set, when the indexed palette or the
+ * accessors of the image change, and when pixman writes to the image.
+ * pixman can't tell when the pixels are changed in any other way, so
+ * after that the mipmap mode has to be set again.
+ */
+void		pixman_image_set_mipmap              (pixman_image_t               *image,
+						      pixman_mipmap_t               mipmap);
 void		pixman_image_set_source_clipping     (pixman_image_t		   *image,
 						      pixman_bool_t                 source_clipping);
 void            pixman_image_set_alpha_map           (pixman_image_t               *image,
@@ -907,6 +927,93 @@ void          pixman_image_composite32        (pixman_op_t        op,
 					       int32_t            width,
 					       int32_t            height);
 
+/* Batched compositing: the records are composited onto one destination
+ * in order, exactly as if pixman_image_composite32() had been called for
+ * each of them, but images are only validated once and the composite
+ * function is reused between consecutive records that need the same one.
+ */
+typedef struct
+{
+    pixman_op_t		op;
+    pixman_image_t     *src;
+    pixman_image_t     *mask;
+    int32_t		src_x, src_y;
+    int32_t		mask_x, mask_y;
+    int32_t		dest_x, dest_y;
+    int32_t		width, height;
+} pixman_composite_record_t;
+
+void          pixman_image_composite_batch    (pixman_image_t                  *dest,
+					       int                              n_records,
+					       const pixman_composite_record_t *records);
+
+/* Composite plans: a plan remembers the operator and images of a
+ * composite that is repeated with different coordinates, along with the
+ * flags and composite function of the last execution. Executions within
+ * the area of that one reuse them without looking at the images again,
+ * as long as no property of the images changed.
+ */
+typedef struct pixman_composite_plan pixman_composite_plan_t;
+
+pixman_composite_plan_t *pixman_composite_plan_create  (pixman_op_t              op,
+							pixman_image_t          *src,
+							pixman_image_t          *mask,
+							pixman_image_t          *dest);
+void                     pixman_composite_plan_execute (pixman_composite_plan_t *plan,
+							int32_t                  src_x,
+							int32_t                  src_y,
+							int32_t                  mask_x,
+							int32_t                  mask_y,
+							int32_t                  dest_x,
+							int32_t                  dest_y,
+							int32_t                  width,
+							int32_t                  height);
+void                     pixman_composite_plan_destroy (pixman_composite_plan_t *plan);
+
+/* Large composites can be split into horizontal bands that are
+ * composited by several threads at once. The default is one thread,
+ * which can also be changed with the PIXMAN_THREADS environment
+ * variable. Setting the count back to one waits for the worker threads
+ * to exit; they are also stopped when pixman is unloaded.
+ */
+void          pixman_set_thread_count         (int                count);
+int           pixman_get_thread_count         (void);
+
+/* The temporary masks used for trapezoids, triangles and glyphs come
+ * from a cache of scratch memory that every thread keeps. This frees
+ * the memory cached by the calling thread.
+ */
+void          pixman_release_scratch          (void);
+
+/* Composite statistics: when enabled, every composite is counted under
+ * the operator and formats used to look up its composite function, and
+ * the implementation that provided it. The formats are the ones used for
+ * the lookup, so an absent or opaque mask has format 0, and solid images
+ * have a format of their own. The cycle counts come from the CPU's time
+ * stamp counter and are 0 where there isn't one.
+ *
+ * Setting the PIXMAN_STATS environment variable enables the statistics
+ * and prints them to stderr when the process exits.
+ */
+typedef struct
+{
+    pixman_op_t			op;
+    pixman_format_code_t	src_format;
+    pixman_format_code_t	mask_format;
+    pixman_format_code_t	dest_format;
+    const char *		implementation;
+    pixman_bool_t		general;	/* Handled by the general path */
+    uint64_t			n_calls;
+    uint64_t			n_lookups;	/* Fast path table lookups */
+    uint64_t			n_pixels;
+    uint64_t			n_cycles;
+} pixman_composite_stat_t;
+
+void          pixman_composite_stats_enable   (pixman_bool_t            enable);
+int           pixman_composite_stats_get      (pixman_composite_stat_t *list,
+					       int                      n_list);
+void          pixman_composite_stats_reset    (void);
+
 /* Executive Summary: This function is a no-op that only exists
  * for historical reasons.
  *
@@ -938,6 +1045,29 @@ typedef struct
 } pixman_glyph_t;
 
 pixman_glyph_cache_t *pixman_glyph_cache_create       (void);
+
+/* A concurrent glyph cache can be shared by threads without locking
+ * around it. Each thread freezes the cache while it looks up, inserts
+ * or composites glyphs, and the glyphs it gets stay valid until it
+ * thaws the cache again. Inserting a glyph that another thread inserted
+ * first returns that glyph. Removed and evicted glyphs are freed once no
+ * thread has the cache frozen. Returns NULL when pixman is built without
+ * thread support.
+ */
+pixman_glyph_cache_t *pixman_glyph_cache_create_concurrent (void);
+
+/* Creates an ordinary or a concurrent glyph cache that evicts the least
+ * recently used glyphs when thawed with more than n_bytes of glyphs in
+ * it, until it is down to three quarters of that. Each glyph is charged
+ * for the space that it takes up in the atlas image that it is packed
+ * into, at the bit depth of its format, plus some bookkeeping. Glyphs
+ * that are too big to share an atlas are charged for a whole one. Like
+ * other caches, it also evicts glyphs when it has too many of them for
+ * its hash table. A budget of 0 means no budget.
+ */
+pixman_glyph_cache_t *pixman_glyph_cache_create_with_budget (uint64_t      n_bytes,
+							    pixman_bool_t concurrent);
+
 void                  pixman_glyph_cache_destroy      (pixman_glyph_cache_t *cache);
 void                  pixman_glyph_cache_freeze       (pixman_glyph_cache_t *cache);
 void                  pixman_glyph_cache_thaw         (pixman_glyph_cache_t *cache);
@@ -953,6 +1083,25 @@ const void *          pixman_glyph_cache_insert       (pixman_glyph_cache_t *cac
 void                  pixman_glyph_cache_remove       (pixman_glyph_cache_t *cache,
 						       void                 *font_key,
 						       void                 *glyph_key);
+
+/* Lookups are counted as hits or misses; threads that have a concurrent
+ * cache frozen add theirs when they thaw it. Evictions are glyphs that
+ * the cache dropped itself, not ones that were removed.
+ */
+typedef struct
+{
+    uint64_t		n_hits;
+    uint64_t		n_misses;
+    uint64_t		n_insertions;
+    uint64_t		n_evictions;
+    int			n_glyphs;
+    uint64_t		n_bytes;
+    uint64_t		budget;
+} pixman_glyph_cache_stats_t;
+
+void                  pixman_glyph_cache_get_stats    (pixman_glyph_cache_t       *cache,
+						       pixman_glyph_cache_stats_t *stats);
+
 void                  pixman_glyph_get_extents        (pixman_glyph_cache_t *cache,
 						       int                   n_glyphs,
 						       pixman_glyph_t       *glyphs,
@@ -986,6 +1135,56 @@ void                  pixman_composite_glyphs_no_mask (pixman_op_t           op,
 						       int		     n_glyphs,
 						       const pixman_glyph_t *glyphs);
 
+/* A glyph run holds a glyph array along with its extents and mask
+ * format, so that the same text can be measured and composited again
+ * without looking up its glyphs. The glyphs must be in the cache when
+ * the run is created, and the run must be destroyed before the cache.
+ *
+ * Runs check that their glyphs are still in the cache whenever they
+ * are composited or validated, which the cache must be frozen for. The
+ * check doesn't look at the glyphs when none has left the cache since
+ * the last one. Otherwise a run looks up those of its own glyphs that
+ * were removed or evicted since the last check, and if any of them is
+ * gone, the run is invalid and draws nothing until they are inserted
+ * again. The extents and mask format are those of the glyphs found in
+ * the last check.
+ *
+ * Validating or compositing a run updates it, so a run must not be
+ * validated or composited from several threads at once, even when its
+ * cache is concurrent.
+ */
+typedef struct pixman_glyph_run_t pixman_glyph_run_t;
+
+pixman_glyph_run_t *  pixman_glyph_run_create         (pixman_glyph_cache_t *cache,
+						       int                   n_glyphs,
+						       const pixman_glyph_t *glyphs);
+void                  pixman_glyph_run_destroy        (pixman_glyph_run_t   *run);
+pixman_bool_t         pixman_glyph_run_validate       (pixman_glyph_run_t   *run);
+void                  pixman_glyph_run_get_extents    (pixman_glyph_run_t   *run,
+						       pixman_box32_t       *extents);
+pixman_format_code_t  pixman_glyph_run_get_mask_format (pixman_glyph_run_t  *run);
+void                  pixman_composite_glyph_run      (pixman_op_t           op,
+						       pixman_image_t       *src,
+						       pixman_image_t       *dest,
+						       pixman_format_code_t  mask_format,
+						       int32_t               src_x,
+						       int32_t               src_y,
+						       int32_t		     mask_x,
+						       int32_t		     mask_y,
+						       int32_t               dest_x,
+						       int32_t               dest_y,
+						       int32_t		     width,
+						       int32_t		     height,
+						       pixman_glyph_run_t   *run);
+void                  pixman_composite_glyph_run_no_mask (pixman_op_t        op,
+						       pixman_image_t       *src,
+						       pixman_image_t       *dest,
+						       int32_t               src_x,
+						       int32_t               src_y,
+						       int32_t               dest_x,
+						       int32_t               dest_y,
+						       pixman_glyph_run_t   *run);
+
 /*
  * Trapezoids
  */
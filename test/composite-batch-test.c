@@ -0,0 +1,125 @@
+/*
+ * Checks that pixman_image_composite_batch() gives exactly the same
+ * result as compositing the records one at a time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define WIDTH		67
+#define HEIGHT		45
+#define N_IMAGES	4
+#define N_RECORDS	200
+#define N_ITERATIONS	40
+
+static const pixman_format_code_t formats[] =
+{
+    PIXMAN_a8r8g8b8,
+    PIXMAN_x8r8g8b8,
+    PIXMAN_r5g6b5,
+    PIXMAN_a8,
+};
+
+static const pixman_op_t operators[] =
+{
+    PIXMAN_OP_SRC,
+    PIXMAN_OP_OVER,
+    PIXMAN_OP_ADD,
+    PIXMAN_OP_IN,
+    PIXMAN_OP_OUT_REVERSE,
+};
+
+static pixman_bool_t
+images_equal (pixman_image_t *a, pixman_image_t *b)
+{
+    return memcmp (pixman_image_get_data (a), pixman_image_get_data (b),
+		   pixman_image_get_stride (a) * HEIGHT) == 0;
+}
+
+static int
+test_one (int seed)
+{
+    pixman_composite_record_t records[N_RECORDS];
+    pixman_image_t *images[N_IMAGES];
+    pixman_image_t *dest_batch, *dest_single;
+    pixman_format_code_t dest_format;
+    pixman_color_t color;
+    int i, ok;
+
+    prng_srand (seed);
+
+    for (i = 0; i < N_IMAGES - 1; ++i)
+    {
+	images[i] = make_random_image (
+	    formats[prng_rand_n (ARRAY_LENGTH (formats))], WIDTH, HEIGHT);
+    }
+
+    color.red = prng_rand_n (0x10000);
+    color.green = prng_rand_n (0x10000);
+    color.blue = prng_rand_n (0x10000);
+    color.alpha = prng_rand_n (0x10000);
+    images[N_IMAGES - 1] = pixman_image_create_solid_fill (&color);
+
+    dest_format = formats[prng_rand_n (ARRAY_LENGTH (formats))];
+    dest_batch = make_random_image (dest_format, WIDTH, HEIGHT);
+    dest_single = make_random_image (dest_format, WIDTH, HEIGHT);
+    memcpy (pixman_image_get_data (dest_single), pixman_image_get_data (dest_batch),
+	    pixman_image_get_stride (dest_batch) * HEIGHT);
+
+    for (i = 0; i < N_RECORDS; ++i)
+    {
+	pixman_composite_record_t *r = &records[i];
+
+	r->op = operators[prng_rand_n (ARRAY_LENGTH (operators))];
+	r->src = images[prng_rand_n (N_IMAGES)];
+	r->mask = prng_rand_n (3) ? NULL : images[prng_rand_n (N_IMAGES)];
+	r->src_x = prng_rand_n (WIDTH) - 8;
+	r->src_y = prng_rand_n (HEIGHT) - 8;
+	r->mask_x = prng_rand_n (WIDTH) - 8;
+	r->mask_y = prng_rand_n (HEIGHT) - 8;
+	r->dest_x = prng_rand_n (WIDTH) - 8;
+	r->dest_y = prng_rand_n (HEIGHT) - 8;
+	r->width = prng_rand_n (WIDTH / 2);
+	r->height = prng_rand_n (HEIGHT / 2);
+    }
+
+    for (i = 0; i < N_RECORDS; ++i)
+    {
+	pixman_composite_record_t *r = &records[i];
+
+	pixman_image_composite32 (r->op, r->src, r->mask, dest_single,
+				  r->src_x, r->src_y, r->mask_x, r->mask_y,
+				  r->dest_x, r->dest_y, r->width, r->height);
+    }
+
+    pixman_image_composite_batch (dest_batch, N_RECORDS, records);
+
+    ok = images_equal (dest_batch, dest_single);
+
+    for (i = 0; i < N_IMAGES; ++i)
+	pixman_image_unref (images[i]);
+    pixman_image_unref (dest_batch);
+    pixman_image_unref (dest_single);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("composite batch test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("composite batch test passed\n");
+
+    return 0;
+}
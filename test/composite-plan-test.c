@@ -0,0 +1,214 @@
+/*
+ * Checks that executing a composite plan gives exactly the same result
+ * as pixman_image_composite32(), also after the properties of the
+ * images have been changed. Many executions are within the area of the
+ * previous one, where the plan may skip analyzing the images.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define WIDTH		53
+#define HEIGHT		47
+#define N_EXECUTIONS	60
+#define N_ITERATIONS	40
+
+static const pixman_format_code_t formats[] =
+{
+    PIXMAN_a8r8g8b8,
+    PIXMAN_x8r8g8b8,
+    PIXMAN_r5g6b5,
+    PIXMAN_a8,
+};
+
+static const pixman_op_t operators[] =
+{
+    PIXMAN_OP_SRC,
+    PIXMAN_OP_OVER,
+    PIXMAN_OP_ADD,
+    PIXMAN_OP_IN_REVERSE,
+};
+
+static void
+change_properties (pixman_image_t *image)
+{
+    pixman_transform_t transform;
+
+    switch (prng_rand_n (3))
+    {
+    case 0:
+	pixman_image_set_repeat (image, prng_rand_n (4));
+	break;
+
+    case 1:
+	pixman_transform_init_scale (&transform,
+				     pixman_fixed_1 / 2 + prng_rand_n (pixman_fixed_1),
+				     pixman_fixed_1 / 2 + prng_rand_n (pixman_fixed_1));
+	pixman_image_set_transform (image, &transform);
+	break;
+
+    case 2:
+	pixman_image_set_transform (image, NULL);
+	pixman_image_set_filter (image,
+				 prng_rand_n (2) ?
+				 PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR,
+				 NULL, 0);
+	break;
+    }
+}
+
+static int
+test_one (int seed)
+{
+    pixman_composite_plan_t *plan;
+    pixman_image_t *src, *mask, *dest_plan, *dest_single;
+    pixman_op_t op;
+    int src_x, src_y, mask_x, mask_y, dest_x, dest_y, width, height;
+    int i, ok;
+
+    prng_srand (seed);
+
+    src = make_random_image (
+	formats[prng_rand_n (ARRAY_LENGTH (formats))], WIDTH, HEIGHT);
+    mask = prng_rand_n (2) ?
+	make_random_image (PIXMAN_a8, WIDTH, HEIGHT) : NULL;
+    dest_plan = make_random_image (
+	formats[prng_rand_n (ARRAY_LENGTH (formats))], WIDTH, HEIGHT);
+    dest_single = make_random_image (
+	pixman_image_get_format (dest_plan), WIDTH, HEIGHT);
+    memcpy (pixman_image_get_data (dest_single), pixman_image_get_data (dest_plan),
+	    pixman_image_get_stride (dest_plan) * HEIGHT);
+
+    op = operators[prng_rand_n (ARRAY_LENGTH (operators))];
+    plan = pixman_composite_plan_create (op, src, mask, dest_plan);
+
+    for (i = 0; i < N_EXECUTIONS; ++i)
+    {
+	if (i == 0 || prng_rand_n (2))
+	{
+	    src_x = prng_rand_n (WIDTH) - 8;
+	    src_y = prng_rand_n (HEIGHT) - 8;
+	    mask_x = prng_rand_n (WIDTH) - 8;
+	    mask_y = prng_rand_n (HEIGHT) - 8;
+	    dest_x = prng_rand_n (WIDTH) - 8;
+	    dest_y = prng_rand_n (HEIGHT) - 8;
+	    width = prng_rand_n (WIDTH);
+	    height = prng_rand_n (HEIGHT);
+	}
+	else
+	{
+	    /* Part of the previous rectangle */
+	    int dx = prng_rand_n (width / 2 + 1);
+	    int dy = prng_rand_n (height / 2 + 1);
+
+	    src_x += dx;
+	    src_y += dy;
+	    mask_x += dx;
+	    mask_y += dy;
+	    dest_x += dx;
+	    dest_y += dy;
+	    width = prng_rand_n (width - dx + 1);
+	    height = prng_rand_n (height - dy + 1);
+	}
+
+	if (prng_rand_n (8) == 0)
+	    change_properties (src);
+	if (mask && prng_rand_n (8) == 0)
+	    change_properties (mask);
+
+	pixman_composite_plan_execute (plan, src_x, src_y, mask_x, mask_y,
+				       dest_x, dest_y, width, height);
+	pixman_image_composite32 (op, src, mask, dest_single,
+				  src_x, src_y, mask_x, mask_y,
+				  dest_x, dest_y, width, height);
+    }
+
+    pixman_composite_plan_destroy (plan);
+
+    ok = memcmp (pixman_image_get_data (dest_plan),
+		 pixman_image_get_data (dest_single),
+		 pixman_image_get_stride (dest_plan) * HEIGHT) == 0;
+
+    pixman_image_unref (src);
+    if (mask)
+	pixman_image_unref (mask);
+    pixman_image_unref (dest_plan);
+    pixman_image_unref (dest_single);
+
+    return ok;
+}
+
+/* An opaque scaled source that is only covered by the first execution,
+ * so the second one can't use the fast paths for covered samples.
+ */
+static int
+test_uncovered (void)
+{
+    static const pixman_op_t ops[] = { PIXMAN_OP_SRC, PIXMAN_OP_OVER };
+    pixman_composite_plan_t *plan;
+    pixman_image_t *src, *dest_plan, *dest_single;
+    pixman_transform_t transform;
+    int i, ok = TRUE;
+
+    prng_srand (0);
+
+    src = make_random_image (PIXMAN_x8r8g8b8, WIDTH, HEIGHT);
+    pixman_transform_init_scale (&transform, pixman_fixed_1 / 2, pixman_fixed_1 / 2);
+    pixman_image_set_transform (src, &transform);
+
+    for (i = 0; i < ARRAY_LENGTH (ops); ++i)
+    {
+	dest_plan = make_random_image (PIXMAN_a8r8g8b8, WIDTH, HEIGHT);
+	dest_single = make_random_image (PIXMAN_a8r8g8b8, WIDTH, HEIGHT);
+	memcpy (pixman_image_get_data (dest_single), pixman_image_get_data (dest_plan),
+		pixman_image_get_stride (dest_plan) * HEIGHT);
+
+	plan = pixman_composite_plan_create (ops[i], src, NULL, dest_plan);
+
+	pixman_composite_plan_execute (plan, 10, 10, 0, 0, 0, 0, 20, 20);
+	pixman_composite_plan_execute (plan, 90, 80, 0, 0, 10, 10, 30, 30);
+	pixman_image_composite32 (ops[i], src, NULL, dest_single,
+				  10, 10, 0, 0, 0, 0, 20, 20);
+	pixman_image_composite32 (ops[i], src, NULL, dest_single,
+				  90, 80, 0, 0, 10, 10, 30, 30);
+
+	pixman_composite_plan_destroy (plan);
+
+	ok = ok && memcmp (pixman_image_get_data (dest_plan),
+			   pixman_image_get_data (dest_single),
+			   pixman_image_get_stride (dest_plan) * HEIGHT) == 0;
+
+	pixman_image_unref (dest_plan);
+	pixman_image_unref (dest_single);
+    }
+
+    pixman_image_unref (src);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    if (!test_uncovered ())
+    {
+	printf ("composite plan test failed for an uncovered source\n");
+	return 1;
+    }
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("composite plan test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("composite plan test passed\n");
+
+    return 0;
+}
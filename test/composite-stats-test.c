@@ -0,0 +1,113 @@
+/*
+ * Checks that the composite statistics count calls and pixels under the
+ * right key, and tell fast paths from the general path.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+#define WIDTH		40
+#define HEIGHT		30
+
+static const pixman_composite_stat_t *
+find_stat (const pixman_composite_stat_t *stats, int n, pixman_op_t op)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+    {
+	if (stats[i].op == op				&&
+	    stats[i].src_format == PIXMAN_a8r8g8b8	&&
+	    stats[i].mask_format == 0			&&
+	    stats[i].dest_format == PIXMAN_a8r8g8b8)
+	{
+	    return &stats[i];
+	}
+    }
+
+    return NULL;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    pixman_composite_stat_t stats[64];
+    const pixman_composite_stat_t *over, *hue;
+    pixman_image_t *src, *dest;
+    int i, n;
+
+    src = pixman_image_create_bits (PIXMAN_a8r8g8b8, WIDTH, HEIGHT, NULL, 0);
+    dest = pixman_image_create_bits (PIXMAN_a8r8g8b8, WIDTH, HEIGHT, NULL, 0);
+
+    pixman_composite_stats_enable (TRUE);
+    pixman_composite_stats_reset ();
+
+    for (i = 0; i < 10; ++i)
+    {
+	pixman_image_composite32 (PIXMAN_OP_OVER, src, NULL, dest,
+				  0, 0, 0, 0, 0, 0, 20, 10);
+    }
+
+    for (i = 0; i < 3; ++i)
+    {
+	/* Partly outside the destination, so only 10x10 pixels are drawn */
+	pixman_image_composite32 (PIXMAN_OP_HSL_HUE, src, NULL, dest,
+				  0, 0, 0, 0, WIDTH - 10, HEIGHT - 10, 20, 20);
+    }
+
+    pixman_composite_stats_enable (FALSE);
+
+    /* Not counted */
+    pixman_image_composite32 (PIXMAN_OP_OVER, src, NULL, dest,
+			      0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+
+    n = pixman_composite_stats_get (stats, ARRAY_LENGTH (stats));
+    if (n > ARRAY_LENGTH (stats))
+	n = ARRAY_LENGTH (stats);
+
+    over = find_stat (stats, n, PIXMAN_OP_OVER);
+    hue = find_stat (stats, n, PIXMAN_OP_HSL_HUE);
+
+    if (!over || !hue)
+    {
+	printf ("missing statistics\n");
+	return 1;
+    }
+
+    if (over->n_calls != 10 || over->n_pixels != 10 * 20 * 10 || over->general)
+    {
+	printf ("wrong OVER statistics: %d calls, %d pixels, %s path\n",
+		(int)over->n_calls, (int)over->n_pixels,
+		over->general ? "general" : "fast");
+	return 1;
+    }
+
+    if (hue->n_calls != 3 || hue->n_pixels != 3 * 10 * 10 || !hue->general)
+    {
+	printf ("wrong HSL_HUE statistics: %d calls, %d pixels, %s path\n",
+		(int)hue->n_calls, (int)hue->n_pixels,
+		hue->general ? "general" : "fast");
+	return 1;
+    }
+
+    if (over->n_lookups < 1 || hue->n_lookups < 1)
+    {
+	printf ("lookups were not counted\n");
+	return 1;
+    }
+
+    pixman_composite_stats_reset ();
+
+    if (pixman_composite_stats_get (stats, ARRAY_LENGTH (stats)) != 0)
+    {
+	printf ("statistics were not reset\n");
+	return 1;
+    }
+
+    pixman_image_unref (src);
+    pixman_image_unref (dest);
+
+    printf ("composite stats test passed\n");
+
+    return 0;
+}
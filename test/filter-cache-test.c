@@ -0,0 +1,142 @@
+/*
+ * Checks that separable convolution filters come out the same whether
+ * or not they are cached. The filters are made in one order, then again
+ * in the opposite order after the cache has been flushed with others,
+ * so that filters whose keys only differ in the kernels or subsample
+ * bits are made fresh in both orders. Finally they are made in random
+ * order from several threads.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define N_FILTERS	48
+#define N_LOOKUPS	2000
+
+typedef struct
+{
+    pixman_fixed_t	scale_x, scale_y;
+    pixman_kernel_t	reconstruct_x, reconstruct_y;
+    pixman_kernel_t	sample_x, sample_y;
+    int			subsample_bits_x, subsample_bits_y;
+    int			n_values;
+    pixman_fixed_t *	values;
+} filter_t;
+
+static filter_t filters[N_FILTERS];
+
+static pixman_fixed_t *
+create (const filter_t *f, int *n_values)
+{
+    return pixman_filter_create_separable_convolution (
+	n_values, f->scale_x, f->scale_y,
+	f->reconstruct_x, f->reconstruct_y, f->sample_x, f->sample_y,
+	f->subsample_bits_x, f->subsample_bits_y);
+}
+
+static pixman_bool_t
+check (const filter_t *f)
+{
+    pixman_fixed_t *values;
+    int n_values;
+    pixman_bool_t ok;
+
+    values = create (f, &n_values);
+    ok = values && n_values == f->n_values &&
+	memcmp (values, f->values, n_values * sizeof (pixman_fixed_t)) == 0;
+    free (values);
+
+    return ok;
+}
+
+static pixman_kernel_t
+random_kernel (void)
+{
+    return prng_rand_n (PIXMAN_KERNEL_LANCZOS3_STRETCHED + 1);
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i, n_failures = 0;
+
+    prng_srand (0);
+
+    /* Pairs of filters with the same scales, but other kernels */
+    for (i = 0; i < N_FILTERS; ++i)
+    {
+	filter_t *f = &filters[i];
+
+	if (i & 1)
+	{
+	    f->scale_x = filters[i - 1].scale_x;
+	    f->scale_y = filters[i - 1].scale_y;
+	}
+	else
+	{
+	    f->scale_x = prng_rand_n (6 * pixman_fixed_1) + pixman_fixed_1 / 4;
+	    f->scale_y = prng_rand_n (2) ?
+		f->scale_x : prng_rand_n (6 * pixman_fixed_1) + pixman_fixed_1 / 4;
+	}
+
+	f->reconstruct_x = random_kernel ();
+	f->reconstruct_y = random_kernel ();
+	f->sample_x = random_kernel ();
+	f->sample_y = random_kernel ();
+	f->subsample_bits_x = prng_rand_n (5);
+	f->subsample_bits_y = prng_rand_n (5);
+
+	f->values = create (f, &f->n_values);
+	if (!f->values)
+	{
+	    printf ("failed to create filter %d\n", i);
+	    return 1;
+	}
+    }
+
+    /* Flush the cache */
+    for (i = 0; i < 100; ++i)
+    {
+	filter_t f = filters[0];
+	pixman_fixed_t *values;
+	int n_values;
+
+	f.scale_x = f.scale_y = 7 * pixman_fixed_1 + i;
+	values = create (&f, &n_values);
+	free (values);
+    }
+
+    for (i = N_FILTERS - 1; i >= 0; --i)
+    {
+	if (!check (&filters[i]))
+	{
+	    printf ("filter %d differs after the cache was flushed\n", i);
+	    n_failures++;
+	}
+    }
+
+#ifdef USE_OPENMP
+#   pragma omp parallel for reduction(+:n_failures)
+#endif
+    for (i = 0; i < N_LOOKUPS; ++i)
+    {
+	int j = (i * 7919) % N_FILTERS;
+
+	if (!check (&filters[j]))
+	{
+	    printf ("filter %d differs in lookup %d\n", j, i);
+	    n_failures++;
+	}
+    }
+
+    for (i = 0; i < N_FILTERS; ++i)
+	free (filters[i].values);
+
+    if (n_failures)
+	return 1;
+
+    printf ("filter cache test passed\n");
+
+    return 0;
+}
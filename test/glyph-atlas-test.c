@@ -0,0 +1,152 @@
+/*
+ * Checks that glyphs keep their pixels while the glyph cache packs them
+ * into shared atlases, and while other glyphs come and go around them.
+ * Every live glyph is drawn from the cache and compared with the same
+ * composite that uses the image it was inserted from.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define N_ROUNDS	60
+#define MAX_LIVE	600
+
+typedef struct
+{
+    int			key;
+    pixman_image_t *	image;
+    const void *	glyph;
+} live_glyph_t;
+
+static live_glyph_t live[MAX_LIVE];
+static int n_live;
+
+static pixman_image_t *
+create_glyph_image (void)
+{
+    static const pixman_format_code_t formats[] =
+    {
+	PIXMAN_a8, PIXMAN_a1, PIXMAN_a4, PIXMAN_a8r8g8b8
+    };
+    pixman_format_code_t format = formats[prng_rand_n (ARRAY_LENGTH (formats))];
+    int width, height;
+
+    /* Mostly small, sometimes too big to share an atlas */
+    if (prng_rand_n (40))
+    {
+	width = prng_rand_n (40) + 1;
+	height = prng_rand_n (40) + 1;
+    }
+    else
+    {
+	width = prng_rand_n (300) + 1;
+	height = prng_rand_n (300) + 1;
+    }
+
+    return make_random_glyph_image (format, width, height, 0);
+}
+
+static pixman_bool_t
+check_glyph (pixman_glyph_cache_t *cache, pixman_image_t *white,
+	     const live_glyph_t *g)
+{
+    int width = pixman_image_get_width (g->image);
+    int height = pixman_image_get_height (g->image);
+    pixman_image_t *expected, *result;
+    pixman_glyph_t glyph;
+    pixman_bool_t ok;
+
+    expected = pixman_image_create_bits (PIXMAN_a8r8g8b8, width, height, NULL, -1);
+    result = pixman_image_create_bits (PIXMAN_a8r8g8b8, width, height, NULL, -1);
+
+    pixman_image_composite32 (PIXMAN_OP_SRC, white, g->image, expected,
+			      0, 0, 0, 0, 0, 0, width, height);
+
+    glyph.x = 3;
+    glyph.y = 2;
+    glyph.glyph = g->glyph;
+    pixman_composite_glyphs_no_mask (PIXMAN_OP_SRC, white, result,
+				     0, 0, 0, 0, cache, 1, &glyph);
+
+    ok = memcmp (pixman_image_get_data (expected),
+		 pixman_image_get_data (result), width * height * 4) == 0;
+
+    pixman_image_unref (expected);
+    pixman_image_unref (result);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    static const pixman_color_t white_color = { 0xffff, 0xffff, 0xffff, 0xffff };
+    pixman_glyph_cache_t *cache;
+    pixman_image_t *white;
+    int next_key = 0;
+    int round, i;
+
+    prng_srand (0);
+
+    cache = pixman_glyph_cache_create ();
+    white = pixman_image_create_solid_fill (&white_color);
+
+    for (round = 0; round < N_ROUNDS; ++round)
+    {
+	int n_remove = prng_rand_n (n_live + 1);
+	int n_insert = prng_rand_n (MAX_LIVE - n_live + n_remove + 1);
+
+	pixman_glyph_cache_freeze (cache);
+
+	for (i = 0; i < n_remove; ++i)
+	{
+	    int j = prng_rand_n (n_live);
+
+	    pixman_glyph_cache_remove (cache, NULL, glyph_key (live[j].key));
+	    pixman_image_unref (live[j].image);
+
+	    live[j] = live[--n_live];
+	}
+
+	for (i = 0; i < n_insert && n_live < MAX_LIVE; ++i)
+	{
+	    live_glyph_t *g = &live[n_live++];
+
+	    g->key = next_key++;
+	    g->image = create_glyph_image ();
+	    g->glyph = pixman_glyph_cache_insert (
+		cache, NULL, glyph_key (g->key), 3, 2, g->image);
+
+	    if (!g->glyph)
+	    {
+		printf ("failed to insert glyph\n");
+		return 1;
+	    }
+	}
+
+	pixman_glyph_cache_thaw (cache);
+
+	for (i = 0; i < n_live; ++i)
+	{
+	    if (pixman_glyph_cache_lookup (
+		    cache, NULL, glyph_key (live[i].key)) != live[i].glyph ||
+		!check_glyph (cache, white, &live[i]))
+	    {
+		printf ("glyph %d is wrong after round %d\n",
+			live[i].key, round);
+		return 1;
+	    }
+	}
+    }
+
+    for (i = 0; i < n_live; ++i)
+	pixman_image_unref (live[i].image);
+
+    pixman_image_unref (white);
+    pixman_glyph_cache_destroy (cache);
+
+    printf ("glyph atlas test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * Checks that glyph caches with a budget stay within it when thawed,
+ * evict the glyphs that were used least recently, and count lookups,
+ * insertions and evictions correctly, for ordinary caches and for
+ * concurrent ones shared between threads. Also checks that glyphs are
+ * charged for their own space in the atlases rather than for the whole
+ * atlases that hold them.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+#define BUDGET		(256 * 1024)
+#define N_ROUNDS	200
+#define N_LOOKUPS	20000
+#define N_KEYS		3000
+
+static pixman_image_t *white;
+
+/* Mostly small glyphs, some of them big enough to be a sizable part of
+ * the budget.
+ */
+static pixman_image_t *
+create_glyph_image (int k)
+{
+    int size = (k % 17) ? 8 + k % 9 : 100 + k % 50;
+
+    return make_random_glyph_image (PIXMAN_a8, size, size, 0);
+}
+
+static const void *
+lookup_or_insert (pixman_glyph_cache_t *cache, int k, int *n_misses)
+{
+    const void *glyph;
+
+    if (!(glyph = pixman_glyph_cache_lookup (cache, NULL, glyph_key (k))))
+    {
+	pixman_image_t *image = create_glyph_image (k);
+
+	glyph = pixman_glyph_cache_insert (cache, NULL, glyph_key (k), 0, 0, image);
+	pixman_image_unref (image);
+
+	(*n_misses)++;
+    }
+
+    return glyph;
+}
+
+static void
+use_glyph (pixman_glyph_cache_t *cache, const void *glyph)
+{
+    pixman_image_t *dest = pixman_image_create_bits (PIXMAN_a8, 4, 4, NULL, -1);
+    pixman_glyph_t g = { 0, 0, glyph };
+
+    pixman_composite_glyphs_no_mask (PIXMAN_OP_OVER, white, dest,
+				     0, 0, 0, 0, cache, 1, &g);
+
+    pixman_image_unref (dest);
+}
+
+/* Threads of a concurrent cache can miss the same glyph at once, and
+ * then only one of them inserts it.
+ */
+static pixman_bool_t
+check_stats (pixman_glyph_cache_t *cache, int n_lookups, int n_misses,
+	     const char *what, pixman_glyph_cache_stats_t *stats_out)
+{
+    pixman_glyph_cache_stats_t stats;
+
+    pixman_glyph_cache_get_stats (cache, &stats);
+
+    if (stats_out)
+	*stats_out = stats;
+
+    if (stats.budget != BUDGET						||
+	stats.n_bytes > BUDGET						||
+	stats.n_hits + stats.n_misses != (uint64_t)n_lookups		||
+	stats.n_misses != (uint64_t)n_misses				||
+	stats.n_insertions > (uint64_t)n_misses			||
+	stats.n_insertions - stats.n_evictions != (uint64_t)stats.n_glyphs)
+    {
+	printf ("%s: wrong stats: %d lookups, %d misses, "
+		"hits %llu, misses %llu, insertions %llu, evictions %llu, "
+		"%d glyphs, %llu bytes\n",
+		what, n_lookups, n_misses,
+		(unsigned long long)stats.n_hits,
+		(unsigned long long)stats.n_misses,
+		(unsigned long long)stats.n_insertions,
+		(unsigned long long)stats.n_evictions,
+		stats.n_glyphs, (unsigned long long)stats.n_bytes);
+
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+static pixman_bool_t
+test_ordinary (void)
+{
+    pixman_glyph_cache_t *cache = pixman_glyph_cache_create_with_budget (BUDGET, FALSE);
+    pixman_glyph_cache_stats_t stats;
+    int n_lookups = 0, n_misses = 0;
+    int round, i;
+
+    prng_srand (0);
+
+    for (round = 0; round < N_ROUNDS; ++round)
+    {
+	pixman_glyph_cache_freeze (cache);
+
+	for (i = 0; i < 20; ++i)
+	{
+	    use_glyph (cache, lookup_or_insert (
+			   cache, 1 + prng_rand_n (N_KEYS - 1), &n_misses));
+	    n_lookups++;
+	}
+
+	/* Glyph 0 is used last in every round, so it must never be evicted */
+	if (round > 0 && !pixman_glyph_cache_lookup (cache, NULL, glyph_key (0)))
+	{
+	    printf ("ordinary: the most recently used glyph was evicted\n");
+	    return FALSE;
+	}
+
+	use_glyph (cache, lookup_or_insert (cache, 0, &n_misses));
+	n_lookups += round > 0 ? 2 : 1;
+
+	pixman_glyph_cache_thaw (cache);
+
+	if (!check_stats (cache, n_lookups, n_misses, "ordinary", &stats))
+	    return FALSE;
+    }
+
+    if (stats.n_insertions != (uint64_t)n_misses || stats.n_evictions == 0)
+    {
+	printf ("ordinary: %llu of %d glyphs inserted, %llu evicted\n",
+		(unsigned long long)stats.n_insertions, n_misses,
+		(unsigned long long)stats.n_evictions);
+	return FALSE;
+    }
+
+    pixman_glyph_cache_destroy (cache);
+
+    return TRUE;
+}
+
+static pixman_bool_t
+test_concurrent (void)
+{
+    pixman_glyph_cache_t *cache = pixman_glyph_cache_create_with_budget (BUDGET, TRUE);
+    int n_misses = 0;
+    int i;
+
+    if (!cache)
+	return TRUE;
+
+#ifdef USE_OPENMP
+#   pragma omp parallel for reduction(+:n_misses) schedule(dynamic, 64)
+#endif
+    for (i = 0; i < N_LOOKUPS; ++i)
+    {
+	prng_srand (i);
+
+	pixman_glyph_cache_freeze (cache);
+	use_glyph (cache, lookup_or_insert (
+		       cache, prng_rand_n (N_KEYS), &n_misses));
+	pixman_glyph_cache_thaw (cache);
+    }
+
+    /* The last thread to thaw may have lost the race to evict */
+    pixman_glyph_cache_freeze (cache);
+    pixman_glyph_cache_thaw (cache);
+
+    if (!check_stats (cache, N_LOOKUPS, n_misses, "concurrent", NULL))
+	return FALSE;
+
+    pixman_glyph_cache_destroy (cache);
+
+    return TRUE;
+}
+
+#define N_SMALL_GLYPHS	640
+
+static pixman_bool_t
+insert_small_glyph (pixman_glyph_cache_t *cache, int k, int size)
+{
+    pixman_image_t *image = make_random_glyph_image (PIXMAN_a8, size, size, 0);
+    const void *glyph;
+
+    glyph = pixman_glyph_cache_insert (cache, NULL, glyph_key (k), 0, 0, image);
+    pixman_image_unref (image);
+
+    return glyph != NULL;
+}
+
+/* Removing every other glyph uncharges those glyphs, even though their
+ * shelves stay in use. Filling the holes with glyphs that don't fit in
+ * those shelves takes new atlases, but the cache still has to stay
+ * within its budget.
+ */
+static pixman_bool_t
+test_fragmented (void)
+{
+    pixman_glyph_cache_t *cache = pixman_glyph_cache_create_with_budget (BUDGET, FALSE);
+    pixman_glyph_cache_stats_t full, half, stats;
+    int round, i;
+
+    pixman_glyph_cache_freeze (cache);
+    for (i = 0; i < N_SMALL_GLYPHS; ++i)
+    {
+	if (!insert_small_glyph (cache, i, 16))
+	    return FALSE;
+    }
+    pixman_glyph_cache_thaw (cache);
+
+    pixman_glyph_cache_get_stats (cache, &full);
+
+    pixman_glyph_cache_freeze (cache);
+    for (i = 1; i < N_SMALL_GLYPHS; i += 2)
+	pixman_glyph_cache_remove (cache, NULL, glyph_key (i));
+    pixman_glyph_cache_thaw (cache);
+
+    pixman_glyph_cache_get_stats (cache, &half);
+
+    if (full.n_evictions != 0 || 2 * half.n_bytes != full.n_bytes)
+    {
+	printf ("fragmented: %llu bytes with all glyphs and %llu with half "
+		"of them, %llu evicted\n",
+		(unsigned long long)full.n_bytes,
+		(unsigned long long)half.n_bytes,
+		(unsigned long long)full.n_evictions);
+	return FALSE;
+    }
+
+    for (round = 0; round < 20; ++round)
+    {
+	pixman_glyph_cache_freeze (cache);
+	for (i = 0; i < N_SMALL_GLYPHS / 4; ++i)
+	{
+	    if (!insert_small_glyph (
+		    cache, N_SMALL_GLYPHS + round * N_SMALL_GLYPHS + i, 3 + i % 6))
+	    {
+		return FALSE;
+	    }
+	}
+	pixman_glyph_cache_thaw (cache);
+
+	pixman_glyph_cache_get_stats (cache, &stats);
+
+	if (stats.n_bytes > BUDGET)
+	{
+	    printf ("fragmented: %llu bytes after round %d\n",
+		    (unsigned long long)stats.n_bytes, round);
+	    return FALSE;
+	}
+    }
+
+    pixman_glyph_cache_destroy (cache);
+
+    return TRUE;
+}
+
+#define SMALL_BUDGET	(64 * 1024)
+#define N_OLD_GLYPHS	120
+#define N_NEW_GLYPHS	60
+#define N_KEPT_GLYPHS	30
+
+/* With a budget of a few atlases, glyphs used in an order that spreads
+ * them over the atlases must be evicted one by one, least recently used
+ * first, rather than until a whole atlas is empty.
+ */
+static pixman_bool_t
+test_spread (void)
+{
+    pixman_glyph_cache_t *cache =
+	pixman_glyph_cache_create_with_budget (SMALL_BUDGET, FALSE);
+    pixman_glyph_cache_stats_t stats;
+    int i;
+
+    pixman_glyph_cache_freeze (cache);
+    for (i = 0; i < N_OLD_GLYPHS; ++i)
+    {
+	if (!insert_small_glyph (cache, i, 16))
+	    return FALSE;
+    }
+    pixman_glyph_cache_thaw (cache);
+
+    pixman_glyph_cache_freeze (cache);
+    for (i = 0; i < N_OLD_GLYPHS; ++i)
+	use_glyph (cache, pixman_glyph_cache_lookup (
+		       cache, NULL, glyph_key (i * 7 % N_OLD_GLYPHS)));
+    for (i = 0; i < N_NEW_GLYPHS; ++i)
+    {
+	if (!insert_small_glyph (cache, N_OLD_GLYPHS + i, 16))
+	    return FALSE;
+    }
+    pixman_glyph_cache_thaw (cache);
+
+    pixman_glyph_cache_get_stats (cache, &stats);
+
+    if (stats.n_evictions == 0				||
+	stats.n_bytes > SMALL_BUDGET / 4 * 3		||
+	stats.n_bytes < SMALL_BUDGET / 2)
+    {
+	printf ("spread: %llu bytes left, %llu evicted\n",
+		(unsigned long long)stats.n_bytes,
+		(unsigned long long)stats.n_evictions);
+	return FALSE;
+    }
+
+    pixman_glyph_cache_freeze (cache);
+    for (i = N_OLD_GLYPHS - N_KEPT_GLYPHS; i < N_OLD_GLYPHS + N_NEW_GLYPHS; ++i)
+    {
+	int k = i < N_OLD_GLYPHS ? i * 7 % N_OLD_GLYPHS : i;
+
+	if (!pixman_glyph_cache_lookup (cache, NULL, glyph_key (k)))
+	{
+	    printf ("spread: recently used glyph %d was evicted\n", k);
+	    return FALSE;
+	}
+    }
+    pixman_glyph_cache_thaw (cache);
+
+    pixman_glyph_cache_destroy (cache);
+
+    return TRUE;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    static const pixman_color_t white_color = { 0xffff, 0xffff, 0xffff, 0xffff };
+    pixman_bool_t ok;
+
+    white = pixman_image_create_solid_fill (&white_color);
+
+    ok = test_ordinary () && test_concurrent () && test_fragmented () &&
+	test_spread ();
+
+    pixman_image_unref (white);
+
+    if (!ok)
+	return 1;
+
+    printf ("glyph budget test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Shares one concurrent glyph cache between threads that look up, insert
+ * and remove glyphs and composite runs of them, with more glyphs than
+ * the cache keeps, so that glyphs are evicted while they are in use.
+ * Every run is checked against the pixels the glyphs were made from.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+#define N_KEYS		24000
+#define N_RUNS		6000
+#define RUN_LENGTH	24
+#define CELL_SIZE	16
+
+static uint8_t
+glyph_pixel (int key, int x, int y)
+{
+    return (key * 31 + x * 7 + y * 13) & 0xff;
+}
+
+static void
+glyph_size (int key, int *width, int *height)
+{
+    *width = 1 + key % 13;
+    *height = 1 + (key / 13) % 11;
+}
+
+static pixman_image_t *
+create_glyph_image (int key)
+{
+    pixman_image_t *image;
+    int width, height, x, y;
+
+    glyph_size (key, &width, &height);
+
+    image = pixman_image_create_bits (PIXMAN_a8, width, height, NULL, -1);
+
+    for (y = 0; y < height; ++y)
+    {
+	uint8_t *row = (uint8_t *)pixman_image_get_data (image) +
+	    y * pixman_image_get_stride (image);
+
+	for (x = 0; x < width; ++x)
+	    row[x] = glyph_pixel (key, x, y);
+    }
+
+    return image;
+}
+
+static pixman_bool_t
+render_run (pixman_glyph_cache_t *cache, pixman_image_t *white)
+{
+    pixman_glyph_t glyphs[RUN_LENGTH];
+    int keys[RUN_LENGTH];
+    pixman_image_t *dest;
+    uint32_t *bits;
+    pixman_bool_t ok = TRUE;
+    int i, x, y;
+
+    pixman_glyph_cache_freeze (cache);
+
+    for (i = 0; i < RUN_LENGTH; ++i)
+    {
+	const void *glyph;
+
+	keys[i] = prng_rand_n (N_KEYS);
+
+	glyph = pixman_glyph_cache_lookup (cache, NULL, glyph_key (keys[i]));
+	if (!glyph)
+	{
+	    pixman_image_t *image = create_glyph_image (keys[i]);
+
+	    glyph = pixman_glyph_cache_insert (
+		cache, NULL, glyph_key (keys[i]), 0, 0, image);
+
+	    pixman_image_unref (image);
+	}
+
+	if (!glyph)
+	{
+	    printf ("failed to insert glyph %d\n", keys[i]);
+	    pixman_glyph_cache_thaw (cache);
+	    return FALSE;
+	}
+
+	glyphs[i].x = i * CELL_SIZE;
+	glyphs[i].y = 0;
+	glyphs[i].glyph = glyph;
+    }
+
+    /* The glyphs of the run stay usable until the cache is thawed */
+    if (prng_rand_n (4) == 0)
+    {
+	pixman_glyph_cache_remove (
+	    cache, NULL, glyph_key (keys[prng_rand_n (RUN_LENGTH)]));
+    }
+
+    dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, RUN_LENGTH * CELL_SIZE, CELL_SIZE, NULL, -1);
+    bits = pixman_image_get_data (dest);
+
+    pixman_composite_glyphs_no_mask (PIXMAN_OP_SRC, white, dest,
+				     0, 0, 0, 0, cache, RUN_LENGTH, glyphs);
+
+    pixman_glyph_cache_thaw (cache);
+
+    for (i = 0; i < RUN_LENGTH && ok; ++i)
+    {
+	int width, height;
+
+	glyph_size (keys[i], &width, &height);
+
+	for (y = 0; y < height && ok; ++y)
+	{
+	    for (x = 0; x < width && ok; ++x)
+	    {
+		uint32_t pixel = bits[y * RUN_LENGTH * CELL_SIZE + i * CELL_SIZE + x];
+
+		if (pixel != glyph_pixel (keys[i], x, y) * 0x01010101u)
+		{
+		    printf ("glyph %d has %08x at %d, %d\n", keys[i], pixel, x, y);
+		    ok = FALSE;
+		}
+	    }
+	}
+    }
+
+    pixman_image_unref (dest);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    static const pixman_color_t white_color = { 0xffff, 0xffff, 0xffff, 0xffff };
+    pixman_glyph_cache_t *cache;
+    pixman_image_t *white;
+    int i, n_failures = 0;
+
+    if (!(cache = pixman_glyph_cache_create_concurrent ()))
+    {
+	printf ("concurrent glyph caches are not supported\n");
+	return 77;
+    }
+
+    white = pixman_image_create_solid_fill (&white_color);
+
+#ifdef USE_OPENMP
+#   pragma omp parallel for reduction(+:n_failures) schedule(dynamic, 16)
+#endif
+    for (i = 0; i < N_RUNS; ++i)
+    {
+	prng_srand (i);
+
+	if (!render_run (cache, white))
+	    n_failures++;
+    }
+
+    pixman_image_unref (white);
+    pixman_glyph_cache_destroy (cache);
+
+    if (n_failures)
+	return 1;
+
+    printf ("glyph concurrent test passed\n");
+
+    return 0;
+}
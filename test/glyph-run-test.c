@@ -0,0 +1,234 @@
+/*
+ * Checks that glyph runs measure and composite like the glyph arrays
+ * they are made from, that drawing a run again doesn't look up its
+ * glyphs, also after other glyphs left the cache, and that runs notice
+ * when their own glyphs leave the cache and come back.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define N_KEYS		40
+#define N_GLYPHS	300
+#define N_FRAMES	10
+#define WIDTH		400
+#define HEIGHT		200
+
+static pixman_image_t *white;
+
+static const void *
+insert_glyph (pixman_glyph_cache_t *cache, int k, int size)
+{
+    pixman_format_code_t format = (k % 7) ? PIXMAN_a8 : PIXMAN_a4;
+    pixman_image_t *image;
+    const void *glyph;
+
+    image = make_random_glyph_image (format, size + k % 5, size + k % 3, 0);
+
+    glyph = pixman_glyph_cache_insert (
+	cache, NULL, glyph_key (k), k % 4, 8, image);
+    pixman_image_unref (image);
+
+    return glyph;
+}
+
+static void
+lookup_glyphs (pixman_glyph_cache_t *cache, const int *keys,
+	       pixman_glyph_t *glyphs)
+{
+    int i;
+
+    for (i = 0; i < N_GLYPHS; ++i)
+    {
+	glyphs[i].glyph = pixman_glyph_cache_lookup (cache, NULL, glyph_key (keys[i]));
+	glyphs[i].x = (i % 30) * 13;
+	glyphs[i].y = (i / 30) * 18 + 10;
+    }
+}
+
+static uint64_t
+n_lookups (pixman_glyph_cache_t *cache)
+{
+    pixman_glyph_cache_stats_t stats;
+
+    pixman_glyph_cache_get_stats (cache, &stats);
+
+    return stats.n_hits + stats.n_misses;
+}
+
+static pixman_image_t *
+create_dest (void)
+{
+    pixman_image_t *dest;
+
+    dest = pixman_image_create_bits (PIXMAN_a8r8g8b8, WIDTH, HEIGHT, NULL, -1);
+    memset (pixman_image_get_data (dest), 0x40, WIDTH * HEIGHT * 4);
+
+    return dest;
+}
+
+static pixman_bool_t
+same_pixels (pixman_image_t *a, pixman_image_t *b)
+{
+    return memcmp (pixman_image_get_data (a), pixman_image_get_data (b),
+		   WIDTH * HEIGHT * 4) == 0;
+}
+
+/* Checks the run against the glyph array, with and without a mask */
+static pixman_bool_t
+check_run (pixman_glyph_cache_t *cache, pixman_glyph_run_t *run,
+	   const pixman_glyph_t *glyphs, const char *what)
+{
+    pixman_box32_t extents, run_extents;
+    pixman_format_code_t format;
+    pixman_image_t *expected = create_dest ();
+    pixman_image_t *result = create_dest ();
+    pixman_bool_t ok;
+
+    pixman_glyph_get_extents (cache, N_GLYPHS, (pixman_glyph_t *)glyphs, &extents);
+    pixman_glyph_run_get_extents (run, &run_extents);
+    format = pixman_glyph_get_mask_format (cache, N_GLYPHS, glyphs);
+
+    pixman_composite_glyphs_no_mask (PIXMAN_OP_OVER, white, expected,
+				     0, 0, 5, 3, cache, N_GLYPHS, glyphs);
+    pixman_composite_glyph_run_no_mask (PIXMAN_OP_OVER, white, result,
+					0, 0, 5, 3, run);
+
+    ok = same_pixels (expected, result);
+
+    pixman_composite_glyphs (PIXMAN_OP_OVER, white, expected, format,
+			     0, 0, extents.x1, extents.y1,
+			     extents.x1 + 2, extents.y1 + 1,
+			     extents.x2 - extents.x1, extents.y2 - extents.y1,
+			     cache, N_GLYPHS, glyphs);
+    pixman_composite_glyph_run (PIXMAN_OP_OVER, white, result,
+				pixman_glyph_run_get_mask_format (run),
+				0, 0, run_extents.x1, run_extents.y1,
+				run_extents.x1 + 2, run_extents.y1 + 1,
+				run_extents.x2 - run_extents.x1,
+				run_extents.y2 - run_extents.y1,
+				run);
+
+    ok = ok && same_pixels (expected, result);
+
+    if (memcmp (&extents, &run_extents, sizeof (extents)) != 0	||
+	format != pixman_glyph_run_get_mask_format (run)	||
+	!ok)
+    {
+	printf ("%s: the run is not like its glyphs\n", what);
+	ok = FALSE;
+    }
+
+    pixman_image_unref (expected);
+    pixman_image_unref (result);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    static const pixman_color_t white_color = { 0xffff, 0xffff, 0xffff, 0xffff };
+    pixman_glyph_cache_t *cache = pixman_glyph_cache_create ();
+    pixman_glyph_t glyphs[N_GLYPHS];
+    pixman_glyph_run_t *run;
+    pixman_image_t *dest, *copy;
+    int keys[N_GLYPHS];
+    uint64_t n;
+    int i;
+
+    prng_srand (0);
+
+    white = pixman_image_create_solid_fill (&white_color);
+
+    pixman_glyph_cache_freeze (cache);
+
+    /* The last key is not in the run */
+    for (i = 0; i <= N_KEYS; ++i)
+	insert_glyph (cache, i, 6);
+
+    for (i = 0; i < N_GLYPHS; ++i)
+	keys[i] = prng_rand_n (N_KEYS);
+
+    lookup_glyphs (cache, keys, glyphs);
+    run = pixman_glyph_run_create (cache, N_GLYPHS, glyphs);
+
+    pixman_glyph_cache_thaw (cache);
+
+    n = n_lookups (cache);
+
+    for (i = 0; i < N_FRAMES; ++i)
+    {
+	pixman_glyph_cache_freeze (cache);
+
+	if (!check_run (cache, run, glyphs, "frame"))
+	    return 1;
+
+	pixman_glyph_cache_thaw (cache);
+    }
+
+    if (n_lookups (cache) != n)
+    {
+	printf ("drawing the run looked up glyphs\n");
+	return 1;
+    }
+
+    /* Other glyphs leaving the cache don't concern the run */
+    pixman_glyph_cache_freeze (cache);
+    pixman_glyph_cache_remove (cache, NULL, glyph_key (N_KEYS));
+
+    if (!pixman_glyph_run_validate (run)			||
+	n_lookups (cache) != n					||
+	!check_run (cache, run, glyphs, "after removing another glyph"))
+    {
+	printf ("removing another glyph broke the run\n");
+	return 1;
+    }
+
+    pixman_glyph_cache_thaw (cache);
+
+    /* A glyph of the run leaving the cache makes it draw nothing */
+    pixman_glyph_cache_freeze (cache);
+    pixman_glyph_cache_remove (cache, NULL, glyph_key (keys[0]));
+
+    dest = create_dest ();
+    copy = create_dest ();
+
+    pixman_composite_glyph_run_no_mask (PIXMAN_OP_OVER, white, dest,
+					0, 0, 0, 0, run);
+
+    if (pixman_glyph_run_validate (run) || !same_pixels (dest, copy))
+    {
+	printf ("the run was still used without one of its glyphs\n");
+	return 1;
+    }
+
+    pixman_image_unref (dest);
+    pixman_image_unref (copy);
+
+    pixman_glyph_cache_thaw (cache);
+
+    /* Until the glyph is back, perhaps with another image */
+    pixman_glyph_cache_freeze (cache);
+
+    insert_glyph (cache, keys[0], 11);
+    lookup_glyphs (cache, keys, glyphs);
+
+    if (!pixman_glyph_run_validate (run)			||
+	!check_run (cache, run, glyphs, "after inserting the glyph again"))
+    {
+	printf ("the run didn't find its glyphs again\n");
+	return 1;
+    }
+
+    pixman_glyph_cache_thaw (cache);
+
+    pixman_glyph_run_destroy (run);
+    pixman_glyph_cache_destroy (cache);
+    pixman_image_unref (white);
+
+    printf ("glyph run test passed\n");
+
+    return 0;
+}
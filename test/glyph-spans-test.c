@@ -0,0 +1,185 @@
+/*
+ * Composites runs of overlapping a8 glyphs OVER a solid source, which
+ * goes through the glyph span functions, and checks the result against
+ * the same run with a 2x2 repeating source of the same color, which is
+ * composited glyph by glyph. The destinations are clipped to regions
+ * with several boxes in each band.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+#define N_TESTS		400
+#define N_KEYS		40
+#define MAX_GLYPHS	200
+#define DEST_WIDTH	97
+#define DEST_HEIGHT	61
+
+static const pixman_format_code_t dest_formats[] =
+{
+    PIXMAN_a8r8g8b8, PIXMAN_x8r8g8b8, PIXMAN_a8b8g8r8, PIXMAN_x8b8g8r8
+};
+
+static pixman_image_t *
+create_glyph_image (int k)
+{
+    int width, height;
+
+    /* Some glyphs are too big to share an atlas */
+    if (k % 10)
+    {
+	width = prng_rand_n (24) + 1;
+	height = prng_rand_n (24) + 1;
+    }
+    else
+    {
+	width = prng_rand_n (300) + 1;
+	height = prng_rand_n (60) + 1;
+    }
+
+    return make_random_glyph_image (
+	PIXMAN_a8, width, height,
+	prng_rand_n (2) ? RANDMEMSET_MORE_00_AND_FF : 0);
+}
+
+static void
+set_random_clip (pixman_image_t **dest)
+{
+    pixman_region32_t region;
+    int n_rects = prng_rand_n (8);
+    int i;
+
+    if (!n_rects)
+	return;
+
+    pixman_region32_init (&region);
+
+    for (i = 0; i < n_rects; ++i)
+    {
+	pixman_region32_union_rect (
+	    &region, &region,
+	    prng_rand_n (DEST_WIDTH), prng_rand_n (DEST_HEIGHT),
+	    prng_rand_n (DEST_WIDTH / 2) + 1, prng_rand_n (DEST_HEIGHT / 2) + 1);
+    }
+
+    pixman_image_set_clip_region32 (dest[0], &region);
+    pixman_image_set_clip_region32 (dest[1], &region);
+    pixman_region32_fini (&region);
+}
+
+static pixman_bool_t
+test_spans (int testnum, pixman_glyph_cache_t *cache)
+{
+    pixman_format_code_t format =
+	dest_formats[prng_rand_n (ARRAY_LENGTH (dest_formats))];
+    pixman_glyph_t glyphs[MAX_GLYPHS];
+    pixman_image_t *solid, *tiled, *dest[2];
+    pixman_color_t color;
+    uint32_t tile[4];
+    uint32_t mask = PIXMAN_FORMAT_A (format) ? 0xffffffff : 0x00ffffff;
+    int n_glyphs = prng_rand_n (MAX_GLYPHS) + 1;
+    int dest_x = prng_rand_n (40) - 20;
+    int dest_y = prng_rand_n (40) - 20;
+    pixman_bool_t ok = TRUE;
+    int i, x, y;
+
+    color.alpha = prng_rand_n (4) ? prng_rand () : 0xffff;
+    color.red = prng_rand () & color.alpha;
+    color.green = prng_rand () & color.alpha;
+    color.blue = prng_rand () & color.alpha;
+
+    solid = pixman_image_create_solid_fill (&color);
+
+    /* A 1x1 repeating image would count as solid */
+    tiled = pixman_image_create_bits (PIXMAN_a8r8g8b8, 2, 2, tile, 8);
+    pixman_image_set_repeat (tiled, PIXMAN_REPEAT_NORMAL);
+    pixman_image_composite32 (PIXMAN_OP_SRC, solid, NULL, tiled,
+			      0, 0, 0, 0, 0, 0, 2, 2);
+
+    for (i = 0; i < 2; ++i)
+    {
+	dest[i] = pixman_image_create_bits (
+	    format, DEST_WIDTH, DEST_HEIGHT, NULL, -1);
+    }
+
+    prng_randmemset (pixman_image_get_data (dest[0]),
+		     DEST_WIDTH * DEST_HEIGHT * 4, 0);
+    pixman_image_composite32 (PIXMAN_OP_SRC, dest[0], NULL, dest[1],
+			      0, 0, 0, 0, 0, 0, DEST_WIDTH, DEST_HEIGHT);
+
+    set_random_clip (dest);
+
+    pixman_glyph_cache_freeze (cache);
+
+    for (i = 0; i < n_glyphs; ++i)
+    {
+	int k = prng_rand_n (N_KEYS);
+	void *key = glyph_key (k);
+
+	if (!(glyphs[i].glyph = pixman_glyph_cache_lookup (cache, NULL, key)))
+	{
+	    pixman_image_t *image = create_glyph_image (k);
+
+	    glyphs[i].glyph = pixman_glyph_cache_insert (
+		cache, NULL, key, prng_rand_n (8), prng_rand_n (8), image);
+
+	    pixman_image_unref (image);
+	}
+
+	glyphs[i].x = prng_rand_n (DEST_WIDTH + 20) - 10;
+	glyphs[i].y = prng_rand_n (DEST_HEIGHT + 20) - 10;
+    }
+
+    pixman_composite_glyphs_no_mask (PIXMAN_OP_OVER, solid, dest[0],
+				     0, 0, dest_x, dest_y,
+				     cache, n_glyphs, glyphs);
+    pixman_composite_glyphs_no_mask (PIXMAN_OP_OVER, tiled, dest[1],
+				     0, 0, dest_x, dest_y,
+				     cache, n_glyphs, glyphs);
+
+    pixman_glyph_cache_thaw (cache);
+
+    for (y = 0; y < DEST_HEIGHT && ok; ++y)
+    {
+	uint32_t *row0 = pixman_image_get_data (dest[0]) + y * DEST_WIDTH;
+	uint32_t *row1 = pixman_image_get_data (dest[1]) + y * DEST_WIDTH;
+
+	for (x = 0; x < DEST_WIDTH && ok; ++x)
+	{
+	    if ((row0[x] & mask) != (row1[x] & mask))
+	    {
+		printf ("test %d: %08x instead of %08x at %d, %d\n",
+			testnum, row0[x] & mask, row1[x] & mask, x, y);
+		ok = FALSE;
+	    }
+	}
+    }
+
+    pixman_image_unref (solid);
+    pixman_image_unref (tiled);
+    pixman_image_unref (dest[0]);
+    pixman_image_unref (dest[1]);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    pixman_glyph_cache_t *cache = pixman_glyph_cache_create ();
+    int i;
+
+    prng_srand (0);
+
+    for (i = 0; i < N_TESTS; ++i)
+    {
+	if (!test_spans (i, cache))
+	    return 1;
+    }
+
+    pixman_glyph_cache_destroy (cache);
+
+    printf ("glyph spans test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Checks that the SIMD gradient fetchers give exactly the same results
+ * as the C ones. Linear, radial and conical gradients are rendered with
+ * every repeat mode, with and without a transform, once for each
+ * implementation, and the CRCs of the results are compared.
+ */
+#include "utils.h"
+#include <stdio.h>
+#include <math.h>
+
+#define WIDTH		173
+#define HEIGHT		67
+#define N_STOPS		5
+#define N_ITERATIONS	40
+
+static const implementation_t implementations[] =
+{
+    { "C",		"avx2 sse2 mmx fast" },
+    { "fast",		"avx2 sse2 mmx" },
+    { "sse2",		"avx2" },
+    { "default",	"" },
+};
+
+static const pixman_repeat_t repeats[] =
+{
+    PIXMAN_REPEAT_NONE,
+    PIXMAN_REPEAT_NORMAL,
+    PIXMAN_REPEAT_PAD,
+    PIXMAN_REPEAT_REFLECT,
+};
+
+static pixman_fixed_t
+random_coordinate (int max)
+{
+    return pixman_int_to_fixed (prng_rand_n (2 * max) - max / 2) +
+	prng_rand_n (pixman_fixed_1);
+}
+
+static pixman_image_t *
+create_gradient (int type)
+{
+    pixman_gradient_stop_t stops[N_STOPS];
+    pixman_point_fixed_t p1, p2;
+    pixman_fixed_t x = 0;
+    int i;
+
+    /* Either stops that are far enough apart for the color ramp, or
+     * arbitrary ones that include hard stops.
+     */
+    for (i = 0; i < N_STOPS; ++i)
+    {
+	stops[i].x = x;
+	stops[i].color.red = prng_rand_n (0x10000);
+	stops[i].color.green = prng_rand_n (0x10000);
+	stops[i].color.blue = prng_rand_n (0x10000);
+	stops[i].color.alpha = prng_rand_n (0x10000);
+
+	if (prng_rand_n (2))
+	    x += pixman_fixed_1 / N_STOPS / 2 + prng_rand_n (pixman_fixed_1 / N_STOPS / 2);
+	else
+	    x += prng_rand_n (pixman_fixed_1 / N_STOPS);
+    }
+
+    p1.x = random_coordinate (WIDTH);
+    p1.y = random_coordinate (HEIGHT);
+    p2.x = random_coordinate (WIDTH);
+    p2.y = random_coordinate (HEIGHT);
+
+    switch (type)
+    {
+    case 0:
+	return pixman_image_create_linear_gradient (&p1, &p2, stops, N_STOPS);
+
+    case 1:
+	/* Concentric circles, for which a is negative, half of the time */
+	return pixman_image_create_radial_gradient (
+	    &p1, prng_rand_n (2) ? &p2 : &p1,
+	    pixman_int_to_fixed (prng_rand_n (20)),
+	    pixman_int_to_fixed (prng_rand_n (WIDTH) + 1),
+	    stops, N_STOPS);
+
+    default:
+	return pixman_image_create_conical_gradient (
+	    &p1, prng_rand_n (0x10000 * 360), stops, N_STOPS);
+    }
+}
+
+static uint32_t
+render (void)
+{
+    pixman_image_t *dest, *gradient;
+    pixman_transform_t transform;
+    uint32_t crc = 0;
+    int i, j, type;
+
+    dest = pixman_image_create_bits (PIXMAN_a8r8g8b8, WIDTH, HEIGHT, NULL, -1);
+
+    prng_srand (0);
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	for (type = 0; type < 3; ++type)
+	{
+	    gradient = create_gradient (type);
+
+	    /* Odd iterations rotate, scale and translate the gradient */
+	    if (i & 1)
+	    {
+		pixman_transform_init_rotate (
+		    &transform,
+		    pixman_double_to_fixed (cos (i * 0.3)),
+		    pixman_double_to_fixed (sin (i * 0.3)));
+		pixman_transform_scale (
+		    &transform, NULL,
+		    pixman_double_to_fixed (0.25 + prng_rand_n (16) / 4.0),
+		    pixman_double_to_fixed (0.25 + prng_rand_n (16) / 4.0));
+		pixman_transform_translate (
+		    &transform, NULL,
+		    pixman_int_to_fixed (prng_rand_n (WIDTH)),
+		    pixman_int_to_fixed (prng_rand_n (HEIGHT)));
+
+		pixman_image_set_transform (gradient, &transform);
+	    }
+
+	    for (j = 0; j < ARRAY_LENGTH (repeats); ++j)
+	    {
+		pixman_image_set_repeat (gradient, repeats[j]);
+
+		pixman_image_composite32 (
+		    PIXMAN_OP_SRC, gradient, NULL, dest,
+		    0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+
+		crc = compute_crc32_for_image (crc, dest);
+	    }
+
+	    pixman_image_unref (gradient);
+	}
+    }
+
+    pixman_image_unref (dest);
+
+    return crc;
+}
+
+int
+main (int argc, char *argv[])
+{
+#ifdef CAN_RUN_IMPLEMENTATIONS
+    uint32_t crcs[ARRAY_LENGTH (implementations)];
+    int i, n_failures = 0;
+
+    if (argc > 1)
+    {
+	printf ("crc %08x\n", render ());
+	return 0;
+    }
+
+    if (!run_implementations (argv[0], implementations,
+			      ARRAY_LENGTH (implementations), crcs))
+    {
+	return 1;
+    }
+
+    for (i = 0; i < ARRAY_LENGTH (implementations); ++i)
+    {
+	printf ("%-8s %08x\n", implementations[i].name, crcs[i]);
+
+	if (crcs[i] != crcs[0])
+	    n_failures++;
+    }
+
+    if (n_failures)
+    {
+	printf ("gradient fetch test failed\n");
+	return 1;
+    }
+
+    printf ("gradient fetch test passed\n");
+
+    return 0;
+#else
+    printf ("gradient fetch test needs to run itself again\n");
+
+    return 77;
+#endif
+}
@@ -0,0 +1,251 @@
+/*
+ * Checks that gradients rendered from their color ramp, and conical
+ * gradients with their approximate atan2, stay within one of the exact
+ * colors that PIXMAN_FILTER_BEST gives, also after the repeat mode has
+ * been changed, which has to rebuild the ramp. Gradients with hard or
+ * unsorted stops must not use the ramp at all.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define WIDTH		97
+#define HEIGHT		61
+#define N_STOPS		5
+#define N_ITERATIONS	50
+
+static const pixman_repeat_t repeats[] =
+{
+    PIXMAN_REPEAT_NONE,
+    PIXMAN_REPEAT_NORMAL,
+    PIXMAN_REPEAT_PAD,
+    PIXMAN_REPEAT_REFLECT,
+};
+
+static pixman_image_t *
+create_gradient (int type, const pixman_point_fixed_t *p1,
+		 const pixman_point_fixed_t *p2,
+		 const pixman_gradient_stop_t *stops)
+{
+    switch (type)
+    {
+    case 0:
+	return pixman_image_create_linear_gradient (p1, p2, stops, N_STOPS);
+
+    case 1:
+	return pixman_image_create_radial_gradient (
+	    p1, p2, pixman_int_to_fixed (2), pixman_int_to_fixed (WIDTH),
+	    stops, N_STOPS);
+
+    default:
+	return pixman_image_create_conical_gradient (
+	    p1, p2->x, stops, N_STOPS);
+    }
+}
+
+static void
+render (pixman_image_t *gradient, pixman_image_t *dest)
+{
+    pixman_image_composite32 (PIXMAN_OP_SRC, gradient, NULL, dest,
+			      0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+}
+
+static pixman_bool_t
+compare (const uint32_t *a, const uint32_t *b)
+{
+    int i, s;
+
+    for (i = 0; i < WIDTH * HEIGHT; ++i)
+    {
+	for (s = 0; s < 32; s += 8)
+	{
+	    if (abs ((int)((a[i] >> s) & 0xff) - (int)((b[i] >> s) & 0xff)) > 1)
+	    {
+		printf ("%08x is not close to %08x at %d\n", a[i], b[i], i);
+		return FALSE;
+	    }
+	}
+    }
+
+    return TRUE;
+}
+
+static pixman_bool_t
+test_one (int seed)
+{
+    pixman_gradient_stop_t stops[N_STOPS];
+    uint32_t ramp_bits[WIDTH * HEIGHT], exact_bits[WIDTH * HEIGHT];
+    pixman_image_t *ramp_dest, *exact_dest, *ramp, *exact;
+    pixman_point_fixed_t p1, p2;
+    pixman_fixed_t x = 0;
+    int i, type;
+    pixman_bool_t ok;
+
+    prng_srand (seed);
+
+    /* Stops that are far enough apart that the colors in between are
+     * smooth
+     */
+    for (i = 0; i < N_STOPS; ++i)
+    {
+	stops[i].x = x;
+	stops[i].color.red = prng_rand_n (0x10000);
+	stops[i].color.green = prng_rand_n (0x10000);
+	stops[i].color.blue = prng_rand_n (0x10000);
+	stops[i].color.alpha = prng_rand_n (0x10000);
+
+	x += pixman_fixed_1 / N_STOPS / 2 + prng_rand_n (pixman_fixed_1 / N_STOPS / 2);
+    }
+
+    ramp_dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, ramp_bits, WIDTH * 4);
+    exact_dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, exact_bits, WIDTH * 4);
+
+    p1.x = pixman_int_to_fixed (prng_rand_n (WIDTH));
+    p1.y = pixman_int_to_fixed (prng_rand_n (HEIGHT));
+    p2.x = p1.x + pixman_int_to_fixed (prng_rand_n (WIDTH) + 10);
+    p2.y = p1.y + pixman_int_to_fixed (prng_rand_n (HEIGHT));
+
+    type = prng_rand_n (3);
+    ramp = create_gradient (type, &p1, &p2, stops);
+    exact = create_gradient (type, &p1, &p2, stops);
+    pixman_image_set_filter (exact, PIXMAN_FILTER_BEST, NULL, 0);
+
+    ok = TRUE;
+    for (i = 0; i < ARRAY_LENGTH (repeats) && ok; ++i)
+    {
+	pixman_repeat_t repeat = repeats[(i + seed) % ARRAY_LENGTH (repeats)];
+
+	pixman_image_set_repeat (ramp, repeat);
+	pixman_image_set_repeat (exact, repeat);
+
+	render (ramp, ramp_dest);
+	render (exact, exact_dest);
+
+	ok = compare (ramp_bits, exact_bits);
+    }
+
+    pixman_image_unref (ramp);
+    pixman_image_unref (exact);
+    pixman_image_unref (ramp_dest);
+    pixman_image_unref (exact_dest);
+
+    return ok;
+}
+
+/* Renders a linear gradient that is length pixels long with the given
+ * stops and compares it against PIXMAN_FILTER_BEST, either exactly or
+ * within one.
+ */
+static pixman_bool_t
+test_stops (const pixman_fixed_t *positions, int n_stops,
+	    int length, pixman_bool_t exact_only)
+{
+    pixman_gradient_stop_t stops[4];
+    uint32_t bits[WIDTH * HEIGHT], exact_bits[WIDTH * HEIGHT];
+    pixman_image_t *dest, *exact_dest, *gradient, *exact;
+    pixman_point_fixed_t p1 = { 0, 0 };
+    pixman_point_fixed_t p2 = { pixman_int_to_fixed (length), 0 };
+    pixman_bool_t ok = TRUE;
+    int i;
+
+    for (i = 0; i < n_stops; ++i)
+    {
+	stops[i].x = positions[i];
+	stops[i].color.red = (i & 1) ? 0xffff : 0x2000;
+	stops[i].color.green = (i & 2) ? 0xffff : 0x4000;
+	stops[i].color.blue = i * 0x5000;
+	stops[i].color.alpha = 0xffff;
+    }
+
+    dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, bits, WIDTH * 4);
+    exact_dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, exact_bits, WIDTH * 4);
+
+    gradient = pixman_image_create_linear_gradient (&p1, &p2, stops, n_stops);
+    exact = pixman_image_create_linear_gradient (&p1, &p2, stops, n_stops);
+    pixman_image_set_filter (exact, PIXMAN_FILTER_BEST, NULL, 0);
+
+    for (i = 0; i < ARRAY_LENGTH (repeats) && ok; ++i)
+    {
+	pixman_image_set_repeat (gradient, repeats[i]);
+	pixman_image_set_repeat (exact, repeats[i]);
+
+	render (gradient, dest);
+	render (exact, exact_dest);
+
+	if (exact_only)
+	    ok = memcmp (bits, exact_bits, sizeof (bits)) == 0;
+	else
+	    ok = compare (bits, exact_bits);
+
+	if (!ok)
+	    printf ("stops differ from exact colors with repeat %d\n", repeats[i]);
+    }
+
+    pixman_image_unref (gradient);
+    pixman_image_unref (exact);
+    pixman_image_unref (dest);
+    pixman_image_unref (exact_dest);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    static const pixman_fixed_t unsorted[] =
+    {
+	pixman_double_to_fixed (0.2),
+	pixman_double_to_fixed (0.8),
+	pixman_double_to_fixed (0.5),
+    };
+    static const pixman_fixed_t hard[] =
+    {
+	pixman_double_to_fixed (0.0),
+	pixman_double_to_fixed (0.5),
+	pixman_double_to_fixed (0.5),
+	pixman_double_to_fixed (1.0),
+    };
+    /* The steepest colors that still get a ramp */
+    static const pixman_fixed_t steep[] =
+    {
+	0,
+	pixman_fixed_1 / 32,
+    };
+    int i;
+
+    if (!test_stops (unsorted, ARRAY_LENGTH (unsorted), WIDTH, TRUE))
+    {
+	printf ("gradient ramp test failed for unsorted stops\n");
+	return 1;
+    }
+
+    if (!test_stops (hard, ARRAY_LENGTH (hard), WIDTH, TRUE))
+    {
+	printf ("gradient ramp test failed for hard stops\n");
+	return 1;
+    }
+
+    if (!test_stops (steep, ARRAY_LENGTH (steep), 32 * WIDTH, FALSE))
+    {
+	printf ("gradient ramp test failed for steep stops\n");
+	return 1;
+    }
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("gradient ramp test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("gradient ramp test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Checks that the SSE2 linear gradient fetcher gives exactly the same
+ * results as the C one. Gradients of all directions and lengths,
+ * including ones far away from the destination that the fetcher leaves
+ * to the C code, are composited at random offsets and widths so that
+ * spans end at every position within a group of four pixels.
+ */
+#include "utils.h"
+#include <stdio.h>
+
+#define WIDTH		131
+#define HEIGHT		29
+#define N_STOPS		4
+#define N_ITERATIONS	400
+
+static const implementation_t implementations[] =
+{
+    { "C",		"avx2 sse2 mmx fast" },
+    { "sse2",		"avx2" },
+};
+
+static const pixman_repeat_t repeats[] =
+{
+    PIXMAN_REPEAT_NONE,
+    PIXMAN_REPEAT_NORMAL,
+    PIXMAN_REPEAT_PAD,
+    PIXMAN_REPEAT_REFLECT,
+};
+
+static pixman_image_t *
+create_gradient (void)
+{
+    pixman_gradient_stop_t stops[N_STOPS];
+    pixman_point_fixed_t p1, p2;
+    int i, scale;
+
+    for (i = 0; i < N_STOPS; ++i)
+    {
+	stops[i].x = pixman_fixed_1 * i / (N_STOPS - 1);
+	stops[i].color.red = prng_rand_n (0x10000);
+	stops[i].color.green = prng_rand_n (0x10000);
+	stops[i].color.blue = prng_rand_n (0x10000);
+	stops[i].color.alpha = prng_rand_n (0x10000);
+    }
+
+    /* Short, long and very long gradients, the latter putting the
+     * positions out of the range the fetcher handles.
+     */
+    scale = 1 << prng_rand_n (15);
+
+    p1.x = pixman_int_to_fixed (prng_rand_n (WIDTH)) + prng_rand_n (pixman_fixed_1);
+    p1.y = pixman_int_to_fixed (prng_rand_n (HEIGHT)) + prng_rand_n (pixman_fixed_1);
+    p2 = p1;
+
+    /* Horizontal, vertical and arbitrary directions */
+    switch (prng_rand_n (3))
+    {
+    case 0:
+	p2.x += (prng_rand_n (2 * WIDTH * scale) - WIDTH * scale) * 0x100;
+	break;
+
+    case 1:
+	p2.y += (prng_rand_n (2 * HEIGHT * scale) - HEIGHT * scale) * 0x100;
+	break;
+
+    default:
+	p2.x += (prng_rand_n (2 * WIDTH * scale) - WIDTH * scale) * 0x100;
+	p2.y += (prng_rand_n (2 * HEIGHT * scale) - HEIGHT * scale) * 0x100;
+	break;
+    }
+
+    if (p1.x == p2.x && p1.y == p2.y)
+	p2.x += pixman_fixed_1;
+
+    return pixman_image_create_linear_gradient (&p1, &p2, stops, N_STOPS);
+}
+
+static uint32_t
+render (void)
+{
+    pixman_image_t *dest, *gradient;
+    pixman_transform_t transform;
+    uint32_t crc = 0;
+    int i, j;
+
+    dest = pixman_image_create_bits (PIXMAN_a8r8g8b8, WIDTH, HEIGHT, NULL, -1);
+
+    prng_srand (0);
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	int x = prng_rand_n (WIDTH);
+	int y = prng_rand_n (HEIGHT);
+	int w = prng_rand_n (WIDTH - x) + 1;
+	int h = prng_rand_n (HEIGHT - y) + 1;
+
+	gradient = create_gradient ();
+
+	/* Every other gradient is skewed */
+	if (i & 1)
+	{
+	    pixman_transform_init_identity (&transform);
+	    transform.matrix[0][1] = prng_rand_n (2 * pixman_fixed_1) - pixman_fixed_1;
+	    transform.matrix[1][0] = prng_rand_n (2 * pixman_fixed_1) - pixman_fixed_1;
+
+	    pixman_image_set_transform (gradient, &transform);
+	}
+
+	for (j = 0; j < ARRAY_LENGTH (repeats); ++j)
+	{
+	    pixman_image_set_repeat (gradient, repeats[j]);
+
+	    memset (pixman_image_get_data (dest), 0,
+		    pixman_image_get_stride (dest) * HEIGHT);
+
+	    pixman_image_composite32 (
+		PIXMAN_OP_SRC, gradient, NULL, dest,
+		prng_rand_n (64) - 32, prng_rand_n (64) - 32, 0, 0,
+		x, y, w, h);
+
+	    crc = compute_crc32_for_image (crc, dest);
+	}
+
+	pixman_image_unref (gradient);
+    }
+
+    pixman_image_unref (dest);
+
+    return crc;
+}
+
+int
+main (int argc, char *argv[])
+{
+#ifdef CAN_RUN_IMPLEMENTATIONS
+    uint32_t crcs[ARRAY_LENGTH (implementations)];
+    int i, n_failures = 0;
+
+    if (argc > 1)
+    {
+	printf ("crc %08x\n", render ());
+	return 0;
+    }
+
+    if (!run_implementations (argv[0], implementations,
+			      ARRAY_LENGTH (implementations), crcs))
+    {
+	return 1;
+    }
+
+    for (i = 0; i < ARRAY_LENGTH (implementations); ++i)
+    {
+	printf ("%-8s %08x\n", implementations[i].name, crcs[i]);
+
+	if (crcs[i] != crcs[0])
+	    n_failures++;
+    }
+
+    if (n_failures)
+    {
+	printf ("linear gradient test failed\n");
+	return 1;
+    }
+
+    printf ("linear gradient test passed\n");
+
+    return 0;
+#else
+    printf ("linear gradient test needs to run itself again\n");
+
+    return 77;
+#endif
+}
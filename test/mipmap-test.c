@@ -0,0 +1,335 @@
+/*
+ * Checks that images with a mipmap mode are sampled from 2x2 box
+ * reductions of themselves, chosen from the scale of the transform,
+ * by comparing them with reductions made here that are composited with
+ * the scaled transform. With PIXMAN_MIPMAP_LINEAR the two levels are
+ * blended like UN8x4_MUL_UN8_ADD_UN8x4_MUL_UN8() does it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "utils.h"
+
+#define WIDTH		43
+#define HEIGHT		29
+#define N_ITERATIONS	400
+
+/* The 2x2 box reduction of the a8r8g8b8 image src */
+static pixman_image_t *
+reduce (pixman_image_t *src)
+{
+    int w = pixman_image_get_width (src);
+    int h = pixman_image_get_height (src);
+    uint32_t *s = pixman_image_get_data (src);
+    pixman_image_t *dst = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, (w + 1) / 2, (h + 1) / 2, NULL, -1);
+    uint32_t *d = pixman_image_get_data (dst);
+    int x, y, c;
+
+    for (y = 0; y < (h + 1) / 2; ++y)
+    {
+	for (x = 0; x < (w + 1) / 2; ++x)
+	{
+	    int x0 = 2 * x, x1 = MIN (2 * x + 1, w - 1);
+	    int y0 = 2 * y, y1 = MIN (2 * y + 1, h - 1);
+	    uint32_t result = 0;
+
+	    for (c = 0; c < 32; c += 8)
+	    {
+		uint32_t sum =
+		    ((s[y0 * w + x0] >> c) & 0xff) + ((s[y0 * w + x1] >> c) & 0xff) +
+		    ((s[y1 * w + x0] >> c) & 0xff) + ((s[y1 * w + x1] >> c) & 0xff);
+
+		result |= ((sum + 2) >> 2) << c;
+	    }
+
+	    d[y * ((w + 1) / 2) + x] = result;
+	}
+    }
+
+    return dst;
+}
+
+/* Composites level n, which is image when n is 0, into dest bits */
+static void
+composite_level (pixman_image_t *image, int n, const pixman_transform_t *transform,
+		 pixman_filter_t filter, pixman_repeat_t repeat_mode, uint32_t *bits)
+{
+    pixman_image_t *dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, bits, WIDTH * 4);
+    pixman_transform_t t = *transform;
+    int i, j;
+
+    for (i = 0; i < 2; ++i)
+    {
+	for (j = 0; j < 3 && n; ++j)
+	    t.matrix[i][j] = ((int64_t)t.matrix[i][j] + (1 << (n - 1))) >> n;
+    }
+
+    pixman_image_set_transform (image, &t);
+    pixman_image_set_filter (image, filter, NULL, 0);
+    pixman_image_set_repeat (image, repeat_mode);
+
+    pixman_image_composite32 (PIXMAN_OP_SRC, image, NULL, dest,
+			      0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+
+    pixman_image_unref (dest);
+}
+
+static uint32_t
+mul_un8 (uint32_t x, uint32_t a)
+{
+    uint32_t t = x * a + 0x80;
+
+    return ((t >> 8) + t) >> 8;
+}
+
+static uint32_t
+blend (uint32_t fine, uint32_t coarse, uint32_t w)
+{
+    uint32_t result = 0;
+    int c;
+
+    for (c = 0; c < 32; c += 8)
+    {
+	uint32_t v = mul_un8 ((fine >> c) & 0xff, 255 - w) +
+	    mul_un8 ((coarse >> c) & 0xff, w);
+
+	result |= MIN (v, 0xff) << c;
+    }
+
+    return result;
+}
+
+/* Accessors that invert the colors, but not alpha */
+static uint32_t
+read_inverted (const void *src, int size)
+{
+    uint32_t v = 0;
+
+    memcpy (&v, src, size);
+
+    return size == 4 ? v ^ 0x00ffffff : v;
+}
+
+static void
+write_memory (void *dst, uint32_t value, int size)
+{
+    memcpy (dst, &value, size);
+}
+
+static pixman_bool_t
+test_one (int seed)
+{
+    static const pixman_repeat_t repeats[] =
+    {
+	PIXMAN_REPEAT_NONE, PIXMAN_REPEAT_NORMAL,
+	PIXMAN_REPEAT_PAD, PIXMAN_REPEAT_REFLECT
+    };
+    static const pixman_filter_t filters[] =
+    {
+	PIXMAN_FILTER_NEAREST, PIXMAN_FILTER_BILINEAR, PIXMAN_FILTER_GOOD
+    };
+    uint32_t result[WIDTH * HEIGHT];
+    uint32_t fine[WIDTH * HEIGHT], coarse[WIDTH * HEIGHT];
+    pixman_image_t *levels[32];
+    pixman_image_t *src, *dest;
+    pixman_format_code_t format;
+    pixman_transform_t transform;
+    pixman_repeat_t repeat_mode;
+    pixman_filter_t filter;
+    pixman_mipmap_t mipmap;
+    uint32_t *src_bits;
+    int src_width, src_height, n_levels, level, weight, max_level, pass, i;
+    double angle, scale_x, scale_y, lod;
+    pixman_bool_t ok = TRUE;
+
+    prng_srand (seed);
+
+    src_width = prng_rand_n (400) + 1;
+    src_height = prng_rand_n (200) + 1;
+    src_bits = malloc (src_width * src_height * 4);
+
+    format = prng_rand_n (2) ? PIXMAN_a8r8g8b8 : PIXMAN_x8r8g8b8;
+    repeat_mode = repeats[prng_rand_n (ARRAY_LENGTH (repeats))];
+    filter = filters[prng_rand_n (ARRAY_LENGTH (filters))];
+    mipmap = prng_rand_n (2) ? PIXMAN_MIPMAP_NEAREST : PIXMAN_MIPMAP_LINEAR;
+
+    /* Anything from a slight magnification to a large reduction,
+     * sometimes rotated.
+     */
+    scale_x = pow (2, prng_rand_n (1000) / 1000.0 * 7 - 1);
+    scale_y = pow (2, prng_rand_n (1000) / 1000.0 * 7 - 1);
+    angle = prng_rand_n (4) ? 0 : prng_rand_n (1000) / 1000.0;
+
+    pixman_transform_init_identity (&transform);
+    transform.matrix[0][0] = pixman_double_to_fixed (scale_x * cos (angle));
+    transform.matrix[0][1] = pixman_double_to_fixed (-scale_y * sin (angle));
+    transform.matrix[1][0] = pixman_double_to_fixed (scale_x * sin (angle));
+    transform.matrix[1][1] = pixman_double_to_fixed (scale_y * cos (angle));
+    transform.matrix[0][2] = prng_rand_n (60 * pixman_fixed_1) - 30 * pixman_fixed_1;
+    transform.matrix[1][2] = prng_rand_n (60 * pixman_fixed_1) - 30 * pixman_fixed_1;
+
+    src = pixman_image_create_bits (
+	format, src_width, src_height, src_bits, src_width * 4);
+    dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, result, WIDTH * 4);
+
+    pixman_image_set_transform (src, &transform);
+    pixman_image_set_filter (src, filter, NULL, 0);
+    pixman_image_set_repeat (src, repeat_mode);
+
+    /* The level of detail, like pixman-mipmap.c computes it */
+    lod = log2 (MAX (
+	hypot (pixman_fixed_to_double (transform.matrix[0][0]),
+	       pixman_fixed_to_double (transform.matrix[1][0])),
+	hypot (pixman_fixed_to_double (transform.matrix[0][1]),
+	       pixman_fixed_to_double (transform.matrix[1][1]))));
+
+    max_level = 0;
+    while ((src_width - 1) >> max_level || (src_height - 1) >> max_level)
+	max_level++;
+
+    if (mipmap == PIXMAN_MIPMAP_NEAREST)
+    {
+	level = floor (lod + 0.5);
+	weight = 0;
+    }
+    else
+    {
+	level = floor (lod);
+	weight = (int)((lod - level) * 255 + 0.5);
+	if (weight == 255)
+	{
+	    level++;
+	    weight = 0;
+	}
+    }
+
+    if (lod <= 0 || level < 0)
+    {
+	level = 0;
+	weight = 0;
+    }
+    else if (level >= max_level)
+    {
+	level = max_level;
+	weight = 0;
+    }
+
+    /* The levels are made again when the mipmap mode is set after the
+     * pixels change, and without setting it again after pixman writes
+     * to the image by compositing, filling or blitting, and after the
+     * accessors change.
+     */
+    for (pass = 0; pass < 5 && ok; ++pass)
+    {
+	uint32_t invert = 0;
+	pixman_image_t *random;
+	int x, y;
+
+	switch (pass)
+	{
+	case 0:
+	    prng_randmemset (src_bits, src_width * src_height * 4, 0);
+	    pixman_image_set_mipmap (src, mipmap);
+	    break;
+
+	case 1:
+	    random = make_random_image (PIXMAN_a8r8g8b8, src_width, src_height);
+	    pixman_image_composite32 (PIXMAN_OP_SRC, random, NULL, src,
+				      0, 0, 0, 0, 0, 0, src_width, src_height);
+	    pixman_image_unref (random);
+	    break;
+
+	case 2:
+	    x = prng_rand_n (src_width);
+	    y = prng_rand_n (src_height);
+	    pixman_fill (src_bits, src_width, 32, x, y,
+			 prng_rand_n (src_width - x) + 1,
+			 prng_rand_n (src_height - y) + 1, prng_rand ());
+	    break;
+
+	case 3:
+	    random = make_random_image (PIXMAN_a8r8g8b8, src_width, src_height);
+	    pixman_blt (pixman_image_get_data (random), src_bits,
+			src_width, src_width, 32, 32,
+			0, 0, 0, 0, src_width, src_height);
+	    pixman_image_unref (random);
+	    break;
+
+	default:
+	    pixman_image_set_accessors (src, read_inverted, write_memory);
+	    invert = 0x00ffffff;
+	    break;
+	}
+
+	pixman_image_composite32 (PIXMAN_OP_SRC, src, NULL, dest,
+				  0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+
+	/* The reference levels start from the image as a8r8g8b8 */
+	levels[0] = pixman_image_create_bits (
+	    PIXMAN_a8r8g8b8, src_width, src_height, NULL, -1);
+	for (i = 0; i < src_width * src_height; ++i)
+	{
+	    pixman_image_get_data (levels[0])[i] = (src_bits[i] ^ invert) |
+		(format == PIXMAN_x8r8g8b8 ? 0xff000000 : 0);
+	}
+
+	n_levels = level + (weight ? 2 : 1);
+	for (i = 1; i < n_levels; ++i)
+	    levels[i] = reduce (levels[i - 1]);
+
+	composite_level (level ? levels[level] : levels[0], level,
+			 &transform, filter, repeat_mode, fine);
+
+	if (weight)
+	{
+	    composite_level (levels[level + 1], level + 1,
+			     &transform, filter, repeat_mode, coarse);
+
+	    for (i = 0; i < WIDTH * HEIGHT; ++i)
+		fine[i] = blend (fine[i], coarse[i], weight);
+	}
+
+	for (i = 0; i < WIDTH * HEIGHT; ++i)
+	{
+	    if (result[i] != fine[i])
+	    {
+		printf ("%08x != %08x at %d, %d (level %d, weight %d)\n",
+			result[i], fine[i], i % WIDTH, i / WIDTH, level, weight);
+		ok = FALSE;
+		break;
+	    }
+	}
+
+	for (i = 0; i < n_levels; ++i)
+	    pixman_image_unref (levels[i]);
+    }
+
+    pixman_image_unref (src);
+    pixman_image_unref (dest);
+    free (src_bits);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("mipmap test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("mipmap test passed\n");
+
+    return 0;
+}
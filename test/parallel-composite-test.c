@@ -0,0 +1,155 @@
+/*
+ * Checks that compositing with several threads gives exactly the same
+ * result as compositing with one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define WIDTH		613
+#define HEIGHT		419
+#define N_ITERATIONS	24
+
+static const pixman_format_code_t formats[] =
+{
+    PIXMAN_a8r8g8b8,
+    PIXMAN_x8r8g8b8,
+    PIXMAN_r5g6b5,
+    PIXMAN_a8,
+};
+
+static const pixman_op_t operators[] =
+{
+    PIXMAN_OP_SRC,
+    PIXMAN_OP_OVER,
+    PIXMAN_OP_ADD,
+    PIXMAN_OP_OUT_REVERSE,
+    PIXMAN_OP_MULTIPLY,
+};
+
+static const pixman_filter_t filters[] =
+{
+    PIXMAN_FILTER_NEAREST,
+    PIXMAN_FILTER_BILINEAR,
+};
+
+static pixman_image_t *
+create_source (void)
+{
+    pixman_image_t *image;
+
+    if (prng_rand_n (4) == 0)
+    {
+	pixman_gradient_stop_t stops[2];
+	pixman_point_fixed_t p1, p2;
+
+	p1.x = pixman_int_to_fixed (prng_rand_n (WIDTH));
+	p1.y = pixman_int_to_fixed (prng_rand_n (HEIGHT));
+	p2.x = pixman_int_to_fixed (prng_rand_n (WIDTH));
+	p2.y = pixman_int_to_fixed (prng_rand_n (HEIGHT));
+
+	stops[0].x = 0;
+	stops[0].color.red = 0xffff;
+	stops[0].color.green = 0x8000;
+	stops[0].color.blue = 0x0000;
+	stops[0].color.alpha = 0xffff;
+	stops[1].x = pixman_fixed_1;
+	stops[1].color.red = 0x0000;
+	stops[1].color.green = 0x4000;
+	stops[1].color.blue = 0xffff;
+	stops[1].color.alpha = 0x8000;
+
+	image = pixman_image_create_linear_gradient (&p1, &p2, stops, 2);
+    }
+    else
+    {
+	image = make_random_image (
+	    formats[prng_rand_n (ARRAY_LENGTH (formats))],
+	    WIDTH / 2 + prng_rand_n (WIDTH),
+	    HEIGHT / 2 + prng_rand_n (HEIGHT));
+
+	if (prng_rand_n (2))
+	{
+	    pixman_transform_t transform;
+
+	    pixman_transform_init_scale (&transform,
+					 pixman_fixed_1 / 2 + prng_rand_n (pixman_fixed_1),
+					 pixman_fixed_1 / 2 + prng_rand_n (pixman_fixed_1));
+	    pixman_image_set_transform (image, &transform);
+	    pixman_image_set_filter (image,
+				     filters[prng_rand_n (ARRAY_LENGTH (filters))],
+				     NULL, 0);
+	}
+
+	pixman_image_set_repeat (image, prng_rand_n (4));
+    }
+
+    return image;
+}
+
+static uint32_t
+test_one (int seed, int n_threads)
+{
+    pixman_image_t *src, *dest;
+    pixman_format_code_t dest_format;
+    pixman_op_t op;
+    uint32_t crc;
+
+    prng_srand (seed);
+
+    src = create_source ();
+    op = operators[prng_rand_n (ARRAY_LENGTH (operators))];
+    dest_format = formats[prng_rand_n (ARRAY_LENGTH (formats))];
+    dest = make_random_image (dest_format, WIDTH, HEIGHT);
+
+    if (prng_rand_n (2))
+    {
+	pixman_region32_t clip;
+
+	pixman_region32_init_rect (&clip, 0, 0, WIDTH / 2, HEIGHT);
+	pixman_region32_union_rect (&clip, &clip, WIDTH / 3, HEIGHT / 4,
+				    WIDTH / 2, HEIGHT / 2);
+	pixman_image_set_clip_region32 (dest, &clip);
+	pixman_region32_fini (&clip);
+    }
+
+    pixman_set_thread_count (n_threads);
+
+    pixman_image_composite32 (op, src, NULL, dest,
+			      prng_rand_n (32), prng_rand_n (32), 0, 0,
+			      prng_rand_n (16), prng_rand_n (16),
+			      WIDTH, HEIGHT);
+
+    pixman_set_thread_count (1);
+
+    crc = compute_crc32_for_image (0, dest);
+
+    pixman_image_unref (src);
+    pixman_image_unref (dest);
+
+    return crc;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	uint32_t crc1 = test_one (i, 1);
+	uint32_t crc4 = test_one (i, 4);
+
+	if (crc1 != crc4)
+	{
+	    printf ("parallel composite test failed for seed %d "
+		    "(%08x with one thread, %08x with four)\n", i, crc1, crc4);
+	    return 1;
+	}
+    }
+
+    printf ("parallel composite test passed\n");
+
+    return 0;
+}
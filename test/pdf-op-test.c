@@ -1,6 +1,9 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include "utils.h"
 
+#define WIDTH 37
+
 static const pixman_op_t pdf_ops[] =
 {
     PIXMAN_OP_MULTIPLY,
@@ -31,10 +34,103 @@ static const uint32_t pixels[] =
     0x00123456,
 };
 
+static uint32_t
+random_pixel (void)
+{
+    uint32_t a, r, g, b;
+
+    /* Mostly premultiplied pixels, but also some that aren't */
+    if (prng_rand_n (8) == 0)
+	return prng_rand ();
+
+    switch (prng_rand_n (4))
+    {
+    case 0:
+	a = 0;
+	break;
+    case 1:
+	a = 0xff;
+	break;
+    default:
+	a = prng_rand_n (256);
+	break;
+    }
+
+    r = prng_rand_n (a + 1);
+    g = prng_rand_n (a + 1);
+    b = prng_rand_n (a + 1);
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+/* Composites a row of pixels at once and checks that the result is the
+ * same as compositing each pixel on its own.
+ */
+static pixman_bool_t
+test_row (pixman_op_t op, int mask_type)
+{
+    uint32_t src_bits[WIDTH], mask_bits[WIDTH], dest_bits[WIDTH];
+    uint32_t expected[WIDTH];
+    pixman_image_t *src, *msk, *dst;
+    int i;
+
+    for (i = 0; i < WIDTH; ++i)
+    {
+	src_bits[i] = random_pixel ();
+	mask_bits[i] = random_pixel ();
+	dest_bits[i] = expected[i] = random_pixel ();
+    }
+
+    for (i = 0; i < WIDTH; ++i)
+    {
+	src = pixman_image_create_bits (
+	    PIXMAN_a8r8g8b8, 1, 1, &src_bits[i], 4);
+	msk = pixman_image_create_bits (
+	    PIXMAN_a8r8g8b8, 1, 1, &mask_bits[i], 4);
+	dst = pixman_image_create_bits (
+	    PIXMAN_a8r8g8b8, 1, 1, &expected[i], 4);
+
+	pixman_image_set_component_alpha (msk, mask_type == 2);
+	pixman_image_composite (op, src, mask_type ? msk : NULL, dst,
+				0, 0, 0, 0, 0, 0, 1, 1);
+
+	pixman_image_unref (src);
+	pixman_image_unref (msk);
+	pixman_image_unref (dst);
+    }
+
+    src = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, 1, src_bits, WIDTH * 4);
+    msk = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, 1, mask_bits, WIDTH * 4);
+    dst = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, 1, dest_bits, WIDTH * 4);
+
+    pixman_image_set_component_alpha (msk, mask_type == 2);
+    pixman_image_composite (op, src, mask_type ? msk : NULL, dst,
+			    0, 0, 0, 0, 0, 0, WIDTH, 1);
+
+    pixman_image_unref (src);
+    pixman_image_unref (msk);
+    pixman_image_unref (dst);
+
+    for (i = 0; i < WIDTH; ++i)
+    {
+	if (dest_bits[i] != expected[i])
+	{
+	    printf ("op %d, mask type %d: got %08x, expected %08x at %d\n",
+		    op, mask_type, dest_bits[i], expected[i], i);
+	    return FALSE;
+	}
+    }
+
+    return TRUE;
+}
+
 int
 main ()
 {
-    int o, s, m, d;
+    int o, s, m, d, i;
 
     enable_divbyzero_exceptions();
 
@@ -79,5 +175,19 @@ main ()
 	}
     }
 
+    prng_srand (0);
+
+    for (o = 0; o < ARRAY_LENGTH (pdf_ops); ++o)
+    {
+	for (m = 0; m < 3; ++m)
+	{
+	    for (i = 0; i < 200; ++i)
+	    {
+		if (!test_row (pdf_ops[o], m))
+		    return 1;
+	    }
+	}
+    }
+
     return 0;
 }
@@ -1,8 +1,18 @@
 #include "utils.h"
 #include <stdio.h>
 
-int
-main ()
+#define WIDTH		640
+#define HEIGHT		361
+
+static const implementation_t implementations[] =
+{
+    { "default",	"" },
+    { "sse2",		"avx2" },
+    { "C",		"avx2 sse2 mmx" },
+};
+
+static double
+run (void)
 {
     static const pixman_point_fixed_t inner = { 0x0000, 0x0000 };
     static const pixman_point_fixed_t outer = { 0x0000, 0x0000 };
@@ -46,13 +56,45 @@ main ()
 
 	pixman_image_composite32 (
 	    PIXMAN_OP_OVER, radial, NULL, dest,
-	    - 150, -158, 0, 0, 0, 0, 640, 361);
+	    - 150, -158, 0, 0, 0, 0, WIDTH, HEIGHT);
     }
 
     after = gettime();
 
     write_png (dest, "radial.png");
 
-    printf ("Average time to composite: %f\n", (after - before) / N_COMPOSITE);
+    pixman_image_unref (radial);
+    pixman_image_unref (zero);
+    pixman_image_unref (dest);
+
+    return (after - before) / N_COMPOSITE;
+}
+
+static void
+report (const char *name, double t)
+{
+    printf ("%-10s average time to composite: %f, %.2f Mpixels/s\n",
+	    name, t, WIDTH * HEIGHT / t / 1000000.);
+}
+
+int
+main (int argc, char *argv[])
+{
+#ifdef CAN_RUN_IMPLEMENTATIONS
+    if (argc > 1)
+    {
+	report (argv[1], run ());
+	return 0;
+    }
+
+    if (!run_implementations (argv[0], implementations,
+			      ARRAY_LENGTH (implementations), NULL))
+    {
+	return 1;
+    }
+#else
+    report ("default", run ());
+#endif
+
     return 0;
 }
@@ -0,0 +1,398 @@
+/*
+ * Checks that affine transformed a8r8g8b8 and x8r8g8b8 images with a
+ * separable convolution filter are sampled exactly like the reference
+ * below, which does what bits_image_fetch_separable_convolution_affine()
+ * does. The SIMD fetchers have to give bit-identical results. Scaled
+ * images are filtered in two passes, which don't round the weights, so
+ * for those the result has to match either that reference or the two
+ * pass one exactly. Either way, compositing a wide rectangle at once has
+ * to give exactly the same results as compositing it in tiles.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "pixman-inlines.h"
+
+#define WIDTH		71
+#define HEIGHT		23
+#define N_ITERATIONS	300
+
+#define WIDE_WIDTH	3000
+#define WIDE_HEIGHT	150
+#define TILE_WIDTH	1000
+#define N_WIDE_TESTS	8
+
+static uint32_t
+reference_pixel (const uint32_t *bits, int width, int height,
+		 pixman_bool_t has_alpha, pixman_repeat_t repeat_mode,
+		 const pixman_fixed_t *params, pixman_fixed_t vx, pixman_fixed_t vy)
+{
+    int cwidth = pixman_fixed_to_int (params[0]);
+    int cheight = pixman_fixed_to_int (params[1]);
+    int x_off = ((cwidth << 16) - pixman_fixed_1) >> 1;
+    int y_off = ((cheight << 16) - pixman_fixed_1) >> 1;
+    int x_phase_bits = pixman_fixed_to_int (params[2]);
+    int x_phase_shift = 16 - x_phase_bits;
+    int y_phase_shift = 16 - pixman_fixed_to_int (params[3]);
+    const pixman_fixed_t *x_params, *y_params;
+    int32_t tot[4] = { 0, 0, 0, 0 };
+    pixman_fixed_t x, y;
+    int x1, y1, i, j, c;
+    uint32_t result = 0;
+
+    x = ((vx >> x_phase_shift) << x_phase_shift) + ((1 << x_phase_shift) >> 1);
+    y = ((vy >> y_phase_shift) << y_phase_shift) + ((1 << y_phase_shift) >> 1);
+
+    x_params = params + 4 + ((x & 0xffff) >> x_phase_shift) * cwidth;
+    y_params = params + 4 + (1 << x_phase_bits) * cwidth +
+	((y & 0xffff) >> y_phase_shift) * cheight;
+
+    x1 = pixman_fixed_to_int (x - pixman_fixed_e - x_off);
+    y1 = pixman_fixed_to_int (y - pixman_fixed_e - y_off);
+
+    for (i = 0; i < cheight; ++i)
+    {
+	for (j = 0; j < cwidth; ++j)
+	{
+	    int32_t f = ((int64_t)x_params[j] * y_params[i] + 0x8000) >> 16;
+	    int rx = x1 + j, ry = y1 + i;
+	    uint32_t pixel;
+
+	    if (repeat (repeat_mode, &rx, width) &&
+		repeat (repeat_mode, &ry, height))
+	    {
+		pixel = bits[ry * width + rx] | (has_alpha ? 0 : 0xff000000);
+	    }
+	    else
+	    {
+		pixel = 0;
+	    }
+
+	    for (c = 0; c < 4; ++c)
+		tot[c] += (int32_t)((pixel >> (8 * c)) & 0xff) * f;
+	}
+    }
+
+    for (c = 0; c < 4; ++c)
+    {
+	int32_t v = (tot[c] + 0x8000) >> 16;
+
+	result |= (uint32_t)CLIP (v, 0, 0xff) << (8 * c);
+    }
+
+    return result;
+}
+
+/* What the two pass scaler computes: the exact sum of the products of
+ * the pixels and the x and y filter values, rounded once.
+ */
+static uint32_t
+reference_scaled_pixel (const uint32_t *bits, int width, int height,
+			pixman_bool_t has_alpha, pixman_repeat_t repeat_mode,
+			const pixman_fixed_t *params,
+			pixman_fixed_t vx, pixman_fixed_t vy)
+{
+    int cwidth = pixman_fixed_to_int (params[0]);
+    int cheight = pixman_fixed_to_int (params[1]);
+    int x_off = ((cwidth << 16) - pixman_fixed_1) >> 1;
+    int y_off = ((cheight << 16) - pixman_fixed_1) >> 1;
+    int x_phase_bits = pixman_fixed_to_int (params[2]);
+    int x_phase_shift = 16 - x_phase_bits;
+    int y_phase_shift = 16 - pixman_fixed_to_int (params[3]);
+    const pixman_fixed_t *x_params, *y_params;
+    int64_t tot[4] = { 0, 0, 0, 0 };
+    pixman_fixed_t x, y;
+    int x1, y1, i, j, c;
+    uint32_t result = 0;
+
+    x = ((vx >> x_phase_shift) << x_phase_shift) + ((1 << x_phase_shift) >> 1);
+    y = ((vy >> y_phase_shift) << y_phase_shift) + ((1 << y_phase_shift) >> 1);
+
+    x_params = params + 4 + ((x & 0xffff) >> x_phase_shift) * cwidth;
+    y_params = params + 4 + (1 << x_phase_bits) * cwidth +
+	((y & 0xffff) >> y_phase_shift) * cheight;
+
+    x1 = pixman_fixed_to_int (x - pixman_fixed_e - x_off);
+    y1 = pixman_fixed_to_int (y - pixman_fixed_e - y_off);
+
+    for (i = 0; i < cheight; ++i)
+    {
+	int64_t row[4] = { 0, 0, 0, 0 };
+	int ry = y1 + i;
+
+	if (!repeat (repeat_mode, &ry, height))
+	    continue;
+
+	for (j = 0; j < cwidth; ++j)
+	{
+	    int rx = x1 + j;
+	    uint32_t pixel;
+
+	    if (!repeat (repeat_mode, &rx, width))
+		continue;
+
+	    pixel = bits[ry * width + rx] | (has_alpha ? 0 : 0xff000000);
+
+	    for (c = 0; c < 4; ++c)
+		row[c] += (int64_t)((pixel >> (8 * c)) & 0xff) * x_params[j];
+	}
+
+	for (c = 0; c < 4; ++c)
+	    tot[c] += row[c] * y_params[i];
+    }
+
+    for (c = 0; c < 4; ++c)
+    {
+	int64_t v = (tot[c] + ((int64_t)1 << 31)) >> 32;
+
+	result |= (uint32_t)CLIP (v, 0, 0xff) << (8 * c);
+    }
+
+    return result;
+}
+
+static pixman_fixed_t *
+create_params (int *n_params, pixman_fixed_t scale_x, pixman_fixed_t scale_y)
+{
+    pixman_fixed_t *params;
+    int cwidth, cheight, x_phase_bits, y_phase_bits, i;
+
+    if (prng_rand_n (6))
+    {
+	return pixman_filter_create_separable_convolution (
+	    n_params, scale_x, scale_y,
+	    prng_rand_n (PIXMAN_KERNEL_LANCZOS3_STRETCHED + 1),
+	    prng_rand_n (PIXMAN_KERNEL_LANCZOS3_STRETCHED + 1),
+	    prng_rand_n (PIXMAN_KERNEL_LANCZOS3_STRETCHED + 1),
+	    prng_rand_n (PIXMAN_KERNEL_LANCZOS3_STRETCHED + 1),
+	    prng_rand_n (5), prng_rand_n (5));
+    }
+
+    /* Arbitrary values, some of them too large for 16 bit weights */
+    cwidth = prng_rand_n (6) + 1;
+    cheight = prng_rand_n (6) + 1;
+    x_phase_bits = prng_rand_n (3);
+    y_phase_bits = prng_rand_n (3);
+
+    *n_params = 4 + (1 << x_phase_bits) * cwidth + (1 << y_phase_bits) * cheight;
+    params = malloc (*n_params * sizeof (pixman_fixed_t));
+
+    params[0] = pixman_int_to_fixed (cwidth);
+    params[1] = pixman_int_to_fixed (cheight);
+    params[2] = pixman_int_to_fixed (x_phase_bits);
+    params[3] = pixman_int_to_fixed (y_phase_bits);
+
+    for (i = 4; i < *n_params; ++i)
+    {
+	if (prng_rand_n (4))
+	    params[i] = prng_rand_n (0x8000) - 0x2000;
+	else
+	    params[i] = prng_rand_n (0x1c000) - 0x8000;
+    }
+
+    return params;
+}
+
+static pixman_bool_t
+test_one (int seed)
+{
+    static const pixman_repeat_t repeats[] =
+    {
+	PIXMAN_REPEAT_NONE, PIXMAN_REPEAT_NORMAL,
+	PIXMAN_REPEAT_PAD, PIXMAN_REPEAT_REFLECT
+    };
+    uint32_t dest_bits[WIDTH * HEIGHT];
+    pixman_image_t *src, *dest;
+    pixman_transform_t transform;
+    pixman_repeat_t repeat_mode;
+    pixman_fixed_t *params;
+    pixman_bool_t has_alpha;
+    uint32_t *src_bits;
+    int src_width, src_height, n_params, x, y;
+    pixman_bool_t scaled;
+    pixman_bool_t result = TRUE;
+
+    prng_srand (seed);
+
+    src_width = prng_rand_n (300) + 1;
+    src_height = prng_rand_n (100) + 1;
+    src_bits = malloc (src_width * src_height * 4);
+    prng_randmemset (src_bits, src_width * src_height * 4, 0);
+
+    has_alpha = prng_rand_n (2);
+    repeat_mode = repeats[prng_rand_n (4)];
+
+    src = pixman_image_create_bits (
+	has_alpha ? PIXMAN_a8r8g8b8 : PIXMAN_x8r8g8b8,
+	src_width, src_height, src_bits, src_width * 4);
+    dest = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDTH, HEIGHT, dest_bits, WIDTH * 4);
+
+    /* Mostly downscaling, half of the time with a bit of shearing */
+    pixman_transform_init_identity (&transform);
+    transform.matrix[0][0] = prng_rand_n (8 * pixman_fixed_1) + pixman_fixed_1 / 4;
+    transform.matrix[1][1] = prng_rand_n (8 * pixman_fixed_1) + pixman_fixed_1 / 4;
+    if (prng_rand_n (2))
+    {
+	transform.matrix[0][1] = prng_rand_n (pixman_fixed_1) - pixman_fixed_1 / 2;
+	transform.matrix[1][0] = prng_rand_n (pixman_fixed_1) - pixman_fixed_1 / 2;
+    }
+    transform.matrix[0][2] = prng_rand_n (100 * pixman_fixed_1) - 50 * pixman_fixed_1;
+    transform.matrix[1][2] = prng_rand_n (100 * pixman_fixed_1) - 50 * pixman_fixed_1;
+
+    scaled = transform.matrix[0][1] == 0 && transform.matrix[1][0] == 0;
+
+    params = create_params (
+	&n_params, transform.matrix[0][0], transform.matrix[1][1]);
+
+    pixman_image_set_transform (src, &transform);
+    pixman_image_set_repeat (src, repeat_mode);
+    pixman_image_set_filter (
+	src, PIXMAN_FILTER_SEPARABLE_CONVOLUTION, params, n_params);
+
+    pixman_image_composite32 (PIXMAN_OP_SRC, src, NULL, dest,
+			      0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+
+    for (y = 0; y < HEIGHT && result; ++y)
+    {
+	pixman_vector_t v;
+
+	/* Step along the scanline like the fetchers do */
+	v.vector[0] = pixman_int_to_fixed (0) + pixman_fixed_1 / 2;
+	v.vector[1] = pixman_int_to_fixed (y) + pixman_fixed_1 / 2;
+	v.vector[2] = pixman_fixed_1;
+
+	if (!pixman_transform_point_3d (&transform, &v))
+	    continue;
+
+	for (x = 0; x < WIDTH; ++x)
+	{
+	    uint32_t pixel = dest_bits[y * WIDTH + x];
+	    uint32_t expected = reference_pixel (
+		src_bits, src_width, src_height, has_alpha, repeat_mode,
+		params, v.vector[0], v.vector[1]);
+
+	    if (scaled && pixel != expected)
+	    {
+		expected = reference_scaled_pixel (
+		    src_bits, src_width, src_height, has_alpha, repeat_mode,
+		    params, v.vector[0], v.vector[1]);
+	    }
+
+	    if (pixel != expected)
+	    {
+		printf ("%08x != %08x at %d, %d\n", pixel, expected, x, y);
+		result = FALSE;
+		break;
+	    }
+
+	    v.vector[0] += transform.matrix[0][0];
+	    v.vector[1] += transform.matrix[1][0];
+	}
+    }
+
+    pixman_image_unref (src);
+    pixman_image_unref (dest);
+    free (src_bits);
+    free (params);
+
+    return result;
+}
+
+static pixman_bool_t
+test_tiles (int seed)
+{
+    static const pixman_repeat_t repeats[] =
+    {
+	PIXMAN_REPEAT_NONE, PIXMAN_REPEAT_NORMAL,
+	PIXMAN_REPEAT_PAD, PIXMAN_REPEAT_REFLECT
+    };
+    pixman_image_t *src, *wide, *tiled;
+    pixman_transform_t transform;
+    pixman_fixed_t *params;
+    uint32_t *src_bits;
+    int src_width, src_height, n_params, x;
+    pixman_bool_t result;
+
+    prng_srand (seed);
+
+    src_width = prng_rand_n (2000) + 1;
+    src_height = prng_rand_n (200) + 1;
+    src_bits = malloc (src_width * src_height * 4);
+    prng_randmemset (src_bits, src_width * src_height * 4, 0);
+
+    src = pixman_image_create_bits (
+	prng_rand_n (2) ? PIXMAN_a8r8g8b8 : PIXMAN_x8r8g8b8,
+	src_width, src_height, src_bits, src_width * 4);
+    wide = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDE_WIDTH, WIDE_HEIGHT, NULL, -1);
+    tiled = pixman_image_create_bits (
+	PIXMAN_a8r8g8b8, WIDE_WIDTH, WIDE_HEIGHT, NULL, -1);
+
+    /* Up to 4x in either direction, only sometimes sheared */
+    pixman_transform_init_identity (&transform);
+    transform.matrix[0][0] = prng_rand_n (4 * pixman_fixed_1) + pixman_fixed_1 / 4;
+    transform.matrix[1][1] = prng_rand_n (4 * pixman_fixed_1) + pixman_fixed_1 / 4;
+    if (prng_rand_n (4) == 0)
+	transform.matrix[0][1] = prng_rand_n (pixman_fixed_1) - pixman_fixed_1 / 2;
+    transform.matrix[0][2] = prng_rand_n (100 * pixman_fixed_1) - 50 * pixman_fixed_1;
+    transform.matrix[1][2] = prng_rand_n (100 * pixman_fixed_1) - 50 * pixman_fixed_1;
+
+    params = create_params (
+	&n_params, transform.matrix[0][0], transform.matrix[1][1]);
+
+    pixman_image_set_transform (src, &transform);
+    pixman_image_set_repeat (src, repeats[prng_rand_n (4)]);
+    pixman_image_set_filter (
+	src, PIXMAN_FILTER_SEPARABLE_CONVOLUTION, params, n_params);
+
+    pixman_image_composite32 (PIXMAN_OP_SRC, src, NULL, wide,
+			      0, 0, 0, 0, 0, 0, WIDE_WIDTH, WIDE_HEIGHT);
+
+    for (x = 0; x < WIDE_WIDTH; x += TILE_WIDTH)
+    {
+	pixman_image_composite32 (PIXMAN_OP_SRC, src, NULL, tiled,
+				  x, 0, 0, 0, x, 0, TILE_WIDTH, WIDE_HEIGHT);
+    }
+
+    result = memcmp (pixman_image_get_data (wide),
+		     pixman_image_get_data (tiled),
+		     WIDE_WIDTH * WIDE_HEIGHT * 4) == 0;
+
+    pixman_image_unref (src);
+    pixman_image_unref (wide);
+    pixman_image_unref (tiled);
+    free (src_bits);
+    free (params);
+
+    return result;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("separable convolution test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    for (i = 0; i < N_WIDE_TESTS; ++i)
+    {
+	if (!test_tiles (i))
+	{
+	    printf ("tiles differ from the wide composite for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("separable convolution test passed\n");
+
+    return 0;
+}
@@ -15,6 +15,10 @@
 #include <unistd.h>
 #endif
 
+#ifdef CAN_RUN_IMPLEMENTATIONS
+#include <sys/wait.h>
+#endif
+
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
@@ -433,6 +437,42 @@ make_random_bytes (int n_bytes)
     return bytes;
 }
 
+pixman_image_t *
+make_random_image (pixman_format_code_t format, int width, int height)
+{
+    pixman_image_t *image =
+	pixman_image_create_bits (format, width, height, NULL, -1);
+
+    prng_randmemset (pixman_image_get_data (image),
+		     pixman_image_get_stride (image) * height, 0);
+
+    return image;
+}
+
+pixman_image_t *
+make_random_glyph_image (pixman_format_code_t    format,
+			 int                     width,
+			 int                     height,
+			 prng_randmemset_flags_t flags)
+{
+    pixman_image_t *image =
+	pixman_image_create_bits (format, width, height, NULL, -1);
+
+    prng_randmemset (pixman_image_get_data (image),
+		     pixman_image_get_stride (image) * height, flags);
+
+    if (PIXMAN_FORMAT_A (format) && PIXMAN_FORMAT_RGB (format))
+	pixman_image_set_component_alpha (image, TRUE);
+
+    return image;
+}
+
+void *
+glyph_key (int k)
+{
+    return (void *)(uintptr_t)(k + 1);
+}
+
 void
 a8r8g8b8_to_rgba_np (uint32_t *dst, uint32_t *src, int n_pixels)
 {
@@ -729,6 +769,94 @@ gettime (void)
 #endif
 }
 
+#ifdef CAN_RUN_IMPLEMENTATIONS
+
+static pixman_bool_t
+run_implementation (const char             *argv0,
+		    const implementation_t *implementation,
+		    uint32_t               *crc)
+{
+    char *args[3], line[128];
+    unsigned int value = 0;
+    int fds[2];
+    FILE *f;
+    pid_t pid;
+    int status;
+
+    fflush (stdout);
+
+    if (crc && pipe (fds) < 0)
+	return FALSE;
+
+    if ((pid = fork ()) == 0)
+    {
+	if (crc)
+	{
+	    close (fds[0]);
+	    dup2 (fds[1], STDOUT_FILENO);
+	    close (fds[1]);
+	}
+
+	setenv ("PIXMAN_DISABLE", implementation->disable, 1);
+
+	args[0] = (char *)argv0;
+	args[1] = (char *)implementation->name;
+	args[2] = NULL;
+
+	execv (argv0, args);
+	_exit (1);
+    }
+
+    if (crc)
+    {
+	/* pixman prints which implementations are disabled, so the CRC
+	 * has its own line.
+	 */
+	close (fds[1]);
+
+	if ((f = fdopen (fds[0], "r")))
+	{
+	    while (fgets (line, sizeof (line), f))
+		sscanf (line, "crc %x", &value);
+
+	    fclose (f);
+	}
+	else
+	{
+	    close (fds[0]);
+	}
+
+	*crc = value;
+    }
+
+    return pid >= 0 && waitpid (pid, &status, 0) >= 0 &&
+	WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+pixman_bool_t
+run_implementations (const char             *argv0,
+		     const implementation_t *implementations,
+		     int                     n_implementations,
+		     uint32_t               *crcs)
+{
+    int i;
+
+    for (i = 0; i < n_implementations; ++i)
+    {
+	if (!run_implementation (argv0, &implementations[i],
+				 crcs ? &crcs[i] : NULL))
+	{
+	    printf ("failed to run the %s implementation\n",
+		    implementations[i].name);
+	    return FALSE;
+	}
+    }
+
+    return TRUE;
+}
+
+#endif
+
 uint32_t
 get_random_seed (void)
 {
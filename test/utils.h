@@ -90,10 +90,52 @@ fence_free (void *data);
 uint8_t *
 make_random_bytes (int n_bytes);
 
+/* Create an image with random pixels; pixman_image_unref() frees it */
+pixman_image_t *
+make_random_image (pixman_format_code_t format, int width, int height);
+
+/* Create a glyph image with random pixels, filled with the given
+ * prng_randmemset() flags. Formats with both alpha and color get
+ * component alpha.
+ */
+pixman_image_t *
+make_random_glyph_image (pixman_format_code_t    format,
+			 int                     width,
+			 int                     height,
+			 prng_randmemset_flags_t flags);
+
+/* The glyph cache key for glyph number k >= 0; never NULL */
+void *
+glyph_key (int k);
+
 /* Return current time in seconds */
 double
 gettime (void);
 
+/* pixman chooses its implementation once when it is loaded, so tests
+ * that compare implementations run themselves again for each of them.
+ */
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+#define CAN_RUN_IMPLEMENTATIONS
+#endif
+
+typedef struct
+{
+    const char *name;
+    const char *disable; /* The value of PIXMAN_DISABLE that selects it */
+} implementation_t;
+
+/* Run argv0 once for each implementation, with PIXMAN_DISABLE set and the
+ * name of the implementation as the only argument. If crcs is not NULL,
+ * each run is expected to print a line "crc <hex>", which is stored in
+ * crcs, and its other output is dropped. Returns FALSE if a run fails.
+ */
+pixman_bool_t
+run_implementations (const char             *argv0,
+		     const implementation_t *implementations,
+		     int                     n_implementations,
+		     uint32_t               *crcs);
+
 uint32_t
 get_random_seed (void);
 
@@ -0,0 +1,169 @@
+/*
+ * Checks that linear gradients that are a single color on each row
+ * composite the same with and without an opaque mask. Without a mask
+ * they go through the solid rows fast paths, with it they don't.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+#define WIDTH		300
+#define HEIGHT		80
+#define N_ITERATIONS	400
+
+static pixman_image_t *
+create_gradient (void)
+{
+    pixman_gradient_stop_t stops[3];
+    pixman_point_fixed_t p1, p2;
+    pixman_transform_t transform;
+    pixman_image_t *gradient;
+    pixman_bool_t diagonal;
+    int i, a = 0, b = 1;
+
+    for (i = 0; i < 3; ++i)
+    {
+	stops[i].x = i * pixman_fixed_1 / 2;
+	stops[i].color.red = prng_rand_n (0x10000);
+	stops[i].color.green = prng_rand_n (0x10000);
+	stops[i].color.blue = prng_rand_n (0x10000);
+	stops[i].color.alpha = prng_rand_n (2) ? 0xffff : prng_rand_n (0x10000);
+	stops[i].color.red = MIN (stops[i].color.red, stops[i].color.alpha);
+	stops[i].color.green = MIN (stops[i].color.green, stops[i].color.alpha);
+	stops[i].color.blue = MIN (stops[i].color.blue, stops[i].color.alpha);
+    }
+
+    p1.x = pixman_int_to_fixed (prng_rand_n (WIDTH));
+    p1.y = pixman_int_to_fixed (prng_rand_n (HEIGHT));
+
+    /* Vertical gradients, and diagonal ones along (a, b) that the
+     * transformation below turns so that they are constant along the
+     * x axis of the destination.
+     */
+    diagonal = prng_rand_n (2);
+    if (diagonal)
+    {
+	int length = prng_rand_n (pixman_int_to_fixed (HEIGHT) / 8) + 1;
+
+	a = prng_rand_n (17) - 8;
+	b = prng_rand_n (8) + 1;
+
+	p2.x = p1.x + a * length;
+	p2.y = p1.y + b * length;
+    }
+    else
+    {
+	p2.x = p1.x;
+	p2.y = p1.y + pixman_int_to_fixed (prng_rand_n (HEIGHT) + 1);
+    }
+
+    gradient = pixman_image_create_linear_gradient (&p1, &p2, stops, 3);
+
+    pixman_image_set_repeat (gradient, prng_rand_n (4));
+
+    if (diagonal || prng_rand_n (2))
+    {
+	/* Any transformation that maps the x axis onto a line along
+	 * which the gradient doesn't change. For the diagonal gradients
+	 * that takes a rotation or a skew.
+	 */
+	pixman_transform_init_identity (&transform);
+	if (diagonal)
+	{
+	    int m = prng_rand_n (0x4000) + 1;
+
+	    transform.matrix[0][0] = b * m;
+	    transform.matrix[1][0] = -a * m;
+	}
+	else
+	{
+	    transform.matrix[0][0] = prng_rand_n (0x40000) - 0x20000;
+	}
+	transform.matrix[0][1] = prng_rand_n (0x40000) - 0x20000;
+	transform.matrix[1][1] = prng_rand_n (0x40000) - 0x20000;
+	transform.matrix[0][2] = prng_rand_n (0x1000000) - 0x800000;
+	transform.matrix[1][2] = prng_rand_n (0x1000000) - 0x800000;
+
+	pixman_image_set_transform (gradient, &transform);
+    }
+
+    return gradient;
+}
+
+static pixman_bool_t
+test_one (int seed)
+{
+    static uint32_t mask_bits[WIDTH * HEIGHT / 4];
+    uint32_t bits[2][WIDTH * HEIGHT];
+    pixman_image_t *gradient, *mask, *dest[2];
+    pixman_format_code_t format;
+    pixman_op_t op;
+    int i, x, y, w, h, src_x, src_y;
+
+    prng_srand (seed);
+
+    gradient = create_gradient ();
+    /* An opaque solid mask would be optimized away */
+    memset (mask_bits, 0xff, sizeof (mask_bits));
+    mask = pixman_image_create_bits (
+	PIXMAN_a8, WIDTH, HEIGHT, mask_bits, WIDTH);
+
+    format = prng_rand_n (2) ? PIXMAN_a8r8g8b8 : PIXMAN_x8r8g8b8;
+    op = prng_rand_n (2) ? PIXMAN_OP_OVER : PIXMAN_OP_SRC;
+
+    prng_randmemset (bits[0], sizeof (bits[0]), 0);
+    memcpy (bits[1], bits[0], sizeof (bits[0]));
+
+    x = prng_rand_n (WIDTH);
+    y = prng_rand_n (HEIGHT);
+    w = prng_rand_n (WIDTH - x) + 1;
+    h = prng_rand_n (HEIGHT - y) + 1;
+    src_x = prng_rand_n (200) - 100;
+    src_y = prng_rand_n (200) - 100;
+
+    for (i = 0; i < 2; ++i)
+    {
+	dest[i] = pixman_image_create_bits (
+	    format, WIDTH, HEIGHT, bits[i], WIDTH * 4);
+
+	pixman_image_composite32 (op, gradient, i ? mask : NULL, dest[i],
+				  src_x, src_y, x, y, x, y, w, h);
+    }
+
+    pixman_image_unref (gradient);
+    pixman_image_unref (mask);
+    pixman_image_unref (dest[0]);
+    pixman_image_unref (dest[1]);
+
+    for (i = 0; i < WIDTH * HEIGHT; ++i)
+    {
+	uint32_t m = format == PIXMAN_x8r8g8b8 ? 0x00ffffff : 0xffffffff;
+
+	if ((bits[0][i] & m) != (bits[1][i] & m))
+	{
+	    printf ("%08x != %08x at %d\n", bits[0][i], bits[1][i], i);
+	    return FALSE;
+	}
+    }
+
+    return TRUE;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("vertical gradient test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("vertical gradient test passed\n");
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Checks that rectangles that are wider than the scanline buffers of
+ * the general implementation composite like they do in narrower tiles.
+ * Horizontal linear gradients are only computed once, when their
+ * iterator is set up, so they would show it if the column chunks of a
+ * wide row overwrote each other's buffers. The gradients are a power of
+ * two pixels long, so that their positions are exact whichever column
+ * they are computed from, and the results have to be identical.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define WIDTH		5000
+#define HEIGHT		4
+#define TILE_WIDTH	500
+#define N_ITERATIONS	40
+
+static const pixman_op_t operators[] =
+{
+    PIXMAN_OP_SRC,
+    PIXMAN_OP_OVER,
+    PIXMAN_OP_ADD,
+    PIXMAN_OP_HARD_LIGHT,
+};
+
+/* a2r10g10b10 isn't a narrow format, so it takes the wide path */
+static const pixman_format_code_t formats[] =
+{
+    PIXMAN_a8r8g8b8,
+    PIXMAN_a2r10g10b10,
+};
+
+static pixman_image_t *
+create_gradient (void)
+{
+    pixman_gradient_stop_t stops[2];
+    pixman_point_fixed_t p1, p2;
+    pixman_image_t *gradient;
+    int i;
+
+    for (i = 0; i < 2; ++i)
+    {
+	stops[i].x = i * pixman_fixed_1;
+	stops[i].color.alpha = prng_rand_n (2) ? 0xffff : prng_rand_n (0x10000);
+	stops[i].color.red = prng_rand_n (stops[i].color.alpha + 1);
+	stops[i].color.green = prng_rand_n (stops[i].color.alpha + 1);
+	stops[i].color.blue = prng_rand_n (stops[i].color.alpha + 1);
+    }
+
+    p1.x = pixman_int_to_fixed (prng_rand_n (WIDTH) - WIDTH / 2);
+    p2.x = p1.x + pixman_int_to_fixed (1024 << prng_rand_n (4));
+    p1.y = p2.y = pixman_int_to_fixed (prng_rand_n (HEIGHT));
+
+    gradient = pixman_image_create_linear_gradient (&p1, &p2, stops, 2);
+    pixman_image_set_repeat (gradient, prng_rand_n (4));
+
+    return gradient;
+}
+
+static pixman_bool_t
+test_one (int seed)
+{
+    pixman_image_t *src, *whole, *tiled;
+    pixman_format_code_t format;
+    pixman_op_t op;
+    pixman_bool_t ok;
+    int x;
+
+    prng_srand (seed);
+
+    src = create_gradient ();
+    op = operators[prng_rand_n (ARRAY_LENGTH (operators))];
+    format = formats[prng_rand_n (ARRAY_LENGTH (formats))];
+
+    whole = make_random_image (format, WIDTH, HEIGHT);
+    tiled = pixman_image_create_bits (format, WIDTH, HEIGHT, NULL, -1);
+    memcpy (pixman_image_get_data (tiled), pixman_image_get_data (whole),
+	    pixman_image_get_stride (whole) * HEIGHT);
+
+    pixman_image_composite32 (op, src, NULL, whole,
+			      0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+
+    for (x = 0; x < WIDTH; x += TILE_WIDTH)
+    {
+	pixman_image_composite32 (op, src, NULL, tiled,
+				  x, 0, 0, 0, x, 0, TILE_WIDTH, HEIGHT);
+    }
+
+    ok = memcmp (pixman_image_get_data (whole), pixman_image_get_data (tiled),
+		 pixman_image_get_stride (whole) * HEIGHT) == 0;
+
+    if (!ok)
+	printf ("%s onto %s differs\n", operator_name (op), format_name (format));
+
+    pixman_image_unref (src);
+    pixman_image_unref (whole);
+    pixman_image_unref (tiled);
+
+    return ok;
+}
+
+int
+main (int argc, const char *argv[])
+{
+    int i;
+
+    for (i = 0; i < N_ITERATIONS; ++i)
+    {
+	if (!test_one (i))
+	{
+	    printf ("wide gradient test failed for seed %d\n", i);
+	    return 1;
+	}
+    }
+
+    printf ("wide gradient test passed\n");
+
+    return 0;
+}